@@ -181,3 +181,11 @@ def load_boot_logo(source, target, env):
 # Load the boot logo on TFT builds
 if ("HAS_TFT", 1) in env.get("CPPDEFINES", []):
     env.AddPreAction('$BUILD_DIR/littlefs.bin', load_boot_logo)
+
+def pack_webapp(source, target, env):
+    # Gzipped web app and its manifest, see bin/webapp-pack.py
+    env.Execute(f"\"{sys.executable}\" {join(env['PROJECT_DIR'], 'bin', 'webapp-pack.py')}")
+
+# Pack the web app into the filesystem image on WiFi AP builds
+if any(d == "ENABLE_WIFI_AP" or (isinstance(d, tuple) and d[0] == "ENABLE_WIFI_AP") for d in env.get("CPPDEFINES", [])):
+    env.AddPreAction('$BUILD_DIR/littlefs.bin', pack_webapp)
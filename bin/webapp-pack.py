@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Pack the web app for LittleFS.
+
+Every file under webapp/ is gzipped into data/webapp/<name>.gz, and data/webapp/assets.txt lists them for the firmware
+as "<url> <hash> <max-age> <content-type>" lines (see src/wifi/WebAssets.h).  The hash, of the uncompressed file, is
+the ETag.  precache.json lists every URL and a version derived from all the hashes, for the service worker to cache
+the whole UI and notice when a firmware update changed it.
+
+Run by platformio-custom.py before the filesystem image is built, or by hand: bin/webapp-pack.py [src] [dest]
+"""
+import gzip
+import hashlib
+import json
+import os
+import shutil
+import sys
+
+# Entry points are revalidated on every load (a 304 when unchanged), the rest is kept a week
+REVALIDATE = {"/index.html", "/sw.js", "/precache.json"}
+MAX_AGE = 7 * 24 * 3600
+
+TYPES = {
+    ".html": "text/html; charset=utf-8",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".json": "application/json",
+    ".webmanifest": "application/manifest+json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+}
+
+# Must match WEB_ASSET_MAX and WEB_ASSET_URL_MAX in src/wifi/WebAssets.h
+MAX_ASSETS = 16
+MAX_URL = 47
+
+
+def content_hash(data):
+    return hashlib.sha256(data).hexdigest()[:16]
+
+
+def write_gz(path, data):
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    # mtime=0 keeps the image reproducible
+    with open(path, "wb") as f:
+        with gzip.GzipFile(fileobj=f, mode="wb", compresslevel=9, mtime=0) as gz:
+            gz.write(data)
+
+
+def pack(src, dest):
+    files = {}
+    for root, _, names in os.walk(src):
+        for name in sorted(names):
+            path = os.path.join(root, name)
+            url = "/" + os.path.relpath(path, src).replace(os.sep, "/")
+            with open(path, "rb") as f:
+                files[url] = f.read()
+
+    urls = sorted(files)
+    version = content_hash("".join(content_hash(files[u]) for u in urls).encode())
+    precache = {"version": version, "assets": ["/"] + urls + ["/precache.json"]}
+    files["/precache.json"] = json.dumps(precache, indent=1).encode()
+
+    if len(files) > MAX_ASSETS:
+        sys.exit(f"webapp-pack: {len(files)} assets, the firmware only knows {MAX_ASSETS}")
+
+    shutil.rmtree(dest, ignore_errors=True)
+    lines = []
+    raw = packed = 0
+    for url in sorted(files):
+        if len(url) > MAX_URL:
+            sys.exit(f"webapp-pack: {url} is longer than {MAX_URL} characters")
+        ext = os.path.splitext(url)[1]
+        kind = TYPES.get(ext, "application/octet-stream")
+        age = 0 if url in REVALIDATE else MAX_AGE
+        data = files[url]
+        write_gz(dest + url + ".gz", data)
+        lines.append(f"{url} {content_hash(data)} {age} {kind}")
+        raw += len(data)
+        packed += os.path.getsize(dest + url + ".gz")
+
+    with open(os.path.join(dest, "assets.txt"), "w") as f:
+        f.write("# generated by bin/webapp-pack.py, url hash max-age content-type\n")
+        f.write("\n".join(lines) + "\n")
+
+    print(f"webapp-pack: {len(files)} assets, {raw} -> {packed} bytes, version {version}")
+
+
+if __name__ == "__main__":
+    here = os.path.dirname(os.path.abspath(__file__))
+    project = os.path.dirname(here)
+    src = sys.argv[1] if len(sys.argv) > 1 else os.path.join(project, "webapp")
+    dest = sys.argv[2] if len(sys.argv) > 2 else os.path.join(project, "data", "webapp")
+    pack(src, dest)
@@ -25,6 +25,10 @@ void AirTime::logAirtime(reportTypes reportType, uint32_t airtime_ms)
     } else if (reportType == RX_ALL_LOG) {
         LOG_DEBUG("Packet RX (noise?) : %ums", airtime_ms);
         this->airtimes.periodRX_ALL[0] = this->airtimes.periodRX_ALL[0] + airtime_ms;
+    } else if (reportType == TX_SAVED_LOG) {
+        LOG_DEBUG("Packet TX saved: %ums", airtime_ms);
+        this->airtimes.periodTX_SAVED[0] = this->airtimes.periodTX_SAVED[0] + airtime_ms;
+        return; // never went on air
     }
 
     // Log all airtime type for channel utilization
@@ -56,6 +60,7 @@ void AirTime::airtimeRotatePeriod()
             this->airtimes.periodTX[i + 1] = this->airtimes.periodTX[i];
             this->airtimes.periodRX[i + 1] = this->airtimes.periodRX[i];
             this->airtimes.periodRX_ALL[i + 1] = this->airtimes.periodRX_ALL[i];
+            this->airtimes.periodTX_SAVED[i + 1] = this->airtimes.periodTX_SAVED[i];
 
             air_period_tx[i + 1] = this->airtimes.periodTX[i];
             air_period_rx[i + 1] = this->airtimes.periodRX[i];
@@ -64,6 +69,7 @@ void AirTime::airtimeRotatePeriod()
         this->airtimes.periodTX[0] = 0;
         this->airtimes.periodRX[0] = 0;
         this->airtimes.periodRX_ALL[0] = 0;
+        this->airtimes.periodTX_SAVED[0] = 0;
 
         air_period_tx[0] = 0;
         air_period_rx[0] = 0;
@@ -81,6 +87,8 @@ uint32_t *AirTime::airtimeReport(reportTypes reportType)
         return this->airtimes.periodRX;
     } else if (reportType == RX_ALL_LOG) {
         return this->airtimes.periodRX_ALL;
+    } else if (reportType == TX_SAVED_LOG) {
+        return this->airtimes.periodTX_SAVED;
     }
     return 0;
 }
@@ -183,6 +191,7 @@ int32_t AirTime::runOnce()
             this->airtimes.periodTX[i] = 0;
             this->airtimes.periodRX[i] = 0;
             this->airtimes.periodRX_ALL[i] = 0;
+            this->airtimes.periodTX_SAVED[i] = 0;
 
             // air_period_tx[i] = 0;
             // air_period_rx[i] = 0;
@@ -15,6 +15,9 @@
   RX_ALL_LOG  - Time of all received lora packets. This includes packets that are not
                 for meshtastic devices. Does not include TX air time.
 
+  TX_SAVED_LOG - Time on air this device did not have to transmit because several
+                 messages were packed into one packet. Never counted as utilization.
+
   Example analytics:
 
   TX_LOG + RX_LOG = Total air time for a particular meshtastic channel.
@@ -33,7 +36,7 @@
 #define MS_IN_MINUTE (SECONDS_IN_MINUTE * 1000)
 #define MS_IN_HOUR (MINUTES_IN_HOUR * SECONDS_IN_MINUTE * 1000)
 
-enum reportTypes { TX_LOG, RX_LOG, RX_ALL_LOG };
+enum reportTypes { TX_LOG, RX_LOG, RX_ALL_LOG, TX_SAVED_LOG };
 
 void logAirtime(reportTypes reportType, uint32_t airtime_ms);
 
@@ -72,9 +75,10 @@ class AirTime : private concurrency::OSThread
     uint8_t polite_duty_cycle_percent = 50; // half of Duty Cycle allowance is ok for metadata
 
     struct airtimeStruct {
-        uint32_t periodTX[PERIODS_TO_LOG];     // AirTime transmitted
-        uint32_t periodRX[PERIODS_TO_LOG];     // AirTime received and repeated (Only valid mesh packets)
-        uint32_t periodRX_ALL[PERIODS_TO_LOG]; // AirTime received regardless of valid mesh packet. Could include noise.
+        uint32_t periodTX[PERIODS_TO_LOG];       // AirTime transmitted
+        uint32_t periodRX[PERIODS_TO_LOG];       // AirTime received and repeated (Only valid mesh packets)
+        uint32_t periodRX_ALL[PERIODS_TO_LOG];   // AirTime received regardless of valid mesh packet. Could include noise.
+        uint32_t periodTX_SAVED[PERIODS_TO_LOG]; // AirTime not transmitted thanks to message aggregation
         uint8_t lastPeriodIndex;
     } airtimes;
 
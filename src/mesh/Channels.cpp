@@ -263,7 +263,7 @@ int16_t Channels::setCrypto(ChannelIndex chIndex)
         return -1;
     else {
         // Tell our crypto engine about the psk
-        crypto->setKey(k);
+        crypto->setChannelKey(chIndex, k);
         return getHash(chIndex);
     }
 }
@@ -293,6 +293,8 @@ void Channels::onConfigChanged()
         if (ch.role == meshtastic_Channel_Role_PRIMARY)
             primaryIndex = i;
     }
+    // Keys may have changed, drop the expanded key schedules so stale ones don't linger in RAM
+    crypto->invalidateKeyCache();
 #if !MESHTASTIC_EXCLUDE_MQTT
     if (channels.anyMqttEnabled() && mqtt && !mqtt->isEnabled()) {
         LOG_DEBUG("MQTT is enabled on at least one channel, so set MQTT thread to run immediately");
@@ -423,6 +425,24 @@ bool Channels::decryptForHash(ChannelIndex chIndex, ChannelHash channelHash)
     }
 }
 
+bool Channels::getCryptoForHash(ChannelIndex chIndex, ChannelHash channelHash, CryptoContext &ctx)
+{
+    if (chIndex > getNumChannels() || getHash(chIndex) != channelHash)
+        return false;
+    LOG_DEBUG("Use channel %d (hash 0x%x)", chIndex, channelHash);
+    return getCryptoForIndex(chIndex, ctx) >= 0;
+}
+
+int16_t Channels::getCryptoForIndex(ChannelIndex chIndex, CryptoContext &ctx)
+{
+    CryptoKey k = getKey(chIndex);
+    if (k.length < 0)
+        return -1;
+    ctx.key = k;
+    ctx.keySlot = chIndex;
+    return getHash(chIndex);
+}
+
 bool Channels::setDefaultPresetCryptoForHash(ChannelHash channelHash)
 {
     // Iterate all known presets
@@ -83,6 +83,19 @@ class Channels
      */
     int16_t setActiveByIndex(ChannelIndex channelIndex);
 
+    /** Reentrant counterpart of decryptForHash(): fill ctx with the key for chIndex instead of changing the shared crypto
+     * engine state.
+     *
+     * @return false if the channel hash or channel is invalid
+     */
+    bool getCryptoForHash(ChannelIndex chIndex, ChannelHash channelHash, CryptoContext &ctx);
+
+    /** Reentrant counterpart of setActiveByIndex(): fill ctx with the key for chIndex.
+     *
+     * @return the (0 to 255) hash for that channel - if no suitable channel could be found, return -1
+     */
+    int16_t getCryptoForIndex(ChannelIndex chIndex, CryptoContext &ctx);
+
     // Returns true if the channel has the default name and PSK
     bool isDefaultChannel(ChannelIndex chIndex);
 
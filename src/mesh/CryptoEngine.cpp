@@ -1,6 +1,9 @@
 #include "CryptoEngine.h"
 // #include "NodeDB.h"
 #include "architecture.h"
+#ifdef ARCH_PORTDUINO
+#include <mutex>
+#endif
 
 #if !(MESHTASTIC_EXCLUDE_PKI)
 #include "NodeDB.h"
@@ -32,7 +35,9 @@ void CryptoEngine::generateKeyPair(uint8_t *pubKey, uint8_t *privKey)
     CryptRNG.stir((uint8_t *)&noise, sizeof(noise));
 
     LOG_DEBUG("Generate Curve25519 keypair");
+    KeyMaterialLock guard;
     Curve25519::dh1(public_key, private_key);
+    privateKeyChanged();
     memcpy(pubKey, public_key, sizeof(public_key));
     memcpy(privKey, private_key, sizeof(private_key));
 }
@@ -52,8 +57,10 @@ bool CryptoEngine::regeneratePublicKey(uint8_t *pubKey, uint8_t *privKey)
             memset(pubKey, 0, 32);
             return false;
         }
+        KeyMaterialLock guard;
         memcpy(private_key, privKey, sizeof(private_key));
         memcpy(public_key, pubKey, sizeof(public_key));
+        privateKeyChanged();
     } else {
         LOG_WARN("X25519 key generation failed due to blank private key");
         return false;
@@ -63,8 +70,83 @@ bool CryptoEngine::regeneratePublicKey(uint8_t *pubKey, uint8_t *privKey)
 #endif
 void CryptoEngine::clearKeys()
 {
+    KeyMaterialLock guard;
     memset(public_key, 0, sizeof(public_key));
     memset(private_key, 0, sizeof(private_key));
+    privateKeyChanged();
+}
+
+void CryptoEngine::forgetSharedKey(const uint8_t *remotePublic)
+{
+    KeyMaterialLock guard;
+    for (auto &e : sharedKeyCache) {
+        if (e.lastUsed && memcmp(e.remotePublic, remotePublic, sizeof(e.remotePublic)) == 0)
+            memset(&e, 0, sizeof(e));
+    }
+}
+
+void CryptoEngine::clearSharedKeyCache()
+{
+    KeyMaterialLock guard;
+    memset(sharedKeyCache, 0, sizeof(sharedKeyCache));
+    sharedKeyUseCounter = 0;
+}
+
+void CryptoEngine::privateKeyChanged()
+{
+    memset(sharedKeyCache, 0, sizeof(sharedKeyCache));
+    sharedKeyUseCounter = 0;
+    privateKeyGeneration++;
+}
+
+bool CryptoEngine::deriveSharedKey(const uint8_t *remotePublic, uint8_t *sharedOut)
+{
+    uint8_t localPriv[32];
+    uint32_t generation;
+    {
+        KeyMaterialLock guard;
+        for (auto &e : sharedKeyCache) {
+            if (e.lastUsed && memcmp(e.remotePublic, remotePublic, sizeof(e.remotePublic)) == 0) {
+                e.lastUsed = ++sharedKeyUseCounter;
+                memcpy(sharedOut, e.sharedKey, sizeof(e.sharedKey));
+                sharedKeyHits++;
+                return true;
+            }
+        }
+        sharedKeyMisses++;
+        memcpy(localPriv, private_key, sizeof(localPriv));
+        generation = privateKeyGeneration;
+    }
+
+    // The expensive part runs without the lock, on our own copies of the keys
+    memcpy(sharedOut, remotePublic, 32);
+    bool ok = Curve25519::dh2(sharedOut, localPriv);
+    memset(localPriv, 0, sizeof(localPriv));
+    if (!ok) {
+        LOG_WARN("Curve25519DH step 2 failed!");
+        return false;
+    }
+    hash(sharedOut, 32);
+
+    KeyMaterialLock guard;
+    if (generation != privateKeyGeneration)
+        return true; // our key changed meanwhile, don't cache a secret derived from the old one
+    if (sharedKeyUseCounter == UINT32_MAX)
+        privateKeyChanged(); // keep lastUsed ordering valid, a refill is cheap compared to getting LRU wrong
+    SharedKeyCacheEntry *victim = &sharedKeyCache[0];
+    for (auto &e : sharedKeyCache) {
+        if (e.lastUsed && memcmp(e.remotePublic, remotePublic, sizeof(e.remotePublic)) == 0) {
+            victim = &e; // another thread got here first
+            break;
+        }
+        if (e.lastUsed < victim->lastUsed)
+            victim = &e;
+    }
+    memset(victim, 0, sizeof(*victim));
+    memcpy(victim->remotePublic, remotePublic, sizeof(victim->remotePublic));
+    memcpy(victim->sharedKey, sharedOut, sizeof(victim->sharedKey));
+    victim->lastUsed = ++sharedKeyUseCounter;
+    return true;
 }
 
 /**
@@ -81,6 +163,17 @@ void CryptoEngine::clearKeys()
  */
 bool CryptoEngine::encryptCurve25519(uint32_t toNode, uint32_t fromNode, meshtastic_UserLite_public_key_t remotePublic,
                                      uint64_t packetNum, size_t numBytes, const uint8_t *bytes, uint8_t *bytesOut)
+{
+    CryptoContext ctx;
+    bool ok = encryptCurve25519(ctx, toNode, fromNode, remotePublic, packetNum, numBytes, bytes, bytesOut);
+    memcpy(nonce, ctx.nonce, sizeof(nonce));
+    memcpy(shared_key, ctx.key.bytes, sizeof(shared_key));
+    return ok;
+}
+
+bool CryptoEngine::encryptCurve25519(CryptoContext &ctx, uint32_t toNode, uint32_t fromNode,
+                                     meshtastic_UserLite_public_key_t remotePublic, uint64_t packetNum, size_t numBytes,
+                                     const uint8_t *bytes, uint8_t *bytesOut)
 {
     uint8_t *auth;
     long extraNonceTmp = random();
@@ -92,16 +185,16 @@ bool CryptoEngine::encryptCurve25519(uint32_t toNode, uint32_t fromNode, meshtas
         LOG_DEBUG("Node %d or their public_key not found", toNode);
         return false;
     }
-    if (!setDHPublicKey(remotePublic.bytes)) {
+    if (!deriveSharedKey(remotePublic.bytes, ctx.key.bytes)) {
         return false;
     }
-    hash(shared_key, 32);
-    initNonce(fromNode, packetNum, extraNonceTmp);
+    ctx.key.length = 32;
+    initNonce(ctx.nonce, fromNode, packetNum, extraNonceTmp);
 
     // Calculate the shared secret with the destination node and encrypt
-    printBytes("Attempt encrypt with nonce: ", nonce, 13);
-    printBytes("Attempt encrypt with shared_key starting with: ", shared_key, 8);
-    aes_ccm_ae(shared_key, 32, nonce, 8, bytes, numBytes, nullptr, 0, bytesOut,
+    printBytes("Attempt encrypt with nonce: ", ctx.nonce, 13);
+    printBytes("Attempt encrypt with shared_key starting with: ", ctx.key.bytes, 8);
+    aes_ccm_ae(ctx.key.bytes, 32, ctx.nonce, 8, bytes, numBytes, nullptr, 0, bytesOut,
                auth); // this can write up to 15 bytes longer than numbytes past bytesOut
     memcpy((uint8_t *)(auth + 8), &extraNonceTmp,
            sizeof(uint32_t)); // do not use dereference on potential non aligned pointers : *extraNonce = extraNonceTmp;
@@ -121,6 +214,16 @@ bool CryptoEngine::encryptCurve25519(uint32_t toNode, uint32_t fromNode, meshtas
  */
 bool CryptoEngine::decryptCurve25519(uint32_t fromNode, meshtastic_UserLite_public_key_t remotePublic, uint64_t packetNum,
                                      size_t numBytes, const uint8_t *bytes, uint8_t *bytesOut)
+{
+    CryptoContext ctx;
+    bool ok = decryptCurve25519(ctx, fromNode, remotePublic, packetNum, numBytes, bytes, bytesOut);
+    memcpy(nonce, ctx.nonce, sizeof(nonce));
+    memcpy(shared_key, ctx.key.bytes, sizeof(shared_key));
+    return ok;
+}
+
+bool CryptoEngine::decryptCurve25519(CryptoContext &ctx, uint32_t fromNode, meshtastic_UserLite_public_key_t remotePublic,
+                                     uint64_t packetNum, size_t numBytes, const uint8_t *bytes, uint8_t *bytesOut)
 {
     const uint8_t *auth = bytes + numBytes - 12; // set to last 8 bytes of text?
     uint32_t extraNonce;                         // pointer was not really used
@@ -134,20 +237,22 @@ bool CryptoEngine::decryptCurve25519(uint32_t fromNode, meshtastic_UserLite_publ
     }
 
     // Calculate the shared secret with the sending node and decrypt
-    if (!setDHPublicKey(remotePublic.bytes)) {
+    if (!deriveSharedKey(remotePublic.bytes, ctx.key.bytes)) {
         return false;
     }
-    hash(shared_key, 32);
+    ctx.key.length = 32;
 
-    initNonce(fromNode, packetNum, extraNonce);
-    printBytes("Attempt decrypt with nonce: ", nonce, 13);
-    printBytes("Attempt decrypt with shared_key starting with: ", shared_key, 8);
-    return aes_ccm_ad(shared_key, 32, nonce, 8, bytes, numBytes - 12, nullptr, 0, auth, bytesOut);
+    initNonce(ctx.nonce, fromNode, packetNum, extraNonce);
+    printBytes("Attempt decrypt with nonce: ", ctx.nonce, 13);
+    printBytes("Attempt decrypt with shared_key starting with: ", ctx.key.bytes, 8);
+    return aes_ccm_ad(ctx.key.bytes, 32, ctx.nonce, 8, bytes, numBytes - 12, nullptr, 0, auth, bytesOut);
 }
 
 void CryptoEngine::setDHPrivateKey(uint8_t *_private_key)
 {
+    KeyMaterialLock guard;
     memcpy(private_key, _private_key, 32);
+    privateKeyChanged();
 }
 
 /**
@@ -204,10 +309,75 @@ bool CryptoEngine::setDHPublicKey(uint8_t *pubKey)
 #endif
 concurrency::Lock *cryptLock;
 
+#ifdef ARCH_PORTDUINO
+// concurrency::Lock compiles to nothing on native, but there the API, MQTT and UDP threads really do run in parallel
+static std::mutex keyMaterialMutex;
+
+CryptoEngine::KeyMaterialLock::KeyMaterialLock()
+{
+    keyMaterialMutex.lock();
+}
+
+CryptoEngine::KeyMaterialLock::~KeyMaterialLock()
+{
+    keyMaterialMutex.unlock();
+}
+#else
+// cryptLock is created along with the Router, before that there is nobody to race with
+CryptoEngine::KeyMaterialLock::KeyMaterialLock() : held(cryptLock)
+{
+    if (held)
+        held->lock();
+}
+
+CryptoEngine::KeyMaterialLock::~KeyMaterialLock()
+{
+    if (held)
+        held->unlock();
+}
+#endif
+
 void CryptoEngine::setKey(const CryptoKey &k)
 {
     LOG_DEBUG("Use AES%d key!", k.length * 8);
     key = k;
+    keySlot = CRYPTO_KEY_CACHE_SLOTS - 1;
+}
+
+void CryptoEngine::setChannelKey(uint8_t chIndex, const CryptoKey &k)
+{
+    if (chIndex >= MAX_NUM_CHANNELS) {
+        setKey(k);
+        return;
+    }
+    LOG_DEBUG("Use AES%d key!", k.length * 8);
+    key = k;
+    keySlot = chIndex;
+}
+
+void CryptoEngine::invalidateKeyCache()
+{
+    KeyMaterialLock guard;
+    for (uint8_t i = 0; i < CRYPTO_KEY_CACHE_SLOTS; i++) {
+        delete ctrs[i];
+        ctrs[i] = nullptr;
+    }
+    memset(cachedKeys, 0, sizeof(cachedKeys));
+}
+
+static bool sameKey(const CryptoKey &a, const CryptoKey &b)
+{
+    return a.length > 0 && a.length == b.length && memcmp(a.bytes, b.bytes, a.length) == 0;
+}
+
+uint8_t CryptoEngine::lookupKeySlot(const CryptoKey &k, uint8_t slot, bool &needExpand)
+{
+    if (slot >= CRYPTO_KEY_CACHE_SLOTS)
+        slot = CRYPTO_KEY_CACHE_SLOTS - 1;
+    needExpand = !sameKey(k, cachedKeys[slot]);
+    if (needExpand)
+        cachedKeys[slot] = k;
+    return slot;
 }
 
 /**
@@ -217,40 +387,55 @@ void CryptoEngine::setKey(const CryptoKey &k)
  */
 void CryptoEngine::encryptPacket(uint32_t fromNode, uint64_t packetId, size_t numBytes, uint8_t *bytes)
 {
-    if (key.length > 0) {
-        initNonce(fromNode, packetId);
+    CryptoContext ctx;
+    ctx.key = key;
+    ctx.keySlot = keySlot;
+    encryptPacket(ctx, fromNode, packetId, numBytes, bytes);
+    memcpy(nonce, ctx.nonce, sizeof(nonce));
+}
+
+void CryptoEngine::decrypt(uint32_t fromNode, uint64_t packetId, size_t numBytes, uint8_t *bytes)
+{
+    // For CTR, the implementation is the same
+    encryptPacket(fromNode, packetId, numBytes, bytes);
+}
+
+void CryptoEngine::encryptPacket(CryptoContext &ctx, uint32_t fromNode, uint64_t packetId, size_t numBytes, uint8_t *bytes)
+{
+    if (ctx.key.length > 0) {
+        initNonce(ctx.nonce, fromNode, packetId);
         if (numBytes <= MAX_BLOCKSIZE) {
-            encryptAESCtr(key, nonce, numBytes, bytes);
+            encryptAESCtr(ctx.key, ctx.keySlot, ctx.nonce, numBytes, bytes);
         } else {
             LOG_ERROR("Packet too large for crypto engine: %d. noop encryption!", numBytes);
         }
     }
 }
 
-void CryptoEngine::decrypt(uint32_t fromNode, uint64_t packetId, size_t numBytes, uint8_t *bytes)
+void CryptoEngine::decrypt(CryptoContext &ctx, uint32_t fromNode, uint64_t packetId, size_t numBytes, uint8_t *bytes)
 {
     // For CTR, the implementation is the same
-    encryptPacket(fromNode, packetId, numBytes, bytes);
+    encryptPacket(ctx, fromNode, packetId, numBytes, bytes);
 }
 
 // Generic implementation of AES-CTR encryption.
-void CryptoEngine::encryptAESCtr(CryptoKey _key, uint8_t *_nonce, size_t numBytes, uint8_t *bytes)
-{
-    delete ctr;
-    ctr = nullptr;
-    if (_key.length == 16)
-        ctr = new CTR<AES128>();
-    else
-        ctr = new CTR<AES256>();
-    ctr->setKey(_key.bytes, _key.length);
-    static uint8_t scratch[MAX_BLOCKSIZE];
-    memcpy(scratch, bytes, numBytes);
-    memset(scratch + numBytes, 0,
-           sizeof(scratch) - numBytes); // Fill rest of buffer with zero (in case cypher looks at it)
-
+void CryptoEngine::encryptAESCtr(const CryptoKey &_key, uint8_t _keySlot, uint8_t *_nonce, size_t numBytes, uint8_t *bytes)
+{
+    KeyMaterialLock guard;
+    bool needExpand;
+    uint8_t slot = lookupKeySlot(_key, _keySlot, needExpand);
+    if (needExpand || !ctrs[slot]) {
+        delete ctrs[slot];
+        if (_key.length == 16)
+            ctrs[slot] = new CTR<AES128>();
+        else
+            ctrs[slot] = new CTR<AES256>();
+        ctrs[slot]->setKey(_key.bytes, _key.length);
+    }
+    CTRCommon *ctr = ctrs[slot];
     ctr->setIV(_nonce, 16);
     ctr->setCounterSize(4);
-    ctr->encrypt(bytes, scratch, numBytes);
+    ctr->encrypt(bytes, bytes, numBytes); // CTR only xors a keystream, so working in place is fine
 }
 
 /**
@@ -258,13 +443,18 @@ void CryptoEngine::encryptAESCtr(CryptoKey _key, uint8_t *_nonce, size_t numByte
  */
 void CryptoEngine::initNonce(uint32_t fromNode, uint64_t packetId, uint32_t extraNonce)
 {
-    memset(nonce, 0, sizeof(nonce));
+    initNonce(nonce, fromNode, packetId, extraNonce);
+}
+
+void CryptoEngine::initNonce(uint8_t *nonceOut, uint32_t fromNode, uint64_t packetId, uint32_t extraNonce)
+{
+    memset(nonceOut, 0, 16);
 
     // use memcpy to avoid breaking strict-aliasing
-    memcpy(nonce, &packetId, sizeof(uint64_t));
-    memcpy(nonce + sizeof(uint64_t), &fromNode, sizeof(uint32_t));
+    memcpy(nonceOut, &packetId, sizeof(uint64_t));
+    memcpy(nonceOut + sizeof(uint64_t), &fromNode, sizeof(uint32_t));
     if (extraNonce)
-        memcpy(nonce + sizeof(uint32_t), &extraNonce, sizeof(uint32_t));
+        memcpy(nonceOut + sizeof(uint32_t), &extraNonce, sizeof(uint32_t));
 }
 #ifndef HAS_CUSTOM_CRYPTO_ENGINE
 CryptoEngine *crypto = new CryptoEngine;
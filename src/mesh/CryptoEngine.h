@@ -21,6 +21,28 @@ struct CryptoKey {
  */
 
 #define MAX_BLOCKSIZE 256
+
+#ifndef PKI_SHARED_KEY_CACHE_SIZE
+#ifdef ARCH_PORTDUINO
+#define PKI_SHARED_KEY_CACHE_SIZE 64 // native gateways terminate DMs for many nodes
+#else
+#define PKI_SHARED_KEY_CACHE_SIZE 8
+#endif
+#endif
+
+/// One expanded AES context per channel, plus one for keys that were not set through setChannelKey()
+#define CRYPTO_KEY_CACHE_SLOTS (MAX_NUM_CHANNELS + 1)
+
+/**
+ * Per packet crypto state: the key to use and the nonce being built.  Owned by the caller (usually on its stack) so several
+ * threads can push packets through the engine at once, see the CryptoContext overloads in CryptoEngine.
+ */
+struct CryptoContext {
+    CryptoKey key = {};
+    /// Which cached key schedule belongs to `key`, CRYPTO_KEY_CACHE_SLOTS - 1 if it is not a channel key
+    uint8_t keySlot = CRYPTO_KEY_CACHE_SLOTS - 1;
+    uint8_t nonce[16] = {0};
+};
 #define TEST_CURVE25519_FIELD_OPS // Exposes Curve25519::isWeakPoint() for testing keys
 
 class CryptoEngine
@@ -44,6 +66,20 @@ class CryptoEngine
     virtual bool decryptCurve25519(uint32_t fromNode, meshtastic_UserLite_public_key_t remotePublic, uint64_t packetNum,
                                    size_t numBytes, const uint8_t *bytes, uint8_t *bytesOut);
     virtual bool setDHPublicKey(uint8_t *publicKey);
+
+    /// Reentrant variants of encrypt/decryptCurve25519, the shared key and nonce end up in ctx instead of this engine
+    bool encryptCurve25519(CryptoContext &ctx, uint32_t toNode, uint32_t fromNode, meshtastic_UserLite_public_key_t remotePublic,
+                           uint64_t packetNum, size_t numBytes, const uint8_t *bytes, uint8_t *bytesOut);
+    bool decryptCurve25519(CryptoContext &ctx, uint32_t fromNode, meshtastic_UserLite_public_key_t remotePublic,
+                           uint64_t packetNum, size_t numBytes, const uint8_t *bytes, uint8_t *bytesOut);
+
+    /// Drop the cached shared key for this remote public key, if any (e.g. the node changed or lost its key)
+    void forgetSharedKey(const uint8_t *remotePublic);
+    /// Drop all cached shared keys, needed whenever our own private key changes
+    void clearSharedKeyCache();
+    /// How often encrypt/decryptCurve25519 found the shared key in the cache vs had to run X25519
+    uint32_t getSharedKeyHits() const { return sharedKeyHits; }
+    uint32_t getSharedKeyMisses() const { return sharedKeyMisses; }
     virtual void hash(uint8_t *bytes, size_t numBytes);
 
     virtual void aesSetKey(const uint8_t *key, size_t key_len);
@@ -65,23 +101,82 @@ class CryptoEngine
     virtual void setKey(const CryptoKey &k);
 
     /**
-     * Encrypt a packet
+     * Like setKey(), but the expanded key schedule is kept per channel, so switching between channels (as perhapsDecode does
+     * for every channel with a matching hash) does not redo the AES key expansion each time.
+     */
+    virtual void setChannelKey(uint8_t chIndex, const CryptoKey &k);
+
+    /// Forget all cached key schedules, called when the channel configuration changes
+    virtual void invalidateKeyCache();
+
+    /**
+     * Encrypt a packet with the key from setKey()/setChannelKey().  Not reentrant, the key and nonce are engine state.
      *
      * @param bytes is updated in place
      */
     virtual void encryptPacket(uint32_t fromNode, uint64_t packetId, size_t numBytes, uint8_t *bytes);
     virtual void decrypt(uint32_t fromNode, uint64_t packetId, size_t numBytes, uint8_t *bytes);
-    virtual void encryptAESCtr(CryptoKey key, uint8_t *nonce, size_t numBytes, uint8_t *bytes);
+
+    /**
+     * Encrypt a packet with the key in ctx (see Channels::getCryptoForIndex).  Safe to call from several threads at once: the
+     * whole AES-CTR pass holds KeyMaterialLock, since it runs on a cached key schedule, the rest works on ctx and bytes.
+     *
+     * @param bytes is updated in place
+     */
+    void encryptPacket(CryptoContext &ctx, uint32_t fromNode, uint64_t packetId, size_t numBytes, uint8_t *bytes);
+    void decrypt(CryptoContext &ctx, uint32_t fromNode, uint64_t packetId, size_t numBytes, uint8_t *bytes);
+
+    /// AES-CTR with the key schedule cached in keySlot, platforms override this to use their hardware
+    virtual void encryptAESCtr(const CryptoKey &key, uint8_t keySlot, uint8_t *nonce, size_t numBytes, uint8_t *bytes);
+    void encryptAESCtr(CryptoKey key, uint8_t *nonce, size_t numBytes, uint8_t *bytes)
+    {
+        encryptAESCtr(key, CRYPTO_KEY_CACHE_SLOTS - 1, nonce, numBytes, bytes);
+    }
 #ifndef PIO_UNIT_TESTING
   protected:
 #endif
+    /**
+     * Held while touching cached key material (AES key schedules, shared keys, our private key).  Per packet state lives in
+     * the caller's CryptoContext, so this is the only place threads using the engine wait on each other.
+     */
+    class KeyMaterialLock
+    {
+      public:
+        KeyMaterialLock();
+        ~KeyMaterialLock();
+
+      private:
+        concurrency::Lock *held = nullptr;
+    };
+
     /** Our per packet nonce */
     uint8_t nonce[16] = {0};
     CryptoKey key = {};
-    CTRCommon *ctr = NULL;
+    /// Which cache slot belongs to `key`
+    uint8_t keySlot = CRYPTO_KEY_CACHE_SLOTS - 1;
+    /// The key each slot's context was expanded from, length 0 means empty
+    CryptoKey cachedKeys[CRYPTO_KEY_CACHE_SLOTS] = {};
+    CTRCommon *ctrs[CRYPTO_KEY_CACHE_SLOTS] = {};
 #if !(MESHTASTIC_EXCLUDE_PKI)
     uint8_t shared_key[32] = {0};
     uint8_t private_key[32] = {0};
+
+    /// A derived (DH + SHA256) key for one remote public key, least recently used entries get evicted
+    struct SharedKeyCacheEntry {
+        uint8_t remotePublic[32];
+        uint8_t sharedKey[32];
+        uint32_t lastUsed; // 0 = empty
+    };
+    SharedKeyCacheEntry sharedKeyCache[PKI_SHARED_KEY_CACHE_SIZE] = {};
+    uint32_t sharedKeyUseCounter = 0;
+    uint32_t sharedKeyHits = 0, sharedKeyMisses = 0;
+    /// Bumped whenever private_key changes, so a DH computed against the old key is not cached
+    uint32_t privateKeyGeneration = 0;
+
+    /// Fill sharedOut for remotePublic, from the cache if possible.  Returns false if DH failed.
+    bool deriveSharedKey(const uint8_t *remotePublic, uint8_t *sharedOut);
+    /// Our private key changed: empty the shared key cache.  Caller holds KeyMaterialLock.
+    void privateKeyChanged();
 #endif
     /**
      * Init our 128 bit nonce for a new packet
@@ -92,6 +187,13 @@ class CryptoEngine
      * a 32 bit block counter (starts at zero)
      */
     void initNonce(uint32_t fromNode, uint64_t packetId, uint32_t extraNonce = 0);
+    static void initNonce(uint8_t *nonceOut, uint32_t fromNode, uint64_t packetId, uint32_t extraNonce = 0);
+
+    /**
+     * Check whether the platform context in keySlot already holds k, and if not record that it is about to be (re)keyed
+     * (needExpand).  Caller holds KeyMaterialLock until it is done with the slot.
+     */
+    uint8_t lookupKeySlot(const CryptoKey &k, uint8_t keySlot, bool &needExpand);
 };
 
 extern CryptoEngine *crypto;
\ No newline at end of file
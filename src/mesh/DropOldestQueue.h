@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Arduino.h>
+#include <assert.h>
+#include <utility>
+
+/**
+ * A bounded FIFO of values that makes room for new entries by discarding the oldest one.
+ *
+ * Meant for per-consumer queues of SharedPacket handles (or small structs holding one): each consumer decides its own depth
+ * and a slow consumer only ever loses its own oldest entries, it never holds back anybody else.  Dropping an entry just
+ * releases that consumer's reference.
+ */
+template <class T> class DropOldestQueue
+{
+    const int maxElements;
+    T *slots;
+    int first = 0, count = 0;
+    uint32_t dropped = 0;
+
+  public:
+    explicit DropOldestQueue(int _maxElements) : maxElements(_maxElements)
+    {
+        assert(maxElements > 0);
+        slots = new T[maxElements];
+    }
+
+    ~DropOldestQueue() { delete[] slots; }
+
+    DropOldestQueue(const DropOldestQueue &) = delete;
+    DropOldestQueue &operator=(const DropOldestQueue &) = delete;
+
+    int numUsed() const { return count; }
+    int numFree() const { return maxElements - count; }
+    bool isEmpty() const { return count == 0; }
+
+    /// How many entries were discarded to make room since boot
+    uint32_t getDropped() const { return dropped; }
+
+    /// Append an entry, discarding the oldest if full.  Returns false if something had to be dropped.
+    bool push(T item)
+    {
+        bool room = true;
+        if (count == maxElements) {
+            pop();
+            dropped++;
+            room = false;
+        }
+        slots[(first + count) % maxElements] = std::move(item);
+        count++;
+        return room;
+    }
+
+    /// The oldest entry, only valid while !isEmpty()
+    T &front() { return slots[first]; }
+
+    /// Remove and return the oldest entry, or an empty T if there is none
+    T pop()
+    {
+        if (count == 0)
+            return T();
+        T item = std::move(slots[first]);
+        slots[first] = T();
+        first = (first + 1) % maxElements;
+        count--;
+        return item;
+    }
+
+    void clear()
+    {
+        while (count)
+            pop();
+    }
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <Arduino.h>
+#include <assert.h>
+
+/**
+ * A bounded FIFO of shared handles (e.g. SharedPacket) that several readers consume independently.
+ *
+ * Every entry is stored exactly once.  Each reader keeps its own cursor into the FIFO and take() returns another handle to
+ * the same object rather than a copy, so N readers cost N cursors instead of N buffers.  The queue drops its own handle once
+ * every open reader has moved past an entry; a reader still copying it out keeps it alive through the handle it got from take().
+ *
+ * While no reader is open entries simply accumulate (up to maxElements), so the first reader to open sees the backlog.
+ * Readers opened later start at the oldest entry still queued.
+ *
+ * T must be cheap to copy, default-construct to "empty" and convert to bool.  Not thread safe: callers run from the cooperative
+ * main loop, like the queues this replaces.
+ */
+template <class T, int MaxReaders> class FanoutQueue
+{
+    static_assert(MaxReaders > 0 && MaxReaders < 128, "FanoutQueue reader ids must fit in an int8_t");
+
+    struct Reader {
+        bool open;
+        uint32_t cursor; // sequence number of the next entry this reader will take
+    };
+
+    const int maxElements;
+    T *slots;
+    Reader readers[MaxReaders] = {};
+
+    /// Sequence numbers of the oldest queued entry and of the next one to be enqueued
+    uint32_t head = 0, tail = 0;
+
+    /// Index in slots of the entry with sequence number head
+    int headSlot = 0;
+
+    /// Index in slots of a queued sequence number (head <= seq <= tail)
+    int slotOf(uint32_t seq) const { return (int)((headSlot + (seq - head)) % (uint32_t)maxElements); }
+
+    /// Drop our handle to the oldest entry and advance head
+    void popHead()
+    {
+        slots[headSlot] = T();
+        headSlot = (headSlot + 1) % maxElements;
+        head++;
+    }
+
+    /// Wraparound-safe a < b for sequence numbers
+    static bool before(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; }
+
+    /// Let go of entries from the front that every open reader has already passed
+    void trim()
+    {
+        bool anyOpen = false;
+        for (int r = 0; r < MaxReaders; r++)
+            anyOpen |= readers[r].open;
+        if (!anyOpen)
+            return; // keep the backlog for whoever connects next
+
+        while (head != tail) {
+            for (int r = 0; r < MaxReaders; r++)
+                if (readers[r].open && !before(head, readers[r].cursor))
+                    return; // someone has not read it yet
+            popHead();
+        }
+    }
+
+    bool validReader(int r) const { return r >= 0 && r < MaxReaders && readers[r].open; }
+
+  public:
+    explicit FanoutQueue(int _maxElements) : maxElements(_maxElements)
+    {
+        assert(maxElements > 0);
+        slots = new T[maxElements];
+    }
+
+    ~FanoutQueue() { delete[] slots; }
+
+    FanoutQueue(const FanoutQueue &) = delete;
+    FanoutQueue &operator=(const FanoutQueue &) = delete;
+
+    int numUsed() const { return (int)(tail - head); }
+    int numFree() const { return maxElements - numUsed(); }
+    bool isEmpty() const { return head == tail; }
+
+    /// The i-th queued entry counting from the oldest (0 <= i < numUsed()), for read-only scans
+    const T &peek(int i) const { return slots[slotOf(head + i)]; }
+
+    /// Append an entry.  Returns false if the queue is full.
+    bool enqueue(const T &item)
+    {
+        if (numFree() == 0)
+            return false;
+        slots[slotOf(tail)] = item;
+        tail++;
+        return true;
+    }
+
+    /// Discard the oldest entry to make room, readers that had not reached it skip it.  Returns false if the queue was empty.
+    bool dropOldest()
+    {
+        if (head == tail)
+            return false;
+        popHead();
+        for (int r = 0; r < MaxReaders; r++)
+            if (readers[r].open && before(readers[r].cursor, head))
+                readers[r].cursor = head;
+        return true;
+    }
+
+    /// Register a new reader positioned at the oldest queued entry.  Returns -1 if all reader slots are taken.
+    int openReader()
+    {
+        for (int r = 0; r < MaxReaders; r++) {
+            if (!readers[r].open) {
+                readers[r] = {true, head};
+                return r;
+            }
+        }
+        return -1;
+    }
+
+    /// Drop a reader, entries it had not read yet no longer wait for it
+    void closeReader(int r)
+    {
+        if (!validReader(r))
+            return;
+        readers[r].open = false;
+        trim();
+    }
+
+    /// Return the next entry for reader r, or an empty T if it is caught up
+    T take(int r)
+    {
+        if (!validReader(r) || readers[r].cursor == tail)
+            return T();
+        T item = slots[slotOf(readers[r].cursor++)];
+        trim();
+        return item;
+    }
+};
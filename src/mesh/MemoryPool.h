@@ -4,17 +4,28 @@
 #include <assert.h>
 #include <functional>
 #include <memory>
+#include <type_traits>
 
 #include "PointerQueue.h"
 #include "configuration.h" // For LOG_WARN, LOG_DEBUG, LOG_HEAP
 
+/// Occupancy counters kept by every Allocator, used to size the pools from real traffic
+struct AllocatorStats {
+    uint32_t inUse;     // buffers currently handed out
+    uint32_t highWater; // largest inUse seen since boot
+    uint32_t failures;  // alloc() calls that returned nullptr
+};
+
 template <class T> class Allocator
 {
 
   public:
-    Allocator() : deleter([this](T *p) { this->release(p); }) {}
+    Allocator() : stats{}, deleter([this](T *p) { this->release(p); }) {}
     virtual ~Allocator() {}
 
+    /// Snapshot of the occupancy counters
+    AllocatorStats getStats() const { return stats; }
+
     /// Return a queable object which has been prefilled with zeros.  Return nullptr if no buffer is available
     /// Note: this method is safe to call from regular OR ISR code
     T *allocZeroed()
@@ -73,7 +84,25 @@ template <class T> class Allocator
     // Alloc some storage
     virtual T *alloc(TickType_t maxWait) = 0;
 
+    /// Subclasses call these from alloc()/release() to keep the counters current
+    void noteAlloc(const T *p)
+    {
+        if (!p) {
+            stats.failures++;
+            return;
+        }
+        if (++stats.inUse > stats.highWater)
+            stats.highWater = stats.inUse;
+    }
+    void noteRelease()
+    {
+        if (stats.inUse)
+            stats.inUse--;
+    }
+
   private:
+    AllocatorStats stats;
+
     // std::unique_ptr Deleter function; calls release().
     const std::function<void(T *)> deleter;
 };
@@ -93,6 +122,7 @@ template <class T> class MemoryDynamic : public Allocator<T>
         LOG_HEAP("Freeing 0x%x", p);
 
         free(p);
+        this->noteRelease();
     }
 
   protected:
@@ -101,25 +131,32 @@ template <class T> class MemoryDynamic : public Allocator<T>
     {
         T *p = (T *)malloc(sizeof(T));
         assert(p);
+        this->noteAlloc(p);
         return p;
     }
 };
 
 /**
- * A static memory pool that uses a fixed buffer instead of heap allocation
+ * A static memory pool that uses a fixed buffer instead of heap allocation.
+ *
+ * Free slots are kept on an index stack so alloc() and release() are O(1) regardless of MaxSize.
  */
 template <class T, int MaxSize> class MemoryPool : public Allocator<T>
 {
   private:
+    using Index = typename std::conditional<(MaxSize <= 0xFFFF), uint16_t, uint32_t>::type;
+
     T pool[MaxSize];
     bool used[MaxSize];
+    Index freeStack[MaxSize]; // indices of free slots, top of stack at freeStack[numFree - 1]
+    Index numFree;
 
   public:
-    MemoryPool() : pool{}, used{}
+    MemoryPool() : pool{}, used{}, numFree(MaxSize)
     {
-        // Arrays are now zero-initialized by member initializer list
-        // pool array: all elements are default-constructed (zero for POD types)
-        // used array: all elements are false (zero-initialized)
+        // Push in reverse so the lowest slots are handed out first, same as the old first-fit scan
+        for (int i = 0; i < MaxSize; i++)
+            freeStack[i] = (Index)(MaxSize - 1 - i);
     }
 
     /// Return a buffer for use by others
@@ -134,7 +171,13 @@ template <class T, int MaxSize> class MemoryPool : public Allocator<T>
         int index = p - pool;
         if (index >= 0 && index < MaxSize) {
             assert(used[index]); // Should be marked as used
+            if (!used[index]) {
+                LOG_WARN("Double release of static pool item %d", index);
+                return;
+            }
             used[index] = false;
+            freeStack[numFree++] = (Index)index;
+            this->noteRelease();
             LOG_HEAP("Released static pool item %d at 0x%x", index, p);
         } else {
             LOG_WARN("Pointer 0x%x not from our pool!", p);
@@ -145,17 +188,17 @@ template <class T, int MaxSize> class MemoryPool : public Allocator<T>
     // Alloc some storage from our static pool
     virtual T *alloc(TickType_t maxWait) override
     {
-        // Find first free slot
-        for (int i = 0; i < MaxSize; i++) {
-            if (!used[i]) {
-                used[i] = true;
-                LOG_HEAP("Allocated static pool item %d at 0x%x", i, &pool[i]);
-                return &pool[i];
-            }
+        if (numFree == 0) {
+            // No free slots available - return nullptr instead of asserting
+            this->noteAlloc(nullptr);
+            LOG_WARN("No free slots available in static memory pool!");
+            return nullptr;
         }
 
-        // No free slots available - return nullptr instead of asserting
-        LOG_WARN("No free slots available in static memory pool!");
-        return nullptr;
+        Index i = freeStack[--numFree];
+        used[i] = true;
+        this->noteAlloc(&pool[i]);
+        LOG_HEAP("Allocated static pool item %d at 0x%x", i, &pool[i]);
+        return &pool[i];
     }
 };
@@ -28,11 +28,141 @@ bool CompareMeshPacketFunc(const meshtastic_MeshPacket *p1, const meshtastic_Mes
     return (p1p != p2p) ? (p1p > p2p) : (!isFromUs(p1) && isFromUs(p2));
 }
 
-MeshPacketQueue::MeshPacketQueue(size_t _maxLen) : maxLen(_maxLen) {}
+MeshPacketQueue::MeshPacketQueue(size_t _maxLen) : maxLen(_maxLen)
+{
+    if (maxLen >= NIL) // entry numbers must fit below NIL
+        maxLen = NIL - 1;
+
+    entries.resize(maxLen);
+    for (size_t i = 0; i < maxLen; i++)
+        entries[i].next = (i + 1 < maxLen) ? i + 1 : NIL;
+    freeHead = maxLen ? 0 : NIL;
+    buckets.reserve(maxLen);
+
+    // Index at a load factor of at most 1/2
+    uint32_t indexSize = 8;
+    while (indexSize < 2 * maxLen)
+        indexSize <<= 1;
+    index.assign(indexSize, 0);
+    indexMask = indexSize - 1;
+}
 
 bool MeshPacketQueue::empty()
 {
-    return queue.empty();
+    return count == 0;
+}
+
+uint16_t MeshPacketQueue::orderClass(const meshtastic_MeshPacket *p)
+{
+    // Same keys as CompareMeshPacketFunc, most significant first: late window, priority (higher first), from us
+    uint32_t pri = getPriority(p);
+    if (pri > 0xFF)
+        pri = 0xFF;
+    return ((p->tx_after ? 1 : 0) << 9) | ((0xFF - pri) << 1) | (isFromUs(p) ? 1 : 0);
+}
+
+uint32_t MeshPacketQueue::indexHome(NodeNum from, PacketId id) const
+{
+    return (((from * 0x9E3779B1u) ^ (id * 0x85EBCA6Bu)) >> 7) & indexMask;
+}
+
+void MeshPacketQueue::indexAdd(uint16_t e)
+{
+    const meshtastic_MeshPacket *p = entries[e].p;
+    uint32_t b = entries[e].home = indexHome(getFrom(p), p->id);
+    while (index[b] != 0)
+        b = (b + 1) & indexMask;
+    index[b] = e + 1;
+}
+
+void MeshPacketQueue::indexRemove(uint16_t e)
+{
+    // Homes are remembered, so a packet edited while queued cannot corrupt the index
+    uint32_t hole = entries[e].home;
+    while (index[hole] != e + 1)
+        hole = (hole + 1) & indexMask;
+
+    for (uint32_t b = (hole + 1) & indexMask; index[b] != 0; b = (b + 1) & indexMask) {
+        uint32_t home = entries[index[b] - 1].home;
+        // Move the entry into the hole unless its home bucket lies cyclically in (hole, b]
+        if (((b - home) & indexMask) >= ((b - hole) & indexMask)) {
+            index[hole] = index[b];
+            hole = b;
+        }
+    }
+    index[hole] = 0;
+}
+
+uint16_t MeshPacketQueue::findEntry(NodeNum from, PacketId id, bool tx_normal, bool tx_late, uint8_t hop_limit_lt)
+{
+    uint16_t found = NIL;
+    for (uint32_t b = indexHome(from, id); index[b] != 0; b = (b + 1) & indexMask) {
+        uint16_t e = index[b] - 1;
+        const meshtastic_MeshPacket *p = entries[e].p;
+        if (getFrom(p) == from && p->id == id && ((tx_normal && !p->tx_after) || (tx_late && p->tx_after)) &&
+            (!hop_limit_lt || p->hop_limit < hop_limit_lt)) {
+            // The same packet can be queued more than once, report the copy that goes out first
+            if (found == NIL || entries[e].order < entries[found].order ||
+                (entries[e].order == entries[found].order && (int32_t)(entries[e].seq - entries[found].seq) < 0))
+                found = e;
+        }
+    }
+    return found;
+}
+
+void MeshPacketQueue::insert(meshtastic_MeshPacket *p)
+{
+    uint16_t e = freeHead;
+    assert(e != NIL);
+    freeHead = entries[e].next;
+
+    Entry &entry = entries[e];
+    entry.p = p;
+    entry.seq = nextSeq++;
+    entry.order = orderClass(p);
+    entry.next = NIL;
+
+    auto it = std::lower_bound(buckets.begin(), buckets.end(), entry.order,
+                               [](const Bucket &bucket, uint16_t order) { return bucket.order < order; });
+    if (it == buckets.end() || it->order != entry.order) {
+        entry.prev = NIL;
+        buckets.insert(it, Bucket{entry.order, e, e});
+    } else {
+        // Stable: behind everything that compares equal
+        entry.prev = it->tail;
+        entries[it->tail].next = e;
+        it->tail = e;
+    }
+
+    indexAdd(e);
+    count++;
+}
+
+meshtastic_MeshPacket *MeshPacketQueue::unlink(uint16_t e)
+{
+    Entry &entry = entries[e];
+    auto it = std::lower_bound(buckets.begin(), buckets.end(), entry.order,
+                               [](const Bucket &bucket, uint16_t order) { return bucket.order < order; });
+    assert(it != buckets.end() && it->order == entry.order);
+
+    if (entry.prev != NIL)
+        entries[entry.prev].next = entry.next;
+    else
+        it->head = entry.next;
+    if (entry.next != NIL)
+        entries[entry.next].prev = entry.prev;
+    else
+        it->tail = entry.prev;
+    if (it->head == NIL)
+        buckets.erase(it);
+
+    indexRemove(e);
+    meshtastic_MeshPacket *p = entry.p;
+    entry.p = NULL;
+    entry.next = freeHead;
+    freeHead = e;
+    count--;
+    return p;
 }
 
 /**
@@ -68,7 +198,7 @@ void fixPriority(meshtastic_MeshPacket *p)
 bool MeshPacketQueue::enqueue(meshtastic_MeshPacket *p, bool *dropped)
 {
     // no space - try to replace a lower priority packet in the queue
-    if (queue.size() >= maxLen) {
+    if (count >= maxLen) {
         bool replaced = replaceLowerPriorityPacket(p);
         if (!replaced) {
             LOG_WARN("TX queue is full, and there is no lower-priority packet available to evict in favour of 0x%08x", p->id);
@@ -83,9 +213,7 @@ bool MeshPacketQueue::enqueue(meshtastic_MeshPacket *p, bool *dropped)
         *dropped = false;
     }
 
-    // Find the correct position using upper_bound to maintain a stable order
-    auto it = std::upper_bound(queue.begin(), queue.end(), p, CompareMeshPacketFunc);
-    queue.insert(it, p); // Insert packet at the found position
+    insert(p); // Appended to its bucket, which keeps a stable order
     return true;
 }
 
@@ -95,9 +223,7 @@ meshtastic_MeshPacket *MeshPacketQueue::dequeue()
         return NULL;
     }
 
-    auto *p = queue.front();
-    queue.erase(queue.begin()); // Remove the highest-priority packet
-    return p;
+    return unlink(buckets.front().head); // Remove the highest-priority packet
 }
 
 meshtastic_MeshPacket *MeshPacketQueue::getFront()
@@ -106,42 +232,27 @@ meshtastic_MeshPacket *MeshPacketQueue::getFront()
         return NULL;
     }
 
-    auto *p = queue.front();
-    return p;
+    return entries[buckets.front().head].p;
 }
 
 /** Get a packet from this queue. Returns a pointer to the packet, or NULL if not found. */
 meshtastic_MeshPacket *MeshPacketQueue::getPacketFromQueue(NodeNum from, PacketId id)
 {
-    for (auto it = queue.begin(); it != queue.end(); it++) {
-        auto p = (*it);
-        if (getFrom(p) == from && p->id == id) {
-            return p;
-        }
-    }
-
-    return NULL;
+    uint16_t e = findEntry(from, id);
+    return (e != NIL) ? entries[e].p : NULL;
 }
 
 /** Attempt to find and remove a packet from this queue.  Returns a pointer to the removed packet, or NULL if not found */
 meshtastic_MeshPacket *MeshPacketQueue::remove(NodeNum from, PacketId id, bool tx_normal, bool tx_late, uint8_t hop_limit_lt)
 {
-    for (auto it = queue.begin(); it != queue.end(); it++) {
-        auto p = (*it);
-        if (getFrom(p) == from && p->id == id && ((tx_normal && !p->tx_after) || (tx_late && p->tx_after)) &&
-            (!hop_limit_lt || p->hop_limit < hop_limit_lt)) {
-            queue.erase(it);
-            return p;
-        }
-    }
-
-    return NULL;
+    uint16_t e = findEntry(from, id, tx_normal, tx_late, hop_limit_lt);
+    return (e != NIL) ? unlink(e) : NULL;
 }
 
 /* Attempt to find a packet from this queue. Return true if it was found. */
 bool MeshPacketQueue::find(const NodeNum from, const PacketId id)
 {
-    return getPacketFromQueue(from, id) != NULL;
+    return findEntry(from, id) != NIL;
 }
 
 /**
@@ -151,16 +262,17 @@ bool MeshPacketQueue::find(const NodeNum from, const PacketId id)
 bool MeshPacketQueue::replaceLowerPriorityPacket(meshtastic_MeshPacket *p)
 {
 
-    if (queue.empty()) {
+    if (empty()) {
         return false; // No packets to replace
     }
 
     // Check if the packet at the back has a lower priority than the new packet
-    auto *backPacket = queue.back();
+    uint16_t back = buckets.back().tail;
+    auto *backPacket = entries[back].p;
     if (!backPacket->tx_after && backPacket->priority < p->priority) {
         LOG_WARN("Dropping packet 0x%08x to make room in the TX queue for higher-priority packet 0x%08x", backPacket->id, p->id);
         // Remove the back packet
-        queue.pop_back();
+        unlink(back);
         packetPool.release(backPacket);
         // Insert the new packet in the correct order
         enqueue(p);
@@ -168,22 +280,25 @@ bool MeshPacketQueue::replaceLowerPriorityPacket(meshtastic_MeshPacket *p)
     }
 
     if (backPacket->tx_after) {
-        // Check if there's a non-late packet with lower priority
-        auto it = queue.end();
-        auto refPacket = *--it;
-        for (; refPacket->tx_after && it != queue.begin(); refPacket = *--it)
-            ;
-        if (!refPacket->tx_after && refPacket->priority < p->priority) {
-            LOG_WARN("Dropping non-late packet 0x%08x to make room in the TX queue for higher-priority packet 0x%08x",
-                     refPacket->id, p->id);
-            queue.erase(it);
-            packetPool.release(refPacket);
-            // Insert the new packet in the correct order
-            enqueue(p);
-            return true;
+        // Check if there's a non-late packet with lower priority: the back of the last non-late bucket
+        auto it = buckets.end();
+        while (it != buckets.begin() && entries[(it - 1)->tail].p->tx_after)
+            --it;
+        if (it != buckets.begin()) {
+            uint16_t ref = (it - 1)->tail;
+            auto refPacket = entries[ref].p;
+            if (refPacket->priority < p->priority) {
+                LOG_WARN("Dropping non-late packet 0x%08x to make room in the TX queue for higher-priority packet 0x%08x",
+                         refPacket->id, p->id);
+                unlink(ref);
+                packetPool.release(refPacket);
+                // Insert the new packet in the correct order
+                enqueue(p);
+                return true;
+            }
         }
     }
 
     // If the back packet's priority is not lower, no replacement occurs
     return false;
-}
\ No newline at end of file
+}
@@ -3,14 +3,61 @@
 #include "MeshTypes.h"
 
 #include <queue>
+#include <vector>
+
+/// @return "true" if "p1" is ordered before "p2": not-late before late, then higher priority, then packets already on mesh
+bool CompareMeshPacketFunc(const meshtastic_MeshPacket *p1, const meshtastic_MeshPacket *p2);
 
 /**
  * A priority queue of packets
+ *
+ * Packets live in a fixed pool of maxLen entries. Entries that compare equal under CompareMeshPacketFunc share a FIFO
+ * bucket, and the non-empty buckets are kept sorted, so dequeue order is exactly that of a stable sort by
+ * CompareMeshPacketFunc. A hash index on (from, id) makes find and remove O(1).
  */
 class MeshPacketQueue
 {
+    static const uint16_t NIL = 0xFFFF;
+
+    struct Entry {
+        meshtastic_MeshPacket *p;
+        uint32_t seq;   // enqueue order, breaks ties between entries with the same (from, id)
+        uint32_t home;  // index bucket of (from, id) when it was enqueued
+        uint16_t order; // orderClass() of p when it was enqueued
+        uint16_t prev;  // within the bucket, or the free list for unused entries
+        uint16_t next;
+    };
+
+    struct Bucket {
+        uint16_t order; // lower is dequeued first
+        uint16_t head;
+        uint16_t tail;
+    };
+
     size_t maxLen;
-    std::vector<meshtastic_MeshPacket *> queue;
+    size_t count = 0;
+    uint32_t nextSeq = 0;
+    uint16_t freeHead = NIL;
+    std::vector<Entry> entries;  // fixed pool of maxLen entries
+    std::vector<Bucket> buckets; // non-empty buckets, sorted by order
+    std::vector<uint16_t> index; // open addressed (from, id) -> entry+1, 0 means empty
+    uint32_t indexMask = 0;
+
+    /** Sort class of a packet: packets with equal class compare equal under CompareMeshPacketFunc */
+    static uint16_t orderClass(const meshtastic_MeshPacket *p);
+
+    uint32_t indexHome(NodeNum from, PacketId id) const;
+    void indexAdd(uint16_t e);
+    void indexRemove(uint16_t e);
+
+    /** Find the queued entry for (from, id) that is dequeued first among those passing the filters, or NIL */
+    uint16_t findEntry(NodeNum from, PacketId id, bool tx_normal = true, bool tx_late = true, uint8_t hop_limit_lt = 0);
+
+    /** Put a packet at the back of its bucket, there must be a free entry */
+    void insert(meshtastic_MeshPacket *p);
+
+    /** Unlink an entry from its bucket and the index, and return its packet */
+    meshtastic_MeshPacket *unlink(uint16_t e);
 
     /** Replace a lower priority package in the queue with 'mp' (provided there are lower pri packages). Return true if replaced.
      */
@@ -28,7 +75,7 @@ class MeshPacketQueue
     bool empty();
 
     /** return amount of free packets in Queue */
-    size_t getFree() { return maxLen - queue.size(); }
+    size_t getFree() { return maxLen - count; }
 
     /** return total size of the Queue */
     size_t getMaxLen() { return maxLen; }
@@ -46,4 +93,4 @@ class MeshPacketQueue
 
     /* Attempt to find a packet from this queue. Return true if it was found. */
     bool find(const NodeNum from, const PacketId id);
-};
\ No newline at end of file
+};
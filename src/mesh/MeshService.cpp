@@ -67,6 +67,8 @@ MeshService::MeshService()
 #ifdef ARCH_PORTDUINO
     : toPhoneQueue(MAX_RX_TOPHONE), toPhoneQueueStatusQueue(MAX_RX_QUEUESTATUS_TOPHONE),
       toPhoneMqttProxyQueue(MAX_RX_MQTTPROXY_TOPHONE), toPhoneClientNotificationQueue(MAX_RX_NOTIFICATION_TOPHONE)
+#else
+    : toPhoneQueue(MAX_RX_TOPHONE)
 #endif
 {
     lastQueueStatus = {0, 0, 16, 0};
@@ -109,7 +111,16 @@ int MeshService::handleFromRadio(const meshtastic_MeshPacket *mp)
     }
 
     printPacket("Forwarding to phone", mp);
-    sendToPhone(packetPool.allocCopy(*mp));
+    // One copy shared by every client (phones, WiFi bridge, ...) instead of one each
+    meshtastic_MeshPacket *copy = packetPool.allocCopy(*mp);
+    if (copy) {
+        perhapsDecode(copy);
+        clearLocalBitfield(copy);
+    }
+    SharedPacket shared = SharedPacket::adopt(copy);
+    sendToPhone(shared);
+    if (shared)
+        packetForClients.notifyObservers(&shared);
 
     return 0;
 }
@@ -159,13 +170,11 @@ NodeNum MeshService::getNodenumFromRequestId(uint32_t request_id)
 {
     NodeNum nodenum = 0;
     for (int i = 0; i < toPhoneQueue.numUsed(); i++) {
-        meshtastic_MeshPacket *p = toPhoneQueue.dequeuePtr(0);
+        const SharedPacket &p = toPhoneQueue.peek(i);
         if (p->id == request_id) {
             nodenum = p->to;
             // make sure to continue this to make one full loop
         }
-        // put it right back on the queue
-        toPhoneQueue.enqueue(p, 0);
     }
     return nodenum;
 }
@@ -230,6 +239,7 @@ ErrorCode MeshService::sendQueueStatusToPhone(const meshtastic_QueueStatus &qs,
     }
 
     lastQueueStatus = *copied;
+    queueStatusChanged.notifyObservers(copied);
 
     res = toPhoneQueueStatusQueue.enqueue(copied, 0);
     fromNum++;
@@ -292,14 +302,23 @@ bool MeshService::trySendPosition(NodeNum dest, bool wantReplies)
 
 void MeshService::sendToPhone(meshtastic_MeshPacket *p)
 {
+    if (!p)
+        return;
     perhapsDecode(p);
+    clearLocalBitfield(p);
+    sendToPhone(SharedPacket::adopt(p));
+}
+
+void MeshService::sendToPhone(const SharedPacket &p)
+{
+    if (!p)
+        return;
 
 #ifdef ARCH_ESP32
 #if !MESHTASTIC_EXCLUDE_STOREFORWARD
     if (moduleConfig.store_forward.enabled && storeForwardModule->isServer() &&
         p->decoded.portnum == meshtastic_PortNum_TEXT_MESSAGE_APP) {
-        releaseToPool(p); // Copy is already stored in StoreForward history
-        fromNum++;        // Notify observers for packet from radio
+        fromNum++; // Copy is already stored in StoreForward history, notify observers for packet from radio
         return;
     }
 #endif
@@ -309,18 +328,15 @@ void MeshService::sendToPhone(meshtastic_MeshPacket *p)
         if (p->decoded.portnum == meshtastic_PortNum_TEXT_MESSAGE_APP ||
             p->decoded.portnum == meshtastic_PortNum_RANGE_TEST_APP) {
             LOG_WARN("ToPhone queue is full, discard oldest");
-            meshtastic_MeshPacket *d = toPhoneQueue.dequeuePtr(0);
-            if (d)
-                releaseToPool(d);
+            toPhoneQueue.dropOldest();
         } else {
             LOG_WARN("ToPhone queue is full, drop packet");
-            releaseToPool(p);
             fromNum++; // Make sure to notify observers in case they are reconnected so they can get the packets
             return;
         }
     }
 
-    if (toPhoneQueue.enqueue(p, 0) == false) {
+    if (toPhoneQueue.enqueue(p) == false) {
         LOG_CRIT("Failed to queue a packet into toPhoneQueue!");
         abort();
     }
@@ -4,11 +4,13 @@
 #include <assert.h>
 #include <string>
 
+#include "FanoutQueue.h"
 #include "GPSStatus.h"
 #include "MemoryPool.h"
 #include "MeshRadio.h"
 #include "MeshTypes.h"
 #include "Observer.h"
+#include "SharedPacket.h"
 #ifdef ARCH_PORTDUINO
 #include "PointerQueue.h"
 #else
@@ -24,6 +26,22 @@
 #endif
 #endif
 
+/// How many API clients (BLE, serial, each TCP connection, ...) can read toPhoneQueue at the same time
+#ifndef MAX_TOPHONE_READERS
+#ifdef ARCH_PORTDUINO
+#define MAX_TOPHONE_READERS 8
+#else
+#define MAX_TOPHONE_READERS 4
+#endif
+#endif
+
+/// An ACK or NAK addressed to us, for one of our packets
+struct DeliveryReport {
+    PacketId id;                    ///< the packet being acknowledged (request_id of the ACK/NAK)
+    NodeNum from;                   ///< who acknowledged it, our own node for an implicit ACK (we heard it being relayed)
+    meshtastic_Routing_Error error; ///< NONE for an ACK
+};
+
 extern Allocator<meshtastic_QueueStatus> &queueStatusPool;
 extern Allocator<meshtastic_MqttClientProxyMessage> &mqttClientProxyMessagePool;
 extern Allocator<meshtastic_ClientNotification> &clientNotificationPool;
@@ -38,15 +56,10 @@ class MeshService
     CallbackObserver<MeshService, const meshtastic::GPSStatus *> gpsObserver =
         CallbackObserver<MeshService, const meshtastic::GPSStatus *>(this, &MeshService::onGPSChanged);
 #endif
-    /// received packets waiting for the phone to process them
-    /// FIXME, change to a DropOldestQueue and keep a count of the number of dropped packets to ensure
-    /// we never hang because android hasn't been there in a while
+    /// received packets waiting for the phone(s) to process them.  Every connected API client reads the same packets through its
+    /// own cursor (see openPhoneReader), so a packet is only freed once all of them have downloaded it.
     /// FIXME - save this to flash on deep sleep
-#ifdef ARCH_PORTDUINO
-    PointerQueue<meshtastic_MeshPacket> toPhoneQueue;
-#else
-    StaticPointerQueue<meshtastic_MeshPacket, MAX_RX_TOPHONE> toPhoneQueue;
-#endif
+    FanoutQueue<SharedPacket, MAX_TOPHONE_READERS> toPhoneQueue;
 
     // keep list of QueueStatus packets to be send to the phone
 #ifdef ARCH_PORTDUINO
@@ -106,6 +119,16 @@ class MeshService
     /// Called when radio config has changed (radios should observe this and set their hardware as required)
     Observable<void *> configChanged;
 
+    /// Called with every packet delivered from the mesh to the phone(s).  Other local consumers (WiFi bridge, ...) should keep a
+    /// copy of the handle rather than of the packet, and queue it with their own drop-oldest limit.
+    Observable<const SharedPacket *> packetForClients;
+
+    /// Called with every queue status sent to the phone, mesh_packet_id and res say what happened to a packet we queued
+    Observable<const meshtastic_QueueStatus *> queueStatusChanged;
+
+    /// Called by RoutingModule for every ACK/NAK addressed to us, including the ones the router generates locally
+    Observable<const DeliveryReport *> deliveryReports;
+
     MeshService();
 
     void init();
@@ -113,9 +136,16 @@ class MeshService
     /// Do idle processing (mostly processing messages which have been queued from the radio)
     void loop();
 
-    /// Return the next packet destined to the phone.  FIXME, somehow use fromNum to allow the phone to retry the
-    /// last few packets if needs to.
-    meshtastic_MeshPacket *getForPhone() { return toPhoneQueue.dequeuePtr(0); }
+    /// Register an API client as a reader of the to-phone packets.  Returns -1 if too many clients are already reading.
+    int openPhoneReader() { return toPhoneQueue.openReader(); }
+
+    /// The client is gone, anything it had not downloaded yet no longer waits for it
+    void closePhoneReader(int reader) { toPhoneQueue.closeReader(reader); }
+
+    /// Return the next packet destined to this client, or an empty handle if it is caught up.  The packet is shared with the
+    /// other clients and must not be modified.  FIXME, somehow use fromNum to allow the phone to retry the last few packets if
+    /// needs to.
+    SharedPacket getForPhone(int reader) { return toPhoneQueue.take(reader); }
 
     /// Allows the bluetooth handler to free packets after they have been sent
     void releaseToPool(meshtastic_MeshPacket *p) { packetPool.release(p); }
@@ -172,9 +202,12 @@ class MeshService
     /// Pull the latest power and time info into my nodeinfo
     meshtastic_NodeInfoLite *refreshLocalMeshNode();
 
-    /// Send a packet to the phone
+    /// Send a packet to the phone, p must have been allocated from packetPool and is owned by us afterwards
     void sendToPhone(meshtastic_MeshPacket *p);
 
+    /// Send an already decoded, shared packet to the phone without copying it
+    void sendToPhone(const SharedPacket &p);
+
     /// Send an MQTT message to the phone for client proxying
     virtual void sendMqttMessageToClientProxy(meshtastic_MqttClientProxyMessage *m);
 
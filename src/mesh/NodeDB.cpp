@@ -523,6 +523,8 @@ void NodeDB::installDefaultNodeDatabase()
     nodeDatabase.nodes = std::vector<meshtastic_NodeInfoLite>(MAX_NUM_NODES);
     numMeshNodes = 0;
     meshNodes = &nodeDatabase.nodes;
+    rebuildNodeIndex();
+    sortMeshDB();
 }
 
 void NodeDB::installDefaultConfig(bool preserveKey = false)
@@ -988,21 +990,23 @@ void NodeDB::resetNodes(bool keepFavorites)
 {
     if (!config.position.fixed_position)
         clearLocalPosition();
-    numMeshNodes = 1;
     if (keepFavorites) {
         LOG_INFO("Clearing node database - preserving favorites");
-        for (size_t i = 0; i < meshNodes->size(); i++) {
-            meshtastic_NodeInfoLite &node = meshNodes->at(i);
-            if (i > 0 && !node.is_favorite) {
-                node = meshtastic_NodeInfoLite();
-            } else {
-                numMeshNodes += 1;
-            }
-        };
+        // Keep our own node and the favorites packed at the front, so they stay within [0, numMeshNodes)
+        size_t newPos = 1;
+        for (size_t i = 1; i < numMeshNodes; i++) {
+            if (meshNodes->at(i).is_favorite)
+                meshNodes->at(newPos++) = meshNodes->at(i);
+        }
+        std::fill(nodeDatabase.nodes.begin() + newPos, nodeDatabase.nodes.end(), meshtastic_NodeInfoLite());
+        numMeshNodes = newPos;
     } else {
+        numMeshNodes = 1;
         LOG_INFO("Clearing node database - removing favorites");
         std::fill(nodeDatabase.nodes.begin() + 1, nodeDatabase.nodes.end(), meshtastic_NodeInfoLite());
     }
+    rebuildNodeIndex();
+    sortMeshDB();
     devicestate.has_rx_text_message = false;
     devicestate.has_rx_waypoint = false;
     saveNodeDatabaseToDisk();
@@ -1013,6 +1017,11 @@ void NodeDB::resetNodes(bool keepFavorites)
 
 void NodeDB::removeNodeByNum(NodeNum nodeNum)
 {
+#if !(MESHTASTIC_EXCLUDE_PKI)
+    const meshtastic_NodeInfoLite *gone = getMeshNode(nodeNum);
+    if (gone && gone->user.public_key.size == 32)
+        crypto->forgetSharedKey(gone->user.public_key.bytes);
+#endif
     int newPos = 0, removed = 0;
     for (int i = 0; i < numMeshNodes; i++) {
         if (meshNodes->at(i).num != nodeNum)
@@ -1023,6 +1032,8 @@ void NodeDB::removeNodeByNum(NodeNum nodeNum)
     numMeshNodes -= removed;
     std::fill(nodeDatabase.nodes.begin() + numMeshNodes, nodeDatabase.nodes.begin() + numMeshNodes + 1,
               meshtastic_NodeInfoLite());
+    rebuildNodeIndex();
+    sortMeshDB();
     LOG_DEBUG("NodeDB::removeNodeByNum purged %d entries. Save changes", removed);
     saveNodeDatabaseToDisk();
 }
@@ -1058,6 +1069,8 @@ void NodeDB::cleanupMeshDB()
     numMeshNodes -= removed;
     std::fill(nodeDatabase.nodes.begin() + numMeshNodes, nodeDatabase.nodes.begin() + numMeshNodes + removed,
               meshtastic_NodeInfoLite());
+    rebuildNodeIndex();
+    sortMeshDB();
     LOG_DEBUG("cleanupMeshDB purged %d entries", removed);
 }
 
@@ -1221,6 +1234,8 @@ void NodeDB::loadFromDisk()
         numMeshNodes = MAX_NUM_NODES;
     }
     meshNodes->resize(MAX_NUM_NODES);
+    rebuildNodeIndex();
+    sortMeshDB();
 
     // static DeviceState scratch; We no longer read into a tempbuf because this structure is 15KB of valuable RAM
     state = loadProto(deviceStateFileName, meshtastic_DeviceState_size, sizeof(meshtastic_DeviceState),
@@ -1511,11 +1526,30 @@ bool NodeDB::saveToDisk(int saveWhat)
 const meshtastic_NodeInfoLite *NodeDB::readNextMeshNode(uint32_t &readIndex)
 {
     if (readIndex < numMeshNodes)
-        return &meshNodes->at(readIndex++);
+        return getMeshNodeByIndex(readIndex++);
     else
         return NULL;
 }
 
+bool NodeDB::receiversHave(NodeNum to, uint8_t channel, uint32_t nodeInfoMask)
+{
+    if (!isBroadcast(to)) {
+        const meshtastic_NodeInfoLite *node = getMeshNode(to);
+        return node && (node->bitfield & nodeInfoMask) == nodeInfoMask;
+    }
+
+    size_t audience = 0;
+    for (size_t i = 0; i < numMeshNodes; i++) {
+        const meshtastic_NodeInfoLite *node = getMeshNodeByIndex(i);
+        if (node->num == getNodeNum() || node->channel != channel || sinceLastSeen(node) > NODEINFO_AUDIENCE_SECS)
+            continue;
+        if ((node->bitfield & nodeInfoMask) != nodeInfoMask)
+            return false;
+        audience++;
+    }
+    return audience > 0;
+}
+
 /// Given a node, return how many seconds in the past (vs now) that we last heard from it
 uint32_t sinceLastSeen(const meshtastic_NodeInfoLite *n)
 {
@@ -1683,7 +1717,7 @@ void NodeDB::addFromContact(meshtastic_SharedContact contact)
         }
         // Mark the node's key as manually verified to indicate trustworthiness.
         updateGUIforNode = info;
-        sortMeshDB();
+        reorderNode(info);
         notifyObservers(true); // Force an update whether or not our node counts have changed
     }
     saveNodeDatabaseToDisk();
@@ -1738,6 +1772,11 @@ bool NodeDB::updateUser(uint32_t nodeId, meshtastic_User &p, uint8_t channelInde
     auto lite = TypeConversions::ConvertToUserLite(p);
     bool changed = memcmp(&info->user, &lite, sizeof(info->user)) || (info->channel != channelIndex);
 
+#if !(MESHTASTIC_EXCLUDE_PKI)
+    if (info->user.public_key.size == 32 &&
+        (lite.public_key.size != 32 || memcmp(lite.public_key.bytes, info->user.public_key.bytes, 32) != 0))
+        crypto->forgetSharedKey(info->user.public_key.bytes);
+#endif
     info->user = lite;
     if (info->user.public_key.size == 32) {
         printBytes("Saved Pubkey: ", info->user.public_key.bytes, 32);
@@ -1795,7 +1834,7 @@ void NodeDB::updateFrom(const meshtastic_MeshPacket &mp)
             info->has_hops_away = true;
             info->hops_away = mp.hop_start - mp.hop_limit;
         }
-        sortMeshDB();
+        reorderNode(info);
     }
 }
 
@@ -1804,7 +1843,7 @@ void NodeDB::set_favorite(bool is_favorite, uint32_t nodeId)
     meshtastic_NodeInfoLite *lite = getMeshNode(nodeId);
     if (lite && lite->is_favorite != is_favorite) {
         lite->is_favorite = is_favorite;
-        sortMeshDB();
+        reorderNode(lite);
         saveNodeDatabaseToDisk();
     }
 }
@@ -1827,80 +1866,87 @@ bool NodeDB::isFavorite(uint32_t nodeId)
 
 bool NodeDB::isFromOrToFavoritedNode(const meshtastic_MeshPacket &p)
 {
-    // This method is logically equivalent to:
-    //   return isFavorite(p.from) || isFavorite(p.to);
-    // but is more efficient by:
-    //   1. doing only one pass through the database, instead of two
-    //   2. exiting early when a favorite is found, or if both from and to have been seen
-
-    if (p.to == NODENUM_BROADCAST)
-        return isFavorite(p.from); // we never store NODENUM_BROADCAST in the DB, so we only need to check p.from
-
-    meshtastic_NodeInfoLite *lite = NULL;
-
-    bool seenFrom = false;
-    bool seenTo = false;
-
-    for (int i = 0; i < numMeshNodes; i++) {
-        lite = &meshNodes->at(i);
-
-        if (lite->num == p.from) {
-            if (lite->is_favorite)
-                return true;
+    // NODENUM_BROADCAST is never stored in the DB, isFavorite() already returns false for it
+    return isFavorite(p.from) || isFavorite(p.to);
+}
 
-            seenFrom = true;
-        }
+void NodeDB::pause_sort(bool paused)
+{
+    sortingIsPaused = paused;
+    if (!paused && nodeOrderStale)
+        sortMeshDB();
+}
 
-        if (lite->num == p.to) {
-            if (lite->is_favorite)
-                return true;
+NodeDB::NodeOrderKey NodeDB::orderKeyFor(const meshtastic_NodeInfoLite &node)
+{
+    NodeOrderKey key;
+    key.lastHeard = node.last_heard;
+    key.group = (node.num == getNodeNum()) ? 0 : (node.is_favorite ? 1 : 2);
+    return key;
+}
 
-            seenTo = true;
+void NodeDB::sortMeshDB()
+{
+    uint32_t start = millis();
+
+    if (nodeOrder.empty()) {
+        // Allocate once for the largest DB we can hold, so adding nodes never reallocates
+        size_t maxNodes = std::max((size_t)MAX_NUM_NODES, meshNodes->size());
+        nodeOrder.resize(maxNodes);
+        nodeRank.resize(maxNodes);
+        nodeOrderKeys.resize(maxNodes);
+    }
+
+    // in the oddball case our own node num is not at slot 0, put it there (the only record we ever move)
+    for (pb_size_t i = 1; i < numMeshNodes; i++) {
+        if (meshNodes->at(i).num == getNodeNum()) {
+            // TODO: Look for slot 0 also matching own node num, and throw the DB in the trash
+            std::swap(meshNodes->at(i), meshNodes->at(0));
+            rebuildNodeIndex();
+            break;
         }
+    }
 
-        if (seenFrom && seenTo)
-            return false; // we've seen both, and neither is a favorite, so we can stop searching early
-
-        // Note: if we knew that sortMeshDB was always called after any change to is_favorite, we could exit early after searching
-        // all favorited nodes first.
+    for (pb_size_t i = 0; i < numMeshNodes; i++) {
+        nodeOrder[i] = i;
+        nodeOrderKeys[i] = orderKeyFor(meshNodes->at(i));
     }
+    std::stable_sort(nodeOrder.begin(), nodeOrder.begin() + numMeshNodes,
+                     [this](pb_size_t a, pb_size_t b) { return orderedBefore(nodeOrderKeys[a], nodeOrderKeys[b]); });
+    for (pb_size_t r = 0; r < numMeshNodes; r++)
+        nodeRank[nodeOrder[r]] = r;
+    nodeOrderStale = false;
 
-    return false;
+    LOG_INFO("Sort took %u milliseconds", millis() - start);
 }
 
-void NodeDB::pause_sort(bool paused)
+void NodeDB::reorderNode(const meshtastic_NodeInfoLite *node)
 {
-    sortingIsPaused = paused;
-}
+    if (sortingIsPaused) { // The node picker is showing the current order, catch up when it unpauses
+        nodeOrderStale = true;
+        return;
+    }
 
-void NodeDB::sortMeshDB()
-{
-    if (!sortingIsPaused && (lastSort == 0 || !Throttle::isWithinTimespanMs(lastSort, 1000 * 5))) {
-        lastSort = millis();
-        bool changed = true;
-        while (changed) { // dumb reverse bubble sort, but probably not bad for what we're doing
-            changed = false;
-            for (int i = numMeshNodes - 1; i > 0; i--) { // lowest case this should examine is i == 1
-                if (meshNodes->at(i - 1).num == getNodeNum()) {
-                    // noop
-                } else if (meshNodes->at(i).num ==
-                           getNodeNum()) { // in the oddball case our own node num is not at location 0, put it there
-                    // TODO: Look for at(i-1) also matching own node num, and throw the DB in the trash
-                    std::swap(meshNodes->at(i), meshNodes->at(i - 1));
-                    changed = true;
-                } else if (meshNodes->at(i).is_favorite && !meshNodes->at(i - 1).is_favorite) {
-                    std::swap(meshNodes->at(i), meshNodes->at(i - 1));
-                    changed = true;
-                } else if (!meshNodes->at(i).is_favorite && meshNodes->at(i - 1).is_favorite) {
-                    // noop
-                } else if (meshNodes->at(i).last_heard > meshNodes->at(i - 1).last_heard) {
-                    std::swap(meshNodes->at(i), meshNodes->at(i - 1));
-                    changed = true;
-                }
-            }
-        }
-        LOG_INFO("Sort took %u milliseconds", millis() - lastSort);
+    pb_size_t slot = node - meshNodes->data();
+    pb_size_t from = nodeRank[slot];
+    NodeOrderKey key = orderKeyFor(*node);
+
+    // nodeOrder is sorted by the stored keys, including this node's old one, so a binary search still works
+    auto it = std::lower_bound(nodeOrder.begin(), nodeOrder.begin() + numMeshNodes, key,
+                               [this](pb_size_t s, const NodeOrderKey &k) { return orderedBefore(nodeOrderKeys[s], k); });
+    pb_size_t to = it - nodeOrder.begin();
+    if (to > from)
+        to--; // the slot leaves its old rank first
+
+    if (to < from) {
+        std::copy_backward(nodeOrder.begin() + to, nodeOrder.begin() + from, nodeOrder.begin() + from + 1);
+    } else if (to > from) {
+        std::copy(nodeOrder.begin() + from + 1, nodeOrder.begin() + to + 1, nodeOrder.begin() + from);
     }
+    nodeOrder[to] = slot;
+    for (pb_size_t r = std::min(from, to); r <= std::max(from, to); r++)
+        nodeRank[nodeOrder[r]] = r;
+    nodeOrderKeys[slot] = key;
 }
 
 uint8_t NodeDB::getMeshNodeChannel(NodeNum n)
@@ -1923,11 +1969,106 @@ std::string NodeDB::getNodeId() const
 /// NOTE: This function might be called from an ISR
 meshtastic_NodeInfoLite *NodeDB::getMeshNode(NodeNum n)
 {
-    for (int i = 0; i < numMeshNodes; i++)
-        if (meshNodes->at(i).num == n)
-            return &meshNodes->at(i);
+    if (nodeIndex.empty())
+        return NULL;
+
+    uint32_t mask = nodeIndex.size() - 1;
+    for (uint32_t b = nodeIndexHome(n);; b = (b + 1) & mask) {
+        pb_size_t slot = nodeIndex[b];
+        if (slot == 0)
+            return NULL;
+        if (meshNodes->at(slot - 1).num == n)
+            return &meshNodes->at(slot - 1);
+    }
+}
+
+void NodeDB::addToNodeIndex(pb_size_t pos)
+{
+    NodeNum n = meshNodes->at(pos).num;
+    uint32_t mask = nodeIndex.size() - 1;
+    uint32_t b = nodeIndexHome(n);
+    for (; nodeIndex[b] != 0; b = (b + 1) & mask) {
+        if (meshNodes->at(nodeIndex[b] - 1).num == n)
+            return; // a linear scan would return the earlier entry, keep that one
+    }
+    nodeIndex[b] = pos + 1;
+}
 
-    return NULL;
+void NodeDB::removeFromNodeIndex(NodeNum n)
+{
+    uint32_t mask = nodeIndex.size() - 1;
+    uint32_t hole = nodeIndexHome(n);
+    for (; nodeIndex[hole] != 0; hole = (hole + 1) & mask) {
+        if (meshNodes->at(nodeIndex[hole] - 1).num == n)
+            break;
+    }
+    if (nodeIndex[hole] == 0)
+        return; // not indexed
+
+    for (uint32_t b = (hole + 1) & mask; nodeIndex[b] != 0; b = (b + 1) & mask) {
+        uint32_t home = nodeIndexHome(meshNodes->at(nodeIndex[b] - 1).num);
+        // Move the entry into the hole unless its home bucket lies cyclically in (hole, b]
+        if (((b - home) & mask) >= ((b - hole) & mask)) {
+            nodeIndex[hole] = nodeIndex[b];
+            hole = b;
+        }
+    }
+    nodeIndex[hole] = 0;
+}
+
+void NodeDB::rebuildNodeIndex()
+{
+    if (nodeIndex.empty()) {
+        // Allocate once for the largest DB we can hold, so adding nodes never rehashes
+        uint32_t maxNodes = std::max((uint32_t)MAX_NUM_NODES, (uint32_t)meshNodes->size());
+        nodeIndexBits = 3;
+        while ((1u << nodeIndexBits) < maxNodes + maxNodes / 2)
+            nodeIndexBits++;
+        nodeIndex.resize(1u << nodeIndexBits);
+    } else {
+        std::fill(nodeIndex.begin(), nodeIndex.end(), 0);
+    }
+
+    for (pb_size_t i = 0; i < numMeshNodes; i++)
+        addToNodeIndex(i);
+
+#ifdef DEBUG_NODEDB_INDEX
+    checkNodeIndex();
+#endif
+}
+
+bool NodeDB::checkNodeIndex()
+{
+    size_t indexed = 0;
+    for (pb_size_t slot : nodeIndex) {
+        if (slot == 0)
+            continue;
+        indexed++;
+        if (slot > numMeshNodes) {
+            LOG_ERROR("NodeDB index points past the end of the DB: %u >= %u", slot - 1, numMeshNodes);
+            return false;
+        }
+    }
+
+    size_t unique = 0;
+    for (pb_size_t i = 0; i < numMeshNodes; i++) {
+        NodeNum n = meshNodes->at(i).num;
+        pb_size_t first = 0;
+        while (meshNodes->at(first).num != n)
+            first++;
+        if (first == i)
+            unique++;
+        if (getMeshNode(n) != &meshNodes->at(first)) {
+            LOG_ERROR("NodeDB index mismatch for node 0x%08x at position %u", n, first);
+            return false;
+        }
+    }
+
+    if (indexed != unique) {
+        LOG_ERROR("NodeDB index holds %u entries for %u distinct nodes", indexed, unique);
+        return false;
+    }
+    return true;
 }
 
 // returns true if the maximum number of nodes is reached or we are running low on memory
@@ -1971,19 +2112,32 @@ meshtastic_NodeInfoLite *NodeDB::getOrCreateMeshNode(NodeNum n)
             }
 
             if (oldestIndex != -1) {
-                // Shove the remaining nodes down the chain
-                for (int i = oldestIndex; i < numMeshNodes - 1; i++) {
-                    meshNodes->at(i) = meshNodes->at(i + 1);
-                }
-                (numMeshNodes)--;
+                // Reuse the evicted slot in place, nothing else has to move
+                removeFromNodeIndex(meshNodes->at(oldestIndex).num);
+                lite = &meshNodes->at(oldestIndex);
             }
         }
-        // add the node at the end
-        lite = &meshNodes->at((numMeshNodes)++);
+        if (!lite) {
+            if (numMeshNodes >= meshNodes->size()) {
+                LOG_WARN("Node database full and nothing can be evicted, drop node 0x%08x", n);
+                return NULL;
+            }
+            // add the node at the end, ordered last until reorderNode() below
+            pb_size_t slot = numMeshNodes++;
+            lite = &meshNodes->at(slot);
+            nodeOrder[slot] = slot;
+            nodeRank[slot] = slot;
+            nodeOrderKeys[slot] = {0, 2};
+        }
 
         // everything is missing except the nodenum
         memset(lite, 0, sizeof(*lite));
         lite->num = n;
+        addToNodeIndex(lite - meshNodes->data());
+        reorderNode(lite);
+#ifdef DEBUG_NODEDB_INDEX
+        checkNodeIndex();
+#endif
         LOG_INFO("Adding node to database with %i nodes and %u bytes free!", numMeshNodes, memGet.getFreeHeap());
     }
 
@@ -243,15 +243,28 @@ class NodeDB
 
     const meshtastic_NodeInfoLite *readNextMeshNode(uint32_t &readIndex);
 
+    /// @return the node at position x of the display order: ourselves, then favorites, then most recently heard.
+    /// Records never move for sorting, nodeOrder maps the rank to their slot in meshNodes.
     meshtastic_NodeInfoLite *getMeshNodeByIndex(size_t x)
     {
         assert(x < numMeshNodes);
-        return &meshNodes->at(x);
+        return &meshNodes->at(nodeOrder.at(x));
     }
 
     virtual meshtastic_NodeInfoLite *getMeshNode(NodeNum n);
     size_t getNumMeshNodes() { return numMeshNodes; }
 
+    /**
+     * Whether everyone a packet to `to` on `channel` reaches has all of nodeInfoMask in its NodeInfoLite bitfield, i.e.
+     * told us in its NodeInfo that it can read some packet format.  For a broadcast that is every node heard on the
+     * channel in the last NODEINFO_AUDIENCE_SECS, and there must be at least one.
+     */
+    bool receiversHave(NodeNum to, uint8_t channel, uint32_t nodeInfoMask);
+
+    /// Check that the NodeNum index agrees with a linear scan of meshNodes, logs and returns false on the first mismatch.
+    /// Runs after every index change when built with DEBUG_NODEDB_INDEX.
+    bool checkNodeIndex();
+
     UserLicenseStatus getLicenseStatus(uint32_t nodeNum);
 
     size_t getMaxNodesAllocatedSize()
@@ -301,10 +314,48 @@ class NodeDB
     bool duplicateWarned = false;
     uint32_t lastNodeDbSave = 0;    // when we last saved our db to flash
     uint32_t lastBackupAttempt = 0; // when we last tried a backup automatically or manually
-    uint32_t lastSort = 0;          // When last sorted the nodeDB
     /// Find a node in our DB, create an empty NodeInfoLite if missing
     meshtastic_NodeInfoLite *getOrCreateMeshNode(NodeNum n);
 
+    /*
+     * NodeNum -> position in meshNodes, open addressed with linear probing.
+     * Buckets hold position+1, 0 means empty. Sized once for MAX_NUM_NODES at a load factor of at most 2/3.
+     */
+    std::vector<pb_size_t> nodeIndex;
+    uint8_t nodeIndexBits = 0;
+
+    /// Home bucket for a NodeNum (Fibonacci hashing)
+    uint32_t nodeIndexHome(NodeNum n) const { return (uint32_t)(n * 2654435769u) >> (32 - nodeIndexBits); }
+
+    /// Index the node at meshNodes position pos, unless its NodeNum is already indexed at a lower position
+    void addToNodeIndex(pb_size_t pos);
+
+    /// Reindex meshNodes [0, numMeshNodes) after nodes were moved, removed or reloaded
+    void rebuildNodeIndex();
+
+    /// Remove a NodeNum from the index, shifting later members of its probe chain back
+    void removeFromNodeIndex(NodeNum n);
+
+    /// Sort key of a node as of its last reorder: ourselves first, then favorites, then most recently heard
+    struct NodeOrderKey {
+        uint32_t lastHeard;
+        uint8_t group; // 0 ourselves, 1 favorite, 2 everyone else
+    };
+
+    std::vector<pb_size_t> nodeOrder;        // rank -> slot in meshNodes
+    std::vector<pb_size_t> nodeRank;         // slot in meshNodes -> rank
+    std::vector<NodeOrderKey> nodeOrderKeys; // slot in meshNodes -> key the slot is currently ordered by
+    bool nodeOrderStale = false;             // a reorder was skipped while sorting was paused
+
+    NodeOrderKey orderKeyFor(const meshtastic_NodeInfoLite &node);
+    static bool orderedBefore(const NodeOrderKey &a, const NodeOrderKey &b)
+    {
+        return a.group < b.group || (a.group == b.group && a.lastHeard > b.lastHeard);
+    }
+
+    /// Move one node to its place in nodeOrder after its favorite flag or last_heard changed. Only index entries move.
+    void reorderNode(const meshtastic_NodeInfoLite *node);
+
     /*
      * Internal boolean to track sorting paused
      */
@@ -330,6 +381,8 @@ class NodeDB
     bool saveChannelsToDisk();
     bool saveDeviceStateToDisk();
     bool saveNodeDatabaseToDisk();
+
+    /// Rebuild nodeOrder from scratch, after nodes were moved, removed or reloaded
     void sortMeshDB();
 };
 
@@ -367,6 +420,15 @@ extern meshtastic_CriticalErrorCode error_code;
 extern uint32_t error_address;
 #define NODEINFO_BITFIELD_IS_KEY_MANUALLY_VERIFIED_SHIFT 0
 #define NODEINFO_BITFIELD_IS_KEY_MANUALLY_VERIFIED_MASK (1 << NODEINFO_BITFIELD_IS_KEY_MANUALLY_VERIFIED_SHIFT)
+// The node's NodeInfo says it can decode compressed text messages, see BITFIELD_TEXT_COMPRESSION_MASK
+#define NODEINFO_BITFIELD_TEXT_COMPRESSION_SHIFT 1
+#define NODEINFO_BITFIELD_TEXT_COMPRESSION_MASK (1 << NODEINFO_BITFIELD_TEXT_COMPRESSION_SHIFT)
+// The node's NodeInfo says it can unpack aggregated WiFi bridge texts, see BITFIELD_TEXT_AGGREGATE_MASK
+#define NODEINFO_BITFIELD_TEXT_AGGREGATE_SHIFT 2
+#define NODEINFO_BITFIELD_TEXT_AGGREGATE_MASK (1 << NODEINFO_BITFIELD_TEXT_AGGREGATE_SHIFT)
+
+/// Nodes heard on a channel this recently are the audience of a broadcast on it, see NodeDB::receiversHave
+#define NODEINFO_AUDIENCE_SECS (2 * 60 * 60)
 
 #define Module_Config_size                                                                                                       \
     (ModuleConfig_CannedMessageConfig_size + ModuleConfig_ExternalNotificationConfig_size + ModuleConfig_MQTTConfig_size +       \
@@ -22,26 +22,47 @@ PacketHistory::PacketHistory(uint32_t size) : recentPacketsCapacity(0), recentPa
         LOG_WARN("Packet History - Invalid size %d, using default %d", size, PACKETHISTORY_MAX);
         size = PACKETHISTORY_MAX; // Use default size if invalid
     }
+    if (size >= (PacketHistorySlot)-1) { // Index buckets store slot+1, keep room for that
+        size = (PacketHistorySlot)-1 - 1;
+    }
+
+    // Index buckets: next power of two holding the records at a load factor of at most 2/3
+    uint32_t indexSize = 8;
+    while (indexSize < size + size / 2)
+        indexSize <<= 1;
 
-    // Allocate memory for the recent packets array
+    // Allocate memory for the recent packets array, its index and the aging ring
     recentPacketsCapacity = size;
     recentPackets = new PacketRecord[recentPacketsCapacity];
-    if (!recentPackets) { // No logging here, console/log probably uninitialized yet.
+    recentPacketsIndex = new PacketHistorySlot[indexSize];
+    ageNewer = new PacketHistorySlot[recentPacketsCapacity];
+    ageOlder = new PacketHistorySlot[recentPacketsCapacity];
+    // No logging here, console/log probably uninitialized yet.
+    if (!recentPackets || !recentPacketsIndex || !ageNewer || !ageOlder) {
         LOG_ERROR("Packet History - Memory allocation failed for size=%d entries / %d Bytes", size,
-                  sizeof(PacketRecord) * recentPacketsCapacity);
+                  sizeof(PacketRecord) * recentPacketsCapacity + sizeof(PacketHistorySlot) * (indexSize + 2 * size));
         recentPacketsCapacity = 0; // mark allocation fail
         return;                    // return early
     }
+    recentPacketsIndexMask = indexSize - 1;
 
-    // Initialize the recent packets array to zero
+    // Initialize the recent packets array and the index to zero
     memset(recentPackets, 0, sizeof(PacketRecord) * recentPacketsCapacity);
+    memset(recentPacketsIndex, 0, sizeof(PacketHistorySlot) * indexSize);
 }
 
 PacketHistory::~PacketHistory()
 {
     recentPacketsCapacity = 0;
+    recentPacketsUsed = 0;
     delete[] recentPackets;
     recentPackets = NULL;
+    delete[] recentPacketsIndex;
+    recentPacketsIndex = NULL;
+    delete[] ageNewer;
+    ageNewer = NULL;
+    delete[] ageOlder;
+    ageOlder = NULL;
 }
 
 /** Update recentPackets and return true if we have already seen this packet */
@@ -194,6 +215,95 @@ bool PacketHistory::wasSeenRecently(const meshtastic_MeshPacket *p, bool withUpd
     return seenRecently;
 }
 
+/** Mix sender and id into a well spread bucket hash (murmur3 finalizer) */
+uint32_t PacketHistory::hashKey(NodeNum sender, PacketId id)
+{
+    uint32_t h = (sender * 0x9E3779B1u) ^ id;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+/** Index position of the record for (sender, id), or -1 if not indexed */
+int32_t PacketHistory::indexFind(NodeNum sender, PacketId id) const
+{
+    for (uint32_t pos = hashKey(sender, id) & recentPacketsIndexMask;; pos = (pos + 1) & recentPacketsIndexMask) {
+        PacketHistorySlot bucket = recentPacketsIndex[pos];
+        if (bucket == 0)
+            return -1; // Hit an empty bucket, so the key is not in the table
+        const PacketRecord &r = recentPackets[bucket - 1];
+        if (r.id == id && r.sender == sender)
+            return pos;
+    }
+}
+
+/** Add a slot to the index. The caller makes sure its key is not indexed yet. */
+void PacketHistory::indexAdd(PacketHistorySlot slot)
+{
+    const PacketRecord &r = recentPackets[slot];
+    uint32_t pos = hashKey(r.sender, r.id) & recentPacketsIndexMask;
+    while (recentPacketsIndex[pos] != 0)
+        pos = (pos + 1) & recentPacketsIndexMask;
+    recentPacketsIndex[pos] = slot + 1;
+}
+
+/** Remove the bucket at pos, shifting later members of the probe chain back so no tombstones are needed */
+void PacketHistory::indexRemove(uint32_t pos)
+{
+    uint32_t next = pos;
+    for (;;) {
+        next = (next + 1) & recentPacketsIndexMask;
+        PacketHistorySlot bucket = recentPacketsIndex[next];
+        if (bucket == 0)
+            break;
+        const PacketRecord &r = recentPackets[bucket - 1];
+        uint32_t home = hashKey(r.sender, r.id) & recentPacketsIndexMask;
+        // Move the entry into the hole unless its home bucket lies cyclically in (pos, next]
+        if (((next - home) & recentPacketsIndexMask) >= ((next - pos) & recentPacketsIndexMask)) {
+            recentPacketsIndex[pos] = bucket;
+            pos = next;
+        }
+    }
+    recentPacketsIndex[pos] = 0;
+}
+
+/** Link a fresh slot into the aging ring as the newest record */
+void PacketHistory::agingAppend(PacketHistorySlot slot)
+{
+    if (recentPacketsUsed == 0) {
+        ageNewer[slot] = ageOlder[slot] = slot;
+        agingOldest = slot;
+        return;
+    }
+    PacketHistorySlot newest = ageOlder[agingOldest];
+    ageNewer[newest] = slot;
+    ageOlder[slot] = newest;
+    ageNewer[slot] = agingOldest;
+    ageOlder[agingOldest] = slot;
+}
+
+/** Move a slot that is already in the aging ring to the newest end */
+void PacketHistory::agingTouch(PacketHistorySlot slot)
+{
+    if (slot == agingOldest) { // Rotating the ring turns the oldest into the newest
+        agingOldest = ageNewer[slot];
+        return;
+    }
+    if (slot == ageOlder[agingOldest])
+        return; // Already the newest
+
+    ageNewer[ageOlder[slot]] = ageNewer[slot];
+    ageOlder[ageNewer[slot]] = ageOlder[slot];
+    PacketHistorySlot newest = ageOlder[agingOldest];
+    ageNewer[newest] = slot;
+    ageOlder[slot] = newest;
+    ageNewer[slot] = agingOldest;
+    ageOlder[agingOldest] = slot;
+}
+
 /** Find a packet record in history.
  * @return pointer to PacketRecord if found, NULL if not found */
 PacketHistory::PacketRecord *PacketHistory::find(NodeNum sender, PacketId id)
@@ -205,17 +315,15 @@ PacketHistory::PacketRecord *PacketHistory::find(NodeNum sender, PacketId id)
         return NULL;
     }
 
-    PacketRecord *it = NULL;
-    for (it = recentPackets; it < (recentPackets + recentPacketsCapacity); ++it) {
-        if (it->id == id && it->sender == sender) {
+    int32_t pos = indexFind(sender, id);
+    if (pos >= 0) {
+        PacketRecord *it = recentPackets + (recentPacketsIndex[pos] - 1);
 #if VERBOSE_PACKET_HISTORY
-            LOG_DEBUG("Packet History - find: s=%08x id=%08x FOUND nh=%02x rby=%02x %02x %02x age=%d slot=%d/%d", it->sender,
-                      it->id, it->next_hop, it->relayed_by[0], it->relayed_by[1], it->relayed_by[2], millis() - (it->rxTimeMsec),
-                      it - recentPackets, recentPacketsCapacity);
+        LOG_DEBUG("Packet History - find: s=%08x id=%08x FOUND nh=%02x rby=%02x %02x %02x age=%d slot=%d/%d", it->sender, it->id,
+                  it->next_hop, it->relayed_by[0], it->relayed_by[1], it->relayed_by[2], millis() - (it->rxTimeMsec),
+                  it - recentPackets, recentPacketsCapacity);
 #endif
-            // only the first match is returned, so be careful not to create duplicate entries
-            return it; // Return pointer to the found record
-        }
+        return it; // Return pointer to the found record
     }
 
 #if VERBOSE_PACKET_HISTORY
@@ -230,48 +338,39 @@ void PacketHistory::insert(const PacketRecord &r)
     uint32_t now_millis = millis(); // Should not jump with time changes
     uint32_t OldtrxTimeMsec = 0;
     PacketRecord *tu = NULL; // Will insert here.
-    PacketRecord *it = NULL;
 
-    // Find a free, matching or oldest used slot in the recentPackets array
-    for (it = recentPackets; it < (recentPackets + recentPacketsCapacity); ++it) {
-        if (it->id == 0 && it->sender == 0 /*&& rxTimeMsec == 0*/) { // Record is empty
-            tu = it;                                                 // Remember the free slot
-#if VERBOSE_PACKET_HISTORY >= 2
-            LOG_DEBUG("Packet History - insert: Free slot@ %d/%d", tu - recentPackets, recentPacketsCapacity);
+    if (r.sender == 0 || r.id == 0) { // Could never be found again, and (0, 0) used to mean an empty slot
+#if VERBOSE_PACKET_HISTORY
+        LOG_WARN("Packet History - insert: I will not store packet with sender or id = 0.");
 #endif
-            // We have that, Exit the loop
-            it = (recentPackets + recentPacketsCapacity);
-        } else if (it->id == r.id && it->sender == r.sender) { // Record matches the packet we want to insert
-            tu = it;                                           // Remember the matching slot
-            OldtrxTimeMsec = now_millis - it->rxTimeMsec;      // ..and save current entry's age
+        return;
+    }
+
+    // Find the matching slot, else a free one, else the oldest used slot (head of the aging ring)
+    int32_t matchPos = indexFind(r.sender, r.id);
+    if (matchPos >= 0) {
+        tu = recentPackets + (recentPacketsIndex[matchPos] - 1); // Remember the matching slot
+        OldtrxTimeMsec = now_millis - tu->rxTimeMsec;            // ..and save current entry's age
 #if VERBOSE_PACKET_HISTORY >= 2
-            LOG_DEBUG("Packet History - insert: Matched slot@ %d/%d age=%d", tu - recentPackets, recentPacketsCapacity,
-                      OldtrxTimeMsec);
+        LOG_DEBUG("Packet History - insert: Matched slot@ %d/%d age=%d", tu - recentPackets, recentPacketsCapacity,
+                  OldtrxTimeMsec);
 #endif
-            // We have that, Exit the loop
-            it = (recentPackets + recentPacketsCapacity);
-        } else {
-            if (it->rxTimeMsec == 0) {
-                LOG_WARN(
-                    "Packet History - insert: Found packet s=%08x id=%08x with rxTimeMsec = 0, slot %d/%d. Should never happen!",
-                    it->sender, it->id, it - recentPackets, recentPacketsCapacity);
-            }
-            if ((now_millis - it->rxTimeMsec) > OldtrxTimeMsec) { // 49.7 days rollover friendly
-                OldtrxTimeMsec = now_millis - it->rxTimeMsec;
-                tu = it; // remember the oldest packet
+    } else if (recentPacketsUsed < recentPacketsCapacity) {
+        tu = recentPackets + recentPacketsUsed; // Remember the free slot
 #if VERBOSE_PACKET_HISTORY >= 2
-                LOG_DEBUG("Packet History - insert: Older slot@ %d/%d age=%d", tu - recentPackets, recentPacketsCapacity,
-                          OldtrxTimeMsec);
+        LOG_DEBUG("Packet History - insert: Free slot@ %d/%d", tu - recentPackets, recentPacketsCapacity);
 #endif
-            }
-            // keep looking for oldest till entire array is checked
+    } else {
+        tu = recentPackets + agingOldest; // remember the oldest packet
+        if (tu->rxTimeMsec == 0) {
+            LOG_WARN("Packet History - insert: Found packet s=%08x id=%08x with rxTimeMsec = 0, slot %d/%d. Should never happen!",
+                     tu->sender, tu->id, tu - recentPackets, recentPacketsCapacity);
         }
-    }
-
-    if (tu == NULL) {
-        LOG_ERROR("Packet History - insert: No free slot, no matched packet, no oldest to reuse. Something leaked."); // mx
-        // assert(false); // This should never happen, we should always have at least one packet to clear
-        return; // Return early if we can't update the history
+        OldtrxTimeMsec = now_millis - tu->rxTimeMsec; // 49.7 days rollover friendly
+#if VERBOSE_PACKET_HISTORY >= 2
+        LOG_DEBUG("Packet History - insert: Older slot@ %d/%d age=%d", tu - recentPackets, recentPacketsCapacity,
+                  OldtrxTimeMsec);
+#endif
     }
 
 #if VERBOSE_PACKET_HISTORY
@@ -327,7 +426,21 @@ void PacketHistory::insert(const PacketRecord &r)
         return; // Return early if we can't update the history
     }
 
-    *tu = r; // store the packet
+    PacketHistorySlot slot = tu - recentPackets;
+    if (matchPos >= 0) {
+        *tu = r; // store the packet, the key is unchanged so the index stays valid
+        agingTouch(slot);
+    } else if (slot == recentPacketsUsed) {
+        *tu = r; // store the packet
+        agingAppend(slot);
+        recentPacketsUsed++;
+        indexAdd(slot);
+    } else {
+        indexRemove(indexFind(tu->sender, tu->id)); // Drop the evicted key before the slot gets its new one
+        *tu = r;                                    // store the packet
+        agingOldest = ageNewer[slot];               // The oldest slot becomes the newest
+        indexAdd(slot);
+    }
 
 #if VERBOSE_PACKET_HISTORY
     LOG_DEBUG("Packet History - insert: Store slot@ %d/%d s=%08x id=%08x nh=%02x rby=%02x %02x %02x rxT=%d AFTER",
@@ -8,6 +8,13 @@
 #define HOP_LIMIT_OUR_TX_MASK 0x38  // Bits 3-5
 #define HOP_LIMIT_OUR_TX_SHIFT 3    // Bits 3-5
 
+// Slot numbers for the hash index and aging ring. Portduino can raise MaxNodes far enough to overflow 16 bits.
+#ifdef ARCH_PORTDUINO
+typedef uint32_t PacketHistorySlot;
+#else
+typedef uint16_t PacketHistorySlot;
+#endif
+
 /**
  * This is a mixin that adds a record of past packets we have seen
  */
@@ -28,6 +35,29 @@ class PacketHistory
         0; // Can be set in constructor, no need to recompile. Used to allocate memory for mx_recentPackets.
     PacketRecord *recentPackets = NULL; // Simple and fixed in size. Debloat.
 
+    /* Open-addressed (linear probing) index on (sender, id). Each bucket holds slot+1 into recentPackets, 0 means empty.
+     * Sized to a power of two with a load factor of at most 2/3, so lookups touch one or two buckets on average. */
+    PacketHistorySlot *recentPacketsIndex = NULL;
+    uint32_t recentPacketsIndexMask = 0;
+
+    /* Aging ring: a circular doubly linked list threaded through the used slots, ordered from oldest (agingOldest) to
+     * newest (ageOlder[agingOldest]). Refreshing a record moves it to the newest end, evicting the oldest is a rotation. */
+    PacketHistorySlot *ageNewer = NULL;
+    PacketHistorySlot *ageOlder = NULL;
+    PacketHistorySlot agingOldest = 0;
+    uint32_t recentPacketsUsed = 0; // Slots [0, recentPacketsUsed) hold records and are linked into the aging ring
+
+    static uint32_t hashKey(NodeNum sender, PacketId id);
+
+    /** Index position of the record for (sender, id), or -1 if not indexed */
+    int32_t indexFind(NodeNum sender, PacketId id) const;
+    void indexAdd(PacketHistorySlot slot);
+    void indexRemove(uint32_t pos);
+
+    /** Aging ring maintenance */
+    void agingAppend(PacketHistorySlot slot); // Link a fresh slot as the newest
+    void agingTouch(PacketHistorySlot slot);  // Move a linked slot to the newest end
+
     /** Find a packet record in history.
      * @param sender NodeNum
      * @param id PacketId
@@ -74,5 +104,9 @@ class PacketHistory
     void removeRelayer(const uint8_t relayer, const uint32_t id, const NodeNum sender);
 
     // To check if the PacketHistory was initialized correctly by constructor
-    bool initOk(void) { return recentPackets != NULL && recentPacketsCapacity != 0; }
+    bool initOk(void)
+    {
+        return recentPackets != NULL && recentPacketsIndex != NULL && ageNewer != NULL && ageOlder != NULL &&
+               recentPacketsCapacity != 0;
+    }
 };
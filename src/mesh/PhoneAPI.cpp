@@ -52,6 +52,9 @@ void PhoneAPI::handleStartConfig()
     if (!isConnected()) {
         onConnectionChanged(true);
         observe(&service->fromNumChanged);
+        phoneReader = service->openPhoneReader();
+        if (phoneReader < 0)
+            LOG_WARN("Too many API clients, this one will not receive mesh packets");
 #ifdef FSCom
         observe(&xModem.packetReady);
 #endif
@@ -108,6 +111,8 @@ void PhoneAPI::close()
         unobserve(&xModem.packetReady);
 #endif
         releasePhonePacket(); // Don't leak phone packets on shutdown
+        service->closePhoneReader(phoneReader);
+        phoneReader = -1;
         releaseQueueStatusPhonePacket();
         releaseMqttClientProxyPhonePacket();
         releaseClientNotification();
@@ -120,7 +125,6 @@ void PhoneAPI::close()
             nodeInfoForPhone = {};
             nodeInfoQueue.clear();
         }
-        packetForPhone = NULL;
         filesManifest.clear();
         fromRadioNum = 0;
         config_nonce = 0;
@@ -556,7 +560,7 @@ size_t PhoneAPI::getFromRadio(uint8_t *buf)
             fromRadioScratch.clientNotification = *clientNotification;
             releaseClientNotification();
         } else if (packetForPhone) {
-            printPacket("phone downloaded packet", packetForPhone);
+            printPacket("phone downloaded packet", packetForPhone.get());
 
             // Encapsulate as a FromRadio packet
             fromRadioScratch.which_payload_variant = meshtastic_FromRadio_packet_tag;
@@ -612,10 +616,7 @@ void PhoneAPI::sendConfigComplete()
 
 void PhoneAPI::releasePhonePacket()
 {
-    if (packetForPhone) {
-        service->releaseToPool(packetForPhone); // we just copied the bytes, so don't need this buffer anymore
-        packetForPhone = NULL;
-    }
+    packetForPhone.reset(); // we just copied the bytes, so don't need this buffer anymore
 }
 
 void PhoneAPI::releaseQueueStatusPhonePacket()
@@ -723,12 +724,12 @@ bool PhoneAPI::available()
 #if !MESHTASTIC_EXCLUDE_STOREFORWARD
         // Check if StoreForward has packets stored for us.
         if (!packetForPhone && storeForwardModule)
-            packetForPhone = storeForwardModule->getForPhone();
+            packetForPhone = SharedPacket::adopt(storeForwardModule->getForPhone());
 #endif
 #endif
 
         if (!packetForPhone)
-            packetForPhone = service->getForPhone();
+            packetForPhone = service->getForPhone(phoneReader);
         hasPacket = !!packetForPhone;
         return hasPacket;
     }
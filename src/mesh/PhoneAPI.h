@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Observer.h"
+#include "SharedPacket.h"
 #include "concurrency/Lock.h"
 #include "mesh-pb-constants.h"
 #include "meshtastic/portnums.pb.h"
@@ -63,9 +64,12 @@ class PhoneAPI
      */
     uint32_t fromRadioNum = 0;
 
-    /// We temporarily keep the packet here between the call to available and getFromRadio.  We will free it after the phone
-    /// downloads it
-    meshtastic_MeshPacket *packetForPhone = NULL;
+    /// We temporarily keep the packet here between the call to available and getFromRadio.  We drop our reference after the
+    /// phone downloads it
+    SharedPacket packetForPhone;
+
+    /// Our cursor into MeshService's toPhoneQueue, -1 while not connected (or if all reader slots were taken)
+    int phoneReader = -1;
 
     // file transfer packets destined for phone. Push it to the queue then free it.
     meshtastic_XModem xmodemPacketForPhone = meshtastic_XModem_init_zero;
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "DropOldestQueue.h"
+
+#include <assert.h>
+#include <utility>
+
+/**
+ * A bounded FIFO per priority level, sharing one limit, where a full queue drops the least important entries first.
+ *
+ * Level 0 is the most important.  Each level keeps at most its own retention, dropping its oldest entry beyond that, and
+ * all of them together at most maxElements.  When that is reached a new entry takes the place of the oldest one of the
+ * least important level that has any, as long as that level is not more important than its own; otherwise the new entry
+ * is the one dropped.  So a flood of low priority entries only ever pushes out its own kind.
+ *
+ * Entries come out most important level first, in order within a level.
+ */
+template <class T, int levels> class PriorityDropQueue
+{
+    const int maxElements;
+    DropOldestQueue<T> *queues[levels];
+    int count = 0;
+    uint32_t dropped[levels] = {};
+
+  public:
+    /// retention[level] is the most entries kept of that level
+    PriorityDropQueue(int _maxElements, const int (&retention)[levels]) : maxElements(_maxElements)
+    {
+        assert(maxElements > 0);
+        for (int i = 0; i < levels; i++)
+            queues[i] = new DropOldestQueue<T>(retention[i]);
+    }
+
+    ~PriorityDropQueue()
+    {
+        for (int i = 0; i < levels; i++)
+            delete queues[i];
+    }
+
+    PriorityDropQueue(const PriorityDropQueue &) = delete;
+    PriorityDropQueue &operator=(const PriorityDropQueue &) = delete;
+
+    int numUsed() const { return count; }
+    int numUsed(int level) const { return queues[level]->numUsed(); }
+    bool isEmpty() const { return count == 0; }
+
+    /// How many entries of a level were discarded since boot, to make room or because there was none
+    uint32_t getDropped(int level) const { return dropped[level]; }
+
+    /// Append an entry at level.  Returns false if something had to be dropped, the new entry or an older one.
+    bool push(int level, T item)
+    {
+        assert(level >= 0 && level < levels);
+        DropOldestQueue<T> &q = *queues[level];
+        if (q.numFree() == 0) {
+            // Over its own retention, it replaces the oldest of its level and the total stays the same
+            q.push(std::move(item));
+            dropped[level]++;
+            return false;
+        }
+        if (count < maxElements) {
+            q.push(std::move(item));
+            count++;
+            return true;
+        }
+
+        int victim = levels - 1;
+        while (victim > level && queues[victim]->isEmpty())
+            victim--;
+        if (queues[victim]->isEmpty()) {
+            dropped[level]++; // Everything held is more important
+            return false;
+        }
+        queues[victim]->pop();
+        dropped[victim]++;
+        q.push(std::move(item));
+        return false;
+    }
+
+    /// The entry that comes out next, only valid while !isEmpty()
+    T &front() { return queues[nextLevel()]->front(); }
+
+    /// Level of the entry that comes out next, only valid while !isEmpty()
+    int frontLevel() const { return nextLevel(); }
+
+    /// Remove and return the next entry, or an empty T if there is none
+    T pop()
+    {
+        if (count == 0)
+            return T();
+        count--;
+        return queues[nextLevel()]->pop();
+    }
+
+    void clear()
+    {
+        for (int i = 0; i < levels; i++)
+            queues[i]->clear();
+        count = 0;
+    }
+
+  private:
+    int nextLevel() const
+    {
+        int level = 0;
+        while (level < levels - 1 && queues[level]->isEmpty())
+            level++;
+        return level;
+    }
+};
@@ -5,6 +5,8 @@
 #include "MeshService.h"
 #include "NodeDB.h"
 #include "RTC.h"
+#include "SharedPacket.h"
+#include "compression/TextCompression.h"
 
 #include "configuration.h"
 #include "detect/LoRaRadioType.h"
@@ -37,6 +39,8 @@
 
 static MemoryDynamic<meshtastic_MeshPacket> dynamicPool;
 Allocator<meshtastic_MeshPacket> &packetPool = dynamicPool;
+static MemoryDynamic<SharedPacketControl> dynamicSharedControlPool;
+Allocator<SharedPacketControl> &sharedPacketControlPool = dynamicSharedControlPool;
 #elif defined(ARCH_STM32WL)
 // On STM32 there isn't enough heap left over for the rest of the firmware if we allocate this statically.
 // For now, make it dynamic again.
@@ -46,18 +50,28 @@ Allocator<meshtastic_MeshPacket> &packetPool = dynamicPool;
 
 static MemoryDynamic<meshtastic_MeshPacket> dynamicPool;
 Allocator<meshtastic_MeshPacket> &packetPool = dynamicPool;
+static MemoryDynamic<SharedPacketControl> dynamicSharedControlPool;
+Allocator<SharedPacketControl> &sharedPacketControlPool = dynamicSharedControlPool;
 #else
 // Embedded targets use static memory pools with compile-time constants
+// While the broker is unreachable MQTT keeps SharedPacket references to what it still has to publish, those come out of the
+// same pool.  MQTT.h only defines MQTT_HELD_PACKETS when MQTT is compiled in and has a broker connection of its own.
+#if !MESHTASTIC_EXCLUDE_MQTT && defined(MQTT_HELD_PACKETS)
+#define MAX_RX_MQTT_HELD MQTT_HELD_PACKETS
+#else
+#define MAX_RX_MQTT_HELD 0
+#endif
+// The WiFi bridge holds MAX_RX_WIFI_BRIDGE as well until its thread passes them on to the web clients
 #define MAX_PACKETS_STATIC                                                                                                       \
-    (MAX_RX_TOPHONE + MAX_RX_FROMRADIO + 2 * MAX_TX_QUEUE +                                                                      \
+    (MAX_RX_TOPHONE + MAX_RX_FROMRADIO + 2 * MAX_TX_QUEUE + MAX_RX_MQTT_HELD + MAX_RX_WIFI_BRIDGE +                              \
      2) // max number of packets which can be in flight (either queued from reception or queued for sending)
 
 static MemoryPool<meshtastic_MeshPacket, MAX_PACKETS_STATIC> staticPool;
 Allocator<meshtastic_MeshPacket> &packetPool = staticPool;
+static MemoryPool<SharedPacketControl, MAX_PACKETS_STATIC> staticSharedControlPool;
+Allocator<SharedPacketControl> &sharedPacketControlPool = staticSharedControlPool;
 #endif
 
-static uint8_t bytes[MAX_LORA_PAYLOAD_LEN + 1] __attribute__((__aligned__));
-
 /**
  * Constructor
  *
@@ -237,6 +251,11 @@ meshtastic_QueueStatus Router::getQueueStatus()
         return iface->getQueueStatus();
 }
 
+uint32_t Router::getPacketTime(const meshtastic_MeshPacket *p)
+{
+    return iface ? iface->getPacketTime(p) : 0;
+}
+
 ErrorCode Router::sendLocal(meshtastic_MeshPacket *p, RxSource src)
 {
     if (p->to == 0) {
@@ -407,8 +426,6 @@ void Router::sniffReceived(const meshtastic_MeshPacket *p, const meshtastic_Rout
 
 DecodeState perhapsDecode(meshtastic_MeshPacket *p)
 {
-    concurrency::LockGuard g(cryptLock);
-
     if (config.device.rebroadcast_mode == meshtastic_Config_DeviceConfig_RebroadcastMode_KNOWN_ONLY &&
         (nodeDB->getMeshNode(p->from) == NULL || !nodeDB->getMeshNode(p->from)->has_user)) {
         LOG_DEBUG("Node 0x%x not in nodeDB-> Rebroadcast mode KNOWN_ONLY will ignore packet", p->from);
@@ -418,6 +435,8 @@ DecodeState perhapsDecode(meshtastic_MeshPacket *p)
     if (p->which_payload_variant == meshtastic_MeshPacket_decoded_tag)
         return DecodeState::DECODE_SUCCESS; // If packet was already decoded just return
 
+    // Scratch space of our own, packets are decoded from several threads at once and nothing else serializes them
+    uint8_t bytes[MAX_LORA_PAYLOAD_LEN + 1] __attribute__((__aligned__));
     size_t rawSize = p->encrypted.size;
     if (rawSize > sizeof(bytes)) {
         LOG_ERROR("Packet too large to attempt decryption! (rawSize=%d > 256)", rawSize);
@@ -425,6 +444,7 @@ DecodeState perhapsDecode(meshtastic_MeshPacket *p)
     }
     bool decrypted = false;
     ChannelIndex chIndex = 0;
+    CryptoContext cryptoCtx; // per packet, the engine itself only locks around its cached key material
 #if !(MESHTASTIC_EXCLUDE_PKI)
     // Attempt PKI decryption first
     if (p->channel == 0 && isToUs(p) && p->to > 0 && !isBroadcast(p->to) && nodeDB->getMeshNode(p->from) != nullptr &&
@@ -432,8 +452,8 @@ DecodeState perhapsDecode(meshtastic_MeshPacket *p)
         rawSize > MESHTASTIC_PKC_OVERHEAD) {
         LOG_DEBUG("Attempt PKI decryption");
 
-        if (crypto->decryptCurve25519(p->from, nodeDB->getMeshNode(p->from)->user.public_key, p->id, rawSize, p->encrypted.bytes,
-                                      bytes)) {
+        if (crypto->decryptCurve25519(cryptoCtx, p->from, nodeDB->getMeshNode(p->from)->user.public_key, p->id, rawSize,
+                                      p->encrypted.bytes, bytes)) {
             LOG_INFO("PKI Decryption worked!");
 
             meshtastic_Data decodedtmp;
@@ -463,17 +483,22 @@ DecodeState perhapsDecode(meshtastic_MeshPacket *p)
         // Try to find a channel that works with this hash
         for (chIndex = 0; chIndex < channels.getNumChannels(); chIndex++) {
             // Try to use this hash/channel pair
-            if (channels.decryptForHash(chIndex, p->channel)) {
+            if (channels.getCryptoForHash(chIndex, p->channel, cryptoCtx)) {
                 // we have to copy into a scratch buffer, because these bytes are a union with the decoded protobuf. Create a
                 // fresh copy for each decrypt attempt.
                 memcpy(bytes, p->encrypted.bytes, rawSize);
                 // Try to decrypt the packet if we can
-                crypto->decrypt(p->from, p->id, rawSize, bytes);
+                crypto->decrypt(cryptoCtx, p->from, p->id, rawSize, bytes);
 
                 // printBytes("plaintext", bytes, p->encrypted.size);
 
-                // Take those raw bytes and convert them back into a well structured protobuf we can understand
+                // Take those raw bytes and convert them back into a well structured protobuf we can understand.  A wrong key
+                // almost always fails the cheap structural check, so we skip the full decode for those attempts.
                 meshtastic_Data decodedtmp;
+                if (!pb_looks_like_data(bytes, rawSize)) {
+                    LOG_DEBUG("Channel %d key does not decode packet id=0x%08x", chIndex, p->id);
+                    continue;
+                }
                 memset(&decodedtmp, 0, sizeof(decodedtmp));
                 if (!pb_decode_from_bytes(bytes, rawSize, &meshtastic_Data_msg, &decodedtmp)) {
                     LOG_ERROR("Invalid protobufs in received mesh packet id=0x%08x (bad psk?)!", p->id);
@@ -500,25 +525,20 @@ DecodeState perhapsDecode(meshtastic_MeshPacket *p)
         if (p->decoded.has_bitfield)
             p->decoded.want_response |= p->decoded.bitfield & BITFIELD_WANT_RESPONSE_MASK;
 
-        /* Not actually ever used.
-        // Decompress if needed. jm
+        // Modules, clients and MQTT only ever see plain text
         if (p->decoded.portnum == meshtastic_PortNum_TEXT_MESSAGE_COMPRESSED_APP) {
-            // Decompress the payload
-            char compressed_in[meshtastic_Constants_DATA_PAYLOAD_LEN] = {};
-            char decompressed_out[meshtastic_Constants_DATA_PAYLOAD_LEN] = {};
-            int decompressed_len;
-
-            memcpy(compressed_in, p->decoded.payload.bytes, p->decoded.payload.size);
-
-            decompressed_len = unishox2_decompress_simple(compressed_in, p->decoded.payload.size, decompressed_out);
-
-            // LOG_DEBUG("**Decompressed length - %d ", decompressed_len);
-
-            memcpy(p->decoded.payload.bytes, decompressed_out, decompressed_len);
-
-            // Switch the port from PortNum_TEXT_MESSAGE_COMPRESSED_APP to PortNum_TEXT_MESSAGE_APP
-            p->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
-        } */
+            uint8_t text[sizeof(p->decoded.payload.bytes)];
+            int len = decompressText(p->decoded.payload.bytes, p->decoded.payload.size, text, sizeof(text));
+            if (len < 0) {
+                LOG_WARN("Undecodable compressed text id=0x%08x, left as is", p->id);
+            } else {
+                memcpy(p->decoded.payload.bytes, text, len);
+                p->decoded.payload.size = len;
+                p->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+                p->decoded.has_bitfield = true;
+                p->decoded.bitfield |= BITFIELD_WAS_COMPRESSED_MASK;
+            }
+        }
 
         printPacket("decoded message", p);
 #if ENABLE_JSON_LOGGING
@@ -535,13 +555,42 @@ DecodeState perhapsDecode(meshtastic_MeshPacket *p)
     }
 }
 
+void clearLocalBitfield(meshtastic_MeshPacket *p)
+{
+    if (p->which_payload_variant == meshtastic_MeshPacket_decoded_tag)
+        p->decoded.bitfield &= ~BITFIELD_WAS_COMPRESSED_MASK;
+}
+
+/**
+ * Whether text we send to p->to may go compressed: every receiver must have told us in its NodeInfo that it can decompress
+ * it.
+ */
+static bool textCompressionAllowed(const meshtastic_MeshPacket *p)
+{
+    return nodeDB->receiversHave(p->to, p->channel, NODEINFO_BITFIELD_TEXT_COMPRESSION_MASK);
+}
+
+/// Switch a text packet to TEXT_MESSAGE_COMPRESSED_APP if that makes it smaller
+static void perhapsCompressText(meshtastic_MeshPacket *p)
+{
+    uint8_t packed[sizeof(p->decoded.payload.bytes)];
+    size_t len = compressText(p->decoded.payload.bytes, p->decoded.payload.size, packed, sizeof(packed));
+    if (len == 0)
+        return;
+
+    LOG_DEBUG("Compressed text id=0x%08x from %u to %u bytes", p->id, p->decoded.payload.size, (unsigned)len);
+    memcpy(p->decoded.payload.bytes, packed, len);
+    p->decoded.payload.size = len;
+    p->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_COMPRESSED_APP;
+}
+
 /** Return 0 for success or a Routing_Error code for failure
  */
 meshtastic_Routing_Error perhapsEncode(meshtastic_MeshPacket *p)
 {
-    concurrency::LockGuard g(cryptLock);
-
     int16_t hash;
+    CryptoContext cryptoCtx;
+    uint8_t bytes[MAX_LORA_PAYLOAD_LEN + 1] __attribute__((__aligned__)); // As in perhapsDecode, on the caller's stack
 
     // If the packet is not yet encrypted, do so now
     if (p->which_payload_variant == meshtastic_MeshPacket_decoded_tag) {
@@ -551,42 +600,13 @@ meshtastic_Routing_Error perhapsEncode(meshtastic_MeshPacket *p)
             p->decoded.bitfield |= (p->decoded.want_response << BITFIELD_WANT_RESPONSE_SHIFT);
         }
 
-        size_t numbytes = pb_encode_to_bytes(bytes, sizeof(bytes), &meshtastic_Data_msg, &p->decoded);
-
-        /* Not actually used, so save the cycles
-        //  TODO: Allow modules to opt into compression.
-        if (p->decoded.portnum == meshtastic_PortNum_TEXT_MESSAGE_APP) {
-
-            char original_payload[meshtastic_Constants_DATA_PAYLOAD_LEN];
-            memcpy(original_payload, p->decoded.payload.bytes, p->decoded.payload.size);
+        // Text goes compressed when that is shorter and every receiver can read it.  Relayed text goes the way it came.
+        if (p->decoded.portnum == meshtastic_PortNum_TEXT_MESSAGE_APP &&
+            ((p->decoded.bitfield & BITFIELD_WAS_COMPRESSED_MASK) || (isFromUs(p) && textCompressionAllowed(p))))
+            perhapsCompressText(p);
+        p->decoded.bitfield &= ~BITFIELD_WAS_COMPRESSED_MASK;
 
-            char compressed_out[meshtastic_Constants_DATA_PAYLOAD_LEN] = {0};
-
-            int compressed_len;
-            compressed_len = unishox2_compress_simple(original_payload, p->decoded.payload.size, compressed_out);
-
-            LOG_DEBUG("Original length - %d ", p->decoded.payload.size);
-            LOG_DEBUG("Compressed length - %d ", compressed_len);
-            LOG_DEBUG("Original message - %s ", p->decoded.payload.bytes);
-
-            // If the compressed length is greater than or equal to the original size, don't use the compressed form
-            if (compressed_len >= p->decoded.payload.size) {
-
-                LOG_DEBUG("Not using compressing message");
-                // Set the uncompressed payload variant anyway. Shouldn't hurt?
-                // p->decoded.which_payloadVariant = Data_payload_tag;
-
-                // Otherwise we use the compressor
-            } else {
-                LOG_DEBUG("Use compressed message");
-                // Copy the compressed data into the meshpacket
-
-                p->decoded.payload.size = compressed_len;
-                memcpy(p->decoded.payload.bytes, compressed_out, compressed_len);
-
-                p->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_COMPRESSED_APP;
-            }
-        } */
+        size_t numbytes = pb_encode_to_bytes(bytes, sizeof(bytes), &meshtastic_Data_msg, &p->decoded);
 
         if (numbytes + MESHTASTIC_HEADER_LENGTH > MAX_LORA_PAYLOAD_LEN)
             return meshtastic_Routing_Error_TOO_LARGE;
@@ -626,7 +646,8 @@ meshtastic_Routing_Error perhapsEncode(meshtastic_MeshPacket *p)
                          *node->user.public_key.bytes);
                 return meshtastic_Routing_Error_PKI_FAILED;
             }
-            crypto->encryptCurve25519(p->to, getFrom(p), node->user.public_key, p->id, numbytes, bytes, p->encrypted.bytes);
+            crypto->encryptCurve25519(cryptoCtx, p->to, getFrom(p), node->user.public_key, p->id, numbytes, bytes,
+                                      p->encrypted.bytes);
             numbytes += MESHTASTIC_PKC_OVERHEAD;
             p->channel = 0;
             p->pki_encrypted = true;
@@ -635,7 +656,7 @@ meshtastic_Routing_Error perhapsEncode(meshtastic_MeshPacket *p)
                 // Client specifically requested PKI encryption
                 return meshtastic_Routing_Error_PKI_FAILED;
             }
-            hash = channels.setActiveByIndex(chIndex);
+            hash = channels.getCryptoForIndex(chIndex, cryptoCtx);
 
             // Now that we are encrypting the packet channel should be the hash (no longer the index)
             p->channel = hash;
@@ -643,7 +664,7 @@ meshtastic_Routing_Error perhapsEncode(meshtastic_MeshPacket *p)
                 // No suitable channel could be found for
                 return meshtastic_Routing_Error_NO_CHANNEL;
             }
-            crypto->encryptPacket(getFrom(p), p->id, numbytes, bytes);
+            crypto->encryptPacket(cryptoCtx, getFrom(p), p->id, numbytes, bytes);
             memcpy(p->encrypted.bytes, bytes, numbytes);
         }
 #else
@@ -651,7 +672,7 @@ meshtastic_Routing_Error perhapsEncode(meshtastic_MeshPacket *p)
             // Client specifically requested PKI encryption
             return meshtastic_Routing_Error_PKI_FAILED;
         }
-        hash = channels.setActiveByIndex(chIndex);
+        hash = channels.getCryptoForIndex(chIndex, cryptoCtx);
 
         // Now that we are encrypting the packet channel should be the hash (no longer the index)
         p->channel = hash;
@@ -659,7 +680,7 @@ meshtastic_Routing_Error perhapsEncode(meshtastic_MeshPacket *p)
             // No suitable channel could be found for
             return meshtastic_Routing_Error_NO_CHANNEL;
         }
-        crypto->encryptPacket(getFrom(p), p->id, numbytes, bytes);
+        crypto->encryptPacket(cryptoCtx, getFrom(p), p->id, numbytes, bytes);
         memcpy(p->encrypted.bytes, bytes, numbytes);
 #endif
 
@@ -748,12 +769,19 @@ void Router::handleReceived(meshtastic_MeshPacket *p, RxSource src)
             p_encrypted->pki_encrypted = true;
         // After potentially altering it, publish received message to MQTT if we're not the original transmitter of the packet
         if ((decodedState == DecodeState::DECODE_SUCCESS || p_encrypted->pki_encrypted) && moduleConfig.mqtt.enabled &&
-            !isFromUs(p) && mqtt)
-            mqtt->onSend(*p_encrypted, *p, p->channel);
+            !isFromUs(p) && mqtt) {
+            // Relays took their copy in callModules, from here on p only goes out to the broker
+            clearLocalBitfield(p);
+            // Hand MQTT a reference rather than the buffer, so it can hold on to it while the broker is unreachable
+            SharedPacket encrypted = SharedPacket::adopt(p_encrypted);
+            p_encrypted = NULL;
+            mqtt->onSend(encrypted, *p, p->channel);
+        }
 #endif
     }
 
-    packetPool.release(p_encrypted); // Release the encrypted packet
+    if (p_encrypted)
+        packetPool.release(p_encrypted); // Release the encrypted packet
 }
 
 void Router::perhapsHandleReceived(meshtastic_MeshPacket *p)
@@ -62,6 +62,9 @@ class Router : protected concurrency::OSThread, protected PacketHistory
     /** Return Underlying interface's TX queue status */
     meshtastic_QueueStatus getQueueStatus();
 
+    /** Estimated airtime in msec to send this (decoded) packet on the underlying interface, 0 if there is none */
+    uint32_t getPacketTime(const meshtastic_MeshPacket *p);
+
     /**
      * @return our local nodenum */
     NodeNum getNodeNum();
@@ -162,6 +165,10 @@ enum DecodeState { DECODE_SUCCESS, DECODE_FAILURE, DECODE_FATAL };
  */
 DecodeState perhapsDecode(meshtastic_MeshPacket *p);
 
+/// Clear the Data.bitfield bits that only mean something inside this node, from a packet about to go to a client (phone,
+/// MQTT, WiFi bridge...)
+void clearLocalBitfield(meshtastic_MeshPacket *p);
+
 /** Return 0 for success or a Routing_Error code for failure
  */
 meshtastic_Routing_Error perhapsEncode(meshtastic_MeshPacket *p);
@@ -176,3 +183,13 @@ PacketId generatePacketId();
 #define BITFIELD_OK_TO_MQTT_SHIFT 0
 #define BITFIELD_WANT_RESPONSE_MASK (1 << BITFIELD_WANT_RESPONSE_SHIFT)
 #define BITFIELD_OK_TO_MQTT_MASK (1 << BITFIELD_OK_TO_MQTT_SHIFT)
+/// Set on our NodeInfo: we can decode TEXT_MESSAGE_COMPRESSED_APP
+#define BITFIELD_TEXT_COMPRESSION_SHIFT 7
+#define BITFIELD_TEXT_COMPRESSION_MASK (1 << BITFIELD_TEXT_COMPRESSION_SHIFT)
+/// Set on our NodeInfo: we can unpack the WiFi bridge's aggregated texts (EMERGENCY_AGGREGATE_PORTNUM)
+#define BITFIELD_TEXT_AGGREGATE_SHIFT 6
+#define BITFIELD_TEXT_AGGREGATE_MASK (1 << BITFIELD_TEXT_AGGREGATE_SHIFT)
+/// Local only: perhapsDecode decompressed this text, so relaying it sends it compressed again.  Never goes on air, and
+/// clearLocalBitfield takes it off before clients see the packet.
+#define BITFIELD_WAS_COMPRESSED_SHIFT 8
+#define BITFIELD_WAS_COMPRESSED_MASK (1 << BITFIELD_WAS_COMPRESSED_SHIFT)
@@ -0,0 +1,31 @@
+#include "SharedPacket.h"
+#include "configuration.h"
+
+SharedPacket SharedPacket::adopt(meshtastic_MeshPacket *p)
+{
+    SharedPacket handle;
+    if (!p)
+        return handle;
+
+    SharedPacketControl *ctl = sharedPacketControlPool.allocZeroed();
+    if (!ctl) {
+        LOG_ERROR("No SharedPacket control block left, drop packet 0x%08x", p->id);
+        packetPool.release(p);
+        return handle;
+    }
+    ctl->packet = p;
+    ctl->refs = 1;
+    handle.ctl = ctl;
+    return handle;
+}
+
+void SharedPacket::reset()
+{
+    if (!ctl)
+        return;
+    if (--ctl->refs == 0) {
+        packetPool.release(ctl->packet);
+        sharedPacketControlPool.release(ctl);
+    }
+    ctl = NULL;
+}
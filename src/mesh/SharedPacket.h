@@ -0,0 +1,72 @@
+#pragma once
+
+#include "MeshTypes.h"
+
+/// Reference count for one packetPool buffer shared by several consumers
+struct SharedPacketControl {
+    meshtastic_MeshPacket *packet;
+    uint16_t refs;
+};
+
+/// Control blocks for SharedPacket, sized like packetPool (there can never be more shared packets than packets)
+extern Allocator<SharedPacketControl> &sharedPacketControlPool;
+
+/**
+ * A refcounted, read-only handle to a packetPool buffer.
+ *
+ * Lets the phone queue, MQTT, the WiFi bridge etc. all keep the same received packet without each taking a full
+ * meshtastic_MeshPacket copy.  Copying the handle just bumps the count, the buffer goes back to packetPool when the last handle
+ * is dropped.  Holders must treat the packet as immutable, if you need to change it take a copy.
+ *
+ * Not thread safe: handles are created and dropped from the main loop.
+ */
+class SharedPacket
+{
+  public:
+    SharedPacket() {}
+    SharedPacket(const SharedPacket &other) : ctl(other.ctl)
+    {
+        if (ctl)
+            ctl->refs++;
+    }
+    SharedPacket(SharedPacket &&other) : ctl(other.ctl) { other.ctl = NULL; }
+    ~SharedPacket() { reset(); }
+
+    SharedPacket &operator=(const SharedPacket &other)
+    {
+        if (other.ctl)
+            other.ctl->refs++;
+        reset();
+        ctl = other.ctl;
+        return *this;
+    }
+    SharedPacket &operator=(SharedPacket &&other)
+    {
+        if (this != &other) {
+            reset();
+            ctl = other.ctl;
+            other.ctl = NULL;
+        }
+        return *this;
+    }
+
+    /// Take ownership of a packet allocated from packetPool.  Returns an empty handle if p is NULL.
+    static SharedPacket adopt(meshtastic_MeshPacket *p);
+
+    /// Copy p into a new packetPool buffer.  Returns an empty handle if the pool is exhausted.
+    static SharedPacket copyOf(const meshtastic_MeshPacket &p) { return adopt(packetPool.allocCopy(p)); }
+
+    const meshtastic_MeshPacket *get() const { return ctl ? ctl->packet : NULL; }
+    const meshtastic_MeshPacket *operator->() const { return ctl->packet; }
+    const meshtastic_MeshPacket &operator*() const { return *ctl->packet; }
+    explicit operator bool() const { return ctl != NULL; }
+
+    /// Number of handles sharing this packet (0 for an empty handle)
+    uint16_t useCount() const { return ctl ? ctl->refs : 0; }
+
+    /// Drop our reference, freeing the packet if we were the last one
+    void reset();
+
+  private:
+    SharedPacketControl *ctl = NULL;
+};
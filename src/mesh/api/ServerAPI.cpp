@@ -43,6 +43,22 @@ template <class T, class U> void APIServerPort<T, U>::init()
     U::begin();
 }
 
+template <class T, class U> void APIServerPort<T, U>::reapClosed()
+{
+    int kept = 0;
+    for (int i = 0; i < numOpenAPIs; i++) {
+        if (openAPIs[i]->isClientConnected()) {
+            openAPIs[kept++] = openAPIs[i];
+        } else {
+            LOG_DEBUG("Free TCP API slot of dropped client");
+            delete openAPIs[i];
+        }
+    }
+    for (int i = kept; i < numOpenAPIs; i++)
+        openAPIs[i] = NULL;
+    numOpenAPIs = kept;
+}
+
 template <class T, class U> int32_t APIServerPort<T, U>::runOnce()
 {
 #ifdef ARCH_ESP32
@@ -57,8 +73,9 @@ template <class T, class U> int32_t APIServerPort<T, U>::runOnce()
     auto client = U::available();
 #endif
     if (client) {
-        // Close any previous connection (see FIXME in header file)
-        if (openAPI) {
+        reapClosed();
+        // Close the oldest connection if we are out of slots
+        if (numOpenAPIs == MAX_SERVER_API_CLIENTS) {
 #if RAK_4631
             // RAK13800 Ethernet requests periodically take more time
             // This backoff addresses most cases keeping max wait < 1s
@@ -69,11 +86,15 @@ template <class T, class U> int32_t APIServerPort<T, U>::runOnce()
                 return waitTime;
             }
 #endif
-            LOG_INFO("Force close previous TCP connection");
-            delete openAPI;
+            LOG_INFO("Force close oldest TCP connection");
+            delete openAPIs[0];
+            for (int i = 1; i < numOpenAPIs; i++)
+                openAPIs[i - 1] = openAPIs[i];
+            openAPIs[--numOpenAPIs] = NULL;
         }
 
-        openAPI = new T(client);
+        openAPIs[numOpenAPIs++] = new T(client);
+        LOG_DEBUG("%d of %d TCP API connections in use", numOpenAPIs, MAX_SERVER_API_CLIENTS);
     }
 
 #if RAK_4631
@@ -4,6 +4,15 @@
 
 #define SERVER_API_DEFAULT_PORT 4403
 
+/// How many TCP API connections may be open at once.  When a new client arrives and all are in use, the oldest is closed.
+#ifndef MAX_SERVER_API_CLIENTS
+#ifdef ARCH_PORTDUINO
+#define MAX_SERVER_API_CLIENTS 4
+#else
+#define MAX_SERVER_API_CLIENTS 1
+#endif
+#endif
+
 /**
  * Provides both debug printing and, if the client starts sending protobufs to us, switches to send/receive protobufs
  * (and starts dropping debug printing - FIXME, eventually those prints should be encapsulated in protobufs).
@@ -21,6 +30,9 @@ template <class T> class ServerAPI : public StreamAPI, private concurrency::OSTh
     /// override close to also shutdown the TCP link
     virtual void close();
 
+    /// True while the TCP peer is still there, the server port uses this to reclaim slots of dropped clients
+    bool isClientConnected() { return client.connected(); }
+
   protected:
     /// We override this method to prevent publishing EVENT_SERIAL_CONNECTED/DISCONNECTED for wifi links (we want the board to
     /// stay in the POWERED state to prevent disabling wifi)
@@ -37,12 +49,14 @@ template <class T> class ServerAPI : public StreamAPI, private concurrency::OSTh
  */
 template <class T, class U> class APIServerPort : public U, private concurrency::OSThread
 {
-    /** The currently open port
-     *
-     * FIXME: We currently only allow one open TCP connection at a time, because we depend on the loop() call in this class to
-     * delegate to the worker.  Once coroutines are implemented we can relax this restriction.
+    /** The currently open connections, oldest first.  Each one is its own OSThread with its own PhoneAPI state, and they all
+     * read the same to-phone packets from MeshService without copying them.
      */
-    T *openAPI = NULL;
+    T *openAPIs[MAX_SERVER_API_CLIENTS] = {};
+    int numOpenAPIs = 0;
+
+    /// Delete connections whose client has gone away
+    void reapClosed();
 #if defined(RAK_4631) || defined(RAK11310)
     // Track wait time for RAK13800 Ethernet requests
     int32_t waitTime = 100;
@@ -0,0 +1,37 @@
+#include "TextCompression.h"
+#include "unishox2.h"
+
+#include <string.h>
+
+// Longest text we compress or expand, a Data payload
+#define TEXT_COMPRESSION_MAX 256
+
+size_t compressText(const uint8_t *in, size_t len, uint8_t *out, size_t outMax)
+{
+    if (len == 0 || len > TEXT_COMPRESSION_MAX)
+        return 0;
+
+    // Only a strictly shorter result is any use, so that is all unishox2 gets room for: it gives up (returns more than
+    // olen) as soon as it would not fit, which makes the losing case cheap too.
+    int olen = (int)(len - 1 < outMax ? len - 1 : outMax);
+    int n = unishox2_compress((const char *)in, (int)len, (char *)out, olen, USX_PSET_DFLT);
+    if (n <= 0 || n > olen)
+        return 0;
+
+    // Unishox2 is built for UTF-8 text, make sure whatever else a client put in a text message survives the trip
+    uint8_t check[TEXT_COMPRESSION_MAX];
+    if (decompressText(out, n, check, sizeof(check)) != (int)len || memcmp(check, in, len) != 0)
+        return 0;
+    return n;
+}
+
+int decompressText(const uint8_t *in, size_t len, uint8_t *out, size_t outMax)
+{
+    if (len == 0 || len > TEXT_COMPRESSION_MAX)
+        return -1;
+
+    int n = unishox2_decompress((const char *)in, (int)len, (char *)out, (int)outMax, USX_PSET_DFLT);
+    if (n < 0 || (size_t)n > outMax)
+        return -1;
+    return n;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Unishox2 compression of text message payloads (TEXT_MESSAGE_COMPRESSED_APP).
+ *
+ * Short human text is what unishox2 is made for: typical messages shrink by a third or more, which is a third less
+ * airtime.  Only worth it when the result is actually smaller, so compressText() reports when to send the text as is.
+ */
+
+/**
+ * Compress len bytes of text into out, at most outMax bytes.  The result is checked to decompress back to the same bytes,
+ * so arbitrary payloads are safe to pass.
+ * @return the compressed length, 0 if the text should be sent uncompressed (no gain, or not text unishox2 can carry)
+ */
+size_t compressText(const uint8_t *in, size_t len, uint8_t *out, size_t outMax);
+
+/**
+ * Decompress a TEXT_MESSAGE_COMPRESSED_APP payload into out, at most outMax bytes.
+ * @return the text length, -1 if the payload is corrupt or does not fit
+ */
+int decompressText(const uint8_t *in, size_t len, uint8_t *out, size_t outMax);
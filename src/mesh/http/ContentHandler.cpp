@@ -13,6 +13,7 @@
 #include "SPILock.h"
 #include "power.h"
 #include "serialization/JSON.h"
+#include "serialization/JsonWriter.h"
 #include <FSCommon.h>
 #include <HTTPBodyParser.hpp>
 #include <HTTPMultipartBodyParser.hpp>
@@ -650,11 +651,16 @@ void handleReport(HTTPRequest *req, HTTPResponse *res)
     logArray = airTime->airtimeReport(RX_ALL_LOG);
     JSONValue *rxAllLogJsonValue = createJSONArrayFromLog(logArray, airTime->getPeriodsToLog());
 
+    // data->airtime->tx_saved_log
+    logArray = airTime->airtimeReport(TX_SAVED_LOG);
+    JSONValue *txSavedLogJsonValue = createJSONArrayFromLog(logArray, airTime->getPeriodsToLog());
+
     // data->airtime
     JSONObject jsonObjAirtime;
     jsonObjAirtime["tx_log"] = txLogJsonValue;
     jsonObjAirtime["rx_log"] = rxLogJsonValue;
     jsonObjAirtime["rx_all_log"] = rxAllLogJsonValue;
+    jsonObjAirtime["tx_saved_log"] = txSavedLogJsonValue;
     jsonObjAirtime["channel_utilization"] = new JSONValue(airTime->channelUtilizationPercent());
     jsonObjAirtime["utilization_tx"] = new JSONValue(airTime->utilizationTXPercent());
     jsonObjAirtime["seconds_since_boot"] = new JSONValue(int(airTime->getSecondsSinceBoot()));
@@ -717,6 +723,12 @@ void handleReport(HTTPRequest *req, HTTPResponse *res)
     delete value;
 }
 
+// JsonWriter sink for a response being streamed
+static void writeToResponse(void *context, const char *data, size_t len)
+{
+    static_cast<HTTPResponse *>(context)->write((const uint8_t *)data, len);
+}
+
 void handleNodes(HTTPRequest *req, HTTPResponse *res)
 {
     ResourceParameters *params = req->getParams();
@@ -735,63 +747,49 @@ void handleNodes(HTTPRequest *req, HTTPResponse *res)
         res->println("<pre>");
     }
 
-    JSONArray nodesArray;
+    // Streamed out a chunk at a time as it is written, however many nodes there are
+    char chunk[256];
+    JsonWriter w(chunk, sizeof(chunk), writeToResponse, res);
+    w.beginObject();
+    w.key("data").beginObject();
+    w.key("nodes").beginArray();
 
     uint32_t readIndex = 0;
     const meshtastic_NodeInfoLite *tempNodeInfo = nodeDB->readNextMeshNode(readIndex);
     while (tempNodeInfo != NULL) {
         if (tempNodeInfo->has_user) {
-            JSONObject node;
-
-            char id[16];
-            snprintf(id, sizeof(id), "!%08x", tempNodeInfo->num);
-
-            node["id"] = new JSONValue(id);
-            node["snr"] = new JSONValue(tempNodeInfo->snr);
-            node["via_mqtt"] = new JSONValue(BoolToString(tempNodeInfo->via_mqtt));
-            node["last_heard"] = new JSONValue((int)tempNodeInfo->last_heard);
-            node["position"] = new JSONValue();
+            w.beginObject();
+            w.key("id").stringf("!%08x", tempNodeInfo->num);
+            w.key("snr").number(tempNodeInfo->snr);
+            w.key("via_mqtt").string(BoolToString(tempNodeInfo->via_mqtt));
+            w.key("last_heard").integer((int)tempNodeInfo->last_heard);
 
+            w.key("position");
             if (nodeDB->hasValidPosition(tempNodeInfo)) {
-                JSONObject position;
-                position["latitude"] = new JSONValue((float)tempNodeInfo->position.latitude_i * 1e-7);
-                position["longitude"] = new JSONValue((float)tempNodeInfo->position.longitude_i * 1e-7);
-                position["altitude"] = new JSONValue((int)tempNodeInfo->position.altitude);
-                node["position"] = new JSONValue(position);
+                w.beginObject();
+                w.key("latitude").number(tempNodeInfo->position.latitude_i * 1e-7, 10);
+                w.key("longitude").number(tempNodeInfo->position.longitude_i * 1e-7, 10);
+                w.key("altitude").integer(tempNodeInfo->position.altitude);
+                w.endObject();
+            } else {
+                w.null();
             }
 
-            node["long_name"] = new JSONValue(tempNodeInfo->user.long_name);
-            node["short_name"] = new JSONValue(tempNodeInfo->user.short_name);
-            char macStr[18];
-            snprintf(macStr, sizeof(macStr), "%02X:%02X:%02X:%02X:%02X:%02X", tempNodeInfo->user.macaddr[0],
-                     tempNodeInfo->user.macaddr[1], tempNodeInfo->user.macaddr[2], tempNodeInfo->user.macaddr[3],
-                     tempNodeInfo->user.macaddr[4], tempNodeInfo->user.macaddr[5]);
-            node["mac_address"] = new JSONValue(macStr);
-            node["hw_model"] = new JSONValue(tempNodeInfo->user.hw_model);
-
-            nodesArray.push_back(new JSONValue(node));
+            w.key("long_name").string(tempNodeInfo->user.long_name);
+            w.key("short_name").string(tempNodeInfo->user.short_name);
+            const uint8_t *mac = tempNodeInfo->user.macaddr;
+            w.key("mac_address").stringf("%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+            w.key("hw_model").integer(tempNodeInfo->user.hw_model);
+            w.endObject();
         }
         tempNodeInfo = nodeDB->readNextMeshNode(readIndex);
     }
 
-    // collect data to inner data object
-    JSONObject jsonObjInner;
-    jsonObjInner["nodes"] = new JSONValue(nodesArray);
-
-    // create json output structure
-    JSONObject jsonObjOuter;
-    jsonObjOuter["data"] = new JSONValue(jsonObjInner);
-    jsonObjOuter["status"] = new JSONValue("ok");
-    // serialize and write it to the stream
-    JSONValue *value = new JSONValue(jsonObjOuter);
-    std::string jsonString = value->Stringify();
-    res->print(jsonString.c_str());
-    delete value;
-
-    // Clean up the nodesArray to prevent memory leak
-    for (auto *val : nodesArray) {
-        delete val;
-    }
+    w.endArray();
+    w.endObject();
+    w.key("status").string("ok");
+    w.endObject();
+    w.flush();
 }
 
 /*
@@ -32,6 +32,60 @@ bool pb_decode_from_bytes(const uint8_t *srcbuf, size_t srcbufsize, const pb_msg
     }
 }
 
+static bool readVarint(const uint8_t *buf, size_t size, size_t &pos, uint64_t &value)
+{
+    value = 0;
+    for (uint8_t shift = 0; shift < 64; shift += 7) {
+        if (pos >= size)
+            return false;
+        uint8_t b = buf[pos++];
+        value |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false; // more than 10 bytes, nanopb rejects these too
+}
+
+bool pb_looks_like_data(const uint8_t *srcbuf, size_t srcbufsize)
+{
+    bool hasPortnum = false;
+    size_t pos = 0;
+    while (pos < srcbufsize) {
+        uint64_t tag, value;
+        if (!readVarint(srcbuf, srcbufsize, pos, tag))
+            return false;
+        if (tag == 0)
+            break; // nanopb treats a zero tag as the end of the message
+
+        switch (tag & 7) {
+        case PB_WT_VARINT:
+            if (!readVarint(srcbuf, srcbufsize, pos, value))
+                return false;
+            if ((tag >> 3) == meshtastic_Data_portnum_tag)
+                hasPortnum = value != 0; // last one wins, same as the decoder
+            break;
+        case PB_WT_64BIT:
+            if (srcbufsize - pos < 8)
+                return false;
+            pos += 8;
+            break;
+        case PB_WT_STRING:
+            if (!readVarint(srcbuf, srcbufsize, pos, value) || value > srcbufsize - pos)
+                return false;
+            pos += value;
+            break;
+        case PB_WT_32BIT:
+            if (srcbufsize - pos < 4)
+                return false;
+            pos += 4;
+            break;
+        default:
+            return false; // groups and reserved wire types never appear in our messages
+        }
+    }
+    return hasPortnum;
+}
+
 #ifdef FSCom
 /// Read from an Arduino File
 bool readcb(pb_istream_t *stream, uint8_t *buf, size_t count)
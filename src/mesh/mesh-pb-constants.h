@@ -37,6 +37,15 @@
 #define MAX_RX_NOTIFICATION_TOPHONE 2
 #endif
 
+/// max number of received packets the emergency WiFi bridge holds on to until its thread passes them to the web clients
+#ifndef MAX_RX_WIFI_BRIDGE
+#ifdef ENABLE_WIFI_AP
+#define MAX_RX_WIFI_BRIDGE 4
+#else
+#define MAX_RX_WIFI_BRIDGE 0
+#endif
+#endif
+
 /// Verify baseline assumption of node size. If it increases, we need to reevaluate
 /// the impact of its memory footprint, notably on MAX_NUM_NODES.
 static_assert(sizeof(meshtastic_NodeInfoLite) <= 200, "NodeInfoLite size increased. Reconsider impact on MAX_NUM_NODES.");
@@ -76,6 +85,10 @@ size_t pb_encode_to_bytes(uint8_t *destbuf, size_t destbufsize, const pb_msgdesc
 /// helper function for decoding a record as a protobuf, we will return false if the decoding failed
 bool pb_decode_from_bytes(const uint8_t *srcbuf, size_t srcbufsize, const pb_msgdesc_t *fields, void *dest_struct);
 
+/// Cheap structural check of a decrypted meshtastic_Data payload: every top level field must have a sane wire type and fit in
+/// the buffer, and a nonzero portnum must be present.  Lets a wrong channel key be rejected without a full pb_decode.
+bool pb_looks_like_data(const uint8_t *srcbuf, size_t srcbufsize);
+
 /// Read from an Arduino File
 bool readcb(pb_istream_t *stream, uint8_t *buf, size_t count);
 
@@ -3,16 +3,23 @@
 #ifdef ENABLE_WIFI_AP
 
 #include "MeshService.h"
+#include "NodeDB.h"
 #include "Router.h"
+#include "airtime.h"
+#include "concurrency/LockGuard.h"
+#include "serialization/JsonWriter.h"
 #include "wifi/EmergencyWiFiService.h"
-#include <ArduinoJson.h>
 
 EmergencyWiFiBridge *emergencyWiFiBridge;
 
 EmergencyWiFiBridge::EmergencyWiFiBridge()
-    : SinglePortModule("EmergencyWiFiBridge", meshtastic_PortNum_TEXT_MESSAGE_APP), concurrency::OSThread("WiFiBridge")
+    : SinglePortModule("EmergencyWiFiBridge", meshtastic_PortNum_TEXT_MESSAGE_APP), concurrency::OSThread("EmergencyWiFiBridge"),
+      fromMesh(EMERGENCY_BRIDGE_QUEUE_DEPTH), fromWeb(EMERGENCY_BRIDGE_WEB_QUEUE_DEPTH)
 {
     Serial.println("EmergencyWiFiBridge: Initializing...");
+    packetObserver.observe(&service->packetForClients);
+    queueStatusObserver.observe(&service->queueStatusChanged);
+    deliveryObserver.observe(&service->deliveryReports);
 }
 
 bool EmergencyWiFiBridge::sendTextToMesh(const char *message)
@@ -22,89 +29,301 @@ bool EmergencyWiFiBridge::sendTextToMesh(const char *message)
         return false;
     }
 
-    Serial.printf("EmergencyWiFiBridge: Sending to mesh: %s\n", message);
-
-    // Allocate a new mesh packet
-    meshtastic_MeshPacket *p = router->allocForSending();
-    if (!p) {
-        Serial.println("EmergencyWiFiBridge: ERROR - Failed to allocate packet");
-        return false;
+    WebText t;
+    t.len = strlen(message);
+    if (t.len > sizeof(t.text))
+        t.len = sizeof(t.text);
+    memcpy(t.text, message, t.len);
+    {
+        concurrency::LockGuard g(&fromWebLock);
+        if (fromWeb.numFree() == 0) {
+            Serial.println("EmergencyWiFiBridge: Too many messages waiting, refused");
+            return false;
+        }
+        fromWeb.push(t);
     }
 
-    // Set packet parameters
-    p->to = NODENUM_BROADCAST; // Broadcast to all nodes
-    p->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
-    p->want_ack = false; // No ACK needed for broadcast
-    p->priority = meshtastic_MeshPacket_Priority_DEFAULT;
+    // The history, the push queue and the router are only used from our thread, this runs on the web server's task
+    enabled = true;
+    setIntervalFromNow(0);
+    return true;
+}
 
-    // Copy message into payload
-    size_t msgLen = strlen(message);
-    if (msgLen > sizeof(p->decoded.payload.bytes) - 1) {
-        msgLen = sizeof(p->decoded.payload.bytes) - 1; // Truncate if too long
-    }
+void EmergencyWiFiBridge::sendWebText(const WebText &t)
+{
+    Serial.printf("EmergencyWiFiBridge: Sending to mesh: %.*s\n", (int)t.len, t.text);
 
-    memcpy(p->decoded.payload.bytes, message, msgLen);
-    p->decoded.payload.size = msgLen;
+    meshtastic_MeshPacket *p = allocText(NODENUM_BROADCAST, 0, t.text, t.len, false);
+    if (!p) {
+        Serial.println("EmergencyWiFiBridge: ERROR - Failed to allocate packet");
+        return;
+    }
 
-    Serial.printf("EmergencyWiFiBridge: Packet allocated, sending %d bytes\n", msgLen);
+    Serial.printf("EmergencyWiFiBridge: Packet allocated, sending %u bytes\n", (unsigned)p->decoded.payload.size);
+    broadcastToWiFi(*p);
 
     // Send to mesh via router
     ErrorCode result = router->send(p);
 
     if (result == ERRNO_OK) {
         Serial.println("EmergencyWiFiBridge: ✓ Message sent to mesh successfully");
-        return true;
     } else {
         Serial.printf("EmergencyWiFiBridge: ✗ Failed to send, error code: %d\n", result);
+    }
+}
+
+meshtastic_MeshPacket *EmergencyWiFiBridge::allocText(NodeNum dest, ChannelIndex channel, const char *text, size_t len,
+                                                      bool wantAck)
+{
+    meshtastic_MeshPacket *p = router->allocForSending();
+    if (!p)
+        return NULL;
+
+    p->to = dest;
+    p->channel = channel;
+    p->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+    p->want_ack = wantAck;
+    p->priority = wantAck ? meshtastic_MeshPacket_Priority_RELIABLE : meshtastic_MeshPacket_Priority_DEFAULT;
+
+    // Copy message into payload, truncated if too long
+    if (len > sizeof(p->decoded.payload.bytes) - 1)
+        len = sizeof(p->decoded.payload.bytes) - 1;
+    memcpy(p->decoded.payload.bytes, text, len);
+    p->decoded.payload.size = len;
+    return p;
+}
+
+bool EmergencyWiFiBridge::sendTextFromClient(uint8_t client, uint32_t requestId, NodeNum dest, ChannelIndex channel,
+                                             const char *text, size_t len, bool wantAck)
+{
+    AggregateRequest req = {client, requestId};
+    AggregateBatch full;
+    bool fullReady;
+    uint32_t now = millis();
+    if (aggregator.add(dest, channel, wantAck, req, (const uint8_t *)text, len, now, aggregationWindow(), full, fullReady)) {
+        if (fullReady)
+            sendBatch(full);
+        // Wake up when the earliest window closes
+        enabled = true;
+        setIntervalFromNow(aggregator.msUntilDue(now));
+        return true;
+    }
+
+    // Too long to share a packet, or aggregation is off
+    return sendText(client, requestId, dest, channel, (const uint8_t *)text, len, wantAck);
+}
+
+bool EmergencyWiFiBridge::sendText(uint8_t client, uint32_t requestId, NodeNum dest, ChannelIndex channel, const uint8_t *text,
+                                   size_t len, bool wantAck)
+{
+    meshtastic_MeshPacket *p = allocText(dest, channel, (const char *)text, len, wantAck);
+    if (!p) {
+        rejectRequest(client, requestId, "no free packet");
         return false;
     }
+
+    // Tracked before sending: sendToMesh reports the queue status before it returns
+    deliveries.track(p->id, client, requestId, dest, wantAck, millis());
+    Serial.printf("EmergencyWiFiBridge: Client %u request %u -> 0x%x on channel %u, packet 0x%x\n", client, requestId,
+                  dest, channel, p->id);
+    broadcastToWiFi(*p);
+    service->sendToMesh(p, RX_SRC_LOCAL);
+    return true;
 }
 
-ProcessMessage EmergencyWiFiBridge::handleReceived(const meshtastic_MeshPacket &mp)
+void EmergencyWiFiBridge::setAggregationWindow(uint32_t minMs, uint32_t maxMs)
 {
-    // Only handle text messages
-    if (mp.decoded.portnum != meshtastic_PortNum_TEXT_MESSAGE_APP) {
-        return ProcessMessage::CONTINUE;
+    aggregateMinMs = minMs < maxMs ? minMs : maxMs;
+    aggregateMaxMs = maxMs;
+}
+
+uint32_t EmergencyWiFiBridge::aggregationWindow()
+{
+    // On a quiet channel there is little airtime to save, so keep the delay short.  The busier the channel, the longer
+    // messages wait, up to the full window at the utilization where the mesh itself starts holding back.
+    const float busyPercent = 25;
+    float util = airTime ? airTime->channelUtilizationPercent() : 0;
+    if (aggregateMaxMs == 0 || util >= busyPercent)
+        return aggregateMaxMs;
+    return aggregateMinMs + (uint32_t)((aggregateMaxMs - aggregateMinMs) * util / busyPercent);
+}
+
+int32_t EmergencyWiFiBridge::runOnce()
+{
+    while (!fromMesh.isEmpty()) {
+        SharedPacket p = fromMesh.pop();
+        broadcastToWiFi(*p);
+    }
+
+    while (true) {
+        WebText t;
+        {
+            concurrency::LockGuard g(&fromWebLock);
+            if (fromWeb.isEmpty())
+                break;
+            t = fromWeb.pop();
+        }
+        sendWebText(t);
     }
 
-    Serial.printf("EmergencyWiFiBridge: Received message from mesh, from=0x%x, size=%d\n", mp.from, mp.decoded.payload.size);
+    uint32_t now = millis();
+    AggregateBatch b;
+    while (aggregator.takeDue(now, b))
+        sendBatch(b);
+
+    int32_t next = aggregator.msUntilDue(now);
+    return next < 0 ? disable() : next;
+}
+
+void EmergencyWiFiBridge::sendBatch(const AggregateBatch &b)
+{
+    static_assert(AGG_MAX_PAYLOAD <= sizeof(meshtastic_Data_payload_t::bytes), "aggregate must fit a Data payload");
 
-    // Extract text from payload
-    char message[256];
-    size_t msgLen = mp.decoded.payload.size;
-    if (msgLen > sizeof(message) - 1) {
-        msgLen = sizeof(message) - 1;
+    // Every node understands plain text messages.  A single message has nothing to save, and a receiver that never said
+    // it can unpack aggregates would relay them but show nothing.
+    if (b.count == 1 || !nodeDB->receiversHave(b.dest, b.channel, NODEINFO_BITFIELD_TEXT_AGGREGATE_MASK)) {
+        size_t offset = 0;
+        const uint8_t *text;
+        size_t len;
+        for (int i = 0; i < b.count && TextAggregator::nextText(b.payload, b.len, offset, text, len); i++)
+            sendText(b.requests[i].client, b.requests[i].requestId, b.dest, b.channel, text, len, b.wantAck);
+        return;
     }
 
-    memcpy(message, mp.decoded.payload.bytes, msgLen);
-    message[msgLen] = '\0'; // Null terminate
+    meshtastic_MeshPacket *p = allocText(b.dest, b.channel, "", 0, b.wantAck);
+    if (!p) {
+        for (int i = 0; i < b.count; i++)
+            rejectRequest(b.requests[i].client, b.requests[i].requestId, "no free packet");
+        return;
+    }
+    p->decoded.portnum = EMERGENCY_AGGREGATE_PORTNUM;
+    memcpy(p->decoded.payload.bytes, b.payload, b.len);
+    p->decoded.payload.size = b.len;
 
-    Serial.printf("EmergencyWiFiBridge: Message text: %s\n", message);
+    // Tracked before sending: sendToMesh reports the queue status before it returns
+    uint32_t now = millis();
+    for (int i = 0; i < b.count; i++)
+        deliveries.track(p->id, b.requests[i].client, b.requests[i].requestId, b.dest, b.wantAck, now);
+    Serial.printf("EmergencyWiFiBridge: %u message(s) -> 0x%x on channel %u, packet 0x%x (%u bytes)\n", b.count, b.dest,
+                  b.channel, p->id, p->decoded.payload.size);
+    logAirtimeSaved(*p);
+    broadcastToWiFi(*p);
+    service->sendToMesh(p, RX_SRC_LOCAL);
+}
 
-    // Create JSON for WiFi clients
-    DynamicJsonDocument doc(512);
-    doc["type"] = "message";
-    doc["from"] = String(mp.from, HEX);
-    doc["text"] = message;
-    doc["timestamp"] = millis();
-    doc["rssi"] = mp.rx_rssi;
-    doc["snr"] = mp.rx_snr;
+void EmergencyWiFiBridge::logAirtimeSaved(const meshtastic_MeshPacket &p)
+{
+    if (!airTime)
+        return;
 
-    String json;
-    serializeJson(doc, json);
+    // What each message would have cost on its own, header and preamble included
+    meshtastic_MeshPacket one = p;
+    one.decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+    uint32_t separateMs = 0;
+    size_t offset = 0;
+    const uint8_t *text;
+    size_t len;
+    while (TextAggregator::nextText(p.decoded.payload.bytes, p.decoded.payload.size, offset, text, len)) {
+        memcpy(one.decoded.payload.bytes, text, len);
+        one.decoded.payload.size = len;
+        separateMs += router->getPacketTime(&one);
+    }
 
-    // Broadcast to all WiFi clients via WebSocket
-    wifiService.broadcastToClients(json.c_str());
+    uint32_t aggregateMs = router->getPacketTime(&p);
+    if (separateMs > aggregateMs)
+        airTime->logAirtime(TX_SAVED_LOG, separateMs - aggregateMs);
+}
 
-    Serial.printf("EmergencyWiFiBridge: Broadcasted to WiFi clients: %s\n", json.c_str());
+int EmergencyWiFiBridge::onQueueStatus(const meshtastic_QueueStatus *qs)
+{
+    DeliveryUpdate updates[AGG_MAX_MESSAGES];
+    int n = deliveries.onQueued(qs->mesh_packet_id, qs->res == ERRNO_OK, qs->res, updates, AGG_MAX_MESSAGES);
+    for (int i = 0; i < n; i++)
+        pushDeliveryUpdate(updates[i]);
+    return 0;
+}
 
-    return ProcessMessage::CONTINUE; // Let other modules see it too
+int EmergencyWiFiBridge::onDeliveryReport(const DeliveryReport *r)
+{
+    DeliveryUpdate updates[AGG_MAX_MESSAGES];
+    int n = deliveries.onReport(r->id, r->from, r->error, updates, AGG_MAX_MESSAGES);
+    for (int i = 0; i < n; i++)
+        pushDeliveryUpdate(updates[i]);
+    return 0;
 }
 
-int32_t EmergencyWiFiBridge::runOnce()
+void EmergencyWiFiBridge::pushDeliveryUpdate(const DeliveryUpdate &u)
 {
-    // Nothing to do in background loop for now
-    return INT32_MAX; // Sleep indefinitely, we're event-driven
+    char json[128];
+    JsonWriter w(json, sizeof(json));
+    w.beginObject();
+    w.key("type").string("status");
+    w.key("id").integer(u.requestId);
+    w.key("packetId").integer(u.packetId);
+    w.key("state").string(DeliveryTracker::stateName(u.state));
+    w.key("error").integer(u.error);
+    w.endObject();
+    wifiService.queueEvent(json, w.length(), u.client);
+}
+
+void EmergencyWiFiBridge::rejectRequest(uint8_t client, uint32_t requestId, const char *reason)
+{
+    char json[128];
+    JsonWriter w(json, sizeof(json));
+    w.beginObject();
+    w.key("type").string("status");
+    w.key("id").integer(requestId);
+    w.key("state").string("failed");
+    w.key("reason").string(reason);
+    w.endObject();
+    wifiService.queueEvent(json, w.length(), client);
+}
+
+int EmergencyWiFiBridge::onPacketForClients(const SharedPacket *p)
+{
+    // Only handle text messages, alone or aggregated by another bridge
+    if ((*p)->which_payload_variant != meshtastic_MeshPacket_decoded_tag ||
+        ((*p)->decoded.portnum != meshtastic_PortNum_TEXT_MESSAGE_APP && (*p)->decoded.portnum != EMERGENCY_AGGREGATE_PORTNUM))
+        return 0;
+
+    // Keep a reference and do the history append and JSON work from our own thread, outside the receive path
+    if (!fromMesh.push(*p))
+        Serial.println("EmergencyWiFiBridge: WiFi side is behind, dropped oldest message");
+    enabled = true;
+    setIntervalFromNow(0);
+    return 0;
+}
+
+void EmergencyWiFiBridge::broadcastToWiFi(const meshtastic_MeshPacket &mp)
+{
+    if (mp.decoded.portnum != EMERGENCY_AGGREGATE_PORTNUM) {
+        publishText(mp, mp.decoded.payload.bytes, mp.decoded.payload.size);
+        return;
+    }
+
+    // Each message of an aggregate becomes its own entry, clients never see the packing
+    size_t offset = 0;
+    const uint8_t *text;
+    size_t len;
+    while (TextAggregator::nextText(mp.decoded.payload.bytes, mp.decoded.payload.size, offset, text, len))
+        publishText(mp, text, len);
+}
+
+void EmergencyWiFiBridge::publishText(const meshtastic_MeshPacket &mp, const uint8_t *text, size_t len)
+{
+    MessageLogEntry e = {};
+    e.from = getFrom(&mp);
+    e.to = mp.to;
+    e.rxTime = mp.rx_time;
+    e.rssi = mp.rx_rssi;
+    e.snrX4 = (int16_t)(mp.rx_snr * 4);
+    e.channel = mp.channel;
+    e.flags = (isBroadcast(mp.to) ? MSGLOG_FLAG_CHANNEL : 0) | (isFromUs(&mp) ? MSGLOG_FLAG_OUTGOING : 0);
+    e.textLen = len < MSGLOG_MAX_TEXT ? len : MSGLOG_MAX_TEXT;
+
+    // One small flash append, the WiFi service sends it from its own loop
+    if (wifiService.publishMessage(e, text) == 0)
+        Serial.printf("EmergencyWiFiBridge: Message from 0x%x not stored in the history\n", e.from);
 }
 
 #endif // ENABLE_WIFI_AP
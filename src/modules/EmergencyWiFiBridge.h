@@ -4,8 +4,33 @@
 
 #ifdef ENABLE_WIFI_AP
 
+#include "MeshService.h"
 #include "SinglePortModule.h"
+#include "concurrency/Lock.h"
 #include "concurrency/OSThread.h"
+#include "mesh/DropOldestQueue.h"
+#include "mesh/SharedPacket.h"
+#include "mesh/mesh-pb-constants.h"
+#include "wifi/DeliveryTracker.h"
+#include "wifi/TextAggregator.h"
+
+/// Mesh messages waiting to be pushed to the WiFi clients, the oldest is dropped if the web side falls behind.  Each holds a
+/// packet of the static pool, which Router.cpp sizes for MAX_RX_WIFI_BRIDGE of them.
+#define EMERGENCY_BRIDGE_QUEUE_DEPTH MAX_RX_WIFI_BRIDGE
+
+/// Texts from the HTTP endpoints waiting for the bridge's thread, more are refused until it catches up
+#define EMERGENCY_BRIDGE_WEB_QUEUE_DEPTH 4
+
+/// Portnum of aggregated text packets, in the private range: other firmware relays them without looking inside
+#define EMERGENCY_AGGREGATE_PORTNUM ((meshtastic_PortNum)(meshtastic_PortNum_PRIVATE_APP + 0x20))
+
+/// How long WiFi messages wait for company on a quiet channel, and on a busy one.  A max of 0 disables aggregation.
+#ifndef EMERGENCY_AGGREGATE_MIN_MS
+#define EMERGENCY_AGGREGATE_MIN_MS 500
+#endif
+#ifndef EMERGENCY_AGGREGATE_MAX_MS
+#define EMERGENCY_AGGREGATE_MAX_MS 2000
+#endif
 
 /**
  * Emergency WiFi Bridge Module
@@ -14,6 +39,9 @@
  * - Receives text messages from WiFi clients
  * - Broadcasts them to LoRa mesh
  * - Receives LoRa messages and broadcasts to WiFi clients
+ * - Tells WebSocket clients what became of the messages they sent (queued, relayed, acked...)
+ * - Packs bursts of WebSocket messages for the same destination and channel into one LoRa packet, and unpacks them on
+ *   the receiving bridge
  */
 class EmergencyWiFiBridge : public SinglePortModule, private concurrency::OSThread
 {
@@ -21,19 +49,97 @@ class EmergencyWiFiBridge : public SinglePortModule, private concurrency::OSThre
     EmergencyWiFiBridge();
 
     /**
-     * Send a simple text message to the mesh from WiFi client
-     * @param message Text to send (max 200 bytes)
-     * @return true if sent successfully
+     * Send a simple text message to the mesh from WiFi client.  Safe to call from the web server's task: the message is
+     * only copied here, the bridge's thread sends it.
+     * @param message Text to send, cut to what fits a packet
+     * @return true if it was queued for sending
      */
     bool sendTextToMesh(const char *message);
 
-  protected:
-    /** Called to handle a particular incoming message
-     * @return ProcessMessage::STOP if handled, ProcessMessage::CONTINUE if someone else should handle it
+    /**
+     * Send a text message for a WebSocket client, which then gets "status" events tagged with its request id.
+     * The message may wait up to the aggregation window for others going the same way.
+     * @return false if it was refused (the client is told why)
      */
-    virtual ProcessMessage handleReceived(const meshtastic_MeshPacket &mp) override;
+    bool sendTextFromClient(uint8_t client, uint32_t requestId, NodeNum dest, ChannelIndex channel, const char *text,
+                            size_t len, bool wantAck);
+
+    /// Aggregation window on a quiet and on a busy channel, scaled by channel utilization in between. maxMs 0 disables it.
+    void setAggregationWindow(uint32_t minMs, uint32_t maxMs);
 
+    /// A WebSocket client disconnected, its slot number may soon belong to someone else
+    void forgetClient(uint8_t client) { deliveries.forgetClient(client); }
+
+    /// Tell one WebSocket client its request failed before reaching the mesh
+    void rejectRequest(uint8_t client, uint32_t requestId, const char *reason);
+
+  protected:
+    /// Pass on the mesh messages handed to us, and send the aggregates whose window closed
     virtual int32_t runOnce() override;
+
+  private:
+    /// Packets from the mesh, shared with the phone queue rather than copied
+    DropOldestQueue<SharedPacket> fromMesh;
+
+    /// A text from sendTextToMesh
+    struct WebText {
+        size_t len;
+        char text[meshtastic_Constants_DATA_PAYLOAD_LEN];
+    };
+    /// Texts from the HTTP endpoints, pushed from the web server's task so guarded by fromWebLock
+    DropOldestQueue<WebText> fromWeb;
+    concurrency::Lock fromWebLock;
+
+    DeliveryTracker deliveries;
+    TextAggregator aggregator;
+    uint32_t aggregateMinMs = EMERGENCY_AGGREGATE_MIN_MS;
+    uint32_t aggregateMaxMs = EMERGENCY_AGGREGATE_MAX_MS;
+
+    CallbackObserver<EmergencyWiFiBridge, const meshtastic_QueueStatus *> queueStatusObserver =
+        CallbackObserver<EmergencyWiFiBridge, const meshtastic_QueueStatus *>(this, &EmergencyWiFiBridge::onQueueStatus);
+    CallbackObserver<EmergencyWiFiBridge, const DeliveryReport *> deliveryObserver =
+        CallbackObserver<EmergencyWiFiBridge, const DeliveryReport *>(this, &EmergencyWiFiBridge::onDeliveryReport);
+
+    CallbackObserver<EmergencyWiFiBridge, const SharedPacket *> packetObserver =
+        CallbackObserver<EmergencyWiFiBridge, const SharedPacket *>(this, &EmergencyWiFiBridge::onPacketForClients);
+
+    /// Called by MeshService for every packet delivered from the mesh, keeps a reference for runOnce
+    int onPacketForClients(const SharedPacket *p);
+
+    /// The router took (or refused) a packet, maybe one of ours
+    int onQueueStatus(const meshtastic_QueueStatus *qs);
+
+    /// An ACK or NAK came back, maybe for one of ours
+    int onDeliveryReport(const DeliveryReport *r);
+
+    /// Send a text of sendTextToMesh as a broadcast on the primary channel
+    void sendWebText(const WebText &t);
+
+    /// Build a text packet, NULL if the pool is empty
+    meshtastic_MeshPacket *allocText(NodeNum dest, ChannelIndex channel, const char *text, size_t len, bool wantAck);
+
+    /// The aggregation window for a message sent now
+    uint32_t aggregationWindow();
+
+    /// Send one message of a WebSocket client as a plain text packet
+    bool sendText(uint8_t client, uint32_t requestId, NodeNum dest, ChannelIndex channel, const uint8_t *text, size_t len,
+                  bool wantAck);
+
+    /// Hand an aggregate to the router, as plain text packets if it holds a single message or a receiver could not
+    /// unpack it
+    void sendBatch(const AggregateBatch &b);
+
+    /// Log the airtime the aggregate p saved over sending its messages one by one
+    void logAirtimeSaved(const meshtastic_MeshPacket &p);
+
+    /// Queue a "status" event for the client that sent the message
+    void pushDeliveryUpdate(const DeliveryUpdate &u);
+
+    /// Store the text message(s) of a packet (received, or sent by us) in the WiFi history and queue them for all clients
+    void broadcastToWiFi(const meshtastic_MeshPacket &mp);
+
+    /// Store one text of packet mp in the WiFi message history and queue it for all WiFi clients
+    void publishText(const meshtastic_MeshPacket &mp, const uint8_t *text, size_t len);
 };
 
 extern EmergencyWiFiBridge *emergencyWiFiBridge;
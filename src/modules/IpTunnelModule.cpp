@@ -0,0 +1,63 @@
+#include "IpTunnelModule.h"
+#include "MeshService.h"
+#include "configuration.h"
+
+#ifdef ENABLE_WIFI_AP
+#include "wifi/WiFiMeshBridge.h"
+#endif
+
+IpTunnelModule *ipTunnelModule;
+
+// Random first datagram id, so after a reboot our peers do not take new datagrams for ones they already reassembled
+IpTunnelModule::IpTunnelModule()
+    : SinglePortModule("iptunnel", meshtastic_PortNum_IP_TUNNEL_APP), IpFragmenter((uint16_t)random(1, UINT16_MAX)),
+      concurrency::OSThread("IpTunnel")
+{
+}
+
+bool IpTunnelModule::sendToNode(NodeNum dest, const uint8_t *data, size_t len)
+{
+    bool ok = sendDatagram(dest, data, len, millis());
+    setIntervalFromNow(0); // Rearm our timers
+    return ok;
+}
+
+bool IpTunnelModule::sendFrame(uint32_t dest, const uint8_t *frame, size_t len)
+{
+    meshtastic_MeshPacket *p = allocDataPacket();
+    if (!p) {
+        LOG_WARN("IP tunnel: no packet for fragment to 0x%x", dest);
+        return false;
+    }
+    p->to = dest;
+    p->want_ack = false; // Recovery is done by our own NACKs, per fragment
+    p->decoded.payload.size = len;
+    memcpy(p->decoded.payload.bytes, frame, len);
+    service->sendToMesh(p, RX_SRC_LOCAL);
+    return true;
+}
+
+ProcessMessage IpTunnelModule::handleReceived(const meshtastic_MeshPacket &mp)
+{
+    if (isFromUs(&mp))
+        return ProcessMessage::STOP;
+
+    handleFrame(mp.from, mp.decoded.payload.bytes, mp.decoded.payload.size, millis());
+    setIntervalFromNow(0);
+    return ProcessMessage::STOP;
+}
+
+void IpTunnelModule::deliver(uint32_t from, const uint8_t *data, size_t len)
+{
+    LOG_DEBUG("IP tunnel: %u byte frame from 0x%x", (unsigned)len, from);
+#ifdef ENABLE_WIFI_AP
+    wifiMeshBridge.injectPacketFromMesh(data, len, from);
+#endif
+}
+
+int32_t IpTunnelModule::runOnce()
+{
+    // Sleep until the next NACK or expiry is due, sending and receiving wake us early
+    uint32_t next = runTimers(millis());
+    return next > INT32_MAX ? INT32_MAX : (int32_t)next;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "SinglePortModule.h"
+#include "concurrency/OSThread.h"
+#include "wifi/IpFragmenter.h"
+
+static_assert(FRAG_HEADER_LEN + FRAG_MAX_PAYLOAD <= meshtastic_Constants_DATA_PAYLOAD_LEN,
+              "IP tunnel fragments must fit one mesh packet");
+
+/**
+ * Carries (compressed) IP frames for the WiFi mesh bridge over IP_TUNNEL_APP.
+ *
+ * Frames bigger than one mesh packet are fragmented, reassembled and repaired with selective NACKs by IpFragmenter, this
+ * module just moves its frames on and off the mesh and runs its timers.
+ */
+class IpTunnelModule : public SinglePortModule, public IpFragmenter, private concurrency::OSThread
+{
+  public:
+    IpTunnelModule();
+
+    /**
+     * Send a frame to a node (or NODENUM_BROADCAST), fragmenting it if needed
+     * @return false if it is too large or could not be queued
+     */
+    bool sendToNode(NodeNum dest, const uint8_t *data, size_t len);
+
+  protected:
+    virtual ProcessMessage handleReceived(const meshtastic_MeshPacket &mp) override;
+
+    virtual int32_t runOnce() override;
+
+    virtual bool sendFrame(uint32_t dest, const uint8_t *frame, size_t len) override;
+
+    virtual void deliver(uint32_t from, const uint8_t *data, size_t len) override;
+};
+
+extern IpTunnelModule *ipTunnelModule;
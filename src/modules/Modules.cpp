@@ -109,6 +109,7 @@
 
 #ifdef ENABLE_WIFI_AP
 #include "modules/EmergencyWiFiBridge.h"
+#include "modules/IpTunnelModule.h"
 #endif
 
 /**
@@ -168,6 +169,7 @@ void setupModules()
 #endif
 #ifdef ENABLE_WIFI_AP
     emergencyWiFiBridge = new EmergencyWiFiBridge();
+    ipTunnelModule = new IpTunnelModule();
 #endif
     // Note: if the rest of meshtastic doesn't need to explicitly use your module, you do not need to assign the instance
     // to a global variable.
@@ -28,6 +28,20 @@ bool NodeInfoModule::handleReceivedProtobuf(const meshtastic_MeshPacket &mp, mes
 
     bool hasChanged = nodeDB->updateUser(getFrom(&mp), p, mp.channel);
 
+    // Remember whether it can read compressed text, perhapsEncode only compresses for nodes that can.  Likewise for
+    // aggregated texts, which the WiFi bridge only sends to nodes that can unpack them.
+    meshtastic_NodeInfoLite *node = nodeDB->getMeshNode(getFrom(&mp));
+    if (node) {
+        if (mp.decoded.bitfield & BITFIELD_TEXT_COMPRESSION_MASK)
+            node->bitfield |= NODEINFO_BITFIELD_TEXT_COMPRESSION_MASK;
+        else
+            node->bitfield &= ~NODEINFO_BITFIELD_TEXT_COMPRESSION_MASK;
+        if (mp.decoded.bitfield & BITFIELD_TEXT_AGGREGATE_MASK)
+            node->bitfield |= NODEINFO_BITFIELD_TEXT_AGGREGATE_MASK;
+        else
+            node->bitfield &= ~NODEINFO_BITFIELD_TEXT_AGGREGATE_MASK;
+    }
+
     bool wasBroadcast = isBroadcast(mp.to);
 
     // LOG_DEBUG("did encode");
@@ -121,7 +135,17 @@ meshtastic_MeshPacket *NodeInfoModule::allocReply()
 
         LOG_INFO("Send owner %s/%s/%s", u.id, u.long_name, u.short_name);
         lastSentToMesh = millis();
-        return allocDataProtobuf(u);
+        meshtastic_MeshPacket *p = allocDataProtobuf(u);
+        if (p) {
+            // Let everyone know they can send us compressed text
+            p->decoded.has_bitfield = true;
+            p->decoded.bitfield |= BITFIELD_TEXT_COMPRESSION_MASK;
+#ifdef ENABLE_WIFI_AP
+            // EmergencyWiFiBridge unpacks aggregated texts
+            p->decoded.bitfield |= BITFIELD_TEXT_AGGREGATE_MASK;
+#endif
+        }
+        return p;
     }
 }
 
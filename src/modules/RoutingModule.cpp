@@ -30,6 +30,14 @@ bool RoutingModule::handleReceivedProtobuf(const meshtastic_MeshPacket &mp, mesh
     printPacket("Routing sniffing", &mp);
     router->sniffReceived(&mp, r);
 
+    // Same ACK/NAK rules as ReliableRouter: a routing error is a NAK, any other reply to one of our packets is an ACK
+    if (isToUs(&mp) && mp.which_payload_variant == meshtastic_MeshPacket_decoded_tag && mp.decoded.request_id) {
+        DeliveryReport report = {mp.decoded.request_id, getFrom(&mp),
+                                 r && r->which_variant == meshtastic_Routing_error_reason_tag ? r->error_reason
+                                                                                               : meshtastic_Routing_Error_NONE};
+        service->deliveryReports.notifyObservers(&report);
+    }
+
     // FIXME - move this to a non promsicious PhoneAPI module?
     // Note: we are careful not to send back packets that started with the phone back to the phone
     if ((isBroadcast(mp.to) || isToUs(&mp)) && (mp.from != 0)) {
@@ -0,0 +1,235 @@
+#include "StoreForwardHistory.h"
+
+#include <algorithm>
+#include <string.h>
+
+/* Record header layout, little endian as the targets are:
+ *   0 time, 4 to, 8 from, 12 id, 16 reply_id, 20 rx_snr (float), 24 rx_rssi (int16),
+ *   26 channel, 27 hop_start << 4 | hop_limit, 28 flags, 29 transport_mechanism, 30 payload_size */
+#define FLAG_EMOJI 0x01
+#define FLAG_VIA_MQTT 0x02
+
+// Header plus a short text, what slots are provisioned for when the number of records is not limited
+#define TYPICAL_RECORD_SIZE 48
+
+static_assert(meshtastic_Constants_DATA_PAYLOAD_LEN <= 255, "payload size is stored in a byte");
+
+void StoreForwardHistory::RecordList::popFront(uint32_t n)
+{
+    while (!empty() && numbers[head] <= n)
+        head++;
+    if (head == numbers.size()) {
+        numbers.clear();
+        head = 0;
+    } else if (head >= 64 && head * 2 >= numbers.size()) {
+        // Compact once half of it is dropped, so each entry is moved at most once on average
+        numbers.erase(numbers.begin(), numbers.begin() + head);
+        head = 0;
+    }
+}
+
+std::vector<uint32_t>::const_iterator StoreForwardHistory::RecordList::from(uint32_t start) const
+{
+    return std::lower_bound(numbers.begin() + head, numbers.end(), start);
+}
+
+size_t StoreForwardHistory::bytesFor(uint32_t n)
+{
+    return (size_t)n * (sizeof(Slot) + HEADER_SIZE + meshtastic_Constants_DATA_PAYLOAD_LEN);
+}
+
+void StoreForwardHistory::init(uint8_t *storage, size_t bytes, uint32_t maxRecords)
+{
+    slotCount = 0;
+    if (storage) {
+        uint32_t fit = bytes / (sizeof(Slot) + (maxRecords ? HEADER_SIZE : TYPICAL_RECORD_SIZE));
+        slotCount = maxRecords ? std::min(maxRecords, fit) : fit;
+    }
+    slots = (Slot *)storage;
+    ring = storage + slotCount * sizeof(Slot);
+    ringSize = storage ? bytes - slotCount * sizeof(Slot) : 0;
+    if (ringSize < HEADER_SIZE + meshtastic_Constants_DATA_PAYLOAD_LEN)
+        slotCount = 0; // The longest record has to fit
+
+    used = 0;
+    first = end = 0;
+    latestTime = 0;
+    broadcasts = RecordList();
+    nodes.clear();
+}
+
+void StoreForwardHistory::read(size_t offset, void *out, size_t len) const
+{
+    offset %= ringSize;
+    size_t part = std::min(len, ringSize - offset);
+    memcpy(out, ring + offset, part);
+    memcpy((uint8_t *)out + part, ring, len - part);
+}
+
+void StoreForwardHistory::write(size_t offset, const void *data, size_t len)
+{
+    offset %= ringSize;
+    size_t part = std::min(len, ringSize - offset);
+    memcpy(ring + offset, data, part);
+    memcpy(ring, (const uint8_t *)data + part, len - part);
+}
+
+size_t StoreForwardHistory::pack(const PacketHistoryStruct &r, uint8_t *out)
+{
+    uint8_t payloadSize = std::min<pb_size_t>(r.payload_size, meshtastic_Constants_DATA_PAYLOAD_LEN);
+    // RSSI is well within 16 bits, hop counts within 4
+    int16_t rssi = std::max<int32_t>(INT16_MIN, std::min<int32_t>(INT16_MAX, r.rx_rssi));
+
+    memcpy(out, &r.time, 4);
+    memcpy(out + 4, &r.to, 4);
+    memcpy(out + 8, &r.from, 4);
+    memcpy(out + 12, &r.id, 4);
+    memcpy(out + 16, &r.reply_id, 4);
+    memcpy(out + 20, &r.rx_snr, 4);
+    memcpy(out + 24, &rssi, 2);
+    out[26] = r.channel;
+    out[27] = (r.hop_start & 0x0F) << 4 | (r.hop_limit & 0x0F);
+    out[28] = (r.emoji ? FLAG_EMOJI : 0) | (r.via_mqtt ? FLAG_VIA_MQTT : 0);
+    out[29] = r.transport_mechanism;
+    out[30] = payloadSize;
+    memcpy(out + HEADER_SIZE, r.payload, payloadSize);
+    return HEADER_SIZE + payloadSize;
+}
+
+void StoreForwardHistory::unpackHeader(const uint8_t *h, PacketHistoryStruct &r)
+{
+    int16_t rssi;
+    memcpy(&r.time, h, 4);
+    memcpy(&r.to, h + 4, 4);
+    memcpy(&r.from, h + 8, 4);
+    memcpy(&r.id, h + 12, 4);
+    memcpy(&r.reply_id, h + 16, 4);
+    memcpy(&r.rx_snr, h + 20, 4);
+    memcpy(&rssi, h + 24, 2);
+    r.rx_rssi = rssi;
+    r.channel = h[26];
+    r.hop_start = h[27] >> 4;
+    r.hop_limit = h[27] & 0x0F;
+    r.emoji = h[28] & FLAG_EMOJI;
+    r.via_mqtt = h[28] & FLAG_VIA_MQTT;
+    r.transport_mechanism = h[29];
+    r.payload_size = std::min<pb_size_t>(h[30], meshtastic_Constants_DATA_PAYLOAD_LEN);
+}
+
+void StoreForwardHistory::readHeader(uint32_t index, PacketHistoryStruct &r) const
+{
+    uint8_t h[HEADER_SIZE];
+    read(slot(index).offset, h, sizeof(h));
+    unpackHeader(h, r);
+}
+
+void StoreForwardHistory::get(uint32_t index, PacketHistoryStruct &r) const
+{
+    readHeader(index, r);
+    read(slot(index).offset + HEADER_SIZE, r.payload, r.payload_size);
+}
+
+void StoreForwardHistory::add(const PacketHistoryStruct &r)
+{
+    if (!slotCount)
+        return;
+
+    uint8_t packed[MAX_RECORD_SIZE];
+    size_t len = pack(r, packed);
+    while (size() == slotCount || used + len > ringSize)
+        dropOldest();
+
+    size_t offset = size() ? (slot(first).offset + used) % ringSize : 0;
+    write(offset, packed, len);
+    used += len;
+
+    uint32_t index = end++;
+    latestTime = std::max(latestTime, r.time);
+    slots[index % slotCount] = {(uint32_t)offset, latestTime};
+
+    if (!r.time)
+        return; // Stored without a clock, never sent
+
+    if (r.to == NODENUM_BROADCAST) {
+        broadcasts.push(index);
+        nodes[r.from].broadcasts.push(index);
+    } else if (r.to != r.from) {
+        nodes[r.to].direct.push(index);
+    }
+}
+
+void StoreForwardHistory::dropOldest()
+{
+    PacketHistoryStruct r;
+    readHeader(first, r);
+    used -= HEADER_SIZE + r.payload_size;
+
+    if (r.time && (r.to == NODENUM_BROADCAST || r.to != r.from)) {
+        auto node = nodes.find(r.to == NODENUM_BROADCAST ? r.from : r.to);
+        if (r.to == NODENUM_BROADCAST) {
+            broadcasts.popFront(first);
+            node->second.broadcasts.popFront(first);
+        } else {
+            node->second.direct.popFront(first);
+        }
+        if (node->second.direct.empty() && node->second.broadcasts.empty())
+            nodes.erase(node);
+    }
+    first++;
+}
+
+uint32_t StoreForwardHistory::firstCandidate(uint32_t since, uint32_t start) const
+{
+    // First record whose latest time is after since, it only grows with the record number
+    uint32_t lo = first, hi = end;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (slot(mid).latestTime > since)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return std::max(lo, start);
+}
+
+uint32_t StoreForwardHistory::countAvailable(NodeNum dest, uint32_t since, uint32_t start) const
+{
+    start = firstCandidate(since, start);
+    if (start >= end)
+        return 0;
+
+    // Every broadcast, less the ones dest sent itself, plus the direct messages to it
+    uint32_t available = broadcasts.countFrom(start);
+    auto node = nodes.find(dest);
+    if (node != nodes.end())
+        available += node->second.direct.countFrom(start) - node->second.broadcasts.countFrom(start);
+    return available;
+}
+
+uint32_t StoreForwardHistory::next(NodeNum dest, uint32_t since, uint32_t start) const
+{
+    start = firstCandidate(since, start);
+    if (start >= end)
+        return NONE;
+
+    static const RecordList none;
+    auto node = nodes.find(dest);
+    const RecordList &direct = node != nodes.end() ? node->second.direct : none;
+
+    auto b = broadcasts.from(start), bEnd = broadcasts.numbers.end();
+    auto d = direct.from(start), dEnd = direct.numbers.end();
+    while (b != bEnd || d != dEnd) {
+        uint32_t index;
+        if (d == dEnd || (b != bEnd && *b < *d))
+            index = *b++;
+        else
+            index = *d++;
+
+        // Skipped records are behind the cursor once the client has this one, so each is passed over only once
+        PacketHistoryStruct r;
+        readHeader(index, r);
+        if (r.time && r.time > since && r.from != dest)
+            return index;
+    }
+    return NONE;
+}
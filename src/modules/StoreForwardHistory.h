@@ -0,0 +1,150 @@
+#pragma once
+
+#include "mesh/MeshTypes.h"
+#include "mesh/generated/meshtastic/mesh.pb.h"
+
+#include <unordered_map>
+#include <vector>
+
+/// A stored message as it is added and read back, it is kept packed (see StoreForwardHistory)
+struct PacketHistoryStruct {
+    uint32_t time;
+    uint32_t to;
+    uint32_t from;
+    uint32_t id;
+    uint8_t channel;
+    uint32_t reply_id;
+    bool emoji;
+    uint8_t payload[meshtastic_Constants_DATA_PAYLOAD_LEN];
+    pb_size_t payload_size;
+    int32_t rx_rssi;
+    float rx_snr;
+    uint8_t hop_start;
+    uint8_t hop_limit;
+    bool via_mqtt;
+    uint8_t transport_mechanism;
+};
+
+/**
+ * The Store & Forward message history, with the indexes needed to serve it to many clients without scanning it.
+ *
+ * Records are packed one after another into a ring of bytes: a 31 byte header and only as much payload as the message
+ * has, so short texts take a fraction of a full PacketHistoryStruct.  When the ring is full the oldest records are
+ * dropped to make room.  Records are numbered in arrival order and keep their number, so the clients' cursors stay
+ * valid as the ring wraps; a cursor pointing at a dropped record just continues from the oldest one left.
+ *
+ * A client may have a record if it is newer than the time asked for, not from the client itself, and either broadcast
+ * or sent to it.  Rather than testing that against every record, the history keeps one list of broadcasts, and per
+ * node a list of the direct messages to it and of the broadcasts it sent, each sorted by record number, plus the latest
+ * time seen at each record.  How many records a client has waiting is then a few binary searches, and finding the next
+ * one a merge of two lists.
+ *
+ * The counts assume the clock does not step back.  If it does, records stamped before the time asked for may be
+ * counted, but they are never returned by next().
+ */
+class StoreForwardHistory
+{
+  public:
+    /// Returned by next() when there is nothing left for the client
+    static const uint32_t NONE = UINT32_MAX;
+
+    /// Size of a record without its payload, and with the longest one
+    static const size_t HEADER_SIZE = 31;
+    static const size_t MAX_RECORD_SIZE = HEADER_SIZE + meshtastic_Constants_DATA_PAYLOAD_LEN;
+
+    /**
+     * A record as it is kept, out needs MAX_RECORD_SIZE bytes
+     * @return bytes written, the header and the payload
+     */
+    static size_t pack(const PacketHistoryStruct &r, uint8_t *out);
+
+    /// Everything but the payload from a packed record, payload_size bytes of payload follow the header
+    static void unpackHeader(const uint8_t *header, PacketHistoryStruct &r);
+
+    /// Bytes of storage that hold n records whatever their size
+    static size_t bytesFor(uint32_t n);
+
+    /**
+     * Take over storage, allocated by the caller (in PSRAM on the ESP32)
+     * @param maxRecords most records to keep, 0 for as many as fit
+     */
+    void init(uint8_t *storage, size_t bytes, uint32_t maxRecords = 0);
+
+    uint32_t size() const { return end - first; }
+
+    /// Most records that can be kept, fewer fit when they are long
+    uint32_t getCapacity() const { return slotCount; }
+
+    /// Record bytes in use, out of getRingSize()
+    size_t getUsed() const { return used; }
+    size_t getRingSize() const { return ringSize; }
+
+    /// Number of the oldest record kept, and the number the next record will get
+    uint32_t getFirst() const { return first; }
+    uint32_t getEnd() const { return end; }
+
+    /// Append a record, dropping the oldest ones if there is no room for it
+    void add(const PacketHistoryStruct &r);
+
+    /// Copy out a record that is kept, getFirst() <= index < getEnd()
+    void get(uint32_t index, PacketHistoryStruct &r) const;
+
+    /**
+     * Number of records dest may have, from record number start on and newer than since
+     */
+    uint32_t countAvailable(NodeNum dest, uint32_t since, uint32_t start) const;
+
+    /**
+     * Number of the first record dest may have, from record number start on and newer than since
+     * @return NONE if there is none
+     */
+    uint32_t next(NodeNum dest, uint32_t since, uint32_t start) const;
+
+  private:
+    // Where a record is in the ring, and the highest record time up to it, never decreasing so it can be searched
+    struct Slot {
+        uint32_t offset;
+        uint32_t latestTime;
+    };
+
+    // Record numbers in increasing order, dropped from the front as the ring wraps
+    struct RecordList {
+        std::vector<uint32_t> numbers;
+        size_t head = 0;
+
+        bool empty() const { return head == numbers.size(); }
+        void push(uint32_t n) { numbers.push_back(n); }
+        void popFront(uint32_t n); // Drop n and anything before it
+        std::vector<uint32_t>::const_iterator from(uint32_t start) const;
+        uint32_t countFrom(uint32_t start) const { return numbers.end() - from(start); }
+    };
+
+    struct NodeLists {
+        RecordList direct;     // Records sent to the node, except by itself
+        RecordList broadcasts; // Broadcasts the node sent
+    };
+
+    Slot *slots = NULL;
+    uint32_t slotCount = 0;
+    uint8_t *ring = NULL;
+    size_t ringSize = 0;
+    size_t used = 0;
+
+    uint32_t first = 0;
+    uint32_t end = 0;
+    uint32_t latestTime = 0;
+
+    RecordList broadcasts;
+    std::unordered_map<NodeNum, NodeLists> nodes;
+
+    const Slot &slot(uint32_t index) const { return slots[index % slotCount]; }
+    void read(size_t offset, void *out, size_t len) const;
+    void write(size_t offset, const void *data, size_t len);
+    void readHeader(uint32_t index, PacketHistoryStruct &r) const;
+
+    /// Drop the oldest record and take it out of the lists
+    void dropOldest();
+
+    /// Where counting starts for a client: at start, or later if every record before is dropped or too old
+    uint32_t firstCandidate(uint32_t since, uint32_t start) const;
+};
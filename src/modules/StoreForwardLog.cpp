@@ -0,0 +1,282 @@
+#include "StoreForwardLog.h"
+
+#ifdef FSCom
+
+#include "SPILock.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#if defined(ARCH_NRF52) || defined(ARCH_STM32WL)
+#define SFLOG_APPEND FILE_O_WRITE // Adafruit LittleFS opens for writing at the end of the file
+#else
+#define SFLOG_APPEND "a"
+#endif
+
+// On flash a record is magic, the xor hash of the packed record, then the packed record
+#define SFLOG_RECORD_MAGIC 0x5F
+#define SFLOG_FRAME_HEADER 2
+
+// Fewer segments than this and filling the active one would throw away all of the history at once
+#define SFLOG_MIN_SEGMENTS 2
+
+static_assert(SFLOG_BATCH_BYTES >= 2 * (SFLOG_FRAME_HEADER + StoreForwardHistory::MAX_RECORD_SIZE),
+              "replay reads whole records through the batch buffer");
+
+static uint8_t xorHash(const uint8_t *p, size_t len)
+{
+    uint8_t hash = 0;
+    for (size_t i = 0; i < len; i++)
+        hash ^= p[i];
+    return hash;
+}
+
+StoreForwardLog::StoreForwardLog(const char *dir, uint32_t segmentBytes, uint32_t maxSegments)
+    : dir(dir), segmentBytes(segmentBytes), maxSegments(maxSegments)
+{
+}
+
+void StoreForwardLog::segmentPath(uint32_t id, char *out, size_t outMax) const
+{
+    snprintf(out, outMax, "%s/seg%05lu", dir, (unsigned long)id);
+}
+
+uint64_t StoreForwardLog::freeSpace()
+{
+#ifdef ARCH_ESP32
+    concurrency::LockGuard g(spiLock);
+    return FSCom.totalBytes() - FSCom.usedBytes();
+#else
+    return SFLOG_FREE_UNKNOWN;
+#endif
+}
+
+bool StoreForwardLog::begin(StoreForwardHistory &history, uint64_t freeBytes)
+{
+    std::vector<uint32_t> ids;
+    uint64_t ownBytes = 0; // already taken by the log, it is ours to reuse
+    {
+        concurrency::LockGuard g(spiLock);
+        if (!FSCom.exists(dir) && !FSCom.mkdir(dir)) {
+            LOG_ERROR("S&F log: can't create %s", dir);
+            return false;
+        }
+
+        File root = FSCom.open(dir, FILE_O_READ);
+        if (root) {
+            File file = root.openNextFile();
+            while (file && file.name()[0]) {
+                // Some platforms give the full path, some only the name
+                const char *name = strrchr(file.name(), '/') ? strrchr(file.name(), '/') + 1 : file.name();
+                char *end;
+                if (strncmp(name, "seg", 3) == 0) {
+                    uint32_t id = strtoul(name + 3, &end, 10);
+                    if (*end == 0) {
+                        ids.push_back(id);
+                        ownBytes += file.size();
+                    }
+                }
+                file.close();
+                file = root.openNextFile();
+            }
+            root.close();
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    int found = ids.size();
+
+    if (freeBytes != SFLOG_FREE_UNKNOWN) {
+        uint64_t room = freeBytes + ownBytes;
+        uint64_t fit = room > SFLOG_FS_RESERVE_BYTES ? (room - SFLOG_FS_RESERVE_BYTES) / segmentBytes : 0;
+        if (fit < SFLOG_MIN_SEGMENTS) {
+            LOG_WARN("S&F log: only %lu KB of flash free, history is kept in RAM only", (unsigned long)(freeBytes / 1024));
+            return false;
+        }
+        if (fit < maxSegments) {
+            LOG_WARN("S&F log: room for %lu segments of %lu KB only", (unsigned long)fit, (unsigned long)(segmentBytes / 1024));
+            maxSegments = fit;
+        }
+    }
+
+    // Oldest first, so the history ends up holding the newest records that fit
+    for (int i = 0; i < found; i++) {
+        if (i < found - (int)maxSegments) {
+            char path[48];
+            segmentPath(ids[i], path, sizeof(path));
+            concurrency::LockGuard g(spiLock);
+            FSCom.remove(path);
+            continue;
+        }
+        uint32_t bytes;
+        bool whole = replay(ids[i], history, bytes);
+        if (!whole)
+            stats.damaged++;
+        if (i == found - 1) {
+            activeSegment = ids[i];
+            activeBytes = bytes;
+            damagedTail = !whole;
+        }
+    }
+
+    if (found == 0) {
+        firstSegment = activeSegment = 0;
+        activeBytes = 0;
+    } else {
+        // Segments between the oldest kept and the active one may be missing, they read as empty
+        firstSegment = found > (int)maxSegments ? ids[found - maxSegments] : ids[0];
+    }
+
+    ready = true;
+    LOG_INFO("S&F log: %lu records replayed from %lu segments", (unsigned long)stats.replayed,
+             (unsigned long)getSegmentCount());
+    return true;
+}
+
+bool StoreForwardLog::replay(uint32_t id, StoreForwardHistory &history, uint32_t &bytes)
+{
+    char path[48];
+    segmentPath(id, path, sizeof(path));
+    PacketHistoryStruct r;
+
+    concurrency::LockGuard g(spiLock);
+    File f = FSCom.open(path, FILE_O_READ);
+    bytes = 0;
+    if (!f)
+        return true;
+    uint32_t fileSize = f.size();
+
+    // Read in chunks through the batch buffer, keeping any partial record for the next round
+    size_t have = 0, pos = 0;
+    bool whole = false;
+    while (true) {
+        if (have - pos < SFLOG_FRAME_HEADER + StoreForwardHistory::MAX_RECORD_SIZE) {
+            memmove(batch, batch + pos, have - pos);
+            have -= pos;
+            pos = 0;
+            int n = f.read(batch + have, sizeof(batch) - have);
+            if (n > 0)
+                have += n;
+        }
+        if (pos == have) {
+            whole = bytes == fileSize;
+            break;
+        }
+
+        const uint8_t *frame = batch + pos;
+        size_t avail = have - pos;
+        if (avail < SFLOG_FRAME_HEADER + StoreForwardHistory::HEADER_SIZE || frame[0] != SFLOG_RECORD_MAGIC)
+            break;
+        StoreForwardHistory::unpackHeader(frame + SFLOG_FRAME_HEADER, r);
+        size_t len = StoreForwardHistory::HEADER_SIZE + r.payload_size;
+        // The payload size is the last byte of the header, check it was not cut down to fit
+        const uint8_t *packed = frame + SFLOG_FRAME_HEADER;
+        if (avail < SFLOG_FRAME_HEADER + len || packed[StoreForwardHistory::HEADER_SIZE - 1] != r.payload_size ||
+            xorHash(packed, len) != frame[1])
+            break;
+
+        memcpy(r.payload, packed + StoreForwardHistory::HEADER_SIZE, r.payload_size);
+        history.add(r);
+        stats.replayed++;
+        pos += SFLOG_FRAME_HEADER + len;
+        bytes += SFLOG_FRAME_HEADER + len;
+    }
+    f.close();
+    if (!whole)
+        LOG_WARN("S&F log: segment %lu ends in a damaged record after %lu bytes", (unsigned long)id, (unsigned long)bytes);
+    return whole;
+}
+
+void StoreForwardLog::startSegment()
+{
+    activeSegment++;
+    activeBytes = 0;
+    damagedTail = false;
+
+    char path[48];
+    concurrency::LockGuard g(spiLock);
+    // A leftover would be appended to
+    segmentPath(activeSegment, path, sizeof(path));
+    FSCom.remove(path);
+    while (activeSegment - firstSegment + 1 > maxSegments) {
+        segmentPath(firstSegment++, path, sizeof(path));
+        FSCom.remove(path);
+        stats.dropped++;
+    }
+}
+
+void StoreForwardLog::append(const PacketHistoryStruct &r, uint32_t now)
+{
+    if (!ready)
+        return;
+    if (stopped) {
+        stats.discarded++;
+        return;
+    }
+
+    uint8_t frame[SFLOG_FRAME_HEADER + StoreForwardHistory::MAX_RECORD_SIZE];
+    size_t len = StoreForwardHistory::pack(r, frame + SFLOG_FRAME_HEADER);
+    frame[0] = SFLOG_RECORD_MAGIC;
+    frame[1] = xorHash(frame + SFLOG_FRAME_HEADER, len);
+    len += SFLOG_FRAME_HEADER;
+
+    // A batch goes into one segment, so it ends where the segment would overflow
+    if (batchLen + len > sizeof(batch) || (activeBytes + batchLen > 0 && activeBytes + batchLen + len > segmentBytes))
+        flush();
+    if (batchLen == 0)
+        batchSince = now;
+    memcpy(batch + batchLen, frame, len);
+    batchLen += len;
+    batchRecords++;
+    stats.appended++;
+}
+
+void StoreForwardLog::flushIfDue(uint32_t now)
+{
+    if (batchLen > 0 && now - batchSince >= SFLOG_FLUSH_MS)
+        flush();
+}
+
+void StoreForwardLog::flush()
+{
+    if (!ready || stopped || batchLen == 0)
+        return;
+
+    if (damagedTail || (activeBytes > 0 && activeBytes + batchLen > segmentBytes))
+        startSegment();
+
+    char path[48];
+    segmentPath(activeSegment, path, sizeof(path));
+    bool ok;
+    {
+        concurrency::LockGuard g(spiLock);
+        File f = FSCom.open(path, SFLOG_APPEND);
+        ok = f && f.write(batch, batchLen) == batchLen;
+        if (f)
+            f.close();
+    }
+
+    stats.batches++;
+    if (ok) {
+        activeBytes += batchLen;
+        failuresInARow = 0;
+    } else {
+        // Part of it may be on flash, keep it out of the way of the next batch
+        LOG_ERROR("S&F log: can't write to segment %lu", (unsigned long)activeSegment);
+        stats.writeFailures++;
+        stats.discarded += batchRecords;
+        damagedTail = true;
+        // Most likely the flash is full or worn out, a new segment per batch would not help
+        if (++failuresInARow >= SFLOG_MAX_WRITE_FAILURES) {
+            LOG_ERROR("S&F log: %u writes failed in a row, history is kept in RAM only until reboot",
+                      (unsigned)failuresInARow);
+            stopped = true;
+        }
+    }
+    batchLen = 0;
+    batchRecords = 0;
+}
+
+#endif
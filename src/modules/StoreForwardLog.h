@@ -0,0 +1,127 @@
+#pragma once
+
+#include "FSCommon.h"
+#include "StoreForwardHistory.h"
+#include "configuration.h"
+
+#ifdef FSCom
+
+// Keep the store & forward history in flash as well, so a server that reboots still has it; 0 keeps it in RAM only
+#ifndef STOREFORWARD_PERSIST
+#define STOREFORWARD_PERSIST 1
+#endif
+
+// Where the log lives, one file per segment
+#define SFLOG_DIR "/sflog"
+
+// Segment size, the granularity the oldest history is dropped at
+#ifndef SFLOG_SEGMENT_BYTES
+#define SFLOG_SEGMENT_BYTES 32768
+#endif
+
+// Segments kept, the log never takes much more than SFLOG_MAX_SEGMENTS * SFLOG_SEGMENT_BYTES of flash
+#ifndef SFLOG_MAX_SEGMENTS
+#define SFLOG_MAX_SEGMENTS 16
+#endif
+
+// Flash left to the rest of the firmware (config, node database, other modules) when sizing the log at startup
+#ifndef SFLOG_FS_RESERVE_BYTES
+#define SFLOG_FS_RESERVE_BYTES 65536
+#endif
+
+// Writes failing in a row before the log stops writing until the next reboot
+#define SFLOG_MAX_WRITE_FAILURES 3
+
+// freeSpace() on a filesystem that can't tell
+#define SFLOG_FREE_UNKNOWN UINT64_MAX
+
+// Records are written in batches: when this much is waiting, or once the oldest has waited SFLOG_FLUSH_MS
+#define SFLOG_BATCH_BYTES 2048
+#define SFLOG_FLUSH_MS 10000
+
+struct StoreForwardLogStats {
+    uint32_t replayed; // records read back at startup
+    uint32_t appended;
+    uint32_t batches;       // writes to flash
+    uint32_t writeFailures; // batches that did not make it whole
+    uint32_t damaged;       // segments cut short at a torn or corrupt record
+    uint32_t dropped;       // segments removed to stay within the limit
+    uint32_t discarded;     // records that never made it to flash, from failed writes or after the log stopped
+};
+
+/**
+ * Append-only log of the store & forward history in flash, replayed into a StoreForwardHistory at startup.
+ *
+ * Records go into numbered segment files, packed as in the history with a magic byte and an xor hash in front.  When a
+ * segment is full the next one is started and past the limit the oldest is removed.  Writing each record as it comes
+ * would mean a flash commit per message, so they are batched in RAM and written with one open, write and close: at
+ * most SFLOG_FLUSH_MS of history is lost if power goes, and the batch is written at once on reboot or deep sleep.
+ *
+ * If power goes mid-write the segment ends in a torn record.  Replay stops that segment at the last whole record and
+ * new records go to a fresh segment, so nothing after the damage is ever misread.
+ *
+ * The segment limit is lowered at startup to what the filesystem has room for, leaving SFLOG_FS_RESERVE_BYTES to
+ * everything else.  A write that fails moves on to a new segment; after SFLOG_MAX_WRITE_FAILURES in a row the log stops
+ * writing altogether rather than open a segment per batch, and the history is kept in RAM only until reboot.
+ */
+class StoreForwardLog
+{
+  public:
+    explicit StoreForwardLog(const char *dir = SFLOG_DIR, uint32_t segmentBytes = SFLOG_SEGMENT_BYTES,
+                             uint32_t maxSegments = SFLOG_MAX_SEGMENTS);
+
+    /**
+     * Replay the records kept in flash into history, oldest first, and get ready to append.
+     * @param freeBytes what the filesystem has free, SFLOG_FREE_UNKNOWN keeps the configured limit
+     * @return false if the log can't be used, not even two segments fit
+     */
+    bool begin(StoreForwardHistory &history, uint64_t freeBytes = freeSpace());
+
+    /// Queue a record, now is in milliseconds
+    void append(const PacketHistoryStruct &r, uint32_t now);
+
+    /// Write the queued records if they have waited long enough
+    void flushIfDue(uint32_t now);
+
+    /// Write the queued records now
+    void flush();
+
+    uint32_t getSegmentCount() const { return ready ? activeSegment - firstSegment + 1 : 0; }
+    uint32_t getMaxSegments() const { return maxSegments; }
+    bool isStopped() const { return stopped; }
+    const StoreForwardLogStats &getStats() const { return stats; }
+
+    /// Bytes free on the filesystem the log is on, or SFLOG_FREE_UNKNOWN
+    static uint64_t freeSpace();
+
+  private:
+    const char *dir;
+    uint32_t segmentBytes;
+    uint32_t maxSegments;
+    bool ready = false;
+
+    // Segments are numbered firstSegment to activeSegment, the last one is appended to
+    uint32_t firstSegment = 0;
+    uint32_t activeSegment = 0;
+    uint32_t activeBytes = 0;
+    bool damagedTail = false; // the active segment ends in a bad record, append elsewhere
+    uint32_t failuresInARow = 0;
+    bool stopped = false; // too many writes failed, nothing more is written
+
+    // Records waiting to be written; at startup, what is read from flash
+    uint8_t batch[SFLOG_BATCH_BYTES];
+    size_t batchLen = 0;
+    uint32_t batchRecords = 0;
+    uint32_t batchSince = 0;
+
+    StoreForwardLogStats stats = {};
+
+    void segmentPath(uint32_t id, char *out, size_t outMax) const;
+
+    /// Add a segment's valid records to history, returns false if it ends in a bad record
+    bool replay(uint32_t id, StoreForwardHistory &history, uint32_t &bytes);
+
+    void startSegment();
+};
+
+#endif
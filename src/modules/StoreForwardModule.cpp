@@ -24,6 +24,7 @@
 #include "mesh-pb-constants.h"
 #include "mesh/generated/meshtastic/storeforward.pb.h"
 #include "modules/ModuleDev.h"
+#include "sleep.h"
 #include <Arduino.h>
 #include <iterator>
 #include <map>
@@ -34,17 +35,23 @@ int32_t StoreForwardModule::runOnce()
 {
 #if defined(ARCH_ESP32) || defined(ARCH_PORTDUINO)
     if (moduleConfig.store_forward.enabled && is_server) {
-        // Send out the message queue.
-        if (this->busy) {
-            // Only send packets if the channel is less than 25% utilized and until historyReturnMax
-            if (airTime->isTxAllowedChannelUtil(true) && this->requestCount < this->historyReturnMax) {
-                if (!storeForwardModule->sendPayload(this->busyTo, this->last_time)) {
-                    this->requestCount = 0;
-                    this->busy = false;
-                }
-            }
-        } else if (this->heartbeat && (!Throttle::isWithinTimespanMs(lastHeartbeat, heartbeatInterval * 1000)) &&
-                   airTime->isTxAllowedChannelUtil(true)) {
+#if defined(FSCom) && STOREFORWARD_PERSIST
+        if (historyLog)
+            historyLog->flushIfDue(millis());
+#endif
+        // Send out the history, a frame at a time to each client in turn, as fast as the channel allows
+        if (!scheduler.empty()) {
+            uint32_t wait = scheduler.waitFor(millis());
+            if (wait)
+                return wait;
+            // Only send packets if the channel is less than 25% utilized
+            if (!airTime->isTxAllowedChannelUtil(true))
+                return SF_BUSY_INTERVAL_MS;
+            if (sendPayload())
+                return scheduler.waitFor(millis());
+        }
+        if (scheduler.empty() && this->heartbeat &&
+            (!Throttle::isWithinTimespanMs(lastHeartbeat, heartbeatInterval * 1000)) && airTime->isTxAllowedChannelUtil(true)) {
             lastHeartbeat = millis();
             LOG_INFO("Send heartbeat");
             meshtastic_StoreAndForward sf = meshtastic_StoreAndForward_init_zero;
@@ -54,7 +61,7 @@ int32_t StoreForwardModule::runOnce()
             sf.variant.heartbeat.secondary = 0; // TODO we always have one primary router for now
             storeForwardModule->sendMessage(NODENUM_BROADCAST, sf);
         }
-        return (this->packetTimeMax);
+        return SF_BUSY_INTERVAL_MS; // Look again for the heartbeat, requests wake us up sooner
     }
 #endif
     return disable();
@@ -76,21 +83,46 @@ void StoreForwardModule::populatePSRAM()
     /* Use a maximum of 3/4 the available PSRAM unless otherwise specified.
         Note: This needs to be done after every thing that would use PSRAM
     */
-    uint32_t numberOfPackets =
-        (this->records ? this->records : (((memGet.getFreePsram() / 4) * 3) / sizeof(PacketHistoryStruct)));
-    this->records = numberOfPackets;
+    size_t historyBytes = this->records ? StoreForwardHistory::bytesFor(this->records) : (memGet.getFreePsram() / 4) * 3;
+    uint8_t *packetHistory = NULL;
 #if defined(ARCH_ESP32)
-    this->packetHistory = static_cast<PacketHistoryStruct *>(ps_calloc(numberOfPackets, sizeof(PacketHistoryStruct)));
+    packetHistory = static_cast<uint8_t *>(ps_calloc(historyBytes, 1));
 #elif defined(ARCH_PORTDUINO)
-    this->packetHistory = static_cast<PacketHistoryStruct *>(calloc(numberOfPackets, sizeof(PacketHistoryStruct)));
+    packetHistory = static_cast<uint8_t *>(calloc(historyBytes, 1));
 
 #endif
+    // Records are packed, so how many fit depends on their length; records is the most that can be kept
+    this->history.init(packetHistory, historyBytes, this->records);
+    this->records = this->history.getCapacity();
 
     LOG_DEBUG("After PSRAM init: heap %d/%d PSRAM %d/%d", memGet.getFreeHeap(), memGet.getHeapSize(), memGet.getFreePsram(),
               memGet.getPsramSize());
-    LOG_DEBUG("numberOfPackets for packetHistory - %u", numberOfPackets);
+    LOG_DEBUG("packetHistory - %u bytes for up to %u records", (unsigned)historyBytes, this->records);
+
+#if defined(FSCom) && STOREFORWARD_PERSIST
+    // Bring back what we had stored before a reboot
+    if (this->history.getCapacity()) {
+        historyLog = new StoreForwardLog();
+        if (historyLog->begin(this->history)) {
+            rebootObserver.observe(&notifyReboot);
+            deepSleepObserver.observe(&notifyDeepSleep);
+        } else {
+            delete historyLog;
+            historyLog = NULL;
+        }
+    }
+#endif
 }
 
+#if defined(FSCom) && STOREFORWARD_PERSIST
+int StoreForwardModule::flushHistoryLog(void *unused)
+{
+    if (historyLog)
+        historyLog->flush();
+    return 0;
+}
+#endif
+
 /**
  * Sends messages from the message history to the specified recipient.
  *
@@ -99,16 +131,17 @@ void StoreForwardModule::populatePSRAM()
  */
 void StoreForwardModule::historySend(uint32_t secAgo, uint32_t to)
 {
-    this->last_time = getTime() < secAgo ? 0 : getTime() - secAgo;
-    uint32_t queueSize = getNumAvailablePackets(to, last_time);
+    uint32_t since = getTime() < secAgo ? 0 : getTime() - secAgo;
+    uint32_t queueSize = getNumAvailablePackets(to, since);
     if (queueSize > this->historyReturnMax)
         queueSize = this->historyReturnMax;
 
-    if (queueSize) {
-        LOG_INFO("S&F - Send %u message(s)", queueSize);
-        this->busy = true; // runOnce() will pickup the next steps once busy = true.
-        this->busyTo = to;
+    // The caller made sure there is room for the client, runOnce() sends it its share of the frames
+    if (queueSize && scheduler.add(to, since, lastRequest[to], queueSize)) {
+        LOG_INFO("S&F - Send %u message(s), %u client(s) waiting for %u in total", queueSize, (unsigned)scheduler.clients(),
+                 scheduler.queued());
     } else {
+        scheduler.remove(to); // Anything left from an earlier request is superseded
         LOG_INFO("S&F - No history");
     }
     meshtastic_StoreAndForward sf = meshtastic_StoreAndForward_init_zero;
@@ -118,7 +151,7 @@ void StoreForwardModule::historySend(uint32_t secAgo, uint32_t to)
     sf.variant.history.window = secAgo * 1000;
     sf.variant.history.last_request = lastRequest[to];
     storeForwardModule->sendMessage(to, sf);
-    setIntervalFromNow(this->packetTimeMax); // Delay start of sending payloads
+    setIntervalFromNow(scheduler.waitFor(millis())); // The first payload is paced after this response
 }
 
 /**
@@ -130,20 +163,7 @@ void StoreForwardModule::historySend(uint32_t secAgo, uint32_t to)
  */
 uint32_t StoreForwardModule::getNumAvailablePackets(NodeNum dest, uint32_t last_time)
 {
-    uint32_t count = 0;
-    if (lastRequest.find(dest) == lastRequest.end()) {
-        lastRequest.emplace(dest, 0);
-    }
-    for (uint32_t i = lastRequest[dest]; i < this->packetHistoryTotalCount; i++) {
-        if (this->packetHistory[i].time && (this->packetHistory[i].time > last_time)) {
-            // Client is only interested in packets not from itself and only in broadcast packets or packets towards it.
-            if (this->packetHistory[i].from != dest &&
-                (this->packetHistory[i].to == NODENUM_BROADCAST || this->packetHistory[i].to == dest)) {
-                count++;
-            }
-        }
-    }
-    return count;
+    return this->history.countAvailable(dest, last_time, lastRequest[dest]);
 }
 
 /**
@@ -153,27 +173,9 @@ uint32_t StoreForwardModule::getNumAvailablePackets(NodeNum dest, uint32_t last_
  */
 meshtastic_MeshPacket *StoreForwardModule::getForPhone()
 {
-    if (moduleConfig.store_forward.enabled && is_server) {
-        NodeNum to = nodeDB->getNodeNum();
-        if (!this->busy) {
-            // Get number of packets we're going to send in this loop
-            uint32_t histSize = getNumAvailablePackets(to, 0); // No time limit
-            if (histSize) {
-                this->busy = true;
-                this->busyTo = to;
-            } else {
-                return nullptr;
-            }
-        }
-
-        // We're busy with sending to us until no payload is available anymore
-        if (this->busy && this->busyTo == to) {
-            meshtastic_MeshPacket *p = preparePayload(to, 0, true); // No time limit
-            if (!p)                                                 // No more messages to send
-                this->busy = false;
-            return p;
-        }
-    }
+    // The phone is not over the air, so it gets everything at once and needs no turn
+    if (moduleConfig.store_forward.enabled && is_server)
+        return preparePayload(nodeDB->getNodeNum(), 0, true); // No time limit
     return nullptr;
 }
 
@@ -186,50 +188,57 @@ void StoreForwardModule::historyAdd(const meshtastic_MeshPacket &mp)
 {
     const auto &p = mp.decoded;
 
-    if (this->packetHistoryTotalCount == this->records) {
-        LOG_WARN("S&F - PSRAM Full. Starting overwrite");
-        this->packetHistoryTotalCount = 0;
-        for (auto &i : lastRequest) {
-            i.second = 0; // Clear the last request index for each client device
-        }
-    }
-
-    this->packetHistory[this->packetHistoryTotalCount].time = getTime();
-    this->packetHistory[this->packetHistoryTotalCount].to = mp.to;
-    this->packetHistory[this->packetHistoryTotalCount].channel = mp.channel;
-    this->packetHistory[this->packetHistoryTotalCount].from = getFrom(&mp);
-    this->packetHistory[this->packetHistoryTotalCount].id = mp.id;
-    this->packetHistory[this->packetHistoryTotalCount].reply_id = p.reply_id;
-    this->packetHistory[this->packetHistoryTotalCount].emoji = (bool)p.emoji;
-    this->packetHistory[this->packetHistoryTotalCount].payload_size = p.payload.size;
-    this->packetHistory[this->packetHistoryTotalCount].rx_rssi = mp.rx_rssi;
-    this->packetHistory[this->packetHistoryTotalCount].rx_snr = mp.rx_snr;
-    this->packetHistory[this->packetHistoryTotalCount].hop_start = mp.hop_start;
-    this->packetHistory[this->packetHistoryTotalCount].hop_limit = mp.hop_limit;
-    this->packetHistory[this->packetHistoryTotalCount].via_mqtt = mp.via_mqtt;
-    this->packetHistory[this->packetHistoryTotalCount].transport_mechanism = mp.transport_mechanism;
-    memcpy(this->packetHistory[this->packetHistoryTotalCount].payload, p.payload.bytes, meshtastic_Constants_DATA_PAYLOAD_LEN);
-
-    this->packetHistoryTotalCount++;
+    if (!this->history.getCapacity())
+        return;
+
+    PacketHistoryStruct r = {};
+    r.time = getTime();
+    r.to = mp.to;
+    r.channel = mp.channel;
+    r.from = getFrom(&mp);
+    r.id = mp.id;
+    r.reply_id = p.reply_id;
+    r.emoji = (bool)p.emoji;
+    r.payload_size = p.payload.size;
+    r.rx_rssi = mp.rx_rssi;
+    r.rx_snr = mp.rx_snr;
+    r.hop_start = mp.hop_start;
+    r.hop_limit = mp.hop_limit;
+    r.via_mqtt = mp.via_mqtt;
+    r.transport_mechanism = mp.transport_mechanism;
+    memcpy(r.payload, p.payload.bytes, p.payload.size);
+
+    this->history.add(r);
+#if defined(FSCom) && STOREFORWARD_PERSIST
+    if (historyLog)
+        historyLog->append(r, millis());
+#endif
 }
 
 /**
- * Sends a payload to a specified destination node using the store and forward mechanism.
+ * Sends the next frame of history, to the client whose turn it is.
  *
- * @param dest The destination node number.
- * @param last_time The relative time to start sending messages from.
- * @return True if a packet was successfully sent, false otherwise.
+ * @return True if a packet was sent, false if no client has anything left.
  */
-bool StoreForwardModule::sendPayload(NodeNum dest, uint32_t last_time)
+bool StoreForwardModule::sendPayload()
 {
-    meshtastic_MeshPacket *p = preparePayload(dest, last_time);
-    if (p) {
-        LOG_INFO("Send S&F Payload");
-        service->sendToMesh(p);
-        this->requestCount++;
-        return true;
-    }
-    return false;
+    StoreForwardFrame frame;
+    uint32_t cursor;
+    if (!scheduler.next(this->history, frame, cursor))
+        return false;
+
+    lastRequest[frame.dest] = cursor; // Update the last request index for the client device
+    meshtastic_MeshPacket *p = packetFromRecord(frame.record, frame.dest, false);
+    LOG_INFO("Send S&F Payload to 0x%x, %u message(s), %u left for %u client(s)", frame.dest, frame.records,
+             scheduler.queued(), (unsigned)scheduler.clients());
+    pace(p);
+    service->sendToMesh(p);
+    return true;
+}
+
+void StoreForwardModule::pace(const meshtastic_MeshPacket *p)
+{
+    scheduler.sent(millis(), router ? router->getPacketTime(p) : 0, airTime->channelUtilizationPercent());
 }
 
 /**
@@ -241,60 +250,69 @@ bool StoreForwardModule::sendPayload(NodeNum dest, uint32_t last_time)
  */
 meshtastic_MeshPacket *StoreForwardModule::preparePayload(NodeNum dest, uint32_t last_time, bool local)
 {
-    for (uint32_t i = lastRequest[dest]; i < this->packetHistoryTotalCount; i++) {
-        if (this->packetHistory[i].time && (this->packetHistory[i].time > last_time)) {
-            /*  Copy the messages that were received by the server in the last msAgo
-                to the packetHistoryTXQueue structure.
-                Client not interested in packets from itself and only in broadcast packets or packets towards it. */
-            if (this->packetHistory[i].from != dest &&
-                (this->packetHistory[i].to == NODENUM_BROADCAST || this->packetHistory[i].to == dest)) {
-
-                meshtastic_MeshPacket *p = allocDataPacket();
-
-                p->to = local ? this->packetHistory[i].to : dest; // PhoneAPI can handle original `to`
-                p->from = this->packetHistory[i].from;
-                p->id = this->packetHistory[i].id;
-                p->channel = this->packetHistory[i].channel;
-                p->decoded.reply_id = this->packetHistory[i].reply_id;
-                p->rx_time = this->packetHistory[i].time;
-                p->decoded.emoji = (uint32_t)this->packetHistory[i].emoji;
-                p->rx_rssi = this->packetHistory[i].rx_rssi;
-                p->rx_snr = this->packetHistory[i].rx_snr;
-                p->hop_start = this->packetHistory[i].hop_start;
-                p->hop_limit = this->packetHistory[i].hop_limit;
-                p->via_mqtt = this->packetHistory[i].via_mqtt;
-                p->transport_mechanism = (meshtastic_MeshPacket_TransportMechanism)this->packetHistory[i].transport_mechanism;
-
-                // Let's assume that if the server received the S&F request that the client is in range.
-                //   TODO: Make this configurable.
-                p->want_ack = false;
-
-                if (local) { // PhoneAPI gets normal TEXT_MESSAGE_APP
-                    p->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
-                    memcpy(p->decoded.payload.bytes, this->packetHistory[i].payload, this->packetHistory[i].payload_size);
-                    p->decoded.payload.size = this->packetHistory[i].payload_size;
-                } else {
-                    meshtastic_StoreAndForward sf = meshtastic_StoreAndForward_init_zero;
-                    sf.which_variant = meshtastic_StoreAndForward_text_tag;
-                    sf.variant.text.size = this->packetHistory[i].payload_size;
-                    memcpy(sf.variant.text.bytes, this->packetHistory[i].payload, this->packetHistory[i].payload_size);
-                    if (this->packetHistory[i].to == NODENUM_BROADCAST) {
-                        sf.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_TEXT_BROADCAST;
-                    } else {
-                        sf.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_TEXT_DIRECT;
-                    }
-
-                    p->decoded.payload.size = pb_encode_to_bytes(p->decoded.payload.bytes, sizeof(p->decoded.payload.bytes),
-                                                                 &meshtastic_StoreAndForward_msg, &sf);
-                }
+    /*  Copy the next message that was received by the server in the last msAgo.
+        Client not interested in packets from itself and only in broadcast packets or packets towards it. */
+    uint32_t i = this->history.next(dest, last_time, lastRequest[dest]);
+    if (i == StoreForwardHistory::NONE)
+        return nullptr;
+    PacketHistoryStruct r;
+    this->history.get(i, r);
+
+    lastRequest[dest] = i + 1; // Update the last request index for the client device
+    return packetFromRecord(r, dest, local);
+}
 
-                lastRequest[dest] = i + 1; // Update the last request index for the client device
+/**
+ * Builds the packet that carries a record from the S&F packet history.
+ *
+ * @param r The record, for a history frame its payload may hold several texts and then its id is 0.
+ * @param dest The destination node number.
+ * @param local True for the phone, which gets it as a plain text message.
+ * @return A pointer to the prepared mesh packet.
+ */
+meshtastic_MeshPacket *StoreForwardModule::packetFromRecord(const PacketHistoryStruct &r, NodeNum dest, bool local)
+{
+    meshtastic_MeshPacket *p = allocDataPacket();
+
+    p->to = local ? r.to : dest; // PhoneAPI can handle original `to`
+    p->from = r.from;
+    if (r.id)
+        p->id = r.id; // A bundle keeps the id allocDataPacket gave it
+    p->channel = r.channel;
+    p->decoded.reply_id = r.reply_id;
+    p->rx_time = r.time;
+    p->decoded.emoji = (uint32_t)r.emoji;
+    p->rx_rssi = r.rx_rssi;
+    p->rx_snr = r.rx_snr;
+    p->hop_start = r.hop_start;
+    p->hop_limit = r.hop_limit;
+    p->via_mqtt = r.via_mqtt;
+    p->transport_mechanism = (meshtastic_MeshPacket_TransportMechanism)r.transport_mechanism;
 
-                return p;
-            }
+    // Let's assume that if the server received the S&F request that the client is in range.
+    //   TODO: Make this configurable.
+    p->want_ack = false;
+
+    if (local) { // PhoneAPI gets normal TEXT_MESSAGE_APP
+        p->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+        memcpy(p->decoded.payload.bytes, r.payload, r.payload_size);
+        p->decoded.payload.size = r.payload_size;
+    } else {
+        meshtastic_StoreAndForward sf = meshtastic_StoreAndForward_init_zero;
+        sf.which_variant = meshtastic_StoreAndForward_text_tag;
+        sf.variant.text.size = r.payload_size;
+        memcpy(sf.variant.text.bytes, r.payload, r.payload_size);
+        if (r.to == NODENUM_BROADCAST) {
+            sf.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_TEXT_BROADCAST;
+        } else {
+            sf.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_TEXT_DIRECT;
         }
+
+        p->decoded.payload.size =
+            pb_encode_to_bytes(p->decoded.payload.bytes, sizeof(p->decoded.payload.bytes), &meshtastic_StoreAndForward_msg, &sf);
     }
-    return nullptr;
+
+    return p;
 }
 
 /**
@@ -316,6 +334,7 @@ void StoreForwardModule::sendMessage(NodeNum dest, const meshtastic_StoreAndForw
     p->want_ack = false;
     p->decoded.want_response = false;
 
+    pace(p); // History frames leave room for our other S&F traffic too
     service->sendToMesh(p);
 }
 
@@ -348,7 +367,7 @@ void StoreForwardModule::sendErrorTextMessage(NodeNum dest, bool want_response)
     pr->decoded.want_response = false;
     pr->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
     const char *str;
-    if (this->busy) {
+    if (scheduler.full()) {
         str = "S&F - Busy. Try again shortly.";
     } else {
         str = "S&F not permitted on the public channel.";
@@ -374,7 +393,7 @@ void StoreForwardModule::statsSend(uint32_t to)
     sf.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_STATS;
     sf.which_variant = meshtastic_StoreAndForward_stats_tag;
     sf.variant.stats.messages_total = this->records;
-    sf.variant.stats.messages_saved = this->packetHistoryTotalCount;
+    sf.variant.stats.messages_saved = this->history.size();
     sf.variant.stats.messages_max = this->records;
     sf.variant.stats.up_time = millis() / 1000;
     sf.variant.stats.requests = this->requests;
@@ -383,7 +402,9 @@ void StoreForwardModule::statsSend(uint32_t to)
     sf.variant.stats.return_max = this->historyReturnMax;
     sf.variant.stats.return_window = this->historyReturnWindow;
 
-    LOG_DEBUG("Send S&F Stats");
+    // The stats message has no fields for the delivery queue, so it is only logged here
+    LOG_INFO("Send S&F Stats, %u message(s) queued for %u client(s), done in about %u s", scheduler.queued(),
+             (unsigned)scheduler.clients(), scheduler.eta());
     storeForwardModule->sendMessage(to, sf);
 }
 
@@ -404,14 +425,14 @@ ProcessMessage StoreForwardModule::handleReceived(const meshtastic_MeshPacket &m
                 LOG_DEBUG("Legacy Request to send");
 
                 // Send the last 60 minutes of messages.
-                if (this->busy || channels.isDefaultChannel(mp.channel)) {
+                if ((scheduler.full() && !scheduler.has(getFrom(&mp))) || channels.isDefaultChannel(mp.channel)) {
                     sendErrorTextMessage(getFrom(&mp), mp.decoded.want_response);
                 } else {
                     storeForwardModule->historySend(historyReturnWindow * 60, getFrom(&mp));
                 }
             } else {
                 storeForwardModule->historyAdd(mp);
-                LOG_INFO("S&F stored. Message history contains %u records now", this->packetHistoryTotalCount);
+                LOG_INFO("S&F stored. Message history contains %u records now", this->history.size());
             }
         } else if (!isFromUs(&mp) && mp.decoded.portnum == meshtastic_PortNum_STORE_FORWARD_APP) {
             auto &p = mp.decoded;
@@ -456,10 +477,8 @@ bool StoreForwardModule::handleReceivedProtobuf(const meshtastic_MeshPacket &mp,
     case meshtastic_StoreAndForward_RequestResponse_CLIENT_ABORT:
         if (is_server) {
             // stop sending stuff, the client wants to abort or has another error
-            if ((this->busy) && (this->busyTo == getFrom(&mp))) {
+            if (scheduler.remove(getFrom(&mp))) {
                 LOG_ERROR("Client in ERROR or ABORT requested");
-                this->requestCount = 0;
-                this->busy = false;
             }
         }
         break;
@@ -469,7 +488,7 @@ bool StoreForwardModule::handleReceivedProtobuf(const meshtastic_MeshPacket &mp,
             requests_history++;
             LOG_INFO("Client Request to send HISTORY");
             // Send the last 60 minutes of messages.
-            if (this->busy || channels.isDefaultChannel(mp.channel)) {
+            if ((scheduler.full() && !scheduler.has(getFrom(&mp))) || channels.isDefaultChannel(mp.channel)) {
                 sendErrorTextMessage(getFrom(&mp), mp.decoded.want_response);
             } else {
                 if ((p->which_variant == meshtastic_StoreAndForward_history_tag) && (p->variant.history.window > 0)) {
@@ -498,7 +517,7 @@ bool StoreForwardModule::handleReceivedProtobuf(const meshtastic_MeshPacket &mp,
     case meshtastic_StoreAndForward_RequestResponse_CLIENT_STATS:
         if (is_server) {
             LOG_INFO("Client Request to send STATS");
-            if (this->busy) {
+            if (scheduler.full()) {
                 storeForwardModule->sendMessage(getFrom(&mp), meshtastic_StoreAndForward_RequestResponse_ROUTER_BUSY);
                 LOG_INFO("S&F - Busy. Try again shortly");
             } else {
@@ -508,12 +527,18 @@ bool StoreForwardModule::handleReceivedProtobuf(const meshtastic_MeshPacket &mp,
         break;
 
     case meshtastic_StoreAndForward_RequestResponse_ROUTER_ERROR:
+        if (is_client) {
+            LOG_DEBUG("StoreAndForward_RequestResponse_ROUTER_ERROR");
+            // Something went wrong on the server, give it longer than when it is only busy
+            retry_delay = millis() + 2 * SF_BUSY_INTERVAL_MS;
+        }
+        break;
+
     case meshtastic_StoreAndForward_RequestResponse_ROUTER_BUSY:
         if (is_client) {
             LOG_DEBUG("StoreAndForward_RequestResponse_ROUTER_BUSY");
-            // retry in messages_saved * packetTimeMax ms
-            retry_delay = millis() + getNumAvailablePackets(this->busyTo, this->last_time) * packetTimeMax *
-                                         (meshtastic_StoreAndForward_RequestResponse_ROUTER_ERROR ? 2 : 1);
+            // The server paces by airtime, so there is no knowing how long exactly; retry after a while
+            retry_delay = millis() + SF_BUSY_INTERVAL_MS;
         }
         break;
 
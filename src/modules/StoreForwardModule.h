@@ -1,6 +1,10 @@
 #pragma once
 
+#include "Observer.h"
 #include "ProtobufModule.h"
+#include "StoreForwardHistory.h"
+#include "StoreForwardLog.h"
+#include "StoreForwardScheduler.h"
 #include "concurrency/OSThread.h"
 #include "mesh/generated/meshtastic/storeforward.pb.h"
 
@@ -9,41 +13,19 @@
 #include <functional>
 #include <unordered_map>
 
-struct PacketHistoryStruct {
-    uint32_t time;
-    uint32_t to;
-    uint32_t from;
-    uint32_t id;
-    uint8_t channel;
-    uint32_t reply_id;
-    bool emoji;
-    uint8_t payload[meshtastic_Constants_DATA_PAYLOAD_LEN];
-    pb_size_t payload_size;
-    int32_t rx_rssi;
-    float rx_snr;
-    uint8_t hop_start;
-    uint8_t hop_limit;
-    bool via_mqtt;
-    uint8_t transport_mechanism;
-};
-
 class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<meshtastic_StoreAndForward>
 {
-    bool busy = 0;
-    uint32_t busyTo = 0;
     char routerMessage[meshtastic_Constants_DATA_PAYLOAD_LEN] = {0};
 
-    PacketHistoryStruct *packetHistory = 0;
-    uint32_t packetHistoryTotalCount = 0;
-    uint32_t last_time = 0;
-    uint32_t requestCount = 0;
+    StoreForwardHistory history;
 
-    uint32_t packetTimeMax = 5000; // Interval between sending history packets as a server.
+    // The clients being sent history, and the pace of it
+    StoreForwardScheduler scheduler;
 
     bool is_client = false;
     bool is_server = false;
 
-    // Unordered_map stores the last request for each nodeNum (`to` field)
+    // Unordered_map stores the last request for each nodeNum (`to` field): the record number to continue from
     std::unordered_map<NodeNum, uint32_t> lastRequest;
 
   public:
@@ -62,10 +44,10 @@ class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<
     uint32_t getNumAvailablePackets(NodeNum dest, uint32_t last_time);
 
     /**
-     * Send our payload into the mesh
+     * Send the next history frame into the mesh, for the next client in turn
      */
-    bool sendPayload(NodeNum dest = NODENUM_BROADCAST, uint32_t packetHistory_index = 0);
-    meshtastic_MeshPacket *preparePayload(NodeNum dest, uint32_t packetHistory_index, bool local = false);
+    bool sendPayload();
+    meshtastic_MeshPacket *preparePayload(NodeNum dest, uint32_t last_time, bool local = false);
     void sendMessage(NodeNum dest, const meshtastic_StoreAndForward &payload);
     void sendMessage(NodeNum dest, meshtastic_StoreAndForward_RequestResponse rr);
     void sendErrorTextMessage(NodeNum dest, bool want_response);
@@ -90,6 +72,24 @@ class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<
   private:
     void populatePSRAM();
 
+    /// A packet carrying a stored record, to dest over the mesh or as it was to the phone
+    meshtastic_MeshPacket *packetFromRecord(const PacketHistoryStruct &r, NodeNum dest, bool local);
+
+    /// Space the next history frame after p by its airtime
+    void pace(const meshtastic_MeshPacket *p);
+
+#if defined(FSCom) && STOREFORWARD_PERSIST
+    // The history in flash too, replayed at startup
+    StoreForwardLog *historyLog = NULL;
+
+    /// Write out what the log has batched before we go down
+    int flushHistoryLog(void *unused);
+    CallbackObserver<StoreForwardModule, void *> rebootObserver =
+        CallbackObserver<StoreForwardModule, void *>(this, &StoreForwardModule::flushHistoryLog);
+    CallbackObserver<StoreForwardModule, void *> deepSleepObserver =
+        CallbackObserver<StoreForwardModule, void *>(this, &StoreForwardModule::flushHistoryLog);
+#endif
+
     // S&F Defaults
     uint32_t historyReturnMax = 25;     // Return maximum of 25 records by default.
     uint32_t historyReturnWindow = 240; // Return history of last 4 hours by default.
@@ -0,0 +1,136 @@
+#include "StoreForwardScheduler.h"
+
+#include <algorithm>
+#include <string.h>
+
+bool StoreForwardScheduler::add(NodeNum dest, uint32_t since, uint32_t cursor, uint32_t maxRecords)
+{
+    Session s = {dest, since, cursor, maxRecords};
+    for (auto &existing : sessions) {
+        if (existing.dest == dest) {
+            existing = s;
+            return true;
+        }
+    }
+    if (full())
+        return false;
+
+    // Joins the round just before the client served next, so it gets its first frame after everyone else's
+    sessions.insert(sessions.begin() + turn, s);
+    turn = (turn + 1) % sessions.size();
+    return true;
+}
+
+bool StoreForwardScheduler::remove(NodeNum dest)
+{
+    for (size_t i = 0; i < sessions.size(); i++) {
+        if (sessions[i].dest == dest) {
+            sessions.erase(sessions.begin() + i);
+            if (i < turn)
+                turn--;
+            if (turn >= sessions.size())
+                turn = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool StoreForwardScheduler::has(NodeNum dest) const
+{
+    for (auto &s : sessions)
+        if (s.dest == dest)
+            return true;
+    return false;
+}
+
+bool StoreForwardScheduler::next(const StoreForwardHistory &history, StoreForwardFrame &frame, uint32_t &cursor)
+{
+    while (!sessions.empty()) {
+        Session &s = sessions[turn];
+        uint32_t i = s.remaining ? history.next(s.dest, s.since, s.cursor) : StoreForwardHistory::NONE;
+        if (i == StoreForwardHistory::NONE) {
+            // Done with this client, the one after it moves up to its turn
+            sessions.erase(sessions.begin() + turn);
+            if (turn >= sessions.size())
+                turn = 0;
+            continue;
+        }
+
+        frame.dest = s.dest;
+        frame.records = 1;
+        history.get(i, frame.record);
+        s.cursor = i + 1;
+        s.remaining--;
+        bundle(history, s, frame);
+
+        cursor = s.cursor;
+        turn = (turn + 1) % sessions.size();
+        return true;
+    }
+    return false;
+}
+
+void StoreForwardScheduler::bundle(const StoreForwardHistory &history, Session &s, StoreForwardFrame &frame)
+{
+    PacketHistoryStruct &first = frame.record;
+    if (first.emoji || first.reply_id || first.payload_size >= SF_BUNDLE_MAX_TEXT)
+        return;
+
+    uint32_t lastTime = first.time;
+    PacketHistoryStruct r;
+    while (s.remaining) {
+        uint32_t i = history.next(s.dest, s.since, s.cursor);
+        if (i == StoreForwardHistory::NONE)
+            return;
+        history.get(i, r);
+        if (r.from != first.from || r.to != first.to || r.channel != first.channel || r.emoji || r.reply_id ||
+            r.time - lastTime > SF_BUNDLE_GAP_SECS || first.payload_size + 1 + r.payload_size > SF_BUNDLE_MAX_TEXT)
+            return;
+
+        first.payload[first.payload_size++] = '\n';
+        memcpy(first.payload + first.payload_size, r.payload, r.payload_size);
+        first.payload_size += r.payload_size;
+        lastTime = r.time;
+        frame.records++;
+        s.cursor = i + 1;
+        s.remaining--;
+        first.id = 0;
+    }
+}
+
+uint32_t StoreForwardScheduler::interval(uint32_t airtimeMs, float channelUtil)
+{
+    float headroom = SF_CHANNEL_UTIL_TARGET - channelUtil;
+    if (headroom < 1)
+        return SF_BUSY_INTERVAL_MS;
+
+    // From the start of one frame to the next, so the frames take headroom percent of the time
+    uint32_t gap = airtimeMs * 100 / headroom;
+    return std::max<uint32_t>(SF_MIN_INTERVAL_MS, std::min<uint32_t>(SF_MAX_INTERVAL_MS, gap));
+}
+
+void StoreForwardScheduler::sent(uint32_t now, uint32_t airtimeMs, float channelUtil)
+{
+    pace = interval(airtimeMs, channelUtil);
+    nextAt = now + pace;
+}
+
+uint32_t StoreForwardScheduler::waitFor(uint32_t now) const
+{
+    int32_t wait = nextAt - now;
+    return wait > 0 ? wait : 0;
+}
+
+uint32_t StoreForwardScheduler::queued() const
+{
+    uint32_t n = 0;
+    for (auto &s : sessions)
+        n += s.remaining;
+    return n;
+}
+
+uint32_t StoreForwardScheduler::eta() const
+{
+    return (uint64_t)queued() * pace / 1000;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "StoreForwardHistory.h"
+
+#include <vector>
+
+// Clients served at once, a request beyond that is told the server is busy
+#ifndef SF_MAX_CLIENTS
+#define SF_MAX_CLIENTS 8
+#endif
+
+// History delivery uses what is left of the channel below this utilization, the polite limit of isTxAllowedChannelUtil
+#define SF_CHANNEL_UTIL_TARGET 25
+
+// Bounds of the gap between two history frames; at the target or above, the channel is looked at again after
+// SF_BUSY_INTERVAL_MS
+#define SF_MIN_INTERVAL_MS 500
+#define SF_MAX_INTERVAL_MS 60000
+#define SF_BUSY_INTERVAL_MS 5000
+
+// Texts bundled into one frame follow each other within this many seconds
+#define SF_BUNDLE_GAP_SECS 300
+
+// Longest text that still encodes into a single StoreAndForward payload, rr and the text's tag and length around it
+#define SF_BUNDLE_MAX_TEXT (meshtastic_Constants_DATA_PAYLOAD_LEN - 6)
+
+/// What goes out in one history frame
+struct StoreForwardFrame {
+    NodeNum dest;
+    uint32_t records;           // How many stored texts it carries
+    PacketHistoryStruct record; // The first of them, with the texts of all a line each as its payload, id 0 if more
+};
+
+/**
+ * Delivers the Store & Forward history to every client that asked for it, a frame at a time and in turn, so a client
+ * asking while another is being served waits for a share of the frames rather than for the whole of the other one.
+ *
+ * Frames are paced by airtime: after a frame taking airtimeMs, the next one waits long enough for the history to use
+ * no more than what the rest of the mesh leaves below SF_CHANNEL_UTIL_TARGET.  On a quiet fast channel that is well
+ * under a second, on a slow or busy one several seconds.
+ *
+ * Short texts that one node sent to the same destination and channel in a row are bundled, one per line, into a frame
+ * that any client shows as an ordinary message.  Replies and reactions always go on their own so they keep their
+ * reference to the message they answer.  A bundle is a new message and gets a packet id of its own (its record id is
+ * 0), otherwise a client that already had the first text would drop the whole frame as a duplicate.
+ */
+class StoreForwardScheduler
+{
+  public:
+    /**
+     * Start serving dest the records after since from record number cursor on, at most maxRecords of them.
+     * A client that is already being served starts over with the new request.
+     * @return false if SF_MAX_CLIENTS are being served already
+     */
+    bool add(NodeNum dest, uint32_t since, uint32_t cursor, uint32_t maxRecords);
+
+    /// Stop serving dest, returns false if it was not
+    bool remove(NodeNum dest);
+
+    bool has(NodeNum dest) const;
+    bool full() const { return sessions.size() >= SF_MAX_CLIENTS; }
+    bool empty() const { return sessions.empty(); }
+    size_t clients() const { return sessions.size(); }
+
+    /**
+     * Take the next frame, for the next client in turn; clients with nothing left are done with.
+     * @param cursor where that client continues from after this frame
+     * @return false if no client has anything left
+     */
+    bool next(const StoreForwardHistory &history, StoreForwardFrame &frame, uint32_t &cursor);
+
+    /// Gap to leave after a frame of airtimeMs, with the channel utilization (percent) as it is
+    static uint32_t interval(uint32_t airtimeMs, float channelUtil);
+
+    /// Account for a frame sent at now (ms), the next one waits for interval()
+    void sent(uint32_t now, uint32_t airtimeMs, float channelUtil);
+
+    /// Milliseconds until the next frame may go
+    uint32_t waitFor(uint32_t now) const;
+
+    /// Records still to send to all clients, each may get them in fewer frames when they are bundled
+    uint32_t queued() const;
+
+    /// Seconds until everything queued is sent, at the current pace and one record per frame
+    uint32_t eta() const;
+
+  private:
+    struct Session {
+        NodeNum dest;
+        uint32_t since;
+        uint32_t cursor;
+        uint32_t remaining;
+    };
+
+    std::vector<Session> sessions;
+    size_t turn = 0; // Session to serve next
+
+    uint32_t nextAt = 0;
+    uint32_t pace = SF_BUSY_INTERVAL_MS; // The last gap, what the ETA assumes
+
+    /// Add the texts following frame that can share it, they must all fit
+    void bundle(const StoreForwardHistory &history, Session &s, StoreForwardFrame &frame);
+};
@@ -1,5 +1,6 @@
 #include "DeviceTelemetry.h"
 #include "../mesh/generated/meshtastic/telemetry.pb.h"
+#include "CryptoEngine.h"
 #include "Default.h"
 #include "MeshService.h"
 #include "NodeDB.h"
@@ -149,6 +150,12 @@ meshtastic_Telemetry DeviceTelemetryModule::getLocalStatsTelemetry()
     LOG_INFO("num_packets_tx=%i, num_packets_rx=%i, num_packets_rx_bad=%i", telemetry.variant.local_stats.num_packets_tx,
              telemetry.variant.local_stats.num_packets_rx, telemetry.variant.local_stats.num_packets_rx_bad);
 
+    AllocatorStats pool = packetPool.getStats();
+    LOG_INFO("packet_pool in_use=%u, high_water=%u, alloc_failures=%u", pool.inUse, pool.highWater, pool.failures);
+#if !(MESHTASTIC_EXCLUDE_PKI)
+    LOG_INFO("pki_shared_key_cache hits=%u, misses=%u", crypto->getSharedKeyHits(), crypto->getSharedKeyMisses());
+#endif
+
     return telemetry;
 }
 
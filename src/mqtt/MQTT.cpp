@@ -29,6 +29,7 @@
 #include "serialization/MeshPacketSerializer.h"
 #endif
 #include <Throttle.h>
+#include <algorithm>
 #include <assert.h>
 #include <utility>
 
@@ -49,6 +50,9 @@ constexpr int reconnectMax = 5;
 
 // FIXME - this size calculation is super sloppy, but it will go away once we dynamically alloc meshpackets
 static uint8_t bytes[meshtastic_MqttClientProxyMessage_size + 30]; // 12 for channel name and 16 for nodeid
+#if !defined(ARCH_NRF52) || NRF52_USE_JSON
+static char jsonBuf[MESHPACKET_JSON_MAX]; // the JSON topic's payload, written in place rather than on the heap
+#endif
 
 static bool isMqttServerAddressPrivate = false;
 
@@ -399,12 +403,16 @@ void mqttInit()
     new MQTT();
 }
 
+// Most of the queue each MQTTQueueLevel may hold
+static const int queueRetention[MQTT_QUEUE_LEVELS] = {MAX_MQTT_QUEUE, MAX_MQTT_QUEUE, MAX_MQTT_QUEUE / 2};
+
 #if HAS_NETWORKING
 MQTT::MQTT() : MQTT(std::unique_ptr<MQTTClient>(new MQTTClient())) {}
 MQTT::MQTT(std::unique_ptr<MQTTClient> _mqttClient)
-    : concurrency::OSThread("mqtt"), mqttQueue(MAX_MQTT_QUEUE), mqttClient(std::move(_mqttClient)), pubSub(*mqttClient)
+    : concurrency::OSThread("mqtt"), mqttQueue(MAX_MQTT_QUEUE, queueRetention), mqttClient(std::move(_mqttClient)),
+      pubSub(*mqttClient)
 #else
-MQTT::MQTT() : concurrency::OSThread("mqtt"), mqttQueue(MAX_MQTT_QUEUE)
+MQTT::MQTT() : concurrency::OSThread("mqtt"), mqttQueue(MAX_MQTT_QUEUE, queueRetention)
 #endif
 {
     if (moduleConfig.mqtt.enabled) {
@@ -591,6 +599,7 @@ int32_t MQTT::runOnce()
     bool wantConnection = wantsLink();
 
     perhapsReportToMap();
+    perhapsLogQueueStats();
 
     // If connected poll rapidly, otherwise only occasionally check for a wifi connection change and ability to contact server
     if (moduleConfig.mqtt.proxy_to_client_enabled) {
@@ -603,11 +612,11 @@ int32_t MQTT::runOnce()
             return 5000; // If we don't want connection now, check again in 5 secs
         else {
             reconnect();
-            // If we succeeded, empty the queue one by one and start reading rapidly, else try again in 30 seconds (TCP
+            // If we succeeded, start emptying the queue and reading rapidly, else try again in 30 seconds (TCP
             // connections are EXPENSIVE so try rarely)
             if (isConnectedDirectly()) {
                 publishQueuedMessages();
-                return 200;
+                return 20;
             } else
                 return 30000;
         }
@@ -616,6 +625,8 @@ int32_t MQTT::runOnce()
         if (!wantConnection) {
             LOG_INFO("MQTT link not needed, drop");
             pubSub.disconnect();
+        } else {
+            publishQueuedMessages(); // Whatever is left from an outage, a batch at a time
         }
 
         powerFSM.trigger(EVENT_CONTACT_FROM_PHONE); // Suppress entering light sleep (because that would turn off bluetooth)
@@ -691,40 +702,114 @@ void MQTT::publishQueuedMessages()
     if (mqttQueue.isEmpty())
         return;
 
-    LOG_DEBUG("Publish enqueued MQTT message");
-    const std::unique_ptr<QueueEntry> entry(mqttQueue.dequeuePtr(0));
-    LOG_INFO("publish %s, %u bytes from queue", entry->topic.c_str(), entry->envBytes.size());
-    publish(entry->topic.c_str(), entry->envBytes.data(), entry->envBytes.size(), false);
+    // Each publish goes out from PubSubClient's buffer in one write, so a run costs no more than the packets it sends.  The
+    // time budget keeps a long backlog from holding up the rest of the firmware, what is left goes on the next run.
+    std::string nodeId = nodeDB->getNodeId();
+    uint32_t start = millis();
+    uint32_t failures = queueStats.publishFailures;
+    uint32_t published = drainMQTTQueue(
+        mqttQueue, queueStats, [&](const QueueEntry &entry) { return publishQueued(entry, nodeId); },
+        [this] { return moduleConfig.mqtt.proxy_to_client_enabled || isConnectedDirectly(); });
+
+    if (queueStats.publishFailures != failures)
+        LOG_WARN("MQTT broker won't take a queued packet after %d tries, drop it", MQTT_PUBLISH_MAX_ATTEMPTS);
+    if (published)
+        LOG_INFO("MQTT published %u queued packet(s) in %u ms, %d left", published, millis() - start, mqttQueue.numUsed());
+}
+
+void MQTT::perhapsLogQueueStats()
+{
+    if (queueStats.maxDepth == 0 || millis() - queueStatsLoggedAt < MQTT_QUEUE_STATS_LOG_MS)
+        return;
+    queueStatsLoggedAt = millis();
+
+    const MQTTQueueStats &stats = getQueueStats();
+    LOG_INFO("MQTT queue: %d waiting (max %u), %u published in %u drains (latency %u ms, max %u ms), %u failed, dropped "
+             "%u alert/%u message/%u background",
+             mqttQueue.numUsed(), stats.maxDepth, stats.published, stats.drains, stats.lastLatencyMs, stats.maxLatencyMs,
+             stats.publishFailures, stats.dropped[MQTT_QUEUE_ALERT], stats.dropped[MQTT_QUEUE_MESSAGE],
+             stats.dropped[MQTT_QUEUE_BACKGROUND]);
+}
+
+bool MQTT::publishQueued(const QueueEntry &entry, const std::string &nodeId)
+{
+    const meshtastic_ServiceEnvelope env = {.packet = const_cast<meshtastic_MeshPacket *>(entry.packet.get()),
+                                            .channel_id = const_cast<char *>(entry.channelId.c_str()),
+                                            .gateway_id = const_cast<char *>(nodeId.c_str())};
+    size_t numBytes = pb_encode_to_bytes(bytes, sizeof(bytes), &meshtastic_ServiceEnvelope_msg, &env);
+    std::string topic = cryptTopic + entry.channelId + "/" + nodeId;
+    LOG_DEBUG("publish %s, %u bytes from queue", topic.c_str(), numBytes);
+    if (!publish(topic.c_str(), bytes, numBytes, false))
+        return false;
 
 #if !defined(ARCH_NRF52) ||                                                                                                      \
     defined(NRF52_USE_JSON) // JSON is not supported on nRF52, see issue #2804 ### Fixed by using ArduinoJson ###
     if (!moduleConfig.mqtt.json_enabled)
-        return;
+        return true;
 
     // handle json topic
-    const DecodedServiceEnvelope env(entry->envBytes.data(), entry->envBytes.size());
-    if (!env.validDecode || env.packet == NULL || env.channel_id == NULL)
-        return;
-
-    auto jsonString = MeshPacketSerializer::JsonSerialize(env.packet);
-    if (jsonString.length() == 0)
-        return;
-
-    // Generate node ID from nodenum for topic
-    std::string nodeId = nodeDB->getNodeId();
+    size_t jsonLen = MeshPacketSerializer::JsonSerialize(entry.packet.get(), jsonBuf, sizeof(jsonBuf));
+    if (jsonLen == 0)
+        return true;
 
     std::string topicJson;
-    if (env.packet->pki_encrypted) {
+    if (entry.packet->pki_encrypted) {
         topicJson = jsonTopic + "PKI/" + nodeId;
     } else {
-        topicJson = jsonTopic + env.channel_id + "/" + nodeId;
+        topicJson = jsonTopic + entry.channelId + "/" + nodeId;
     }
-    LOG_INFO("JSON publish message to %s, %u bytes: %s", topicJson.c_str(), jsonString.length(), jsonString.c_str());
-    publish(topicJson.c_str(), jsonString.c_str(), false);
+    LOG_INFO("JSON publish message to %s, %u bytes: %s", topicJson.c_str(), jsonLen, jsonBuf);
+    publish(topicJson.c_str(), jsonBuf, false);
 #endif // ARCH_NRF52 NRF52_USE_JSON
+    return true;
+}
+
+const MQTTQueueStats &MQTT::getQueueStats()
+{
+    for (int i = 0; i < MQTT_QUEUE_LEVELS; i++)
+        queueStats.dropped[i] = mqttQueue.getDropped(i);
+    return queueStats;
+}
+
+/// How much it matters that a packet still reaches the broker after an outage
+static MQTTQueueLevel queueLevel(const meshtastic_MeshPacket &mp_decoded)
+{
+    if (mp_decoded.which_payload_variant != meshtastic_MeshPacket_decoded_tag)
+        return MQTT_QUEUE_MESSAGE; // A direct message we can't read
+    if (mp_decoded.priority == meshtastic_MeshPacket_Priority_ALERT)
+        return MQTT_QUEUE_ALERT;
+
+    switch (mp_decoded.decoded.portnum) {
+    case meshtastic_PortNum_ALERT_APP:
+    case meshtastic_PortNum_DETECTION_SENSOR_APP:
+        return MQTT_QUEUE_ALERT;
+    case meshtastic_PortNum_POSITION_APP:
+    case meshtastic_PortNum_NODEINFO_APP:
+    case meshtastic_PortNum_TELEMETRY_APP:
+    case meshtastic_PortNum_NEIGHBORINFO_APP:
+    case meshtastic_PortNum_PAXCOUNTER_APP:
+    case meshtastic_PortNum_MAP_REPORT_APP:
+    case meshtastic_PortNum_RANGE_TEST_APP:
+    case meshtastic_PortNum_TRACEROUTE_APP:
+        return MQTT_QUEUE_BACKGROUND;
+    default:
+        return mp_decoded.priority == meshtastic_MeshPacket_Priority_BACKGROUND ? MQTT_QUEUE_BACKGROUND : MQTT_QUEUE_MESSAGE;
+    }
 }
 
 void MQTT::onSend(const meshtastic_MeshPacket &mp_encrypted, const meshtastic_MeshPacket &mp_decoded, ChannelIndex chIndex)
+{
+    onSend(mp_encrypted, NULL, mp_decoded, chIndex);
+}
+
+void MQTT::onSend(const SharedPacket &mp_encrypted, const meshtastic_MeshPacket &mp_decoded, ChannelIndex chIndex)
+{
+    if (mp_encrypted)
+        onSend(*mp_encrypted, &mp_encrypted, mp_decoded, chIndex);
+}
+
+void MQTT::onSend(const meshtastic_MeshPacket &mp_encrypted, const SharedPacket *sharedEncrypted,
+                  const meshtastic_MeshPacket &mp_decoded, ChannelIndex chIndex)
 {
     if (mp_encrypted.via_mqtt)
         return; // Don't send messages that came from MQTT back into MQTT
@@ -775,16 +860,16 @@ void MQTT::onSend(const meshtastic_MeshPacket &mp_encrypted, const meshtastic_Me
         return; // Don't upload a still-encrypted PKI packet if not encryption_enabled
     }
 
-    // Generate node ID from nodenum for service envelope
-    std::string nodeId = nodeDB->getNodeId();
+    if (moduleConfig.mqtt.proxy_to_client_enabled || this->isConnectedDirectly()) {
+        // Generate node ID from nodenum for service envelope
+        std::string nodeId = nodeDB->getNodeId();
 
-    const meshtastic_ServiceEnvelope env = {.packet = const_cast<meshtastic_MeshPacket *>(p),
-                                            .channel_id = const_cast<char *>(channelId),
-                                            .gateway_id = const_cast<char *>(nodeId.c_str())};
-    size_t numBytes = pb_encode_to_bytes(bytes, sizeof(bytes), &meshtastic_ServiceEnvelope_msg, &env);
-    std::string topic = cryptTopic + channelId + "/" + nodeId;
+        const meshtastic_ServiceEnvelope env = {.packet = const_cast<meshtastic_MeshPacket *>(p),
+                                                .channel_id = const_cast<char *>(channelId),
+                                                .gateway_id = const_cast<char *>(nodeId.c_str())};
+        size_t numBytes = pb_encode_to_bytes(bytes, sizeof(bytes), &meshtastic_ServiceEnvelope_msg, &env);
+        std::string topic = cryptTopic + channelId + "/" + nodeId;
 
-    if (moduleConfig.mqtt.proxy_to_client_enabled || this->isConnectedDirectly()) {
         LOG_DEBUG("MQTT Publish %s, %u bytes", topic.c_str(), numBytes);
         publish(topic.c_str(), bytes, numBytes, false);
 
@@ -793,30 +878,24 @@ void MQTT::onSend(const meshtastic_MeshPacket &mp_encrypted, const meshtastic_Me
         if (!moduleConfig.mqtt.json_enabled)
             return;
         // handle json topic
-        auto jsonString = MeshPacketSerializer::JsonSerialize(&mp_decoded);
-        if (jsonString.length() == 0)
+        size_t jsonLen = MeshPacketSerializer::JsonSerialize(&mp_decoded, jsonBuf, sizeof(jsonBuf));
+        if (jsonLen == 0)
             return;
         // Generate node ID from nodenum for JSON topic
         std::string nodeIdForJson = nodeDB->getNodeId();
         std::string topicJson = jsonTopic + channelId + "/" + nodeIdForJson;
-        LOG_INFO("JSON publish message to %s, %u bytes: %s", topicJson.c_str(), jsonString.length(), jsonString.c_str());
-        publish(topicJson.c_str(), jsonString.c_str(), false);
+        LOG_INFO("JSON publish message to %s, %u bytes: %s", topicJson.c_str(), jsonLen, jsonBuf);
+        publish(topicJson.c_str(), jsonBuf, false);
 #endif // ARCH_NRF52 NRF52_USE_JSON
     } else {
         LOG_INFO("MQTT not connected, queue packet");
-        QueueEntry *entry;
-        if (mqttQueue.numFree() == 0) {
-            LOG_WARN("MQTT queue is full, discard oldest");
-            entry = mqttQueue.dequeuePtr(0);
-        } else {
-            entry = new QueueEntry;
-        }
-        entry->topic = std::move(topic);
-        entry->envBytes.assign(bytes, numBytes);
-        if (mqttQueue.enqueue(entry, 0) == false) {
-            LOG_CRIT("Failed to add a message to mqttQueue!");
-            abort();
-        }
+        // Share the router's copy of the encrypted packet if we were given one, only copy when we have to
+        SharedPacket queued = (sharedEncrypted && p == &mp_encrypted) ? *sharedEncrypted : SharedPacket::copyOf(*p);
+        if (!queued)
+            return;
+        if (!mqttQueue.push(queueLevel(mp_decoded), {std::move(queued), channelId, millis(), 0}))
+            LOG_WARN("MQTT queue is full, discard the oldest of the least important");
+        queueStats.maxDepth = std::max<uint32_t>(queueStats.maxDepth, mqttQueue.numUsed());
     }
 }
 
@@ -5,7 +5,10 @@
 
 #include "concurrency/OSThread.h"
 #include "mesh/Channels.h"
+#include "mesh/PriorityDropQueue.h"
+#include "mesh/SharedPacket.h"
 #include "mesh/generated/meshtastic/mqtt.pb.h"
+#include "mqtt/MQTTQueueDrain.h"
 #if !defined(ARCH_NRF52) || NRF52_USE_JSON
 #include "serialization/JSON.h"
 #endif
@@ -26,6 +29,14 @@
 
 #define MAX_MQTT_QUEUE 16
 
+// Packets the queue can hold on to, reserved in the static packet pool; a proxied connection never queues
+#if HAS_NETWORKING
+#define MQTT_HELD_PACKETS MAX_MQTT_QUEUE
+#endif
+
+// How often the queue counters are logged, if anything had to wait for the broker
+#define MQTT_QUEUE_STATS_LOG_MS (15 * 60 * 1000)
+
 /**
  * Our wrapper/singleton for sending/receiving MQTT "udp" packets.  This object isolates the MQTT protocol implementation from
  * the two components that use it: MQTTPlugin and MQTTSimInterface.
@@ -46,6 +57,9 @@ class MQTT : private concurrency::OSThread
      */
     void onSend(const meshtastic_MeshPacket &mp_encrypted, const meshtastic_MeshPacket &mp_decoded, ChannelIndex chIndex);
 
+    /// Same as above, but if the packet has to wait for the broker we keep a reference to mp_encrypted instead of a copy
+    void onSend(const SharedPacket &mp_encrypted, const meshtastic_MeshPacket &mp_decoded, ChannelIndex chIndex);
+
     bool isConnectedDirectly();
 
     bool publish(const char *topic, const char *payload, bool retained);
@@ -56,6 +70,10 @@ class MQTT : private concurrency::OSThread
 
     bool isEnabled() { return this->enabled; };
 
+    /// Packets waiting for the broker, and how the queue has fared
+    int getQueueDepth() const { return mqttQueue.numUsed(); }
+    const MQTTQueueStats &getQueueStats();
+
     void start() { setIntervalFromNow(0); };
 
     bool isUsingDefaultServer() { return isConfiguredForDefaultServer; }
@@ -65,11 +83,16 @@ class MQTT : private concurrency::OSThread
     static bool isValidConfig(const meshtastic_ModuleConfig_MQTTConfig &config) { return isValidConfig(config, nullptr); }
 
   protected:
+    /// A packet waiting for the broker, the ServiceEnvelope is only encoded when it is published
     struct QueueEntry {
-        std::string topic;
-        std::basic_string<uint8_t> envBytes; // binary/pb_encode_to_bytes ServiceEnvelope
+        SharedPacket packet;   // the packet to wrap (encrypted or decoded, chosen when it was queued)
+        std::string channelId; // short enough for the small string optimisation, so no heap allocation
+        uint32_t queuedAt;     // millis()
+        uint8_t attempts;      // publishes that failed while the broker was there
     };
-    PointerQueue<QueueEntry> mqttQueue;
+    PriorityDropQueue<QueueEntry, MQTT_QUEUE_LEVELS> mqttQueue;
+    MQTTQueueStats queueStats = {};
+    uint32_t queueStatsLoggedAt = 0;
 
     int reconnectCount = 0;
     bool isConfiguredForDefaultServer = true;
@@ -127,8 +150,18 @@ class MQTT : private concurrency::OSThread
     /// Called when a new publish arrives from the MQTT server
     void onReceive(char *topic, byte *payload, size_t length);
 
+    /// Publish from the queue until it is empty or MQTT_DRAIN_BUDGET_MS is used up
     void publishQueuedMessages();
 
+    /// Log the queue counters every MQTT_QUEUE_STATS_LOG_MS, once anything has been queued
+    void perhapsLogQueueStats();
+
+    /// Publish one queued packet, false if the broker did not take it
+    bool publishQueued(const QueueEntry &entry, const std::string &nodeId);
+
+    void onSend(const meshtastic_MeshPacket &mp_encrypted, const SharedPacket *sharedEncrypted,
+                const meshtastic_MeshPacket &mp_decoded, ChannelIndex chIndex);
+
     void publishNodeInfo();
 
     // Check if we should report unencrypted information about our node for consumption by a map
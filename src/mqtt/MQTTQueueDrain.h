@@ -0,0 +1,67 @@
+#pragma once
+
+#include "mesh/PriorityDropQueue.h"
+
+#include <Arduino.h>
+#include <algorithm>
+
+// What waits for the broker is kept by class, alerts first; past MAX_MQTT_QUEUE the oldest of the least important class
+// makes room.  Each class keeps at most its retention, telemetry and other background traffic only half the queue.
+enum MQTTQueueLevel { MQTT_QUEUE_ALERT, MQTT_QUEUE_MESSAGE, MQTT_QUEUE_BACKGROUND, MQTT_QUEUE_LEVELS };
+
+// How long one run may spend publishing from the queue before letting the rest of the firmware run
+#define MQTT_DRAIN_BUDGET_MS 50
+
+// Publishes of one queued packet that may fail while the broker is still there, after that it is dropped
+#define MQTT_PUBLISH_MAX_ATTEMPTS 3
+
+/// Counters for what waited for the broker, since boot
+struct MQTTQueueStats {
+    uint32_t published;                  // queued packets that made it to the broker
+    uint32_t publishFailures;            // queued packets dropped after MQTT_PUBLISH_MAX_ATTEMPTS failed publishes
+    uint32_t dropped[MQTT_QUEUE_LEVELS]; // packets discarded to make room, per MQTTQueueLevel
+    uint32_t lastLatencyMs;              // from being queued to being published
+    uint32_t maxLatencyMs;
+    uint32_t drains;                     // runs that published from the queue
+    uint32_t maxDepth;                   // most packets waiting at once
+};
+
+/**
+ * Publish from the front of queue until it is empty or MQTT_DRAIN_BUDGET_MS is used up, counting in stats.
+ *
+ * If a publish fails and linkUp() says the broker is gone, everything stays queued for when it is back.  If the broker is
+ * still there it is that packet it won't take, so after MQTT_PUBLISH_MAX_ATTEMPTS it is dropped rather than hold up the
+ * ones behind it for good.
+ *
+ * @param publish bool(T &), sends an entry; T has the uint32_t queuedAt (millis) and uint8_t attempts of a queue entry
+ * @param linkUp bool(), whether publishing is possible at all
+ * @return the number of entries published
+ */
+template <class T, int levels, class Publish, class LinkUp>
+uint32_t drainMQTTQueue(PriorityDropQueue<T, levels> &queue, MQTTQueueStats &stats, Publish publish, LinkUp linkUp)
+{
+    uint32_t start = millis();
+    uint32_t published = 0;
+    while (!queue.isEmpty()) {
+        T &entry = queue.front();
+        if (publish(entry)) {
+            stats.lastLatencyMs = millis() - entry.queuedAt;
+            stats.maxLatencyMs = std::max(stats.maxLatencyMs, stats.lastLatencyMs);
+            queue.pop();
+            published++;
+        } else if (!linkUp() || ++entry.attempts < MQTT_PUBLISH_MAX_ATTEMPTS) {
+            break; // Keep it for the next run
+        } else {
+            queue.pop();
+            stats.publishFailures++;
+        }
+        if (millis() - start >= MQTT_DRAIN_BUDGET_MS)
+            break;
+    }
+
+    if (published) {
+        stats.published += published;
+        stats.drains++;
+    }
+    return published;
+}
@@ -6,12 +6,31 @@
 class ESP32CryptoEngine : public CryptoEngine
 {
 
-    mbedtls_aes_context aes;
+    // One expanded key schedule per cache slot, see CryptoEngine::lookupKeySlot()
+    mbedtls_aes_context aes[CRYPTO_KEY_CACHE_SLOTS];
 
   public:
-    ESP32CryptoEngine() { mbedtls_aes_init(&aes); }
+    ESP32CryptoEngine()
+    {
+        for (auto &ctx : aes)
+            mbedtls_aes_init(&ctx);
+    }
 
-    ~ESP32CryptoEngine() { mbedtls_aes_free(&aes); }
+    ~ESP32CryptoEngine()
+    {
+        for (auto &ctx : aes)
+            mbedtls_aes_free(&ctx);
+    }
+
+    virtual void invalidateKeyCache() override
+    {
+        CryptoEngine::invalidateKeyCache();
+        KeyMaterialLock guard;
+        for (auto &ctx : aes) {
+            mbedtls_aes_free(&ctx); // zeroizes the round keys
+            mbedtls_aes_init(&ctx);
+        }
+    }
 
     /**
      * Encrypt a packet
@@ -19,18 +38,24 @@ class ESP32CryptoEngine : public CryptoEngine
      * @param bytes is updated in place
      *  TODO: return bool, and handle graciously when something fails
      */
-    virtual void encryptAESCtr(CryptoKey _key, uint8_t *_nonce, size_t numBytes, uint8_t *bytes) override
+    virtual void encryptAESCtr(const CryptoKey &_key, uint8_t _keySlot, uint8_t *_nonce, size_t numBytes,
+                               uint8_t *bytes) override
     {
         if (_key.length > 0) {
             if (numBytes <= MAX_BLOCKSIZE) {
-                mbedtls_aes_setkey_enc(&aes, _key.bytes, _key.length * 8);
-                static uint8_t scratch[MAX_BLOCKSIZE];
+                uint8_t scratch[MAX_BLOCKSIZE]; // per call, several threads may be in here
                 uint8_t stream_block[16];
                 size_t nc_off = 0;
                 memcpy(scratch, bytes, numBytes);
                 memset(scratch + numBytes, 0,
                        sizeof(scratch) - numBytes); // Fill rest of buffer with zero (in case cypher looks at it)
-                mbedtls_aes_crypt_ctr(&aes, numBytes, &nc_off, _nonce, stream_block, scratch, bytes);
+
+                KeyMaterialLock guard;
+                bool needExpand;
+                mbedtls_aes_context *ctx = &aes[lookupKeySlot(_key, _keySlot, needExpand)];
+                if (needExpand)
+                    mbedtls_aes_setkey_enc(ctx, _key.bytes, _key.length * 8);
+                mbedtls_aes_crypt_ctr(ctx, numBytes, &nc_off, _nonce, stream_block, scratch, bytes);
             } else {
                 LOG_ERROR("Packet too large for crypto engine: %d. noop encryption!", numBytes);
             }
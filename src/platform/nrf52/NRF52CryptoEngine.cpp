@@ -4,17 +4,33 @@
 #include <Adafruit_nRFCrypto.h>
 class NRF52CryptoEngine : public CryptoEngine
 {
+    // Expanded AES256 key schedules, one per cache slot.  AES128 goes through the CryptoCell which takes the raw key.
+    AES_ctx aes256[CRYPTO_KEY_CACHE_SLOTS];
+
   public:
     NRF52CryptoEngine() {}
 
     ~NRF52CryptoEngine() {}
 
-    virtual void encryptAESCtr(CryptoKey _key, uint8_t *_nonce, size_t numBytes, uint8_t *bytes) override
+    virtual void invalidateKeyCache() override
+    {
+        CryptoEngine::invalidateKeyCache();
+        KeyMaterialLock guard;
+        memset(aes256, 0, sizeof(aes256));
+    }
+
+    virtual void encryptAESCtr(const CryptoKey &_key, uint8_t _keySlot, uint8_t *_nonce, size_t numBytes,
+                               uint8_t *bytes) override
     {
+        // The cached schedules and the CryptoCell are both shared
+        KeyMaterialLock guard;
         if (_key.length > 16) {
-            AES_ctx ctx;
-            AES_init_ctx_iv(&ctx, _key.bytes, _nonce);
-            AES_CTR_xcrypt_buffer(&ctx, bytes, numBytes);
+            bool needExpand;
+            AES_ctx *ctx = &aes256[lookupKeySlot(_key, _keySlot, needExpand)];
+            if (needExpand)
+                AES_init_ctx(ctx, _key.bytes);
+            AES_ctx_set_iv(ctx, _nonce);
+            AES_CTR_xcrypt_buffer(ctx, bytes, numBytes);
         } else if (_key.length > 0) {
             nRFCrypto.begin();
             nRFCrypto_AES ctx;
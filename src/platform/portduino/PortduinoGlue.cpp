@@ -485,6 +485,8 @@ bool loadConfig(const char *configPath)
                     }
                 }
             }
+            if (yamlConfig["Lora"]["SimLossPercent"])
+                portduino_config.sim_loss_percent = yamlConfig["Lora"]["SimLossPercent"].as<int>(0);
             if (yamlConfig["Lora"]["SX126X_MAX_POWER"])
                 portduino_config.sx126x_max_power = yamlConfig["Lora"]["SX126X_MAX_POWER"].as<int>(22);
             if (yamlConfig["Lora"]["SX128X_MAX_POWER"])
@@ -71,6 +71,7 @@ extern struct portduino_config_struct {
     uint32_t rfswitch_dio_pins[5] = {RADIOLIB_NC, RADIOLIB_NC, RADIOLIB_NC, RADIOLIB_NC, RADIOLIB_NC};
     Module::RfSwitchMode_t rfswitch_table[8];
     bool force_simradio = false;
+    int sim_loss_percent = 0; // SimRadio drops this share of received packets, to exercise retries
     bool has_device_id = false;
     uint8_t device_id[16] = {0};
     std::string lora_spi_dev = "";
@@ -212,6 +213,8 @@ extern struct portduino_config_struct {
             }
         }
 
+        if (sim_loss_percent != 0)
+            out << YAML::Key << "SimLossPercent" << YAML::Value << sim_loss_percent;
         if (sx126x_max_power != 22)
             out << YAML::Key << "SX126X_MAX_POWER" << YAML::Value << sx126x_max_power;
         if (sx128x_max_power != 13)
@@ -1,10 +1,12 @@
 #include "SimRadio.h"
 #include "MeshService.h"
+#include "PortduinoGlue.h"
 #include "Router.h"
 
 SimRadio::SimRadio() : NotifiedWorkerThread("SimRadio")
 {
     instance = this;
+    rxLossPercent = portduino_config.sim_loss_percent;
 }
 
 SimRadio *SimRadio::instance;
@@ -253,6 +255,11 @@ void SimRadio::unpackAndReceive(meshtastic_MeshPacket &p)
 
 void SimRadio::startReceive(meshtastic_MeshPacket *p)
 {
+    if (rxLossPercent && random(100) < rxLossPercent) {
+        rxLost++;
+        LOG_DEBUG("Simulated loss, drop packet 0x%08x", p->id);
+        return;
+    }
 #ifdef USERPREFS_SIMRADIO_EMULATE_COLLISIONS
     if (isActivelyReceiving()) {
         LOG_WARN("Collision detected, dropping current and previous packet!");
@@ -54,6 +54,12 @@ class SimRadio : public RadioInterface, protected concurrency::NotifiedWorkerThr
     uint32_t rxBad = 0, rxGood = 0, txGood = 0, txRelay = 0;
     uint16_t txDrop = 0;
 
+    /**
+     * Loss injection: percentage of received packets dropped as if they never decoded (Lora.SimLossPercent in config.yaml)
+     */
+    uint8_t rxLossPercent = 0;
+    uint32_t rxLost = 0;
+
   protected:
     /// are _trying_ to receive a packet currently (note - we might just be waiting for one)
     bool isReceiving = true;
@@ -0,0 +1,455 @@
+#include "JsonWriter.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+// Length of the valid UTF-8 sequence at s, 0 if there is none
+static size_t utf8SequenceLength(const uint8_t *s, size_t len)
+{
+    size_t n;
+    uint32_t min;
+    if (s[0] < 0x80)
+        return 1;
+    else if ((s[0] & 0xE0) == 0xC0)
+        n = 2, min = 0x80;
+    else if ((s[0] & 0xF0) == 0xE0)
+        n = 3, min = 0x800;
+    else if ((s[0] & 0xF8) == 0xF0)
+        n = 4, min = 0x10000;
+    else
+        return 0;
+    if (n > len)
+        return 0;
+
+    uint32_t cp = s[0] & (0x7F >> n);
+    for (size_t i = 1; i < n; i++) {
+        if ((s[i] & 0xC0) != 0x80)
+            return 0;
+        cp = (cp << 6) | (s[i] & 0x3F);
+    }
+    // Overlong forms, UTF-16 surrogates and past U+10FFFF are not valid either
+    if (cp < min || (cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+        return 0;
+    return n;
+}
+
+// Escape text into out until either runs out, whole characters only; consumed is how much of text made it
+static size_t escapeInto(char *out, size_t outMax, const uint8_t *text, size_t len, size_t &consumed)
+{
+    size_t n = 0, i = 0;
+
+    while (i < len) {
+        uint8_t c = text[i];
+        if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') {
+            // Plain ASCII is nearly all of it, no need to go through a piece
+            if (n == outMax)
+                break;
+            out[n++] = (char)c;
+            i++;
+            continue;
+        }
+
+        char esc[6];
+        const char *piece = esc;
+        size_t pieceLen, used = 1;
+        if (c == '"' || c == '\\') {
+            esc[0] = '\\';
+            esc[1] = (char)c;
+            pieceLen = 2;
+        } else if (c < 0x20) {
+            memcpy(esc, "\\u00", 4);
+            esc[4] = hexDigits[c >> 4] | 0x20; // lower case, as JSON.stringify() has it
+            esc[5] = hexDigits[c & 0xF] | 0x20;
+            pieceLen = 6;
+        } else if ((used = utf8SequenceLength(text + i, len - i)) != 0) {
+            piece = (const char *)text + i;
+            pieceLen = used;
+        } else {
+            piece = "\xEF\xBF\xBD"; // U+FFFD
+            pieceLen = 3;
+            used = 1;
+        }
+
+        if (n + pieceLen > outMax)
+            break;
+        memcpy(out + n, piece, pieceLen);
+        n += pieceLen;
+        i += used;
+    }
+    consumed = i;
+    return n;
+}
+
+JsonWriter::JsonWriter(char *buf, size_t size, Sink sink, void *context) : buf(buf), size(size), sink(sink), context(context)
+{
+    if (size > 0)
+        buf[0] = 0;
+}
+
+void JsonWriter::put(const char *data, size_t n)
+{
+    if (overflow)
+        return;
+    if (!fits(n) && sink)
+        flush();
+    if (!fits(n)) {
+        if (sink)
+            sink(context, data, n); // longer than the whole buffer, a raw payload
+        else
+            overflow = true;
+        return;
+    }
+    memcpy(buf + len, data, n);
+    len += n;
+    buf[len] = 0;
+}
+
+void JsonWriter::flush()
+{
+    if (sink && len > 0) {
+        sink(context, buf, len);
+        len = 0;
+        buf[0] = 0;
+    }
+}
+
+void JsonWriter::separate()
+{
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    if (depth == 0)
+        return;
+    uint32_t bit = 1UL << (depth - 1);
+    if (nonEmpty & bit)
+        put(',');
+    nonEmpty |= bit;
+}
+
+void JsonWriter::open(char c)
+{
+    separate();
+    if (depth == JSON_WRITER_MAX_DEPTH) {
+        overflow = true;
+        return;
+    }
+    put(c);
+    nonEmpty &= ~(1UL << depth);
+    depth++;
+}
+
+void JsonWriter::close(char c)
+{
+    if (depth > 0)
+        depth--;
+    put(c);
+}
+
+JsonWriter &JsonWriter::beginObject()
+{
+    open('{');
+    return *this;
+}
+
+JsonWriter &JsonWriter::endObject()
+{
+    close('}');
+    return *this;
+}
+
+JsonWriter &JsonWriter::beginArray()
+{
+    open('[');
+    return *this;
+}
+
+JsonWriter &JsonWriter::endArray()
+{
+    close(']');
+    return *this;
+}
+
+JsonWriter &JsonWriter::key(const char *name)
+{
+    string(name);
+    put(':');
+    afterKey = true;
+    return *this;
+}
+
+JsonWriter &JsonWriter::string(const char *s)
+{
+    return string((const uint8_t *)s, strlen(s));
+}
+
+JsonWriter &JsonWriter::string(const uint8_t *s, size_t n, size_t keep)
+{
+    separate();
+    put('"');
+
+    size_t i = 0;
+    while (!overflow) {
+        // Room left for characters, the closing quote and keep come after them when the buffer is all there is
+        size_t room = size - 1 - len;
+        if (!sink)
+            room = room > keep + 1 ? room - keep - 1 : 0;
+        size_t used;
+        len += escapeInto(buf + len, room, s + i, n - i, used);
+        buf[len] = 0;
+        i += used;
+        if (i == n)
+            break;
+        if (!sink) {
+            overflow = keep == 0; // asked for a cut, or it just did not fit
+            break;
+        }
+        flush();
+    }
+
+    put('"');
+    return *this;
+}
+
+JsonWriter &JsonWriter::stringf(const char *format, ...)
+{
+    char text[64];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (n < 0)
+        n = 0;
+    return string((const uint8_t *)text, (size_t)n < sizeof(text) ? n : sizeof(text) - 1);
+}
+
+JsonWriter &JsonWriter::hex(const uint8_t *bytes, size_t n)
+{
+    separate();
+    put('"');
+    for (size_t i = 0; i < n; i++) {
+        char pair[2] = {hexDigits[bytes[i] >> 4], hexDigits[bytes[i] & 0xF]};
+        put(pair, 2);
+    }
+    put('"');
+    return *this;
+}
+
+JsonWriter &JsonWriter::integer(int64_t v)
+{
+    char digits[20];
+    char *p = digits + sizeof(digits);
+    uint64_t u = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+
+    // 64-bit division is a library call on the targets, and nearly every value fits in 32 bits
+    if (u <= UINT32_MAX) {
+        uint32_t w = (uint32_t)u;
+        do {
+            *--p = '0' + w % 10;
+            w /= 10;
+        } while (w);
+    } else {
+        do {
+            *--p = '0' + u % 10;
+            u /= 10;
+        } while (u);
+    }
+    if (v < 0)
+        *--p = '-';
+
+    separate();
+    put(p, digits + sizeof(digits) - p);
+    return *this;
+}
+
+JsonWriter &JsonWriter::number(double v, int precision)
+{
+    if (isnan(v) || isinf(v))
+        return null();
+
+    char text[32];
+    int n = snprintf(text, sizeof(text), "%.*g", precision, v);
+    separate();
+    put(text, n);
+    return *this;
+}
+
+JsonWriter &JsonWriter::boolean(bool v)
+{
+    separate();
+    if (v)
+        put("true", 4);
+    else
+        put("false", 5);
+    return *this;
+}
+
+JsonWriter &JsonWriter::null()
+{
+    separate();
+    put("null", 4);
+    return *this;
+}
+
+JsonWriter &JsonWriter::raw(const char *json, size_t n)
+{
+    separate();
+    put(json, n);
+    return *this;
+}
+
+size_t JsonWriter::escape(char *out, size_t outMax, const uint8_t *text, size_t len)
+{
+    size_t consumed;
+    return escapeInto(out, outMax, text, len, consumed);
+}
+
+// ============================================================================
+// Validation, a recursive descent over RFC 8259 that keeps nothing
+// ============================================================================
+
+static void skipWhitespace(const char *&p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+        p++;
+}
+
+static bool skipDigits(const char *&p, const char *end)
+{
+    const char *start = p;
+    while (p < end && *p >= '0' && *p <= '9')
+        p++;
+    return p > start;
+}
+
+static bool skipNumber(const char *&p, const char *end)
+{
+    if (p < end && *p == '-')
+        p++;
+    if (p < end && *p == '0')
+        p++;
+    else if (!skipDigits(p, end))
+        return false;
+    if (p < end && *p == '.') {
+        p++;
+        if (!skipDigits(p, end))
+            return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < end && (*p == '+' || *p == '-'))
+            p++;
+        if (!skipDigits(p, end))
+            return false;
+    }
+    return true;
+}
+
+static bool skipLiteral(const char *&p, const char *end, const char *word)
+{
+    size_t n = strlen(word);
+    if ((size_t)(end - p) < n || memcmp(p, word, n) != 0)
+        return false;
+    p += n;
+    return true;
+}
+
+static bool skipString(const char *&p, const char *end)
+{
+    p++; // opening quote
+    while (p < end) {
+        uint8_t c = *p;
+        if (c == '"') {
+            p++;
+            return true;
+        } else if (c < 0x20) {
+            return false;
+        } else if (c == '\\') {
+            if (++p == end)
+                return false;
+            if (*p == 'u') {
+                for (int i = 0; i < 4; i++) {
+                    if (++p == end || !strchr("0123456789abcdefABCDEF", *p) || *p == 0)
+                        return false;
+                }
+            } else if (*p == 0 || !strchr("\"\\/bfnrt", *p)) {
+                return false;
+            }
+            p++;
+        } else if (c >= 0x80) {
+            size_t n = utf8SequenceLength((const uint8_t *)p, end - p);
+            if (n == 0)
+                return false;
+            p += n;
+        } else {
+            p++;
+        }
+    }
+    return false;
+}
+
+static bool skipValue(const char *&p, const char *end, int depth)
+{
+    skipWhitespace(p, end);
+    if (p == end)
+        return false;
+
+    switch (*p) {
+    case '{':
+    case '[': {
+        char close = *p == '{' ? '}' : ']';
+        if (depth == 0)
+            return false;
+        p++;
+        skipWhitespace(p, end);
+        if (p < end && *p == close) {
+            p++;
+            return true;
+        }
+        while (true) {
+            if (close == '}') {
+                skipWhitespace(p, end);
+                if (p == end || *p != '"' || !skipString(p, end))
+                    return false;
+                skipWhitespace(p, end);
+                if (p == end || *p++ != ':')
+                    return false;
+            }
+            if (!skipValue(p, end, depth - 1))
+                return false;
+            skipWhitespace(p, end);
+            if (p == end)
+                return false;
+            if (*p == close) {
+                p++;
+                return true;
+            }
+            if (*p++ != ',')
+                return false;
+        }
+    }
+    case '"':
+        return skipString(p, end);
+    case 't':
+        return skipLiteral(p, end, "true");
+    case 'f':
+        return skipLiteral(p, end, "false");
+    case 'n':
+        return skipLiteral(p, end, "null");
+    default:
+        return skipNumber(p, end);
+    }
+}
+
+bool JsonWriter::isValid(const char *json, size_t len)
+{
+    const char *p = json, *end = json + len;
+    if (!skipValue(p, end, JSON_WRITER_MAX_DEPTH))
+        return false;
+    skipWhitespace(p, end);
+    return p == end;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Deepest nesting a JsonWriter tracks
+#define JSON_WRITER_MAX_DEPTH 32
+
+/**
+ * Streaming JSON writer: values are escaped straight into a caller-provided buffer as they are written, with no tree
+ * of heap-allocated values in between.  Commas and colons are placed by the writer, a member is key() then its value.
+ *
+ * Without a sink the buffer bounds the document.  Anything that does not fit sets overflowed() and is dropped, and the
+ * output should then not be sent.  With a sink, each full buffer is handed to it and the document can be any length,
+ * flush() passes on the rest at the end.
+ */
+class JsonWriter
+{
+  public:
+    typedef void (*Sink)(void *context, const char *data, size_t len);
+
+    /// buf is kept NUL terminated, so size must leave a byte for that; with a sink at least 8 bytes
+    JsonWriter(char *buf, size_t size, Sink sink = NULL, void *context = NULL);
+
+    JsonWriter &beginObject();
+    JsonWriter &endObject();
+    JsonWriter &beginArray();
+    JsonWriter &endArray();
+
+    /// Member name, the next call writes its value
+    JsonWriter &key(const char *name);
+
+    JsonWriter &string(const char *s);
+
+    /**
+     * Text from the mesh: quotes, backslashes and control characters escaped, invalid UTF-8 replaced by U+FFFD.
+     * Given keep and no sink, text that does not fit is cut at a character boundary so that keep more bytes still fit
+     * after the closing quote, rather than overflowing.
+     */
+    JsonWriter &string(const uint8_t *s, size_t len, size_t keep = 0);
+
+    /// A string value from printf-style formatting, up to 63 bytes
+    JsonWriter &stringf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    /// Bytes as a string of upper case hex digits
+    JsonWriter &hex(const uint8_t *bytes, size_t len);
+
+    JsonWriter &integer(int64_t v);
+
+    /// precision is in significant digits; inf and nan, which JSON cannot represent, are written as null
+    JsonWriter &number(double v, int precision = 7);
+
+    JsonWriter &boolean(bool v);
+    JsonWriter &null();
+
+    /// Already encoded JSON, such as a payload checked with isValid()
+    JsonWriter &raw(const char *json, size_t len);
+
+    /// Hand what is buffered to the sink, if there is one
+    void flush();
+
+    const char *c_str() const { return buf; }
+
+    /// Bytes in the buffer, the whole document when there is no sink
+    size_t length() const { return len; }
+
+    bool overflowed() const { return overflow; }
+
+    /**
+     * Escape text as the inside of a JSON string (see string()), stopping at a character boundary when out is full.
+     * @return bytes written, out is not NUL terminated
+     */
+    static size_t escape(char *out, size_t outMax, const uint8_t *text, size_t len);
+
+    /// Whether json is exactly one JSON value, with valid UTF-8 in its strings and nothing after it but whitespace
+    static bool isValid(const char *json, size_t len);
+
+  private:
+    char *buf;
+    size_t size;
+    size_t len = 0;
+    Sink sink;
+    void *context;
+
+    bool overflow = false;
+    bool afterKey = false;
+    uint8_t depth = 0;
+    uint32_t nonEmpty = 0; // a bit per open object or array that already has a member
+
+    void separate();
+    void open(char c);
+    void close(char c);
+    void put(const char *data, size_t n);
+    void put(char c) { put(&c, 1); }
+    bool fits(size_t n) const { return len + n < size; }
+};
@@ -1,6 +1,6 @@
 #ifndef NRF52_USE_JSON
 #include "MeshPacketSerializer.h"
-#include "JSON.h"
+#include "JsonWriter.h"
 #include "NodeDB.h"
 #include "mesh/generated/meshtastic/mqtt.pb.h"
 #include "mesh/generated/meshtastic/telemetry.pb.h"
@@ -11,19 +11,24 @@
 #include "../mesh/generated/meshtastic/paxcount.pb.h"
 #endif
 #include "mesh/generated/meshtastic/remote_hardware.pb.h"
+#include <string.h>
 #include <sys/types.h>
 
 static const char *errStr = "Error decoding proto for %s message!";
 
-std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp, bool shouldLog)
+// Appends to a std::string, for the std::string flavours of the API
+static void appendToString(void *context, const char *data, size_t len)
 {
-    // the created jsonObj is immutable after creation, so
-    // we need to do the heavy lifting before assembling it.
-    std::string msgType;
-    JSONObject jsonObj;
+    static_cast<std::string *>(context)->append(data, len);
+}
+
+// Write the whole packet object, the payload first: what it is only comes out of decoding it
+static void writePacket(JsonWriter &w, const meshtastic_MeshPacket *mp, bool shouldLog)
+{
+    const char *msgType = "";
+    w.beginObject();
 
     if (mp->which_payload_variant == meshtastic_MeshPacket_decoded_tag) {
-        JSONObject msgPayload;
         switch (mp->decoded.portnum) {
         case meshtastic_PortNum_TEXT_MESSAGE_APP: {
             msgType = "text";
@@ -31,25 +36,25 @@ std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp,
             if (shouldLog)
                 LOG_DEBUG("got text message of size %u", mp->decoded.payload.size);
 
-            char payloadStr[(mp->decoded.payload.size) + 1];
-            memcpy(payloadStr, mp->decoded.payload.bytes, mp->decoded.payload.size);
-            payloadStr[mp->decoded.payload.size] = 0; // null terminated string
+            // the text ends at the first NUL, if there is one
+            const char *payloadStr = (const char *)mp->decoded.payload.bytes;
+            size_t payloadLen = strnlen(payloadStr, mp->decoded.payload.size);
             // check if this is a JSON payload
-            JSONValue *json_value = JSON::Parse(payloadStr);
-            if (json_value != NULL) {
+            if (JsonWriter::isValid(payloadStr, payloadLen)) {
                 if (shouldLog)
                     LOG_INFO("text message payload is of type json");
 
-                // if it is, then we can just use the json object
-                jsonObj["payload"] = json_value;
+                // if it is, then it goes in as it is
+                w.key("payload").raw(payloadStr, payloadLen);
             } else {
                 // if it isn't, then we need to create a json object
                 // with the string as the value
                 if (shouldLog)
                     LOG_INFO("text message payload is of type plaintext");
 
-                msgPayload["text"] = new JSONValue(payloadStr);
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                w.key("payload").beginObject();
+                w.key("text").string((const uint8_t *)payloadStr, payloadLen);
+                w.endObject();
             }
             break;
         }
@@ -60,130 +65,127 @@ std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp,
             memset(&scratch, 0, sizeof(scratch));
             if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Telemetry_msg, &scratch)) {
                 decoded = &scratch;
+                w.key("payload").beginObject();
                 if (decoded->which_variant == meshtastic_Telemetry_device_metrics_tag) {
                     // If battery is present, encode the battery level value
                     // TODO - Add a condition to send a code for a non-present value
                     if (decoded->variant.device_metrics.has_battery_level) {
-                        msgPayload["battery_level"] = new JSONValue((int)decoded->variant.device_metrics.battery_level);
+                        w.key("battery_level").integer(decoded->variant.device_metrics.battery_level);
                     }
-                    msgPayload["voltage"] = new JSONValue(decoded->variant.device_metrics.voltage);
-                    msgPayload["channel_utilization"] = new JSONValue(decoded->variant.device_metrics.channel_utilization);
-                    msgPayload["air_util_tx"] = new JSONValue(decoded->variant.device_metrics.air_util_tx);
-                    msgPayload["uptime_seconds"] = new JSONValue((unsigned int)decoded->variant.device_metrics.uptime_seconds);
+                    w.key("voltage").number(decoded->variant.device_metrics.voltage);
+                    w.key("channel_utilization").number(decoded->variant.device_metrics.channel_utilization);
+                    w.key("air_util_tx").number(decoded->variant.device_metrics.air_util_tx);
+                    w.key("uptime_seconds").integer(decoded->variant.device_metrics.uptime_seconds);
                 } else if (decoded->which_variant == meshtastic_Telemetry_environment_metrics_tag) {
                     // Avoid sending 0s for sensors that could be 0
                     if (decoded->variant.environment_metrics.has_temperature) {
-                        msgPayload["temperature"] = new JSONValue(decoded->variant.environment_metrics.temperature);
+                        w.key("temperature").number(decoded->variant.environment_metrics.temperature);
                     }
                     if (decoded->variant.environment_metrics.has_relative_humidity) {
-                        msgPayload["relative_humidity"] = new JSONValue(decoded->variant.environment_metrics.relative_humidity);
+                        w.key("relative_humidity").number(decoded->variant.environment_metrics.relative_humidity);
                     }
                     if (decoded->variant.environment_metrics.has_barometric_pressure) {
-                        msgPayload["barometric_pressure"] =
-                            new JSONValue(decoded->variant.environment_metrics.barometric_pressure);
+                        w.key("barometric_pressure").number(decoded->variant.environment_metrics.barometric_pressure);
                     }
                     if (decoded->variant.environment_metrics.has_gas_resistance) {
-                        msgPayload["gas_resistance"] = new JSONValue(decoded->variant.environment_metrics.gas_resistance);
+                        w.key("gas_resistance").number(decoded->variant.environment_metrics.gas_resistance);
                     }
                     if (decoded->variant.environment_metrics.has_voltage) {
-                        msgPayload["voltage"] = new JSONValue(decoded->variant.environment_metrics.voltage);
+                        w.key("voltage").number(decoded->variant.environment_metrics.voltage);
                     }
                     if (decoded->variant.environment_metrics.has_current) {
-                        msgPayload["current"] = new JSONValue(decoded->variant.environment_metrics.current);
+                        w.key("current").number(decoded->variant.environment_metrics.current);
                     }
                     if (decoded->variant.environment_metrics.has_lux) {
-                        msgPayload["lux"] = new JSONValue(decoded->variant.environment_metrics.lux);
+                        w.key("lux").number(decoded->variant.environment_metrics.lux);
                     }
                     if (decoded->variant.environment_metrics.has_white_lux) {
-                        msgPayload["white_lux"] = new JSONValue(decoded->variant.environment_metrics.white_lux);
+                        w.key("white_lux").number(decoded->variant.environment_metrics.white_lux);
                     }
                     if (decoded->variant.environment_metrics.has_iaq) {
-                        msgPayload["iaq"] = new JSONValue((uint)decoded->variant.environment_metrics.iaq);
+                        w.key("iaq").integer(decoded->variant.environment_metrics.iaq);
                     }
                     if (decoded->variant.environment_metrics.has_distance) {
-                        msgPayload["distance"] = new JSONValue(decoded->variant.environment_metrics.distance);
+                        w.key("distance").number(decoded->variant.environment_metrics.distance);
                     }
                     if (decoded->variant.environment_metrics.has_wind_speed) {
-                        msgPayload["wind_speed"] = new JSONValue(decoded->variant.environment_metrics.wind_speed);
+                        w.key("wind_speed").number(decoded->variant.environment_metrics.wind_speed);
                     }
                     if (decoded->variant.environment_metrics.has_wind_direction) {
-                        msgPayload["wind_direction"] = new JSONValue((uint)decoded->variant.environment_metrics.wind_direction);
+                        w.key("wind_direction").integer(decoded->variant.environment_metrics.wind_direction);
                     }
                     if (decoded->variant.environment_metrics.has_wind_gust) {
-                        msgPayload["wind_gust"] = new JSONValue(decoded->variant.environment_metrics.wind_gust);
+                        w.key("wind_gust").number(decoded->variant.environment_metrics.wind_gust);
                     }
                     if (decoded->variant.environment_metrics.has_wind_lull) {
-                        msgPayload["wind_lull"] = new JSONValue(decoded->variant.environment_metrics.wind_lull);
+                        w.key("wind_lull").number(decoded->variant.environment_metrics.wind_lull);
                     }
                     if (decoded->variant.environment_metrics.has_radiation) {
-                        msgPayload["radiation"] = new JSONValue(decoded->variant.environment_metrics.radiation);
+                        w.key("radiation").number(decoded->variant.environment_metrics.radiation);
                     }
                     if (decoded->variant.environment_metrics.has_ir_lux) {
-                        msgPayload["ir_lux"] = new JSONValue(decoded->variant.environment_metrics.ir_lux);
+                        w.key("ir_lux").number(decoded->variant.environment_metrics.ir_lux);
                     }
                     if (decoded->variant.environment_metrics.has_uv_lux) {
-                        msgPayload["uv_lux"] = new JSONValue(decoded->variant.environment_metrics.uv_lux);
+                        w.key("uv_lux").number(decoded->variant.environment_metrics.uv_lux);
                     }
                     if (decoded->variant.environment_metrics.has_weight) {
-                        msgPayload["weight"] = new JSONValue(decoded->variant.environment_metrics.weight);
+                        w.key("weight").number(decoded->variant.environment_metrics.weight);
                     }
                     if (decoded->variant.environment_metrics.has_rainfall_1h) {
-                        msgPayload["rainfall_1h"] = new JSONValue(decoded->variant.environment_metrics.rainfall_1h);
+                        w.key("rainfall_1h").number(decoded->variant.environment_metrics.rainfall_1h);
                     }
                     if (decoded->variant.environment_metrics.has_rainfall_24h) {
-                        msgPayload["rainfall_24h"] = new JSONValue(decoded->variant.environment_metrics.rainfall_24h);
+                        w.key("rainfall_24h").number(decoded->variant.environment_metrics.rainfall_24h);
                     }
                     if (decoded->variant.environment_metrics.has_soil_moisture) {
-                        msgPayload["soil_moisture"] = new JSONValue((uint)decoded->variant.environment_metrics.soil_moisture);
+                        w.key("soil_moisture").integer(decoded->variant.environment_metrics.soil_moisture);
                     }
                     if (decoded->variant.environment_metrics.has_soil_temperature) {
-                        msgPayload["soil_temperature"] = new JSONValue(decoded->variant.environment_metrics.soil_temperature);
+                        w.key("soil_temperature").number(decoded->variant.environment_metrics.soil_temperature);
                     }
                 } else if (decoded->which_variant == meshtastic_Telemetry_air_quality_metrics_tag) {
                     if (decoded->variant.air_quality_metrics.has_pm10_standard) {
-                        msgPayload["pm10"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm10_standard);
+                        w.key("pm10").integer(decoded->variant.air_quality_metrics.pm10_standard);
                     }
                     if (decoded->variant.air_quality_metrics.has_pm25_standard) {
-                        msgPayload["pm25"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm25_standard);
+                        w.key("pm25").integer(decoded->variant.air_quality_metrics.pm25_standard);
                     }
                     if (decoded->variant.air_quality_metrics.has_pm100_standard) {
-                        msgPayload["pm100"] = new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm100_standard);
+                        w.key("pm100").integer(decoded->variant.air_quality_metrics.pm100_standard);
                     }
                     if (decoded->variant.air_quality_metrics.has_pm10_environmental) {
-                        msgPayload["pm10_e"] =
-                            new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm10_environmental);
+                        w.key("pm10_e").integer(decoded->variant.air_quality_metrics.pm10_environmental);
                     }
                     if (decoded->variant.air_quality_metrics.has_pm25_environmental) {
-                        msgPayload["pm25_e"] =
-                            new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm25_environmental);
+                        w.key("pm25_e").integer(decoded->variant.air_quality_metrics.pm25_environmental);
                     }
                     if (decoded->variant.air_quality_metrics.has_pm100_environmental) {
-                        msgPayload["pm100_e"] =
-                            new JSONValue((unsigned int)decoded->variant.air_quality_metrics.pm100_environmental);
+                        w.key("pm100_e").integer(decoded->variant.air_quality_metrics.pm100_environmental);
                     }
                 } else if (decoded->which_variant == meshtastic_Telemetry_power_metrics_tag) {
                     if (decoded->variant.power_metrics.has_ch1_voltage) {
-                        msgPayload["voltage_ch1"] = new JSONValue(decoded->variant.power_metrics.ch1_voltage);
+                        w.key("voltage_ch1").number(decoded->variant.power_metrics.ch1_voltage);
                     }
                     if (decoded->variant.power_metrics.has_ch1_current) {
-                        msgPayload["current_ch1"] = new JSONValue(decoded->variant.power_metrics.ch1_current);
+                        w.key("current_ch1").number(decoded->variant.power_metrics.ch1_current);
                     }
                     if (decoded->variant.power_metrics.has_ch2_voltage) {
-                        msgPayload["voltage_ch2"] = new JSONValue(decoded->variant.power_metrics.ch2_voltage);
+                        w.key("voltage_ch2").number(decoded->variant.power_metrics.ch2_voltage);
                     }
                     if (decoded->variant.power_metrics.has_ch2_current) {
-                        msgPayload["current_ch2"] = new JSONValue(decoded->variant.power_metrics.ch2_current);
+                        w.key("current_ch2").number(decoded->variant.power_metrics.ch2_current);
                     }
                     if (decoded->variant.power_metrics.has_ch3_voltage) {
-                        msgPayload["voltage_ch3"] = new JSONValue(decoded->variant.power_metrics.ch3_voltage);
+                        w.key("voltage_ch3").number(decoded->variant.power_metrics.ch3_voltage);
                     }
                     if (decoded->variant.power_metrics.has_ch3_current) {
-                        msgPayload["current_ch3"] = new JSONValue(decoded->variant.power_metrics.ch3_current);
+                        w.key("current_ch3").number(decoded->variant.power_metrics.ch3_current);
                     }
                 }
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                w.endObject();
             } else if (shouldLog) {
-                LOG_ERROR(errStr, msgType.c_str());
+                LOG_ERROR(errStr, msgType);
             }
             break;
         }
@@ -194,14 +196,15 @@ std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp,
             memset(&scratch, 0, sizeof(scratch));
             if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_User_msg, &scratch)) {
                 decoded = &scratch;
-                msgPayload["id"] = new JSONValue(decoded->id);
-                msgPayload["longname"] = new JSONValue(decoded->long_name);
-                msgPayload["shortname"] = new JSONValue(decoded->short_name);
-                msgPayload["hardware"] = new JSONValue(decoded->hw_model);
-                msgPayload["role"] = new JSONValue((int)decoded->role);
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                w.key("payload").beginObject();
+                w.key("id").string(decoded->id);
+                w.key("longname").string(decoded->long_name);
+                w.key("shortname").string(decoded->short_name);
+                w.key("hardware").integer(decoded->hw_model);
+                w.key("role").integer(decoded->role);
+                w.endObject();
             } else if (shouldLog) {
-                LOG_ERROR(errStr, msgType.c_str());
+                LOG_ERROR(errStr, msgType);
             }
             break;
         }
@@ -212,41 +215,42 @@ std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp,
             memset(&scratch, 0, sizeof(scratch));
             if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Position_msg, &scratch)) {
                 decoded = &scratch;
+                w.key("payload").beginObject();
                 if ((int)decoded->time) {
-                    msgPayload["time"] = new JSONValue((unsigned int)decoded->time);
+                    w.key("time").integer(decoded->time);
                 }
                 if ((int)decoded->timestamp) {
-                    msgPayload["timestamp"] = new JSONValue((unsigned int)decoded->timestamp);
+                    w.key("timestamp").integer(decoded->timestamp);
                 }
-                msgPayload["latitude_i"] = new JSONValue((int)decoded->latitude_i);
-                msgPayload["longitude_i"] = new JSONValue((int)decoded->longitude_i);
+                w.key("latitude_i").integer(decoded->latitude_i);
+                w.key("longitude_i").integer(decoded->longitude_i);
                 if ((int)decoded->altitude) {
-                    msgPayload["altitude"] = new JSONValue((int)decoded->altitude);
+                    w.key("altitude").integer(decoded->altitude);
                 }
                 if ((int)decoded->ground_speed) {
-                    msgPayload["ground_speed"] = new JSONValue((unsigned int)decoded->ground_speed);
+                    w.key("ground_speed").integer(decoded->ground_speed);
                 }
                 if (int(decoded->ground_track)) {
-                    msgPayload["ground_track"] = new JSONValue((unsigned int)decoded->ground_track);
+                    w.key("ground_track").integer(decoded->ground_track);
                 }
                 if (int(decoded->sats_in_view)) {
-                    msgPayload["sats_in_view"] = new JSONValue((unsigned int)decoded->sats_in_view);
+                    w.key("sats_in_view").integer(decoded->sats_in_view);
                 }
                 if ((int)decoded->PDOP) {
-                    msgPayload["PDOP"] = new JSONValue((int)decoded->PDOP);
+                    w.key("PDOP").integer(decoded->PDOP);
                 }
                 if ((int)decoded->HDOP) {
-                    msgPayload["HDOP"] = new JSONValue((int)decoded->HDOP);
+                    w.key("HDOP").integer(decoded->HDOP);
                 }
                 if ((int)decoded->VDOP) {
-                    msgPayload["VDOP"] = new JSONValue((int)decoded->VDOP);
+                    w.key("VDOP").integer(decoded->VDOP);
                 }
                 if ((int)decoded->precision_bits) {
-                    msgPayload["precision_bits"] = new JSONValue((int)decoded->precision_bits);
+                    w.key("precision_bits").integer(decoded->precision_bits);
                 }
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                w.endObject();
             } else if (shouldLog) {
-                LOG_ERROR(errStr, msgType.c_str());
+                LOG_ERROR(errStr, msgType);
             }
             break;
         }
@@ -257,16 +261,17 @@ std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp,
             memset(&scratch, 0, sizeof(scratch));
             if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Waypoint_msg, &scratch)) {
                 decoded = &scratch;
-                msgPayload["id"] = new JSONValue((unsigned int)decoded->id);
-                msgPayload["name"] = new JSONValue(decoded->name);
-                msgPayload["description"] = new JSONValue(decoded->description);
-                msgPayload["expire"] = new JSONValue((unsigned int)decoded->expire);
-                msgPayload["locked_to"] = new JSONValue((unsigned int)decoded->locked_to);
-                msgPayload["latitude_i"] = new JSONValue((int)decoded->latitude_i);
-                msgPayload["longitude_i"] = new JSONValue((int)decoded->longitude_i);
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                w.key("payload").beginObject();
+                w.key("id").integer(decoded->id);
+                w.key("name").string(decoded->name);
+                w.key("description").string(decoded->description);
+                w.key("expire").integer(decoded->expire);
+                w.key("locked_to").integer(decoded->locked_to);
+                w.key("latitude_i").integer(decoded->latitude_i);
+                w.key("longitude_i").integer(decoded->longitude_i);
+                w.endObject();
             } else if (shouldLog) {
-                LOG_ERROR(errStr, msgType.c_str());
+                LOG_ERROR(errStr, msgType);
             }
             break;
         }
@@ -278,21 +283,22 @@ std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp,
             if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_NeighborInfo_msg,
                                      &scratch)) {
                 decoded = &scratch;
-                msgPayload["node_id"] = new JSONValue((unsigned int)decoded->node_id);
-                msgPayload["node_broadcast_interval_secs"] = new JSONValue((unsigned int)decoded->node_broadcast_interval_secs);
-                msgPayload["last_sent_by_id"] = new JSONValue((unsigned int)decoded->last_sent_by_id);
-                msgPayload["neighbors_count"] = new JSONValue(decoded->neighbors_count);
-                JSONArray neighbors;
+                w.key("payload").beginObject();
+                w.key("node_id").integer(decoded->node_id);
+                w.key("node_broadcast_interval_secs").integer(decoded->node_broadcast_interval_secs);
+                w.key("last_sent_by_id").integer(decoded->last_sent_by_id);
+                w.key("neighbors_count").integer(decoded->neighbors_count);
+                w.key("neighbors").beginArray();
                 for (uint8_t i = 0; i < decoded->neighbors_count; i++) {
-                    JSONObject neighborObj;
-                    neighborObj["node_id"] = new JSONValue((unsigned int)decoded->neighbors[i].node_id);
-                    neighborObj["snr"] = new JSONValue((int)decoded->neighbors[i].snr);
-                    neighbors.push_back(new JSONValue(neighborObj));
+                    w.beginObject();
+                    w.key("node_id").integer(decoded->neighbors[i].node_id);
+                    w.key("snr").integer((int)decoded->neighbors[i].snr);
+                    w.endObject();
                 }
-                msgPayload["neighbors"] = new JSONValue(neighbors);
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                w.endArray();
+                w.endObject();
             } else if (shouldLog) {
-                LOG_ERROR(errStr, msgType.c_str());
+                LOG_ERROR(errStr, msgType);
             }
             break;
         }
@@ -305,58 +311,62 @@ std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp,
                 if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_RouteDiscovery_msg,
                                          &scratch)) {
                     decoded = &scratch;
-                    JSONArray route;      // Route this message took
-                    JSONArray routeBack;  // Route this message took back
-                    JSONArray snrTowards; // Snr for forward route
-                    JSONArray snrBack;    // Snr for reverse route
+                    w.key("payload").beginObject();
 
                     // Lambda function for adding a long name to the route
-                    auto addToRoute = [](JSONArray *route, NodeNum num) {
-                        char long_name[40] = "Unknown";
+                    auto addToRoute = [&w](NodeNum num) {
+                        const char *long_name = "Unknown";
                         meshtastic_NodeInfoLite *node = nodeDB->getMeshNode(num);
                         bool name_known = node ? node->has_user : false;
                         if (name_known)
-                            memcpy(long_name, node->user.long_name, sizeof(long_name));
-                        route->push_back(new JSONValue(long_name));
+                            long_name = node->user.long_name;
+                        w.string((const uint8_t *)long_name, strnlen(long_name, sizeof(node->user.long_name)));
                     };
-                    addToRoute(&route, mp->to); // Started at the original transmitter (destination of response)
+
+                    // Route this message took
+                    w.key("route").beginArray();
+                    addToRoute(mp->to); // Started at the original transmitter (destination of response)
                     for (uint8_t i = 0; i < decoded->route_count; i++) {
-                        addToRoute(&route, decoded->route[i]);
+                        addToRoute(decoded->route[i]);
                     }
-                    addToRoute(&route, mp->from); // Ended at the original destination (source of response)
+                    addToRoute(mp->from); // Ended at the original destination (source of response)
+                    w.endArray();
 
-                    addToRoute(&routeBack, mp->from); // Started at the original destination (source of response)
+                    // Route this message took back
+                    w.key("route_back").beginArray();
+                    addToRoute(mp->from); // Started at the original destination (source of response)
                     for (uint8_t i = 0; i < decoded->route_back_count; i++) {
-                        addToRoute(&routeBack, decoded->route_back[i]);
+                        addToRoute(decoded->route_back[i]);
                     }
-                    addToRoute(&routeBack, mp->to); // Ended at the original transmitter (destination of response)
+                    addToRoute(mp->to); // Ended at the original transmitter (destination of response)
+                    w.endArray();
 
+                    // Snr for reverse route
+                    w.key("snr_back").beginArray();
                     for (uint8_t i = 0; i < decoded->snr_back_count; i++) {
-                        snrBack.push_back(new JSONValue((float)decoded->snr_back[i] / 4));
+                        w.number((float)decoded->snr_back[i] / 4);
                     }
+                    w.endArray();
 
+                    // Snr for forward route
+                    w.key("snr_towards").beginArray();
                     for (uint8_t i = 0; i < decoded->snr_towards_count; i++) {
-                        snrTowards.push_back(new JSONValue((float)decoded->snr_towards[i] / 4));
+                        w.number((float)decoded->snr_towards[i] / 4);
                     }
-
-                    msgPayload["route"] = new JSONValue(route);
-                    msgPayload["route_back"] = new JSONValue(routeBack);
-                    msgPayload["snr_back"] = new JSONValue(snrBack);
-                    msgPayload["snr_towards"] = new JSONValue(snrTowards);
-                    jsonObj["payload"] = new JSONValue(msgPayload);
+                    w.endArray();
+                    w.endObject();
                 } else if (shouldLog) {
-                    LOG_ERROR(errStr, msgType.c_str());
+                    LOG_ERROR(errStr, msgType);
                 }
             }
             break;
         }
         case meshtastic_PortNum_DETECTION_SENSOR_APP: {
             msgType = "detection";
-            char payloadStr[(mp->decoded.payload.size) + 1];
-            memcpy(payloadStr, mp->decoded.payload.bytes, mp->decoded.payload.size);
-            payloadStr[mp->decoded.payload.size] = 0; // null terminated string
-            msgPayload["text"] = new JSONValue(payloadStr);
-            jsonObj["payload"] = new JSONValue(msgPayload);
+            const char *payloadStr = (const char *)mp->decoded.payload.bytes;
+            w.key("payload").beginObject();
+            w.key("text").string((const uint8_t *)payloadStr, strnlen(payloadStr, mp->decoded.payload.size));
+            w.endObject();
             break;
         }
 #ifdef ARCH_ESP32
@@ -367,12 +377,13 @@ std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp,
             memset(&scratch, 0, sizeof(scratch));
             if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Paxcount_msg, &scratch)) {
                 decoded = &scratch;
-                msgPayload["wifi_count"] = new JSONValue((unsigned int)decoded->wifi);
-                msgPayload["ble_count"] = new JSONValue((unsigned int)decoded->ble);
-                msgPayload["uptime"] = new JSONValue((unsigned int)decoded->uptime);
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                w.key("payload").beginObject();
+                w.key("wifi_count").integer(decoded->wifi);
+                w.key("ble_count").integer(decoded->ble);
+                w.key("uptime").integer(decoded->uptime);
+                w.endObject();
             } else if (shouldLog) {
-                LOG_ERROR(errStr, msgType.c_str());
+                LOG_ERROR(errStr, msgType);
             }
             break;
         }
@@ -386,13 +397,15 @@ std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp,
                 decoded = &scratch;
                 if (decoded->type == meshtastic_HardwareMessage_Type_GPIOS_CHANGED) {
                     msgType = "gpios_changed";
-                    msgPayload["gpio_value"] = new JSONValue((unsigned int)decoded->gpio_value);
-                    jsonObj["payload"] = new JSONValue(msgPayload);
+                    w.key("payload").beginObject();
+                    w.key("gpio_value").integer(decoded->gpio_value);
+                    w.endObject();
                 } else if (decoded->type == meshtastic_HardwareMessage_Type_READ_GPIOS_REPLY) {
                     msgType = "gpios_read_reply";
-                    msgPayload["gpio_value"] = new JSONValue((unsigned int)decoded->gpio_value);
-                    msgPayload["gpio_mask"] = new JSONValue((unsigned int)decoded->gpio_mask);
-                    jsonObj["payload"] = new JSONValue(msgPayload);
+                    w.key("payload").beginObject();
+                    w.key("gpio_value").integer(decoded->gpio_value);
+                    w.key("gpio_mask").integer(decoded->gpio_mask);
+                    w.endObject();
                 }
             } else if (shouldLog) {
                 LOG_ERROR(errStr, "RemoteHardware");
@@ -407,62 +420,83 @@ std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp,
         LOG_WARN("Couldn't convert encrypted payload of MeshPacket to JSON");
     }
 
-    jsonObj["id"] = new JSONValue((unsigned int)mp->id);
-    jsonObj["timestamp"] = new JSONValue((unsigned int)mp->rx_time);
-    jsonObj["to"] = new JSONValue((unsigned int)mp->to);
-    jsonObj["from"] = new JSONValue((unsigned int)mp->from);
-    jsonObj["channel"] = new JSONValue((unsigned int)mp->channel);
-    jsonObj["type"] = new JSONValue(msgType.c_str());
-    jsonObj["sender"] = new JSONValue(nodeDB->getNodeId().c_str());
+    w.key("id").integer(mp->id);
+    w.key("timestamp").integer(mp->rx_time);
+    w.key("to").integer(mp->to);
+    w.key("from").integer(mp->from);
+    w.key("channel").integer(mp->channel);
+    w.key("type").string(msgType);
+    w.key("sender").string(nodeDB->getNodeId().c_str());
     if (mp->rx_rssi != 0)
-        jsonObj["rssi"] = new JSONValue((int)mp->rx_rssi);
+        w.key("rssi").integer(mp->rx_rssi);
     if (mp->rx_snr != 0)
-        jsonObj["snr"] = new JSONValue((float)mp->rx_snr);
+        w.key("snr").number(mp->rx_snr);
     if (mp->hop_start != 0 && mp->hop_limit <= mp->hop_start) {
-        jsonObj["hops_away"] = new JSONValue((unsigned int)(mp->hop_start - mp->hop_limit));
-        jsonObj["hop_start"] = new JSONValue((unsigned int)(mp->hop_start));
+        w.key("hops_away").integer(mp->hop_start - mp->hop_limit);
+        w.key("hop_start").integer(mp->hop_start);
     }
+    w.endObject();
+}
 
-    // serialize and write it to the stream
-    JSONValue *value = new JSONValue(jsonObj);
-    std::string jsonStr = value->Stringify();
+std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp, bool shouldLog)
+{
+    // Built up in chunks, so there is no limit on the length here
+    std::string jsonStr;
+    char chunk[128];
+    JsonWriter w(chunk, sizeof(chunk), appendToString, &jsonStr);
+    writePacket(w, mp, shouldLog);
+    w.flush();
 
     if (shouldLog)
         LOG_INFO("serialized json message: %s", jsonStr.c_str());
 
-    delete value;
     return jsonStr;
 }
 
+size_t MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp, char *out, size_t outMax, bool shouldLog)
+{
+    JsonWriter w(out, outMax);
+    writePacket(w, mp, shouldLog);
+    if (w.overflowed()) {
+        // Always said, the caller drops the packet
+        LOG_WARN("JSON for packet 0x%08x does not fit in %u bytes, dropped", mp->id, (unsigned)outMax);
+        return 0;
+    }
+
+    if (shouldLog)
+        LOG_INFO("serialized json message: %s", out);
+
+    return w.length();
+}
+
 std::string MeshPacketSerializer::JsonSerializeEncrypted(const meshtastic_MeshPacket *mp)
 {
-    JSONObject jsonObj;
+    std::string jsonStr;
+    char chunk[128];
+    JsonWriter w(chunk, sizeof(chunk), appendToString, &jsonStr);
 
-    jsonObj["id"] = new JSONValue((unsigned int)mp->id);
-    jsonObj["time_ms"] = new JSONValue((double)millis());
-    jsonObj["timestamp"] = new JSONValue((unsigned int)mp->rx_time);
-    jsonObj["to"] = new JSONValue((unsigned int)mp->to);
-    jsonObj["from"] = new JSONValue((unsigned int)mp->from);
-    jsonObj["channel"] = new JSONValue((unsigned int)mp->channel);
-    jsonObj["want_ack"] = new JSONValue(mp->want_ack);
+    w.beginObject();
+    w.key("id").integer(mp->id);
+    w.key("time_ms").integer(millis());
+    w.key("timestamp").integer(mp->rx_time);
+    w.key("to").integer(mp->to);
+    w.key("from").integer(mp->from);
+    w.key("channel").integer(mp->channel);
+    w.key("want_ack").boolean(mp->want_ack);
 
     if (mp->rx_rssi != 0)
-        jsonObj["rssi"] = new JSONValue((int)mp->rx_rssi);
+        w.key("rssi").integer(mp->rx_rssi);
     if (mp->rx_snr != 0)
-        jsonObj["snr"] = new JSONValue((float)mp->rx_snr);
+        w.key("snr").number(mp->rx_snr);
     if (mp->hop_start != 0 && mp->hop_limit <= mp->hop_start) {
-        jsonObj["hops_away"] = new JSONValue((unsigned int)(mp->hop_start - mp->hop_limit));
-        jsonObj["hop_start"] = new JSONValue((unsigned int)(mp->hop_start));
+        w.key("hops_away").integer(mp->hop_start - mp->hop_limit);
+        w.key("hop_start").integer(mp->hop_start);
     }
-    jsonObj["size"] = new JSONValue((unsigned int)mp->encrypted.size);
-    auto encryptedStr = bytesToHex(mp->encrypted.bytes, mp->encrypted.size);
-    jsonObj["bytes"] = new JSONValue(encryptedStr.c_str());
+    w.key("size").integer(mp->encrypted.size);
+    w.key("bytes").hex(mp->encrypted.bytes, mp->encrypted.size);
+    w.endObject();
 
-    // serialize and write it to the stream
-    JSONValue *value = new JSONValue(jsonObj);
-    std::string jsonStr = value->Stringify();
-
-    delete value;
+    w.flush();
     return jsonStr;
 }
-#endif
\ No newline at end of file
+#endif
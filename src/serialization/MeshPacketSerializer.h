@@ -1,6 +1,16 @@
 #include <meshtastic/mesh.pb.h>
 #include <string>
 
+/// A node name as a traceroute reply lists it: at worst all of long_name escaped as \u00XX, in quotes, and a comma
+#define MESHPACKET_JSON_NAME_MAX (sizeof(meshtastic_User::long_name) * 6 + 3)
+
+/**
+ * Room for the JSON of any packet.  The longest is a traceroute reply with both routes full, each with its two ends, and
+ * every name made of characters that all need escaping.  The SNRs and the rest of the packet take well under 1 KB.
+ */
+#define MESHPACKET_JSON_MAX                                                                                                      \
+    (2 * (sizeof(meshtastic_RouteDiscovery::route) / sizeof(uint32_t) + 2) * MESHPACKET_JSON_NAME_MAX + 1024)
+
 static const char hexChars[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
 
 class MeshPacketSerializer
@@ -9,6 +19,12 @@ class MeshPacketSerializer
     static std::string JsonSerialize(const meshtastic_MeshPacket *mp, bool shouldLog = true);
     static std::string JsonSerializeEncrypted(const meshtastic_MeshPacket *mp);
 
+    /**
+     * Write the JSON for mp into out, NUL terminated, without going through the heap.
+     * @return its length, 0 if it does not fit in outMax
+     */
+    static size_t JsonSerialize(const meshtastic_MeshPacket *mp, char *out, size_t outMax, bool shouldLog = true);
+
   private:
     static std::string bytesToHex(const uint8_t *bytes, int len)
     {
@@ -378,6 +378,16 @@ std::string MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp,
     return jsonStr;
 }
 
+size_t MeshPacketSerializer::JsonSerialize(const meshtastic_MeshPacket *mp, char *out, size_t outMax, bool shouldLog)
+{
+    // ArduinoJson already builds into the static documents above, only the result is copied
+    std::string jsonStr = JsonSerialize(mp, shouldLog);
+    if (jsonStr.length() >= outMax)
+        return 0;
+    memcpy(out, jsonStr.c_str(), jsonStr.length() + 1);
+    return jsonStr.length();
+}
+
 std::string MeshPacketSerializer::JsonSerializeEncrypted(const meshtastic_MeshPacket *mp)
 {
     jsonObj.clear();
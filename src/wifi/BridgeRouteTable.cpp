@@ -0,0 +1,271 @@
+#include "BridgeRouteTable.h"
+
+#include <string.h>
+
+#define ROUTE_SLOT_MASK (ROUTE_TABLE_SLOTS - 1)
+
+BridgeRouteTable::BridgeRouteTable() {
+    memset(&stats, 0, sizeof(stats));
+    clear();
+}
+
+void BridgeRouteTable::clear() {
+    memset(table, 0, sizeof(table));
+    memset(leases, 0, sizeof(leases));
+    localCount = 0;
+    remoteCount = 0;
+}
+
+bool BridgeRouteTable::isBroadcast(uint32_t ip) {
+    return ip == 0xFFFFFFFF || (ip & 0xF0000000) == 0xE0000000 || ip == (ROUTE_AP_SUBNET | 0xFF);
+}
+
+// ============================================================================
+// Hash table
+// ============================================================================
+
+uint32_t BridgeRouteTable::home(uint32_t ip) {
+    // Fibonacci hashing, client addresses only differ in their last octet
+    return ((ip * 2654435761U) >> 16) & ROUTE_SLOT_MASK;
+}
+
+int BridgeRouteTable::find(uint32_t ip) const {
+    for (uint32_t i = home(ip);; i = (i + 1) & ROUTE_SLOT_MASK) {
+        if (!table[i].used)
+            return -1;
+        if (table[i].ip == ip)
+            return i;
+    }
+}
+
+void BridgeRouteTable::eraseSlot(int i) {
+    if (table[i].isLocal())
+        localCount--;
+    else
+        remoteCount--;
+
+    // Pull back every entry of the probe run that may move into the hole, so lookups can stop at the first empty slot
+    for (int j = (i + 1) & ROUTE_SLOT_MASK; table[j].used; j = (j + 1) & ROUTE_SLOT_MASK) {
+        uint32_t k = home(table[j].ip);
+        if (((j - i) & ROUTE_SLOT_MASK) <= ((j - k) & ROUTE_SLOT_MASK)) {
+            table[i] = table[j];
+            i = j;
+        }
+    }
+    table[i].used = false;
+}
+
+bool BridgeRouteTable::isExpired(const RouteEntry &e, uint32_t now) const {
+    return !e.isLocal() && now - e.lastSeen > ROUTE_TIMEOUT_MS;
+}
+
+void BridgeRouteTable::evictRemote(uint32_t now) {
+    int victim = -1;
+    for (int i = 0; i < ROUTE_TABLE_SLOTS; i++) {
+        if (table[i].used && !table[i].isLocal() && (victim < 0 || now - table[i].lastSeen > now - table[victim].lastSeen))
+            victim = i;
+    }
+    if (victim < 0)
+        return;
+    if (isExpired(table[victim], now))
+        stats.expired++;
+    else
+        stats.evictions++;
+    eraseSlot(victim);
+}
+
+// ============================================================================
+// Routes
+// ============================================================================
+
+const RouteEntry* BridgeRouteTable::lookup(uint32_t ip, uint32_t now) {
+    int i = find(ip);
+    if (i >= 0 && isExpired(table[i], now)) {
+        stats.expired++;
+        eraseSlot(i);
+        i = -1;
+    }
+    if (i < 0) {
+        stats.misses++;
+        return nullptr;
+    }
+    stats.hits++;
+    table[i].lastSeen = now;
+    return &table[i];
+}
+
+uint32_t BridgeRouteTable::resolve(uint32_t ip, uint32_t now) {
+    if (isBroadcast(ip))
+        return ROUTE_BROADCAST;
+
+    const RouteEntry* route = lookup(ip, now);
+    if (route)
+        return route->nodeId;
+    stats.broadcastFallbacks++;
+    return ROUTE_BROADCAST;
+}
+
+bool BridgeRouteTable::learn(uint32_t ip, uint32_t nodeId, RouteSource source, uint32_t now) {
+    if (ip == 0 || isBroadcast(ip))
+        return false;
+    bool local = source == ROUTE_LOCAL;
+
+    int i = find(ip);
+    if (i >= 0) {
+        RouteEntry &e = table[i];
+        if (e.isLocal() && !local) {
+            stats.conflicts++;
+            return false;
+        }
+        if (!e.isLocal() && local) {
+            // One of our clients now holds an address we used to route to another node
+            if (localCount >= MAX_WIFI_CLIENTS)
+                return false;
+            remoteCount--;
+            localCount++;
+        } else if (!local && e.nodeId != nodeId) {
+            stats.learned++;
+        }
+        e.nodeId = nodeId;
+        e.source = source;
+        e.lastSeen = now;
+        return true;
+    }
+
+    if (local) {
+        if (localCount >= MAX_WIFI_CLIENTS)
+            return false;
+        localCount++;
+    } else {
+        if (remoteCount >= MAX_REMOTE_ROUTES)
+            evictRemote(now);
+        remoteCount++;
+        stats.learned++;
+    }
+
+    // Never full: local and remote routes are both capped well below the slot count
+    uint32_t slot = home(ip);
+    while (table[slot].used)
+        slot = (slot + 1) & ROUTE_SLOT_MASK;
+    table[slot] = {ip, nodeId, now, source, true};
+    return true;
+}
+
+bool BridgeRouteTable::remove(uint32_t ip) {
+    int i = find(ip);
+    if (i < 0)
+        return false;
+    eraseSlot(i);
+    return true;
+}
+
+int BridgeRouteTable::expire(uint32_t now) {
+    int removed = 0;
+    for (int i = 0; i < ROUTE_TABLE_SLOTS; i++) {
+        // Backward shift may pull a later entry into slot i, look at it again
+        while (table[i].used && isExpired(table[i], now)) {
+            eraseSlot(i);
+            stats.expired++;
+            removed++;
+        }
+    }
+    return removed;
+}
+
+// ============================================================================
+// Client leases
+// ============================================================================
+
+int BridgeRouteTable::leaseIndex(const uint8_t* mac) const {
+    for (int i = 0; i < MAX_WIFI_CLIENTS; i++) {
+        if (leases[i].used && memcmp(leases[i].mac, mac, 6) == 0)
+            return i;
+    }
+    return -1;
+}
+
+const ClientLease* BridgeRouteTable::findLease(const uint8_t* mac) const {
+    int i = leaseIndex(mac);
+    return i >= 0 ? &leases[i] : nullptr;
+}
+
+uint32_t BridgeRouteTable::leaseFor(const uint8_t* mac, uint32_t localNode, uint32_t now) {
+    int found = leaseIndex(mac);
+    ClientLease* lease = found >= 0 ? &leases[found] : nullptr;
+
+    if (!lease) {
+        // A free lease, or else the one of the client that left longest ago
+        for (int i = 0; i < MAX_WIFI_CLIENTS; i++) {
+            ClientLease &l = leases[i];
+            if (!l.used) {
+                lease = &l;
+                break;
+            }
+            if (!l.connected && (!lease || now - l.lastSeen > now - lease->lastSeen))
+                lease = &l;
+        }
+        if (!lease) {
+            stats.leasesExhausted++;
+            return 0;
+        }
+
+        // First pool address no other lease holds, there is always one as the pool has a slot per lease
+        uint32_t ip = 0;
+        for (int k = 0; k < MAX_WIFI_CLIENTS && !ip; k++) {
+            ip = ROUTE_AP_SUBNET | (DHCP_POOL_START + k);
+            for (int i = 0; i < MAX_WIFI_CLIENTS; i++) {
+                if (&leases[i] != lease && leases[i].used && leases[i].ip == ip) {
+                    ip = 0;
+                    break;
+                }
+            }
+        }
+        memcpy(lease->mac, mac, 6);
+        lease->ip = ip;
+        lease->used = true;
+    }
+
+    lease->connected = true;
+    lease->lastSeen = now;
+    learn(lease->ip, localNode, ROUTE_LOCAL, now);
+    return lease->ip;
+}
+
+void BridgeRouteTable::bindLease(const uint8_t* mac, uint32_t ip, uint32_t localNode, uint32_t now) {
+    if (leaseIndex(mac) < 0 && !leaseFor(mac, localNode, now))
+        return;
+    ClientLease* lease = &leases[leaseIndex(mac)];
+    if (lease->ip == ip)
+        return;
+
+    // Our guess was wrong: trade addresses with whichever lease guessed ip, the DHCP server has the last word
+    uint32_t oldIp = lease->ip;
+    int i = find(oldIp);
+    if (i >= 0 && table[i].isLocal())
+        eraseSlot(i);
+    for (int k = 0; k < MAX_WIFI_CLIENTS; k++) {
+        ClientLease &other = leases[k];
+        if (&other != lease && other.used && other.ip == ip) {
+            other.ip = oldIp;
+            remove(ip);
+            if (other.connected)
+                learn(oldIp, localNode, ROUTE_LOCAL, now);
+        }
+    }
+    lease->ip = ip;
+    lease->connected = true;
+    lease->lastSeen = now;
+    learn(ip, localNode, ROUTE_LOCAL, now);
+}
+
+void BridgeRouteTable::releaseLease(const uint8_t* mac, uint32_t now) {
+    int i = leaseIndex(mac);
+    if (i < 0)
+        return;
+    ClientLease* lease = &leases[i];
+    lease->connected = false;
+    lease->lastSeen = now;
+    int slot = find(lease->ip);
+    if (slot >= 0 && table[slot].isLocal())
+        eraseSlot(slot);
+}
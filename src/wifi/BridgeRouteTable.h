@@ -0,0 +1,154 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Maximum clients supported
+#define MAX_WIFI_CLIENTS 8
+
+// IP address pool for clients (192.168.4.100 - 192.168.4.107)
+#define DHCP_POOL_START 100
+
+// Remote routes (clients of other nodes, mesh node addresses) remembered at once
+#define MAX_REMOTE_ROUTES 24
+
+// Open-addressed slots, a power of two at least twice the routes we hold so probes stay short
+#define ROUTE_TABLE_SLOTS 64
+
+// Remote routes not used or refreshed for this long are dropped
+#define ROUTE_TIMEOUT_MS (5 * 60 * 1000)
+
+// AP subnet, clients of every node live here
+#define ROUTE_AP_SUBNET ((192U << 24) | (168U << 16) | (4U << 8))
+
+// Mesh-wide node addresses: 10.115.x.y reaches the node whose number ends in x.y
+#define ROUTE_MESH_SUBNET ((10U << 24) | (115U << 16))
+
+#define ROUTE_BROADCAST 0xFFFFFFFF
+
+static_assert((ROUTE_TABLE_SLOTS & (ROUTE_TABLE_SLOTS - 1)) == 0, "ROUTE_TABLE_SLOTS must be a power of two");
+static_assert(ROUTE_TABLE_SLOTS >= 2 * (MAX_WIFI_CLIENTS + MAX_REMOTE_ROUTES), "route table too full for linear probing");
+
+// Where a route was learned from
+enum RouteSource : uint8_t {
+    ROUTE_LOCAL,    // one of our WiFi clients (lease)
+    ROUTE_OBSERVED, // source address of a packet bridged in from that node
+    ROUTE_NODEDB    // mesh node address resolved through NodeDB
+};
+
+// Routing table entry - maps an IP to the LoRa node that can deliver it
+struct RouteEntry {
+    uint32_t ip;
+    uint32_t nodeId;   // Remote Meshtastic node ID (ours for local clients)
+    uint32_t lastSeen; // Last packet timestamp
+    RouteSource source;
+    bool used;
+
+    bool isLocal() const { return source == ROUTE_LOCAL; }
+};
+
+// MAC -> IP lease of one WiFi client, kept after it leaves so it gets the same address back
+struct ClientLease {
+    uint8_t mac[6];
+    uint32_t ip;
+    uint32_t lastSeen;
+    bool connected;
+    bool used;
+};
+
+struct RouteStats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t broadcastFallbacks; // unicast packets flooded to every node for lack of a route
+    uint32_t learned;            // remote routes added or moved to another node
+    uint32_t evictions;          // remote routes pushed out by newer ones while still fresh
+    uint32_t expired;
+    uint32_t conflicts;          // remote claims on addresses leased to our own clients, ignored
+    uint32_t leasesExhausted;    // clients that got no address
+};
+
+/**
+ * Route table and client leases for the WiFi mesh bridge.
+ *
+ * Routes live in a fixed open-addressed hash table (linear probing, backward shift deletion) so lookups on the packet path
+ * never allocate and touch a couple of cache lines.  Local clients always have a slot; remote routes are capped at
+ * MAX_REMOTE_ROUTES and the least recently used one makes room for a new one.  Stale remote routes are dropped lazily when
+ * looked up, expire() sweeps the rest.
+ *
+ * Leases give each client MAC a stable address from the pool: a reconnecting client gets its old address back, a new one
+ * takes a free address or the one of the client that left longest ago.
+ *
+ * Time is passed in so the logic can be driven from tests.  Not thread safe, call from one thread.
+ */
+class BridgeRouteTable {
+public:
+    BridgeRouteTable();
+
+    /**
+     * Find the node for an address, refreshing the route.
+     * @return nullptr if there is no (fresh) route
+     */
+    const RouteEntry* lookup(uint32_t ip, uint32_t now);
+
+    /**
+     * Pick the node a packet for ip goes to: its route, or ROUTE_BROADCAST for broadcast/multicast addresses and
+     * addresses we know nothing about (counted as a broadcast fallback).
+     */
+    uint32_t resolve(uint32_t ip, uint32_t now);
+
+    // Is there a route for ip, without counting it as a hit or miss
+    bool contains(uint32_t ip) const { return find(ip) >= 0; }
+
+    /**
+     * Add or refresh a route.  Remote routes never replace a local client's.
+     * @return false if it was refused (conflict with a local client, table full of local routes)
+     */
+    bool learn(uint32_t ip, uint32_t nodeId, RouteSource source, uint32_t now);
+
+    bool remove(uint32_t ip);
+
+    // Drop remote routes idle for ROUTE_TIMEOUT_MS, returns how many
+    int expire(uint32_t now);
+
+    /**
+     * Lease an address to a client that just associated and route it to localNode.
+     * @return the address, 0 if every lease belongs to a connected client
+     */
+    uint32_t leaseFor(const uint8_t* mac, uint32_t localNode, uint32_t now);
+
+    // The DHCP server told us the address a client really got, move its lease and route there
+    void bindLease(const uint8_t* mac, uint32_t ip, uint32_t localNode, uint32_t now);
+
+    // Client left: keep the lease so it gets the same address back, drop its route
+    void releaseLease(const uint8_t* mac, uint32_t now);
+
+    const ClientLease* findLease(const uint8_t* mac) const;
+
+    void clear();
+
+    int getRouteCount() const { return localCount + remoteCount; }
+    int getRemoteCount() const { return remoteCount; }
+    const RouteStats &getStats() const { return stats; }
+
+    // Iterate over routes: slot index in [0, ROUTE_TABLE_SLOTS), nullptr for empty slots
+    const RouteEntry* getSlot(int i) const { return table[i].used ? &table[i] : nullptr; }
+
+    static bool isBroadcast(uint32_t ip);
+
+private:
+    RouteEntry table[ROUTE_TABLE_SLOTS];
+    ClientLease leases[MAX_WIFI_CLIENTS];
+    int localCount = 0;
+    int remoteCount = 0;
+    RouteStats stats;
+
+    static uint32_t home(uint32_t ip);
+    // Slot holding ip, or -1
+    int find(uint32_t ip) const;
+    void eraseSlot(int i);
+    // Make room for a remote route by dropping the least recently used one
+    void evictRemote(uint32_t now);
+    bool isExpired(const RouteEntry &e, uint32_t now) const;
+    // Lease of a MAC, or -1
+    int leaseIndex(const uint8_t* mac) const;
+};
@@ -0,0 +1,121 @@
+#include "DeliveryTracker.h"
+
+#include <string.h>
+
+DeliveryTracker::DeliveryTracker() {
+    memset(entries, 0, sizeof(entries));
+}
+
+int DeliveryTracker::find(uint32_t packetId) const {
+    for (int i = 0; i < DELIVERY_MAX_TRACKED; i++) {
+        if (entries[i].used && entries[i].packetId == packetId)
+            return i;
+    }
+    return -1;
+}
+
+int DeliveryTracker::getTrackedCount() const {
+    int n = 0;
+    for (int i = 0; i < DELIVERY_MAX_TRACKED; i++)
+        n += entries[i].used;
+    return n;
+}
+
+const char* DeliveryTracker::stateName(DeliveryState state) {
+    switch (state) {
+        case DELIVERY_QUEUED: return "queued";
+        case DELIVERY_RELAYED: return "relayed";
+        case DELIVERY_ACKED: return "acked";
+        case DELIVERY_NAKED: return "naked";
+        case DELIVERY_FAILED: return "failed";
+    }
+    return "unknown";
+}
+
+bool DeliveryTracker::track(uint32_t packetId, uint8_t client, uint32_t requestId, uint32_t dest, bool wantAck,
+                            uint32_t now) {
+    for (int i = 0; i < DELIVERY_MAX_TRACKED; i++) {
+        const Entry &e = entries[i];
+        if (e.used && e.packetId == packetId && e.client == client && e.requestId == requestId)
+            return false;
+    }
+
+    // A free slot, or the message we have been waiting on longest
+    Entry* slot = &entries[0];
+    for (int i = 0; i < DELIVERY_MAX_TRACKED; i++) {
+        if (!entries[i].used) {
+            slot = &entries[i];
+            break;
+        }
+        if (now - entries[i].since > now - slot->since)
+            slot = &entries[i];
+    }
+
+    slot->used = true;
+    slot->client = client;
+    slot->wantAck = wantAck;
+    slot->queued = false;
+    slot->state = DELIVERY_QUEUED;
+    slot->packetId = packetId;
+    slot->requestId = requestId;
+    slot->dest = dest;
+    slot->since = now;
+    return true;
+}
+
+void DeliveryTracker::advance(Entry &e, DeliveryState state, int32_t error, bool done, DeliveryUpdate &update) {
+    update.client = e.client;
+    update.requestId = e.requestId;
+    update.packetId = e.packetId;
+    update.state = state;
+    update.error = error;
+    e.state = state;
+    if (done)
+        e.used = false;
+}
+
+int DeliveryTracker::onQueued(uint32_t packetId, bool ok, int32_t error, DeliveryUpdate* updates, int maxUpdates) {
+    int n = 0;
+    for (int i = 0; i < DELIVERY_MAX_TRACKED && n < maxUpdates; i++) {
+        Entry &e = entries[i];
+        // Queue statuses also come for retransmissions, only the first one is news
+        if (!e.used || e.packetId != packetId || e.queued)
+            continue;
+        e.queued = true;
+        if (!ok)
+            advance(e, DELIVERY_FAILED, error, true, updates[n++]);
+        else
+            advance(e, DELIVERY_QUEUED, 0, !e.wantAck, updates[n++]);
+    }
+    return n;
+}
+
+int DeliveryTracker::onReport(uint32_t packetId, uint32_t from, int32_t error, DeliveryUpdate* updates, int maxUpdates) {
+    int n = 0;
+    for (int i = 0; i < DELIVERY_MAX_TRACKED && n < maxUpdates; i++) {
+        if (entries[i].used && entries[i].packetId == packetId && report(entries[i], from, error, updates[n]))
+            n++;
+    }
+    return n;
+}
+
+bool DeliveryTracker::report(Entry &e, uint32_t from, int32_t error, DeliveryUpdate &update) {
+    if (error != 0) {
+        advance(e, DELIVERY_NAKED, error, true, update);
+    } else if (from == e.dest) {
+        advance(e, DELIVERY_ACKED, 0, true, update);
+    } else if (e.state == DELIVERY_RELAYED) {
+        return false; // more relays, nothing new
+    } else {
+        // Implicit ACKs come from ourselves, relay ACKs from a neighbour: both only say it got out
+        advance(e, DELIVERY_RELAYED, 0, e.dest == DELIVERY_BROADCAST, update);
+    }
+    return true;
+}
+
+void DeliveryTracker::forgetClient(uint8_t client) {
+    for (int i = 0; i < DELIVERY_MAX_TRACKED; i++) {
+        if (entries[i].used && entries[i].client == client)
+            entries[i].used = false;
+    }
+}
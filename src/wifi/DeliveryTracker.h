@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Messages from WiFi clients followed at once (two full aggregates), the oldest is forgotten when a new one needs room
+#define DELIVERY_MAX_TRACKED 32
+
+#define DELIVERY_BROADCAST 0xFFFFFFFF
+
+// What happened to a message, in the order it normally happens
+enum DeliveryState : uint8_t {
+    DELIVERY_QUEUED,  // accepted by the router, waiting for airtime
+    DELIVERY_RELAYED, // we heard a node pass it on (implicit ACK) or a relay acknowledged it
+    DELIVERY_ACKED,   // the destination acknowledged it
+    DELIVERY_NAKED,   // the mesh reported a failure (no route, retransmissions exhausted...), see error
+    DELIVERY_FAILED   // never left this node (queue full, no interface...), see error
+};
+
+// A state change to report to the client that sent the message
+struct DeliveryUpdate {
+    uint8_t client;
+    uint32_t requestId; // chosen by the client
+    uint32_t packetId;  // mesh packet id
+    DeliveryState state;
+    int32_t error;      // router ErrorCode for DELIVERY_FAILED, Routing_Error for DELIVERY_NAKED, 0 otherwise
+};
+
+/**
+ * Follows the messages WiFi clients send into the mesh and turns queue statuses and ACK/NAKs into per-request updates.
+ *
+ * Without want_ack a message is done once queued.  With it, it waits for the ACK or NAK: an ACK from the destination
+ * completes it, an implicit ACK (from ourselves, we heard it being rebroadcast) or one from a relay moves it to RELAYED.
+ * For a broadcast RELAYED is as good as it gets and completes it.  Messages that never hear back are forgotten when their
+ * slot is needed, their last reported state stands.
+ *
+ * Pure bookkeeping with no mesh dependencies so it can be tested on the native build.
+ */
+class DeliveryTracker {
+public:
+    DeliveryTracker();
+
+    /**
+     * Start following a request, call before handing its packet to the router (the queue status comes back
+     * synchronously).  Several requests may share a packet when their messages were aggregated.
+     * @return false if this request is already followed
+     */
+    bool track(uint32_t packetId, uint8_t client, uint32_t requestId, uint32_t dest, bool wantAck, uint32_t now);
+
+    /**
+     * The router queued the packet (ok) or refused it with error.
+     * @return the number of state changes written to updates, one per request in the packet
+     */
+    int onQueued(uint32_t packetId, bool ok, int32_t error, DeliveryUpdate* updates, int maxUpdates);
+
+    /**
+     * An ACK (error 0) or NAK for packetId arrived from node from.
+     * @return the number of state changes written to updates, one per request in the packet
+     */
+    int onReport(uint32_t packetId, uint32_t from, int32_t error, DeliveryUpdate* updates, int maxUpdates);
+
+    // A client went away, stop reporting to it (its WebSocket slot may be reused by someone else)
+    void forgetClient(uint8_t client);
+
+    bool isTracked(uint32_t packetId) const { return find(packetId) >= 0; }
+    int getTrackedCount() const;
+
+    static const char* stateName(DeliveryState state);
+
+private:
+    struct Entry {
+        bool used;
+        uint8_t client;
+        bool wantAck;
+        bool queued; // the router's answer was reported
+        DeliveryState state;
+        uint32_t packetId;
+        uint32_t requestId;
+        uint32_t dest;
+        uint32_t since;
+    };
+
+    Entry entries[DELIVERY_MAX_TRACKED];
+
+    int find(uint32_t packetId) const;
+    // Report a state change, freeing the entry if the message is done
+    void advance(Entry &e, DeliveryState state, int32_t error, bool done, DeliveryUpdate &update);
+    // The state change an ACK/NAK brings to one request, false if none
+    bool report(Entry &e, uint32_t from, int32_t error, DeliveryUpdate &update);
+};
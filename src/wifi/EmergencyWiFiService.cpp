@@ -4,12 +4,15 @@
 
 #include <LittleFS.h>
 #include <ArduinoJson.h>
+#include "mesh/mesh-pb-constants.h"
+#include "serialization/JsonWriter.h"
 #include "modules/EmergencyWiFiBridge.h"
 
 EmergencyWiFiService wifiService;
 
 EmergencyWiFiService::EmergencyWiFiService()
     : httpServer(80), wsServer(81), apActive(false), clientCount(0), lastClientActivity(0) {
+    memset(syncs, 0, sizeof(syncs));
 }
 
 void EmergencyWiFiService::init() {
@@ -22,28 +25,13 @@ void EmergencyWiFiService::init() {
     }
     Serial.println("LittleFS mounted successfully");
 
-    // List files in LittleFS for debugging
-    Serial.println("Files in LittleFS:");
-    File root = LittleFS.open("/");
-    File file = root.openNextFile();
-    while (file) {
-        Serial.printf("  %s (%d bytes)\n", file.name(), file.size());
-        file = root.openNextFile();
-    }
-
-    // Check webapp directory specifically
-    File webappDir = LittleFS.open("/webapp");
-    if (webappDir && webappDir.isDirectory()) {
-        Serial.println("Files in /webapp:");
-        File webappFile = webappDir.openNextFile();
-        while (webappFile) {
-            Serial.printf("  %s (%d bytes)\n", webappFile.name(), webappFile.size());
-            webappFile = webappDir.openNextFile();
-        }
-    } else {
-        Serial.println("WARNING: /webapp directory not found!");
+    // Message history survives reboots, clients catch up with a "sync"
+    if (!messageLog.begin()) {
+        Serial.println("WARNING: message history unavailable");
     }
 
+    loadWebAssets();
+
     // Setup WiFi AP
     setupWiFiAP();
 
@@ -115,18 +103,22 @@ void EmergencyWiFiService::setupWebServer() {
         }
     });
 
-    // Root path - just show instructions
-    httpServer.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
-        Serial.println("Root path requested");
-        String html = "<h1>Emergency Mesh</h1>";
-        html += "<p>Send message: <a href='/send?msg=hello'>/send?msg=hello</a></p>";
-        html += "<p>Quick test: <a href='/test'>/test</a></p>";
-        request->send(200, "text/html", html);
-    });
-
-    // Log all other requests
-    httpServer.onNotFound([](AsyncWebServerRequest *request) {
+    // Everything else is the web app, or a 404. Without it (filesystem image not uploaded) the root shows instructions.
+    httpServer.onNotFound([this](AsyncWebServerRequest *request) {
+        const WebAsset* asset = request->method() == HTTP_GET ? webAssets.find(request->url().c_str()) : NULL;
+        if (asset) {
+            serveWebAsset(request, *asset);
+            return;
+        }
         Serial.printf("Request: %s %s\n", request->methodToString(), request->url().c_str());
+        if (request->url() == "/") {
+            String html = "<h1>Emergency Mesh</h1>";
+            html += "<p>Web app not installed, upload the filesystem image.</p>";
+            html += "<p>Send message: <a href='/send?msg=hello'>/send?msg=hello</a></p>";
+            html += "<p>Quick test: <a href='/test'>/test</a></p>";
+            request->send(200, "text/html", html);
+            return;
+        }
         request->send(404, "text/plain", "Not found: " + request->url());
     });
 
@@ -135,6 +127,45 @@ void EmergencyWiFiService::setupWebServer() {
     Serial.println("Try: http://192.168.4.1/test");
 }
 
+void EmergencyWiFiService::loadWebAssets() {
+    // Only the manifest is read at boot, the assets themselves are streamed from flash per request
+    File f = LittleFS.open(WEB_ASSET_MANIFEST, "r");
+    if (!f) {
+        Serial.println("WARNING: " WEB_ASSET_MANIFEST " not found, web app not installed");
+        return;
+    }
+    char text[WEB_ASSET_MAX * (WEB_ASSET_URL_MAX + WEB_ASSET_TYPE_MAX + 32)];
+    size_t len = f.read((uint8_t*)text, sizeof(text));
+    f.close();
+    Serial.printf("Web app: %d assets\n", webAssets.parse(text, len));
+}
+
+void EmergencyWiFiService::serveWebAsset(AsyncWebServerRequest* request, const WebAsset &asset) {
+    char cacheControl[40];
+    if (asset.maxAge == 0) {
+        strcpy(cacheControl, "no-cache");
+    } else {
+        snprintf(cacheControl, sizeof(cacheControl), "public, max-age=%lu", (unsigned long)asset.maxAge);
+    }
+
+    // The browser's copy is current: a few hundred bytes of headers instead of the file
+    if (request->hasHeader("If-None-Match") &&
+        WebAssetManifest::etagMatches(request->getHeader("If-None-Match")->value().c_str(), asset.etag)) {
+        AsyncWebServerResponse* response = request->beginResponse(304);
+        response->addHeader("ETag", asset.etag);
+        response->addHeader("Cache-Control", cacheControl);
+        request->send(response);
+        return;
+    }
+
+    // Only the .gz is on flash, AsyncFileResponse picks it up and adds Content-Encoding: gzip
+    String path = String(WEB_ASSET_DIR) + asset.url;
+    AsyncWebServerResponse* response = request->beginResponse(LittleFS, path, asset.type);
+    response->addHeader("ETag", asset.etag);
+    response->addHeader("Cache-Control", cacheControl);
+    request->send(response);
+}
+
 void EmergencyWiFiService::setupWebSocket() {
     wsServer.onEvent([this](uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
         this->handleWebSocketEvent(num, type, payload, length);
@@ -151,6 +182,7 @@ void EmergencyWiFiService::handleWebSocketEvent(uint8_t num, WStype_t type, uint
             Serial.printf("WebSocket[%u] connected from %s\n", num, ip.toString().c_str());
             clientCount++;
             lastClientActivity = millis();
+            pushQueue.attach(num);
 
             // Send node info to new client
             sendNodeInfo(num);
@@ -159,6 +191,12 @@ void EmergencyWiFiService::handleWebSocketEvent(uint8_t num, WStype_t type, uint
 
         case WStype_DISCONNECTED:
             Serial.printf("WebSocket[%u] disconnected\n", num);
+            if (pushQueue.getDropped(num) > 0) {
+                Serial.printf("WebSocket[%u] missed %u events while too slow\n", num, pushQueue.getDropped(num));
+            }
+            pushQueue.detach(num);
+            if (num < WS_PUSH_MAX_CLIENTS) syncs[num].active = false;
+            if (emergencyWiFiBridge) emergencyWiFiBridge->forgetClient(num);
             if (clientCount > 0) clientCount--;
             lastClientActivity = millis();
             break;
@@ -184,34 +222,194 @@ void EmergencyWiFiService::handleWebSocketEvent(uint8_t num, WStype_t type, uint
 }
 
 void EmergencyWiFiService::handleClientMessage(uint8_t clientId, const char* json) {
-    // This will be forwarded to EmergencyWiFiBridge
-    // For now, just echo back for testing
-    Serial.printf("Handling message from client %u: %s\n", clientId, json);
+    // {"type":"send","id":7,"dest":"a1b2c3d4"|"broadcast","channel":0,"text":"...","wantAck":true}
+    // {"type":"sync","since":42}, optionally with "peer":"a1b2c3d4" or "channel":0 for a single conversation
+    StaticJsonDocument<512> doc;
+    DeserializationError err = deserializeJson(doc, json);
+    if (err) {
+        Serial.printf("WebSocket[%u] bad JSON: %s\n", clientId, err.c_str());
+        return;
+    }
 
-    // TODO: Forward to bridge module
-    // emergencyBridge.handleWiFiMessage(json);
-}
+    const char* type = doc["type"] | "";
+    if (strcmp(type, "sync") == 0) {
+        MessageLogConversation only = {};
+        bool filtered = true;
+        if (doc.containsKey("peer")) {
+            const char* peer = doc["peer"] | "";
+            if (peer[0] == '!') peer++;
+            only.peer = strtoul(peer, NULL, 16);
+        } else if (doc.containsKey("channel")) {
+            only.peer = doc["channel"] | 0;
+            only.flags = MSGLOG_FLAG_CHANNEL;
+        } else {
+            filtered = false;
+        }
+        startSync(clientId, doc["since"].as<uint32_t>(), filtered ? &only : NULL);
+        return;
+    }
+    if (strcmp(type, "send") != 0) {
+        Serial.printf("WebSocket[%u] unknown message type '%s'\n", clientId, type);
+        return;
+    }
+    if (!emergencyWiFiBridge) return;
+
+    uint32_t requestId = doc["id"] | 0;
+    const char* text = doc["text"] | "";
+    int channel = doc["channel"] | 0;
+    bool wantAck = doc["wantAck"] | false;
+
+    // Node ids as the apps show them: hex, with or without '!' or "0x"
+    uint32_t dest = 0xFFFFFFFF;
+    const char* destStr = doc["dest"] | "broadcast";
+    if (strcmp(destStr, "broadcast") != 0) {
+        if (destStr[0] == '!') destStr++;
+        char* end;
+        dest = strtoul(destStr, &end, 16);
+        if (*destStr == 0 || *end != 0 || dest == 0) {
+            emergencyWiFiBridge->rejectRequest(clientId, requestId, "bad dest");
+            return;
+        }
+    }
 
-void EmergencyWiFiService::sendNodeInfo(uint8_t clientId) {
-    DynamicJsonDocument doc(256);
-    doc["type"] = "node_info";
-    doc["nodeId"] = String(getNodeId(), HEX);
-    doc["name"] = "Test Node";
-    doc["timestamp"] = millis();
+    if (text[0] == 0) {
+        emergencyWiFiBridge->rejectRequest(clientId, requestId, "empty text");
+        return;
+    }
+    if (channel < 0 || (size_t)channel >= MAX_NUM_CHANNELS) {
+        emergencyWiFiBridge->rejectRequest(clientId, requestId, "bad channel");
+        return;
+    }
 
-    String json;
-    serializeJson(doc, json);
+    emergencyWiFiBridge->sendTextFromClient(clientId, requestId, dest, channel, text, strlen(text), wantAck);
+}
 
-    wsServer.sendTXT(clientId, json);
-    Serial.printf("Sent node info to client %u: %s\n", clientId, json.c_str());
+void EmergencyWiFiService::sendNodeInfo(uint8_t clientId) {
+    char json[128];
+    JsonWriter w(json, sizeof(json));
+    w.beginObject();
+    w.key("type").string("node_info");
+    w.key("nodeId").stringf("%x", (unsigned)getNodeId());
+    w.key("name").string("Test Node");
+    w.key("timestamp").integer(millis());
+    w.endObject();
+
+    wsServer.sendTXT(clientId, (uint8_t*)json, w.length());
+    Serial.printf("Sent node info to client %u: %s\n", clientId, json);
 }
 
 void EmergencyWiFiService::loop() {
     wsServer.loop();
+    flushPushQueue();
+    flushSyncs();
+}
+
+void EmergencyWiFiService::flushPushQueue() {
+    // At most one frame per client per tick, a slow phone costs one send and falls behind on its own
+    int built = -1;
+    size_t frameLen = 0;
+    for (uint8_t num = 0; num < WS_PUSH_MAX_CLIENTS; num++) {
+        if (!pushQueue.hasPending(num)) continue;
+
+        // Clients that are caught up all get the same frame, render it once
+        if (built < 0 || !pushQueue.shareFrame(num, built)) {
+            frameLen = pushQueue.buildFrame(num, frameBuf, sizeof(frameBuf));
+            built = num;
+        }
+
+        // Unsent events stay queued for the next tick, until newer ones push them out
+        if (wsServer.sendTXT(num, (uint8_t*)frameBuf, frameLen)) {
+            pushQueue.consumed(num);
+        }
+    }
+}
+
+// ============================================================================
+// Message history
+// ============================================================================
+
+uint32_t EmergencyWiFiService::publishMessage(MessageLogEntry &e, const uint8_t* text) {
+    uint32_t seq = messageLog.append(e, text);
+    if (seq == 0) e.seq = 0; // still worth showing live, there is just nothing to sync later
+
+    char json[WS_PUSH_MAX_EVENT];
+    queueEvent(json, renderMessage(e, text, json, sizeof(json)));
+    return seq;
+}
+
+size_t EmergencyWiFiService::renderMessage(const MessageLogEntry &e, const uint8_t* text, char* out, size_t outMax) {
+    const size_t tailMax = 64; // timestamp, rssi and snr, a long text is cut to leave room for them
+    JsonWriter w(out, outMax);
+    w.beginObject();
+    w.key("type").string("message");
+    w.key("seq").integer(e.seq);
+    w.key("from").stringf("%x", (unsigned)e.from);
+    w.key("to").stringf("%x", (unsigned)e.to);
+    w.key("channel").integer(e.channel);
+    w.key("text").string(text, e.textLen, tailMax);
+    w.key("timestamp").integer(e.rxTime);
+    w.key("rssi").integer(e.rssi);
+    w.key("snr").number(e.snrX4 / 4.0);
+    w.endObject();
+    return w.length();
+}
+
+void EmergencyWiFiService::startSync(uint8_t clientId, uint32_t since, const MessageLogConversation* only) {
+    if (clientId >= WS_PUSH_MAX_CLIENTS) return;
+    Serial.printf("WebSocket[%u] sync since %lu (last %lu)\n", clientId, (unsigned long)since,
+                  (unsigned long)messageLog.getLastSeq());
+    messageLog.startSync(syncs[clientId].cursor, since, only);
+    syncs[clientId].active = true;
+}
+
+void EmergencyWiFiService::flushSyncs() {
+    // One frame per catching-up client per tick, sent directly: a backlog can be far bigger than the push ring
+    static const char doneFormat[] = ",{\"type\":\"sync_done\",\"seq\":%lu}";
+    const size_t doneMax = sizeof(doneFormat) + 10;
+    char json[WS_PUSH_MAX_EVENT];
+    uint8_t text[MSGLOG_MAX_TEXT];
+    MessageLogEntry e;
+
+    for (uint8_t num = 0; num < WS_PUSH_MAX_CLIENTS; num++) {
+        SyncState &sync = syncs[num];
+        if (!sync.active) continue;
+
+        MessageLogCursor start = sync.cursor;
+        size_t n = 0;
+        frameBuf[n++] = '[';
+        while (true) {
+            MessageLogCursor before = sync.cursor;
+            if (!messageLog.next(sync.cursor, e, text)) break;
+            size_t len = renderMessage(e, text, json, sizeof(json));
+            if (n + 1 + len + doneMax + 1 > sizeof(frameBuf)) {
+                sync.cursor = before; // first in the next frame
+                break;
+            }
+            if (n > 1) frameBuf[n++] = ',';
+            memcpy(frameBuf + n, json, len);
+            n += len;
+        }
+        if (sync.cursor.done) {
+            // The client knows where to sync from next time, even with nothing new
+            n += snprintf(frameBuf + n, sizeof(frameBuf) - n, doneFormat + (n > 1 ? 0 : 1),
+                          (unsigned long)messageLog.getLastSeq());
+        }
+        frameBuf[n++] = ']';
+
+        if (!wsServer.sendTXT(num, (uint8_t*)frameBuf, n)) {
+            sync.cursor = start; // try the same frame again next tick
+        } else if (sync.cursor.done) {
+            sync.active = false;
+        }
+    }
 }
 
 void EmergencyWiFiService::stop() {
     wsServer.disconnect();
+    for (uint8_t num = 0; num < WS_PUSH_MAX_CLIENTS; num++) {
+        pushQueue.detach(num);
+        syncs[num].active = false;
+    }
     httpServer.end();
     WiFi.softAPdisconnect(true);
     apActive = false;
@@ -219,8 +417,15 @@ void EmergencyWiFiService::stop() {
 }
 
 void EmergencyWiFiService::broadcastToClients(const char* json) {
-    wsServer.broadcastTXT(json);
-    Serial.printf("Broadcast to all clients: %s\n", json);
+    queueEvent(json, strlen(json));
+}
+
+bool EmergencyWiFiService::queueEvent(const char* json, size_t len, uint8_t clientId) {
+    if (!pushQueue.push(json, len, clientId)) {
+        Serial.printf("WebSocket event too large (%u bytes), dropped\n", (unsigned)len);
+        return false;
+    }
+    return true;
 }
 
 void EmergencyWiFiService::sendToClient(uint8_t clientId, const char* json) {
@@ -5,6 +5,9 @@
 #include <WiFi.h>
 #include <ESPAsyncWebServer.h>
 #include <WebSocketsServer.h>
+#include "MessageLog.h"
+#include "WebAssets.h"
+#include "WsPushQueue.h"
 
 class EmergencyWiFiService {
 public:
@@ -21,6 +24,15 @@ public:
     void broadcastToClients(const char* json);
     void sendToClient(uint8_t clientId, const char* json);
 
+    // Queue one JSON event for every client (or just one), sent from loop() coalesced with the other pending ones.
+    // Never allocates.
+    bool queueEvent(const char* json, size_t len, uint8_t clientId = WS_PUSH_ALL_CLIENTS);
+    const WsPushStats &getPushStats() const { return pushQueue.getStats(); }
+
+    // Store a text message in the history and queue it for every client, returns its sequence number (0 if not stored)
+    uint32_t publishMessage(MessageLogEntry &e, const uint8_t* text);
+    const MessageLogStats &getMessageLogStats() const { return messageLog.getStats(); }
+
     // Node info
     uint32_t getNodeId();
 
@@ -32,12 +44,33 @@ private:
     uint8_t clientCount;
     uint32_t lastClientActivity;
 
+    // Events waiting for the WebSocket clients, and the frame being sent
+    WsPushQueue pushQueue;
+    char frameBuf[WS_PUSH_MAX_FRAME];
+
+    // The packed web app on LittleFS
+    WebAssetManifest webAssets;
+
+    // Message history, and the clients catching up on it
+    MessageLog messageLog;
+    struct SyncState {
+        bool active;
+        MessageLogCursor cursor;
+    };
+    SyncState syncs[WS_PUSH_MAX_CLIENTS];
+
     void setupWiFiAP();
     void setupWebServer();
+    void loadWebAssets();
+    void serveWebAsset(AsyncWebServerRequest* request, const WebAsset &asset);
     void setupWebSocket();
     void handleWebSocketEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length);
     void handleClientMessage(uint8_t clientId, const char* json);
     void sendNodeInfo(uint8_t clientId);
+    void flushPushQueue();
+    void startSync(uint8_t clientId, uint32_t since, const MessageLogConversation* only);
+    void flushSyncs();
+    static size_t renderMessage(const MessageLogEntry &e, const uint8_t* text, char* out, size_t outMax);
 };
 
 extern EmergencyWiFiService wifiService;
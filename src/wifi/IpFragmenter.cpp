@@ -0,0 +1,254 @@
+#include "IpFragmenter.h"
+
+#include <string.h>
+
+static_assert((FRAG_MAX_DATAGRAM + FRAG_MAX_PAYLOAD - 1) / FRAG_MAX_PAYLOAD <= FRAG_MAX_FRAGMENTS,
+              "FRAG_MAX_DATAGRAM needs more fragments than the NACK bitmap can describe");
+
+// Bitmap with the first count fragments set
+static uint16_t allFragments(uint8_t count) {
+    return (uint16_t)((1UL << count) - 1);
+}
+
+IpFragmenter::IpFragmenter(uint16_t firstDatagramId, uint32_t nackDelayMs, uint32_t reassemblyTimeoutMs, uint8_t maxNacks)
+    : nextId(firstDatagramId), nackDelayMs(nackDelayMs), reassemblyTimeoutMs(reassemblyTimeoutMs), maxNacks(maxNacks) {
+    memset(rxSlots, 0, sizeof(rxSlots));
+    memset(txSlots, 0, sizeof(txSlots));
+    memset(recent, 0, sizeof(recent));
+    memset(&stats, 0, sizeof(stats));
+}
+
+// ============================================================================
+// Sending
+// ============================================================================
+
+bool IpFragmenter::sendDatagram(uint32_t dest, const uint8_t* data, size_t len, uint32_t now) {
+    if (len == 0 || len > FRAG_MAX_DATAGRAM)
+        return false;
+
+    uint16_t id = nextId++;
+    uint8_t count = fragmentCount(len);
+
+    // Keep multi-fragment datagrams so NACKs can be answered, replacing the oldest one if needed
+    if (count > 1) {
+        TxSlot* slot = &txSlots[0];
+        for (int i = 0; i < FRAG_TX_SLOTS && slot->used; i++) {
+            if (!txSlots[i].used || now - txSlots[i].sentAt > now - slot->sentAt)
+                slot = &txSlots[i];
+        }
+        slot->used = true;
+        slot->dest = dest;
+        slot->id = id;
+        slot->len = (uint16_t)len;
+        slot->sentAt = now;
+        memcpy(slot->data, data, len);
+        data = slot->data;
+    }
+
+    stats.datagramsSent++;
+    bool ok = true;
+    for (uint8_t i = 0; i < count; i++)
+        ok &= sendFragment(dest, id, data, len, i);
+    return ok;
+}
+
+bool IpFragmenter::sendFragment(uint32_t dest, uint16_t id, const uint8_t* data, size_t len, uint8_t index) {
+    uint8_t frame[FRAG_HEADER_LEN + FRAG_MAX_PAYLOAD];
+    size_t offset = (size_t)index * FRAG_MAX_PAYLOAD;
+    size_t n = len - offset < FRAG_MAX_PAYLOAD ? len - offset : FRAG_MAX_PAYLOAD;
+
+    frame[0] = FRAG_TYPE_DATA;
+    frame[1] = id >> 8;
+    frame[2] = id & 0xFF;
+    frame[3] = index;
+    frame[4] = fragmentCount(len);
+    memcpy(frame + FRAG_HEADER_LEN, data + offset, n);
+
+    stats.fragmentsSent++;
+    return sendFrame(dest, frame, FRAG_HEADER_LEN + n);
+}
+
+void IpFragmenter::handleNack(uint32_t from, const uint8_t* frame) {
+    uint16_t id = (frame[1] << 8) | frame[2];
+    uint16_t received = (frame[3] << 8) | frame[4];
+    stats.nacksReceived++;
+
+    for (int i = 0; i < FRAG_TX_SLOTS; i++) {
+        TxSlot &slot = txSlots[i];
+        if (!slot.used || slot.id != id || (slot.dest != from && slot.dest != FRAG_BROADCAST))
+            continue;
+
+        // Resend just what is missing, to the original destination so every receiver of a broadcast benefits
+        uint8_t count = fragmentCount(slot.len);
+        for (uint8_t f = 0; f < count; f++) {
+            if (!(received & (1 << f))) {
+                stats.fragmentsRetransmitted++;
+                sendFragment(slot.dest, slot.id, slot.data, slot.len, f);
+            }
+        }
+        return;
+    }
+    // Too old, we no longer have it
+}
+
+// ============================================================================
+// Receiving
+// ============================================================================
+
+void IpFragmenter::handleFrame(uint32_t from, const uint8_t* frame, size_t len, uint32_t now) {
+    if (len > FRAG_HEADER_LEN && frame[0] == FRAG_TYPE_DATA)
+        handleData(from, frame, len, now);
+    else if (len == FRAG_NACK_LEN && frame[0] == FRAG_TYPE_NACK)
+        handleNack(from, frame);
+    else
+        stats.malformed++;
+}
+
+IpFragmenter::RxSlot* IpFragmenter::findRxSlot(uint32_t from, uint16_t id) {
+    for (int i = 0; i < FRAG_RX_SLOTS; i++) {
+        if (rxSlots[i].used && rxSlots[i].from == from && rxSlots[i].id == id)
+            return &rxSlots[i];
+    }
+    return nullptr;
+}
+
+IpFragmenter::RxSlot* IpFragmenter::allocRxSlot(uint32_t now) {
+    // A free buffer, or else the one that has been stalled longest if it is overdue for a NACK anyway
+    RxSlot* victim = nullptr;
+    for (int i = 0; i < FRAG_RX_SLOTS; i++) {
+        RxSlot &slot = rxSlots[i];
+        if (!slot.used)
+            return &slot;
+        if ((int32_t)(now - slot.nackAt) >= 0 && (!victim || (int32_t)(slot.nackAt - victim->nackAt) < 0))
+            victim = &slot;
+    }
+    if (victim)
+        stats.timeouts++;
+    return victim;
+}
+
+bool IpFragmenter::isRecent(uint32_t from, uint16_t id) const {
+    for (int i = 0; i < FRAG_RECENT_DATAGRAMS; i++) {
+        if (recent[i].from == from && recent[i].id == id)
+            return true;
+    }
+    return false;
+}
+
+void IpFragmenter::handleData(uint32_t from, const uint8_t* frame, size_t len, uint32_t now) {
+    uint16_t id = (frame[1] << 8) | frame[2];
+    uint8_t index = frame[3];
+    uint8_t count = frame[4];
+    const uint8_t* data = frame + FRAG_HEADER_LEN;
+    size_t n = len - FRAG_HEADER_LEN;
+
+    // Every fragment but the last is full, the last one tells us the datagram length
+    if (count == 0 || count > FRAG_MAX_FRAGMENTS || index >= count || n > FRAG_MAX_PAYLOAD ||
+        (index < count - 1 && n != FRAG_MAX_PAYLOAD) || (size_t)index * FRAG_MAX_PAYLOAD + n > FRAG_MAX_DATAGRAM ||
+        (size_t)(count - 1) * FRAG_MAX_PAYLOAD >= FRAG_MAX_DATAGRAM) {
+        stats.malformed++;
+        return;
+    }
+
+    if (count == 1) {
+        stats.datagramsDelivered++;
+        deliver(from, data, n);
+        return;
+    }
+
+    if (isRecent(from, id)) {
+        stats.duplicates++;
+        return;
+    }
+
+    RxSlot* slot = findRxSlot(from, id);
+    if (!slot) {
+        slot = allocRxSlot(now);
+        if (!slot) {
+            stats.noSlot++;
+            return;
+        }
+        slot->used = true;
+        slot->from = from;
+        slot->id = id;
+        slot->count = count;
+        slot->nacks = 0;
+        slot->received = 0;
+        slot->len = 0;
+        slot->firstSeen = now;
+    } else if (slot->count != count) {
+        stats.malformed++;
+        return;
+    }
+
+    uint16_t bit = 1 << index;
+    if (slot->received & bit) {
+        stats.duplicates++;
+        return;
+    }
+    memcpy(slot->data + (size_t)index * FRAG_MAX_PAYLOAD, data, n);
+    slot->received |= bit;
+    if (index == count - 1)
+        slot->len = (uint16_t)((count - 1) * FRAG_MAX_PAYLOAD + n);
+    slot->nackAt = now + nackDelayMs;
+
+    if (slot->received == allFragments(count)) {
+        recent[recentNext] = {from, id};
+        recentNext = (recentNext + 1) % FRAG_RECENT_DATAGRAMS;
+        stats.datagramsDelivered++;
+        deliver(from, slot->data, slot->len);
+        slot->used = false;
+    }
+}
+
+void IpFragmenter::sendNack(const RxSlot &slot) {
+    uint8_t frame[FRAG_NACK_LEN] = {FRAG_TYPE_NACK, (uint8_t)(slot.id >> 8), (uint8_t)(slot.id & 0xFF),
+                                    (uint8_t)(slot.received >> 8), (uint8_t)(slot.received & 0xFF)};
+    stats.nacksSent++;
+    sendFrame(slot.from, frame, sizeof(frame));
+}
+
+uint32_t IpFragmenter::runTimers(uint32_t now) {
+    uint32_t next = UINT32_MAX;
+
+    for (int i = 0; i < FRAG_RX_SLOTS; i++) {
+        RxSlot &slot = rxSlots[i];
+        if (!slot.used)
+            continue;
+
+        uint32_t expiresIn = reassemblyTimeoutMs - (now - slot.firstSeen);
+        if (now - slot.firstSeen >= reassemblyTimeoutMs || ((int32_t)(now - slot.nackAt) >= 0 && slot.nacks >= maxNacks)) {
+            stats.timeouts++;
+            slot.used = false;
+            continue;
+        }
+        if ((int32_t)(now - slot.nackAt) >= 0) {
+            sendNack(slot);
+            slot.nacks++;
+            slot.nackAt = now + nackDelayMs;
+        }
+        uint32_t nackIn = slot.nackAt - now;
+        next = nackIn < next ? nackIn : next;
+        next = expiresIn < next ? expiresIn : next;
+    }
+
+    for (int i = 0; i < FRAG_TX_SLOTS; i++) {
+        TxSlot &slot = txSlots[i];
+        if (!slot.used)
+            continue;
+        if (now - slot.sentAt >= reassemblyTimeoutMs) {
+            slot.used = false;
+            continue;
+        }
+        uint32_t expiresIn = reassemblyTimeoutMs - (now - slot.sentAt);
+        next = expiresIn < next ? expiresIn : next;
+    }
+    return next;
+}
+
+int IpFragmenter::getPendingCount() const {
+    int n = 0;
+    for (int i = 0; i < FRAG_RX_SLOTS; i++)
+        n += rxSlots[i].used;
+    return n;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest datagram we carry: a WiFi MTU sized packet plus its compression header
+#define FRAG_MAX_DATAGRAM 1501
+
+// Fragment header: type, datagram id (2), index, count
+#define FRAG_HEADER_LEN 5
+
+// Data bytes per fragment, header + data fit one mesh payload (meshtastic_Constants_DATA_PAYLOAD_LEN)
+#define FRAG_MAX_PAYLOAD 228
+
+// Width of the received-fragments bitmap carried in NACKs
+#define FRAG_MAX_FRAGMENTS 16
+
+// Datagrams reassembled at once, each slot holds a full FRAG_MAX_DATAGRAM buffer
+#define FRAG_RX_SLOTS 4
+
+// Sent datagrams kept around to answer NACKs
+#define FRAG_TX_SLOTS 2
+
+// Completed datagrams remembered so late retransmissions are not reassembled twice
+#define FRAG_RECENT_DATAGRAMS 8
+
+#define FRAG_BROADCAST 0xFFFFFFFF
+
+// Frame types (first byte)
+#define FRAG_TYPE_DATA 0x01 // [type][id:2][index][count][data...]
+#define FRAG_TYPE_NACK 0x02 // [type][id:2][received bitmap:2], sent back by the receiver
+#define FRAG_NACK_LEN 5
+
+struct IpFragmenterStats {
+    uint32_t datagramsSent;
+    uint32_t datagramsDelivered;
+    uint32_t fragmentsSent;
+    uint32_t fragmentsRetransmitted;
+    uint32_t nacksSent;
+    uint32_t nacksReceived;
+    uint32_t duplicates; // fragments we already had
+    uint32_t timeouts;   // datagrams given up on, incomplete
+    uint32_t noSlot;     // fragments dropped because every reassembly buffer was busy
+    uint32_t malformed;
+};
+
+/**
+ * Fragmentation and reassembly of IP frames too large for one mesh packet.
+ *
+ * A datagram is cut into up to FRAG_MAX_FRAGMENTS fragments of FRAG_MAX_PAYLOAD bytes sent back to back.  The receiver
+ * reassembles them in one of FRAG_RX_SLOTS fixed buffers (nothing is allocated on the receive path) and delivers the
+ * datagram once every fragment is in.
+ *
+ * Lost fragments are recovered with selective NACKs: when a datagram stops making progress for nackDelayMs the receiver
+ * sends back a bitmap of the fragments it has, and the sender (which keeps its last FRAG_TX_SLOTS multi-fragment datagrams)
+ * resends only the missing ones.  After maxNacks unanswered NACKs, or reassemblyTimeoutMs overall, the datagram is dropped
+ * and the IP layer above deals with it.
+ *
+ * Transport agnostic: subclasses send frames and take delivered datagrams.  Time is passed in so the logic can be driven
+ * from tests.  Not thread safe, call from one thread.
+ */
+class IpFragmenter {
+public:
+    IpFragmenter(uint16_t firstDatagramId = 1, uint32_t nackDelayMs = 8000, uint32_t reassemblyTimeoutMs = 60000,
+                 uint8_t maxNacks = 3);
+    virtual ~IpFragmenter() {}
+
+    /**
+     * Fragment and send a datagram.
+     * @return false if it is too large or a fragment could not be sent
+     */
+    bool sendDatagram(uint32_t dest, const uint8_t* data, size_t len, uint32_t now);
+
+    // Handle a fragment or NACK received from the mesh
+    void handleFrame(uint32_t from, const uint8_t* frame, size_t len, uint32_t now);
+
+    /**
+     * Send due NACKs and expire stale datagrams.
+     * @return ms until the next timer is due, UINT32_MAX if nothing is pending
+     */
+    uint32_t runTimers(uint32_t now);
+
+    const IpFragmenterStats &getStats() const { return stats; }
+
+    // Datagrams currently being reassembled
+    int getPendingCount() const;
+
+protected:
+    // Put one frame on the mesh
+    virtual bool sendFrame(uint32_t dest, const uint8_t* frame, size_t len) = 0;
+
+    // A complete datagram arrived, data is only valid during the call
+    virtual void deliver(uint32_t from, const uint8_t* data, size_t len) = 0;
+
+private:
+    struct RxSlot {
+        bool used;
+        uint32_t from;
+        uint16_t id;
+        uint8_t count;
+        uint8_t nacks;
+        uint16_t received; // bit i set once fragment i is in
+        uint16_t len;      // known once the last fragment arrived
+        uint32_t firstSeen;
+        uint32_t nackAt;
+        uint8_t data[FRAG_MAX_DATAGRAM];
+    };
+
+    struct TxSlot {
+        bool used;
+        uint32_t dest;
+        uint16_t id;
+        uint16_t len;
+        uint32_t sentAt;
+        uint8_t data[FRAG_MAX_DATAGRAM];
+    };
+
+    struct RecentDatagram {
+        uint32_t from;
+        uint16_t id;
+    };
+
+    uint16_t nextId;
+    uint32_t nackDelayMs;
+    uint32_t reassemblyTimeoutMs;
+    uint8_t maxNacks;
+
+    RxSlot rxSlots[FRAG_RX_SLOTS];
+    TxSlot txSlots[FRAG_TX_SLOTS];
+    RecentDatagram recent[FRAG_RECENT_DATAGRAMS];
+    uint8_t recentNext = 0;
+
+    IpFragmenterStats stats;
+
+    static uint8_t fragmentCount(size_t len) { return (uint8_t)((len + FRAG_MAX_PAYLOAD - 1) / FRAG_MAX_PAYLOAD); }
+
+    bool sendFragment(uint32_t dest, uint16_t id, const uint8_t* data, size_t len, uint8_t index);
+    void sendNack(const RxSlot &slot);
+
+    void handleData(uint32_t from, const uint8_t* frame, size_t len, uint32_t now);
+    void handleNack(uint32_t from, const uint8_t* frame);
+
+    RxSlot* findRxSlot(uint32_t from, uint16_t id);
+    RxSlot* allocRxSlot(uint32_t now);
+    bool isRecent(uint32_t from, uint16_t id) const;
+};
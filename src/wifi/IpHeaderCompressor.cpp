@@ -0,0 +1,499 @@
+#include "IpHeaderCompressor.h"
+
+#include <string.h>
+
+#define IP_HEADER_LEN 20
+#define UDP_HEADER_LEN 8
+#define TCP_HEADER_LEN 20
+
+#define PROTO_TCP 6
+#define PROTO_UDP 17
+
+// IR flags byte
+#define IR_SRC_LOCAL 0x01
+#define IR_DST_LOCAL 0x02
+#define IR_DF 0x04
+#define IR_UDP_CSUM_ZERO 0x08
+
+// CO type byte
+#define CO_TOS 0x20
+#define CO_TTL 0x40
+#define CO_ID_MASK 0x03
+#define CO_ID_SEQ 0  // previous ID + 1, only used when DF is set
+#define CO_ID_LSB 1  // low 8 bits
+#define CO_ID_FULL 2 // all 16 bits
+#define CO_ID_SAME 3 // unchanged (stacks that always send 0)
+
+#define TCP_FLAG_URG 0x20
+
+namespace {
+
+uint16_t get16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+uint32_t get32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+void put16(uint8_t* p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+}
+
+// Bounds checked cursor for building frames and packets
+struct Writer {
+    uint8_t* buf;
+    size_t max;
+    size_t pos = 0;
+    bool overflow = false;
+
+    Writer(uint8_t* _buf, size_t _max) : buf(_buf), max(_max) {}
+
+    void bytes(const uint8_t* src, size_t n) {
+        if (overflow || pos + n > max) {
+            overflow = true;
+            return;
+        }
+        memcpy(buf + pos, src, n);
+        pos += n;
+    }
+    void u8(uint8_t v) { bytes(&v, 1); }
+    void u16(uint16_t v) {
+        uint8_t b[2] = {(uint8_t)(v >> 8), (uint8_t)v};
+        bytes(b, 2);
+    }
+    void u32(uint32_t v) {
+        uint8_t b[4] = {(uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v};
+        bytes(b, 4);
+    }
+};
+
+// Bounds checked cursor for parsing frames, reads past the end return 0 and set error
+struct Reader {
+    const uint8_t* buf;
+    size_t len;
+    size_t pos = 0;
+    bool error = false;
+
+    Reader(const uint8_t* _buf, size_t _len) : buf(_buf), len(_len) {}
+
+    bool has(size_t n) {
+        if (error || pos + n > len)
+            error = true;
+        return !error;
+    }
+    uint8_t u8() { return has(1) ? buf[pos++] : 0; }
+    uint16_t u16() {
+        if (!has(2))
+            return 0;
+        pos += 2;
+        return get16(buf + pos - 2);
+    }
+    uint32_t u32() {
+        if (!has(4))
+            return 0;
+        pos += 4;
+        return get32(buf + pos - 4);
+    }
+    void copyTo(Writer &w, size_t n) {
+        if (!has(n))
+            return;
+        w.bytes(buf + pos, n);
+        pos += n;
+    }
+};
+
+bool hasPorts(uint8_t protocol) {
+    return protocol == PROTO_UDP || protocol == PROTO_TCP;
+}
+
+// Partial sum of the TCP/UDP pseudo header
+uint32_t pseudoHeaderSum(uint32_t src, uint32_t dst, uint8_t protocol, size_t len) {
+    return (src >> 16) + (src & 0xFFFF) + (dst >> 16) + (dst & 0xFFFF) + protocol + (uint32_t)len;
+}
+
+} // namespace
+
+IpHeaderCompressor::IpHeaderCompressor(uint32_t localSubnet) : localSubnet(localSubnet & 0xFFFFFF00) {
+    reset();
+}
+
+void IpHeaderCompressor::reset() {
+    memset(txFlows, 0, sizeof(txFlows));
+    memset(rxContexts, 0, sizeof(rxContexts));
+}
+
+uint16_t IpHeaderCompressor::checksum(const uint8_t* data, size_t len, uint32_t sum) {
+    for (size_t i = 0; i + 1 < len; i += 2)
+        sum += get16(data + i);
+    if (len & 1)
+        sum += data[len - 1] << 8;
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+// ============================================================================
+// Compressor
+// ============================================================================
+
+IpHeaderCompressor::TxFlow* IpHeaderCompressor::findTxFlow(const FlowKey &key) {
+    for (int i = 0; i < IPHC_MAX_FLOWS; i++) {
+        if (txFlows[i].used && txFlows[i].state.key == key)
+            return &txFlows[i];
+    }
+    return nullptr;
+}
+
+size_t IpHeaderCompressor::compressRaw(const uint8_t* ip, size_t len, uint8_t* out, size_t outMax) {
+    Writer w(out, outMax);
+    w.u8(IPHC_TYPE_RAW);
+    w.bytes(ip, len);
+    if (w.overflow)
+        return 0;
+    rawPackets++;
+    return w.pos;
+}
+
+size_t IpHeaderCompressor::compress(const uint8_t* ip, size_t len, uint8_t* out, size_t outMax) {
+    tick++;
+
+    // Plain 20 byte IPv4 header, unfragmented, with a valid checksum
+    if (len < IP_HEADER_LEN || ip[0] != 0x45 || get16(ip + 2) != len || (get16(ip + 6) & 0xBFFF) != 0 ||
+        checksum(ip, IP_HEADER_LEN) != 0)
+        return compressRaw(ip, len, out, outMax);
+
+    HeaderState h;
+    memset(&h, 0, sizeof(h));
+    h.key.src = get32(ip + 12);
+    h.key.dst = get32(ip + 16);
+    h.key.protocol = ip[9];
+    h.tos = ip[1];
+    h.ttl = ip[8];
+    h.ipId = get16(ip + 4);
+    h.dontFragment = (ip[6] & 0x40) != 0;
+
+    const uint8_t* transport = ip + IP_HEADER_LEN;
+    size_t transportLen = len - IP_HEADER_LEN;
+    size_t headerLen = 0; // transport header bytes, payload follows
+    uint32_t pseudo = pseudoHeaderSum(h.key.src, h.key.dst, h.key.protocol, transportLen);
+
+    // The receiver recomputes lengths and checksums, so only take packets where they are right
+    if (h.key.protocol == PROTO_UDP) {
+        if (transportLen < UDP_HEADER_LEN || get16(transport + 4) != transportLen)
+            return compressRaw(ip, len, out, outMax);
+        h.udpChecksumZero = get16(transport + 6) == 0;
+        if (!h.udpChecksumZero && checksum(transport, transportLen, pseudo) != 0)
+            return compressRaw(ip, len, out, outMax);
+        headerLen = UDP_HEADER_LEN;
+    } else if (h.key.protocol == PROTO_TCP) {
+        if (transportLen < TCP_HEADER_LEN)
+            return compressRaw(ip, len, out, outMax);
+        headerLen = (transport[12] >> 4) * 4;
+        if (headerLen < TCP_HEADER_LEN || headerLen > transportLen ||
+            (!(transport[13] & TCP_FLAG_URG) && get16(transport + 18) != 0) || checksum(transport, transportLen, pseudo) != 0)
+            return compressRaw(ip, len, out, outMax);
+    }
+    if (hasPorts(h.key.protocol)) {
+        h.key.srcPort = get16(transport);
+        h.key.dstPort = get16(transport + 2);
+    }
+
+    TxFlow* flow = findTxFlow(h.key);
+    if (!flow) {
+        // New flow, take a free context or the least recently used one
+        flow = &txFlows[0];
+        for (int i = 0; i < IPHC_MAX_FLOWS && flow->used; i++) {
+            if (!txFlows[i].used || txFlows[i].lastUsed < flow->lastUsed)
+                flow = &txFlows[i];
+        }
+        uint8_t generation = (flow->generation + 1) & 0x0F;
+        memset(flow, 0, sizeof(*flow));
+        flow->used = true;
+        flow->generation = generation;
+        flow->needIR = true;
+        flow->state.key = h.key;
+        flow->stats.srcIP = h.key.src;
+        flow->stats.dstIP = h.key.dst;
+        flow->stats.srcPort = h.key.srcPort;
+        flow->stats.dstPort = h.key.dstPort;
+        flow->stats.protocol = h.key.protocol;
+    }
+
+    const HeaderState &ctx = flow->state;
+    uint8_t cidGen = (uint8_t)(((flow - txFlows) << 4) | flow->generation);
+    bool sendIR = flow->needIR || flow->sinceRefresh >= IPHC_REFRESH_INTERVAL || h.dontFragment != ctx.dontFragment ||
+                  h.udpChecksumZero != ctx.udpChecksumZero;
+
+    Writer w(out, outMax);
+    if (sendIR) {
+        uint8_t flags = (isLocal(h.key.src) ? IR_SRC_LOCAL : 0) | (isLocal(h.key.dst) ? IR_DST_LOCAL : 0) |
+                        (h.dontFragment ? IR_DF : 0) | (h.udpChecksumZero ? IR_UDP_CSUM_ZERO : 0);
+        w.u8(IPHC_TYPE_IR);
+        w.u8(cidGen);
+        w.u8(flags);
+        w.u8(h.tos);
+        w.u8(h.ttl);
+        w.u8(h.key.protocol);
+        w.u16(h.ipId);
+        if (flags & IR_SRC_LOCAL)
+            w.u8(h.key.src & 0xFF);
+        else
+            w.u32(h.key.src);
+        if (flags & IR_DST_LOCAL)
+            w.u8(h.key.dst & 0xFF);
+        else
+            w.u32(h.key.dst);
+        if (hasPorts(h.key.protocol)) {
+            w.u16(h.key.srcPort);
+            w.u16(h.key.dstPort);
+        }
+    } else {
+        uint16_t idDelta = (uint16_t)(h.ipId - ctx.ipId);
+        uint8_t idMode;
+        if (idDelta == 0)
+            idMode = CO_ID_SAME;
+        else if (idDelta == 1 && h.dontFragment)
+            idMode = CO_ID_SEQ;
+        else if (idDelta <= 256)
+            idMode = CO_ID_LSB;
+        else
+            idMode = CO_ID_FULL;
+
+        uint8_t type = IPHC_TYPE_CO | idMode | (h.tos != ctx.tos ? CO_TOS : 0) | (h.ttl != ctx.ttl ? CO_TTL : 0);
+        w.u8(type);
+        w.u8(cidGen);
+        if (type & CO_TOS)
+            w.u8(h.tos);
+        if (type & CO_TTL)
+            w.u8(h.ttl);
+        if (idMode == CO_ID_LSB)
+            w.u8(h.ipId & 0xFF);
+        else if (idMode == CO_ID_FULL)
+            w.u16(h.ipId);
+    }
+
+    // TCP fields the context cannot predict: seq, ack, offset/flags, window, urgent pointer if used, options
+    if (h.key.protocol == PROTO_TCP) {
+        w.bytes(transport + 4, 12);
+        if (transport[13] & TCP_FLAG_URG)
+            w.bytes(transport + 18, 2);
+        w.bytes(transport + TCP_HEADER_LEN, headerLen - TCP_HEADER_LEN);
+    }
+    w.bytes(transport + headerLen, transportLen - headerLen);
+    if (w.overflow)
+        return 0;
+
+    flow->state = h;
+    flow->needIR = false;
+    flow->sinceRefresh = sendIR ? 1 : flow->sinceRefresh + 1;
+    flow->lastUsed = tick;
+    flow->stats.packets++;
+    flow->stats.bytesIn += len;
+    flow->stats.bytesOut += w.pos;
+    return w.pos;
+}
+
+int IpHeaderCompressor::getFlowCount() const {
+    int n = 0;
+    for (int i = 0; i < IPHC_MAX_FLOWS; i++)
+        n += txFlows[i].used;
+    return n;
+}
+
+bool IpHeaderCompressor::getFlowStats(int i, IphcFlowStats &stats) const {
+    for (int f = 0; f < IPHC_MAX_FLOWS; f++) {
+        if (txFlows[f].used && i-- == 0) {
+            stats = txFlows[f].stats;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ============================================================================
+// Decompressor
+// ============================================================================
+
+IpHeaderCompressor::RxContext* IpHeaderCompressor::findRxContext(uint32_t node, uint8_t cid) {
+    for (int i = 0; i < IPHC_MAX_RX_CONTEXTS; i++) {
+        if (rxContexts[i].used && rxContexts[i].node == node && rxContexts[i].cid == cid)
+            return &rxContexts[i];
+    }
+    return nullptr;
+}
+
+IpHeaderCompressor::RxContext* IpHeaderCompressor::allocRxContext(uint32_t node, uint8_t cid) {
+    RxContext* ctx = &rxContexts[0];
+    for (int i = 0; i < IPHC_MAX_RX_CONTEXTS && ctx->used; i++) {
+        if (!rxContexts[i].used || rxContexts[i].lastUsed < ctx->lastUsed)
+            ctx = &rxContexts[i];
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->used = true;
+    ctx->node = node;
+    ctx->cid = cid;
+    return ctx;
+}
+
+size_t IpHeaderCompressor::rebuild(const HeaderState &h, const uint8_t* body, size_t bodyLen, uint8_t* out, size_t outMax) {
+    Writer w(out, outMax);
+    Reader r(body, bodyLen);
+
+    // IPv4 header, length and checksum are filled in once we know the size
+    w.u8(0x45);
+    w.u8(h.tos);
+    w.u16(0);
+    w.u16(h.ipId);
+    w.u16(h.dontFragment ? 0x4000 : 0);
+    w.u8(h.ttl);
+    w.u8(h.key.protocol);
+    w.u16(0);
+    w.u32(h.key.src);
+    w.u32(h.key.dst);
+
+    if (h.key.protocol == PROTO_UDP) {
+        w.u16(h.key.srcPort);
+        w.u16(h.key.dstPort);
+        w.u32(0); // length and checksum
+    } else if (h.key.protocol == PROTO_TCP) {
+        if (!r.has(12))
+            return 0;
+        const uint8_t* fields = body + r.pos;
+        size_t headerLen = (fields[8] >> 4) * 4;
+        if (headerLen < TCP_HEADER_LEN)
+            return 0;
+        w.u16(h.key.srcPort);
+        w.u16(h.key.dstPort);
+        r.copyTo(w, 12); // seq, ack, offset/flags, window
+        w.u16(0);        // checksum
+        if (fields[9] & TCP_FLAG_URG)
+            r.copyTo(w, 2);
+        else
+            w.u16(0);
+        r.copyTo(w, headerLen - TCP_HEADER_LEN);
+    }
+    r.copyTo(w, bodyLen - r.pos);
+    if (r.error || w.overflow || w.pos > 0xFFFF)
+        return 0;
+
+    size_t total = w.pos;
+    put16(out + 2, (uint16_t)total);
+    put16(out + 10, checksum(out, IP_HEADER_LEN));
+
+    uint8_t* transport = out + IP_HEADER_LEN;
+    size_t transportLen = total - IP_HEADER_LEN;
+    uint32_t pseudo = pseudoHeaderSum(h.key.src, h.key.dst, h.key.protocol, transportLen);
+    if (h.key.protocol == PROTO_UDP) {
+        put16(transport + 4, (uint16_t)transportLen);
+        if (!h.udpChecksumZero) {
+            uint16_t sum = checksum(transport, transportLen, pseudo);
+            put16(transport + 6, sum ? sum : 0xFFFF);
+        }
+    } else if (h.key.protocol == PROTO_TCP) {
+        put16(transport + 16, checksum(transport, transportLen, pseudo));
+    }
+    return total;
+}
+
+IphcResult IpHeaderCompressor::decompress(uint32_t fromNode, const uint8_t* in, size_t len, uint8_t* out, size_t outMax,
+                                          size_t &outLen) {
+    outLen = 0;
+    if (len < 1)
+        return IPHC_MALFORMED;
+    tick++;
+
+    Reader r(in, len);
+    uint8_t type = r.u8();
+
+    if (type == IPHC_TYPE_RAW) {
+        if (len - 1 > outMax)
+            return IPHC_MALFORMED;
+        memcpy(out, in + 1, len - 1);
+        outLen = len - 1;
+        return IPHC_OK;
+    }
+
+    uint8_t cidGen = r.u8();
+    uint8_t cid = cidGen >> 4, generation = cidGen & 0x0F;
+    if (r.error)
+        return IPHC_MALFORMED;
+
+    if (type == IPHC_TYPE_FEEDBACK) {
+        // The receiver lost this context, resend a full header with the next packet
+        if (txFlows[cid].used && txFlows[cid].generation == generation)
+            txFlows[cid].needIR = true;
+        return IPHC_FEEDBACK;
+    }
+
+    HeaderState h;
+    RxContext* ctx = nullptr;
+    if (type == IPHC_TYPE_IR) {
+        memset(&h, 0, sizeof(h));
+        uint8_t flags = r.u8();
+        h.tos = r.u8();
+        h.ttl = r.u8();
+        h.key.protocol = r.u8();
+        h.ipId = r.u16();
+        h.key.src = (flags & IR_SRC_LOCAL) ? localSubnet | r.u8() : r.u32();
+        h.key.dst = (flags & IR_DST_LOCAL) ? localSubnet | r.u8() : r.u32();
+        h.dontFragment = (flags & IR_DF) != 0;
+        h.udpChecksumZero = (flags & IR_UDP_CSUM_ZERO) != 0;
+        if (hasPorts(h.key.protocol)) {
+            h.key.srcPort = r.u16();
+            h.key.dstPort = r.u16();
+        }
+    } else if (type & IPHC_TYPE_CO) {
+        ctx = findRxContext(fromNode, cid);
+        if (!ctx || ctx->generation != generation) {
+            // Ask the sender for a full header, the packet itself is lost
+            if (outMax >= 2) {
+                out[0] = IPHC_TYPE_FEEDBACK;
+                out[1] = cidGen;
+                outLen = 2;
+            }
+            return IPHC_NO_CONTEXT;
+        }
+        h = ctx->state;
+        if (type & CO_TOS)
+            h.tos = r.u8();
+        if (type & CO_TTL)
+            h.ttl = r.u8();
+        switch (type & CO_ID_MASK) {
+        case CO_ID_SEQ:
+            h.ipId++;
+            break;
+        case CO_ID_LSB: {
+            // Closest ID after the last one we saw that has these low bits
+            uint8_t lsb = r.u8();
+            h.ipId = (uint16_t)(h.ipId + 1 + (uint8_t)(lsb - (uint8_t)(h.ipId + 1)));
+            break;
+        }
+        case CO_ID_FULL:
+            h.ipId = r.u16();
+            break;
+        default: // CO_ID_SAME
+            break;
+        }
+    } else {
+        return IPHC_MALFORMED;
+    }
+    if (r.error)
+        return IPHC_MALFORMED;
+
+    size_t n = rebuild(h, in + r.pos, len - r.pos, out, outMax);
+    if (!n)
+        return IPHC_MALFORMED;
+
+    if (!ctx) {
+        ctx = findRxContext(fromNode, cid);
+        if (!ctx)
+            ctx = allocRxContext(fromNode, cid);
+        ctx->generation = generation;
+    }
+    ctx->state = h;
+    ctx->lastUsed = tick;
+    outLen = n;
+    return IPHC_OK;
+}
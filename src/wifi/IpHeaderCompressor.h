@@ -0,0 +1,151 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Flows compressed at once, the context id is 4 bits on the air
+#define IPHC_MAX_FLOWS 16
+
+// (sender node, context id) pairs remembered on the receiving side
+#define IPHC_MAX_RX_CONTEXTS 32
+
+// Send a full header every this many packets of a flow, so a receiver that lost its context recovers even without feedback
+#define IPHC_REFRESH_INTERVAL 32
+
+// AP subnet (192.168.4.0/24): addresses inside it only cost their last octet
+#define IPHC_LOCAL_SUBNET ((192U << 24) | (168U << 16) | (4U << 8))
+
+// Frame types (first byte of every compressed frame)
+#define IPHC_TYPE_RAW 0x00      // IPv4 packet sent as is (options, fragments, bad checksums...)
+#define IPHC_TYPE_IR 0x01       // Full header, (re)initialises a context
+#define IPHC_TYPE_FEEDBACK 0x02 // Receiver lost a context, please resend a full header
+#define IPHC_TYPE_CO 0x80       // Compressed header, low bits carry the field flags
+
+enum IphcResult {
+    IPHC_OK,         // out holds the rebuilt IPv4 packet
+    IPHC_FEEDBACK,   // feedback frame for our compressor, consumed, nothing to inject
+    IPHC_NO_CONTEXT, // unknown or stale context, out holds a feedback frame to send back to the sender
+    IPHC_MALFORMED   // truncated or inconsistent frame, dropped
+};
+
+// Per-flow compression counters
+struct IphcFlowStats {
+    uint32_t srcIP;
+    uint32_t dstIP;
+    uint16_t srcPort;
+    uint16_t dstPort;
+    uint8_t protocol;
+    uint32_t packets;
+    uint32_t bytesIn;  // uncompressed IPv4 bytes
+    uint32_t bytesOut; // bytes put on the air
+};
+
+/**
+ * Stateful IPv4/UDP/TCP header compression for the LoRa bridge, in the spirit of ROHC (RFC 3095) and 6LoWPAN IPHC.
+ *
+ * The first packet of a flow (src IP, dst IP, protocol, ports) is sent with a full header (IR) that sets up a context on the
+ * receiver.  Following packets (CO) only carry what changed:
+ * - addresses, ports and protocol are elided, AP subnet addresses only cost one byte even in IR frames
+ * - total length and UDP length come from the frame length
+ * - IP ID is sent as its low 8 bits (decoded against the last ID received, so a few lost frames do not matter), or not at all
+ *   for sequential IDs on DF packets where the ID is meaningless
+ * - TTL and TOS only when they change
+ * - IPv4, UDP and TCP checksums are recomputed by the receiver
+ *
+ * A plain UDP packet shrinks from 28 header bytes to 2-3, a TCP one from 40 to 14 plus options.
+ *
+ * Contexts are keyed by sender node on the receiving side.  A receiver that gets a CO frame for a context it does not know
+ * (it rebooted, or the IR was lost) answers with a FEEDBACK frame and the sender's next packet for that flow carries a full
+ * header again.  IR frames are also repeated every IPHC_REFRESH_INTERVAL packets for one-way flows.
+ *
+ * Packets we cannot compress safely (IP options, fragments, invalid checksums) go out as RAW frames.
+ *
+ * Pure byte-buffer code with no platform dependencies so it can be tested on the native build.
+ */
+class IpHeaderCompressor {
+public:
+    explicit IpHeaderCompressor(uint32_t localSubnet = IPHC_LOCAL_SUBNET);
+
+    /**
+     * Compress one IPv4 packet.
+     * @return frame length written to out, 0 if it does not fit in outMax
+     */
+    size_t compress(const uint8_t* ip, size_t len, uint8_t* out, size_t outMax);
+
+    /**
+     * Decode a frame received from fromNode.
+     * @param outLen set to the number of bytes written to out (a packet for IPHC_OK, feedback for IPHC_NO_CONTEXT)
+     */
+    IphcResult decompress(uint32_t fromNode, const uint8_t* in, size_t len, uint8_t* out, size_t outMax, size_t &outLen);
+
+    // Forget every context on both sides
+    void reset();
+
+    // Flows currently tracked by the compressor
+    int getFlowCount() const;
+    bool getFlowStats(int i, IphcFlowStats &stats) const;
+
+    uint32_t getRawCount() const { return rawPackets; }
+
+    // Internet checksum (RFC 1071) of len bytes, starting from a partial sum
+    static uint16_t checksum(const uint8_t* data, size_t len, uint32_t sum = 0);
+
+private:
+    struct FlowKey {
+        uint32_t src;
+        uint32_t dst;
+        uint16_t srcPort;
+        uint16_t dstPort;
+        uint8_t protocol;
+
+        bool operator==(const FlowKey &o) const {
+            return src == o.src && dst == o.dst && srcPort == o.srcPort && dstPort == o.dstPort && protocol == o.protocol;
+        }
+    };
+
+    // Fields a context remembers between packets
+    struct HeaderState {
+        FlowKey key;
+        uint8_t tos;
+        uint8_t ttl;
+        uint16_t ipId;
+        bool dontFragment;
+        bool udpChecksumZero;
+    };
+
+    struct TxFlow {
+        bool used;
+        uint8_t generation; // bumped whenever the cid is given to a new flow
+        bool needIR;
+        uint8_t sinceRefresh;
+        uint32_t lastUsed;
+        HeaderState state;
+        IphcFlowStats stats;
+    };
+
+    struct RxContext {
+        bool used;
+        uint32_t node;
+        uint8_t cid;
+        uint8_t generation;
+        uint32_t lastUsed;
+        HeaderState state;
+    };
+
+    uint32_t localSubnet;
+    uint32_t tick = 0; // LRU clock, counts frames rather than milliseconds
+    uint32_t rawPackets = 0;
+
+    TxFlow txFlows[IPHC_MAX_FLOWS];
+    RxContext rxContexts[IPHC_MAX_RX_CONTEXTS];
+
+    bool isLocal(uint32_t addr) const { return (addr & 0xFFFFFF00) == localSubnet; }
+
+    TxFlow* findTxFlow(const FlowKey &key);
+    RxContext* findRxContext(uint32_t node, uint8_t cid);
+    RxContext* allocRxContext(uint32_t node, uint8_t cid);
+
+    size_t compressRaw(const uint8_t* ip, size_t len, uint8_t* out, size_t outMax);
+    // Expand a context plus the rest of a frame (transport fields and payload) into an IPv4 packet, 0 if malformed
+    size_t rebuild(const HeaderState &h, const uint8_t* body, size_t bodyLen, uint8_t* out, size_t outMax);
+};
@@ -0,0 +1,526 @@
+#include "MessageLog.h"
+
+#ifdef FSCom
+
+#include "SPILock.h"
+#include "SafeFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ARCH_NRF52) || defined(ARCH_STM32WL)
+#define MSGLOG_APPEND FILE_O_WRITE // Adafruit LittleFS opens for writing at the end of the file
+#else
+#define MSGLOG_APPEND "a"
+#endif
+
+// On flash a record is magic, hash, the entry as laid out in RAM (all our targets are little-endian) and the text
+#define MSGLOG_RECORD_MAGIC 0xA7
+#define MSGLOG_RECORD_HEADER (2 + sizeof(MessageLogEntry))
+
+#define MSGLOG_INDEX_MAGIC 0x4D4C4F47 // "MLOG"
+#define MSGLOG_INDEX_VERSION 1
+
+struct MessageLogIndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t segmentBytes;
+    uint32_t nextSeq;
+    uint32_t segmentCount;
+    uint32_t conversationCount;
+};
+
+static uint8_t xorHash(uint8_t hash, const uint8_t* p, size_t len) {
+    for (size_t i = 0; i < len; i++)
+        hash ^= p[i];
+    return hash;
+}
+
+static bool writeRecordTo(File &f, const MessageLogEntry &e, const uint8_t* text) {
+    uint8_t header[MSGLOG_RECORD_HEADER];
+    MessageLogEntry copy;
+    memset(&copy, 0, sizeof(copy)); // padding is hashed too
+    copy.seq = e.seq;
+    copy.from = e.from;
+    copy.to = e.to;
+    copy.rxTime = e.rxTime;
+    copy.rssi = e.rssi;
+    copy.snrX4 = e.snrX4;
+    copy.channel = e.channel;
+    copy.flags = e.flags;
+    copy.textLen = e.textLen;
+
+    header[0] = MSGLOG_RECORD_MAGIC;
+    memcpy(header + 2, &copy, sizeof(copy));
+    header[1] = xorHash(xorHash(0, header + 2, sizeof(copy)), text, e.textLen);
+
+    return f.write(header, sizeof(header)) == sizeof(header) &&
+           (e.textLen == 0 || f.write((uint8_t*)text, e.textLen) == e.textLen);
+}
+
+// Size of the record at the current position of f, 0 if it is not whole and valid
+static uint32_t readRecordFrom(File &f, uint32_t room, MessageLogEntry &e, uint8_t* text) {
+    uint8_t header[MSGLOG_RECORD_HEADER];
+    if (room < sizeof(header) || (size_t)f.read(header, sizeof(header)) != sizeof(header) || header[0] != MSGLOG_RECORD_MAGIC)
+        return 0;
+    memcpy(&e, header + 2, sizeof(e));
+    if (room < sizeof(header) + e.textLen || (e.textLen && (size_t)f.read(text, e.textLen) != e.textLen))
+        return 0;
+    if (xorHash(xorHash(0, header + 2, sizeof(e)), text, e.textLen) != header[1])
+        return 0;
+    return sizeof(header) + e.textLen;
+}
+
+MessageLog::MessageLog(const char* dir, uint32_t segmentBytes) : dir(dir), segmentBytes(segmentBytes) {
+    memset(segments, 0, sizeof(segments));
+    memset(conversations, 0, sizeof(conversations));
+}
+
+void MessageLog::segmentPath(uint32_t id, char* out, size_t outMax) const {
+    snprintf(out, outMax, "%s/seg%05lu", dir, (unsigned long)id);
+}
+
+void MessageLog::indexPath(char* out, size_t outMax) const {
+    snprintf(out, outMax, "%s/index", dir);
+}
+
+// ============================================================================
+// Startup and recovery
+// ============================================================================
+
+bool MessageLog::begin() {
+    {
+        concurrency::LockGuard g(spiLock);
+        if (!FSCom.exists(dir) && !FSCom.mkdir(dir)) {
+            LOG_ERROR("MessageLog: can't create %s", dir);
+            return false;
+        }
+    }
+
+    if (!loadIndex()) {
+        rebuild();
+    } else if (!replay(segments[segmentCount - 1], segments[segmentCount - 1].bytes)) {
+        // Power went while the last message was being written
+        damagedTail = true;
+        stats.damaged++;
+    }
+
+    ready = true;
+    LOG_INFO("MessageLog: %d segments, %d conversations, last seq %lu", segmentCount, conversationCount,
+             (unsigned long)getLastSeq());
+    return true;
+}
+
+bool MessageLog::loadIndex() {
+    char path[48];
+    indexPath(path, sizeof(path));
+    MessageLogIndexHeader h;
+
+    {
+        concurrency::LockGuard g(spiLock);
+        File f = FSCom.open(path, FILE_O_READ);
+        if (!f)
+            return false;
+        bool ok = (size_t)f.read((uint8_t*)&h, sizeof(h)) == sizeof(h) && h.magic == MSGLOG_INDEX_MAGIC &&
+                  h.version == MSGLOG_INDEX_VERSION && h.segmentBytes == segmentBytes && h.segmentCount >= 1 &&
+                  h.segmentCount <= MSGLOG_MAX_SEGMENTS && h.conversationCount <= MSGLOG_MAX_CONVERSATIONS;
+        size_t segmentsSize = h.segmentCount * sizeof(Segment);
+        size_t conversationsSize = h.conversationCount * sizeof(MessageLogConversation);
+        ok = ok && (size_t)f.read((uint8_t*)segments, segmentsSize) == segmentsSize;
+        ok = ok && (size_t)f.read((uint8_t*)conversations, conversationsSize) == conversationsSize;
+        f.close();
+        if (!ok) {
+            LOG_WARN("MessageLog: index unreadable, rebuilding");
+            return false;
+        }
+
+        // The segments must still hold at least what the index says, the active one may have grown since
+        for (uint32_t i = 0; i < h.segmentCount; i++) {
+            char seg[48];
+            segmentPath(segments[i].id, seg, sizeof(seg));
+            File s = FSCom.open(seg, FILE_O_READ);
+            bool present = s && s.size() >= segments[i].bytes;
+            if (s)
+                s.close();
+            if (!present) {
+                LOG_WARN("MessageLog: segment %lu does not match the index, rebuilding", (unsigned long)segments[i].id);
+                return false;
+            }
+        }
+    }
+
+    segmentCount = h.segmentCount;
+    conversationCount = h.conversationCount;
+    nextSeq = h.nextSeq;
+    return true;
+}
+
+bool MessageLog::saveIndex() {
+    char path[48];
+    indexPath(path, sizeof(path));
+
+    MessageLogIndexHeader h = {MSGLOG_INDEX_MAGIC, MSGLOG_INDEX_VERSION, segmentBytes,
+                               nextSeq,            (uint32_t)segmentCount, (uint32_t)conversationCount};
+    SafeFile f(path, true);
+    f.write((const uint8_t*)&h, sizeof(h));
+    f.write((const uint8_t*)segments, segmentCount * sizeof(Segment));
+    f.write((const uint8_t*)conversations, conversationCount * sizeof(MessageLogConversation));
+    if (!f.close()) {
+        // Not fatal: the next boot rebuilds it from the segments
+        LOG_ERROR("MessageLog: can't save index");
+        return false;
+    }
+    return true;
+}
+
+static int compareIds(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+void MessageLog::rebuild() {
+    segmentCount = 0;
+    conversationCount = 0;
+    nextSeq = 1;
+
+    // Whatever segments are there, newest last
+    uint32_t ids[MSGLOG_MAX_SEGMENTS * 2];
+    int found = 0;
+    {
+        concurrency::LockGuard g(spiLock);
+        File root = FSCom.open(dir, FILE_O_READ);
+        if (root) {
+            File file = root.openNextFile();
+            while (file && file.name()[0]) {
+                // Some platforms give the full path, some only the name
+                const char* name = strrchr(file.name(), '/') ? strrchr(file.name(), '/') + 1 : file.name();
+                char* end;
+                if (strncmp(name, "seg", 3) == 0 && found < MSGLOG_MAX_SEGMENTS * 2) {
+                    uint32_t id = strtoul(name + 3, &end, 10);
+                    if (*end == 0)
+                        ids[found++] = id;
+                }
+                file.close();
+                file = root.openNextFile();
+            }
+            root.close();
+        }
+    }
+    qsort(ids, found, sizeof(ids[0]), compareIds);
+
+    for (int i = 0; i < found; i++) {
+        char path[48];
+        segmentPath(ids[i], path, sizeof(path));
+        if (i < found - MSGLOG_MAX_SEGMENTS) {
+            concurrency::LockGuard g(spiLock);
+            FSCom.remove(path);
+            continue;
+        }
+        Segment &s = segments[segmentCount++];
+        memset(&s, 0, sizeof(s));
+        s.id = ids[i];
+        if (!replay(s, 0)) {
+            stats.damaged++;
+            damagedTail = (i == found - 1);
+        }
+    }
+
+    if (segmentCount == 0) {
+        startSegment();
+    } else {
+        stats.rebuilds++;
+        LOG_WARN("MessageLog: index rebuilt from %d segments", segmentCount);
+    }
+    saveIndex();
+}
+
+bool MessageLog::replay(Segment &s, uint32_t from) {
+    char path[48];
+    segmentPath(s.id, path, sizeof(path));
+    MessageLogEntry e;
+    uint8_t text[MSGLOG_MAX_TEXT];
+
+    concurrency::LockGuard g(spiLock);
+    File f = FSCom.open(path, FILE_O_READ);
+    if (!f)
+        return from == 0;
+    uint32_t fileSize = f.size();
+    uint32_t offset = from;
+    f.seek(offset);
+    while (offset < fileSize) {
+        uint32_t size = readRecordFrom(f, fileSize - offset, e, text);
+        if (size == 0)
+            break;
+        noteRecord(s, e, size);
+        countMessage(e, conversationOf(e), 1);
+        if (e.seq >= nextSeq)
+            nextSeq = e.seq + 1;
+        offset += size;
+    }
+    f.close();
+    // Readers stop at s.bytes, anything after it is garbage
+    s.bytes = offset;
+    return offset == fileSize;
+}
+
+// ============================================================================
+// Appending
+// ============================================================================
+
+void MessageLog::noteRecord(Segment &s, const MessageLogEntry &e, uint32_t size) {
+    if (s.bytes == 0 || e.seq < s.minSeq)
+        s.minSeq = e.seq;
+    if (e.seq > s.maxSeq)
+        s.maxSeq = e.seq;
+    s.conversationMask |= conversationBit(conversationOf(e));
+    s.bytes += size;
+}
+
+void MessageLog::startSegment() {
+    Segment &s = segments[segmentCount];
+    uint32_t id = segmentCount ? segments[segmentCount - 1].id + 1 : 0;
+    memset(&s, 0, sizeof(s));
+    s.id = id;
+    segmentCount++;
+
+    // A leftover from before a rebuild would be appended to
+    char path[48];
+    segmentPath(id, path, sizeof(path));
+    concurrency::LockGuard g(spiLock);
+    FSCom.remove(path);
+}
+
+void MessageLog::rollover() {
+    stats.rollovers++;
+    damagedTail = false;
+    startSegment();
+    if (segmentCount > MSGLOG_MAX_SEGMENTS)
+        compactOldest();
+    saveIndex();
+}
+
+bool MessageLog::writeRecord(Segment &s, const MessageLogEntry &e, const uint8_t* text) {
+    char path[48];
+    segmentPath(s.id, path, sizeof(path));
+
+    concurrency::LockGuard g(spiLock);
+    File f = FSCom.open(path, MSGLOG_APPEND);
+    if (!f)
+        return false;
+    bool ok = writeRecordTo(f, e, text);
+    f.close();
+    if (ok)
+        noteRecord(s, e, MSGLOG_RECORD_HEADER + e.textLen);
+    return ok;
+}
+
+uint32_t MessageLog::append(MessageLogEntry &e, const uint8_t* text) {
+    if (!ready)
+        return 0;
+
+    uint32_t size = MSGLOG_RECORD_HEADER + e.textLen;
+    Segment* active = &segments[segmentCount - 1];
+    if (damagedTail || (active->bytes > 0 && active->bytes + size > segmentBytes)) {
+        rollover();
+        active = &segments[segmentCount - 1];
+    }
+
+    e.seq = nextSeq;
+    if (!writeRecord(*active, e, text)) {
+        // Part of it may be on flash, keep it out of the way of the next one
+        LOG_ERROR("MessageLog: can't write to segment %lu", (unsigned long)active->id);
+        stats.appendFailures++;
+        damagedTail = true;
+        return 0;
+    }
+    nextSeq++;
+    countMessage(e, conversationOf(e), 1);
+    stats.appended++;
+    return e.seq;
+}
+
+void MessageLog::compactOldest() {
+    Segment old = segments[0];
+    Segment &active = segments[segmentCount - 1];
+    char oldPath[48], activePath[48];
+    segmentPath(old.id, oldPath, sizeof(oldPath));
+    segmentPath(active.id, activePath, sizeof(activePath));
+    stats.compactions++;
+
+    // A message is carried forward if fewer than MSGLOG_KEEP_PER_CONVERSATION of its conversation come after it.
+    // The newer ones are counted as we go, the rest of the log holds all the others.
+    uint16_t seen[MSGLOG_MAX_CONVERSATIONS] = {};
+    uint16_t gone[MSGLOG_MAX_CONVERSATIONS] = {};
+    MessageLogEntry e;
+    uint8_t text[MSGLOG_MAX_TEXT];
+    {
+        concurrency::LockGuard g(spiLock);
+        File in = FSCom.open(oldPath, FILE_O_READ);
+        File out = FSCom.open(activePath, MSGLOG_APPEND);
+        uint32_t offset = 0;
+        while (in && offset < old.bytes) {
+            uint32_t size = readRecordFrom(in, old.bytes - offset, e, text);
+            if (size == 0)
+                break;
+            offset += size;
+
+            int c = findConversation(conversationOf(e));
+            bool keep = c >= 0 && conversations[c].count - 1 - seen[c] < MSGLOG_KEEP_PER_CONVERSATION;
+            if (c >= 0)
+                seen[c]++;
+            // Never let the carried messages take more than half the new segment
+            if (keep && out && active.bytes + size <= segmentBytes / 2 && writeRecordTo(out, e, text)) {
+                noteRecord(active, e, size);
+                stats.carried++;
+            } else {
+                if (c >= 0)
+                    gone[c]++;
+                stats.dropped++;
+            }
+        }
+        if (in)
+            in.close();
+        if (out)
+            out.close();
+        FSCom.remove(oldPath);
+    }
+
+    memmove(segments, segments + 1, (segmentCount - 1) * sizeof(Segment));
+    segmentCount--;
+
+    // Backwards, removing a conversation moves the last one into its place
+    for (int c = conversationCount - 1; c >= 0; c--) {
+        if (gone[c] >= conversations[c].count)
+            conversations[c] = conversations[--conversationCount];
+        else
+            conversations[c].count -= gone[c];
+    }
+}
+
+// ============================================================================
+// Conversations
+// ============================================================================
+
+MessageLogConversation MessageLog::conversationOf(const MessageLogEntry &e) {
+    MessageLogConversation c = {};
+    if (e.flags & MSGLOG_FLAG_CHANNEL) {
+        c.peer = e.channel;
+        c.flags = MSGLOG_FLAG_CHANNEL;
+    } else {
+        c.peer = (e.flags & MSGLOG_FLAG_OUTGOING) ? e.to : e.from;
+    }
+    return c;
+}
+
+uint32_t MessageLog::conversationBit(const MessageLogConversation &c) {
+    return 1u << (((c.peer ^ c.flags) * 2654435761u) >> 27);
+}
+
+int MessageLog::findConversation(const MessageLogConversation &c) const {
+    for (int i = 0; i < conversationCount; i++) {
+        if (conversations[i].peer == c.peer && conversations[i].flags == c.flags)
+            return i;
+    }
+    return -1;
+}
+
+void MessageLog::countMessage(const MessageLogEntry &e, const MessageLogConversation &c, int delta) {
+    int i = findConversation(c);
+    if (i < 0) {
+        if (delta < 0)
+            return;
+        if (conversationCount < MSGLOG_MAX_CONVERSATIONS) {
+            i = conversationCount++;
+        } else {
+            // Forget the quietest one, its messages stay readable but compaction no longer protects them
+            i = 0;
+            for (int j = 1; j < conversationCount; j++) {
+                if (conversations[j].lastSeq < conversations[i].lastSeq)
+                    i = j;
+            }
+        }
+        conversations[i] = c;
+        conversations[i].count = 0;
+        conversations[i].lastSeq = 0;
+    }
+
+    conversations[i].count += delta;
+    if (e.seq > conversations[i].lastSeq)
+        conversations[i].lastSeq = e.seq;
+}
+
+// ============================================================================
+// Sync
+// ============================================================================
+
+int MessageLog::findSegment(uint32_t id) const {
+    // The first segment at or after id: the one the cursor was in may have been compacted away
+    for (int i = 0; i < segmentCount; i++) {
+        if (segments[i].id >= id)
+            return i;
+    }
+    return -1;
+}
+
+void MessageLog::startSync(MessageLogCursor &c, uint32_t since, const MessageLogConversation* only) const {
+    memset(&c, 0, sizeof(c));
+    c.since = since;
+    c.segment = segmentCount ? segments[0].id : 0;
+    if (only) {
+        c.filtered = true;
+        c.only.peer = only->peer;
+        c.only.flags = only->flags;
+    }
+}
+
+bool MessageLog::next(MessageLogCursor &c, MessageLogEntry &e, uint8_t* text) {
+    while (!c.done) {
+        int i = findSegment(c.segment);
+        if (i < 0) {
+            c.done = true;
+            break;
+        }
+        const Segment &s = segments[i];
+        if (s.id != c.segment) {
+            c.segment = s.id;
+            c.offset = 0;
+        }
+
+        bool skip = c.offset >= s.bytes || s.maxSeq <= c.since ||
+                    (c.filtered && !(s.conversationMask & conversationBit(c.only)));
+        if (!skip) {
+            char path[48];
+            segmentPath(s.id, path, sizeof(path));
+            concurrency::LockGuard g(spiLock);
+            File f = FSCom.open(path, FILE_O_READ);
+            if (f)
+                f.seek(c.offset);
+            while (f && c.offset < s.bytes) {
+                uint32_t size = readRecordFrom(f, s.bytes - c.offset, e, text);
+                if (size == 0) {
+                    c.offset = s.bytes;
+                    break;
+                }
+                c.offset += size;
+
+                MessageLogConversation conv = conversationOf(e);
+                if (e.seq > c.since && (!c.filtered || (conv.peer == c.only.peer && conv.flags == c.only.flags))) {
+                    f.close();
+                    return true;
+                }
+            }
+            if (f)
+                f.close();
+        }
+
+        // On to the next segment, or done after the active one
+        if (i == segmentCount - 1)
+            c.done = true;
+        c.segment = s.id + 1;
+        c.offset = 0;
+    }
+    return false;
+}
+
+#endif
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "FSCommon.h"
+#include "configuration.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef FSCom
+
+// Where the log lives, one file per segment plus the index
+#define MSGLOG_DIR "/msglog"
+
+// Segment size: what a rollover costs to compact, and the granularity history is dropped at
+#define MSGLOG_SEGMENT_BYTES 16384
+
+// Segments kept, the log never takes more than MSGLOG_MAX_SEGMENTS * MSGLOG_SEGMENT_BYTES of flash
+#define MSGLOG_MAX_SEGMENTS 8
+
+// Conversations (direct peers and channels) followed by the index
+#define MSGLOG_MAX_CONVERSATIONS 32
+
+// Messages of each conversation that survive compaction of the segment holding them, however old
+#define MSGLOG_KEEP_PER_CONVERSATION 8
+
+// Longest text stored, a mesh payload always fits
+#define MSGLOG_MAX_TEXT 255
+
+#define MSGLOG_FLAG_CHANNEL 0x01  // sent to a channel rather than to one node
+#define MSGLOG_FLAG_OUTGOING 0x02 // sent by one of our WiFi clients
+
+// One stored message, text aside
+struct MessageLogEntry {
+    uint32_t seq;    // assigned by append(), increasing for the life of the log
+    uint32_t from;
+    uint32_t to;
+    uint32_t rxTime; // seconds since the epoch, 0 if we had no time
+    int16_t rssi;
+    int16_t snrX4;   // SNR in quarter dB
+    uint8_t channel;
+    uint8_t flags;   // MSGLOG_FLAG_*
+    uint8_t textLen;
+};
+
+// A conversation: the other node of a direct message, or a channel
+struct MessageLogConversation {
+    uint32_t peer;    // node number, or channel index with MSGLOG_FLAG_CHANNEL
+    uint8_t flags;    // MSGLOG_FLAG_CHANNEL or 0
+    uint32_t lastSeq;
+    uint16_t count;   // messages still in the log
+};
+
+// Where a sync has got to, see startSync()
+struct MessageLogCursor {
+    uint32_t since;
+    uint32_t segment; // segment id, not position: compaction may remove segments under a running sync
+    uint32_t offset;
+    bool filtered;    // only one conversation
+    MessageLogConversation only;
+    bool done;
+};
+
+struct MessageLogStats {
+    uint32_t appended;
+    uint32_t appendFailures;
+    uint32_t rollovers;
+    uint32_t compactions;
+    uint32_t carried;  // messages copied forward by compaction
+    uint32_t dropped;  // messages gone with a compacted segment
+    uint32_t damaged;  // segments cut short at a torn or corrupt record
+    uint32_t rebuilds; // times the index had to be rebuilt from the segments
+};
+
+/**
+ * Append-only message history in flash, so WiFi clients that come back can catch up on what they missed.
+ *
+ * Messages go into fixed size segment files.  When a segment is full a new one is started, and once there are
+ * MSGLOG_MAX_SEGMENTS the oldest is compacted away: the last MSGLOG_KEEP_PER_CONVERSATION messages of each conversation
+ * in it are copied forward so a quiet contact keeps its history while a busy channel churns through the log.
+ *
+ * Integrity follows SafeFile: every record carries an xor hash of its bytes and the index is written through SafeFile
+ * (atomic replace, read back).  The index is saved at each rollover, on boot only the active segment is replayed; a
+ * record that does not check out (power lost mid-write) ends its segment and the next append starts a new one.
+ *
+ * Records are read back by sequence number with a cursor, a few at a time, so a sync never holds more than one record
+ * in RAM.
+ */
+class MessageLog {
+public:
+    explicit MessageLog(const char* dir = MSGLOG_DIR, uint32_t segmentBytes = MSGLOG_SEGMENT_BYTES);
+
+    // Load the index and replay the active segment, rebuilding the index from the segments if it does not match
+    bool begin();
+
+    /**
+     * Store a message, e.seq is set to its sequence number.
+     * @return the sequence number, 0 if it could not be written
+     */
+    uint32_t append(MessageLogEntry &e, const uint8_t* text);
+
+    /**
+     * Start reading the messages newer than since, of one conversation if only is not NULL.  Messages carried forward
+     * by compaction may come after newer ones: order by seq on the client.
+     */
+    void startSync(MessageLogCursor &c, uint32_t since, const MessageLogConversation* only = NULL) const;
+
+    /**
+     * The next message of a sync, text gets MSGLOG_MAX_TEXT bytes at most.
+     * @return false when the sync is complete
+     */
+    bool next(MessageLogCursor &c, MessageLogEntry &e, uint8_t* text);
+
+    uint32_t getLastSeq() const { return nextSeq - 1; }
+    int getSegmentCount() const { return segmentCount; }
+    int getConversationCount() const { return conversationCount; }
+    const MessageLogConversation &getConversation(int i) const { return conversations[i]; }
+    const MessageLogStats &getStats() const { return stats; }
+
+    // The conversation a message belongs to: its channel, or the other node
+    static MessageLogConversation conversationOf(const MessageLogEntry &e);
+
+private:
+    struct Segment {
+        uint32_t id;
+        uint32_t bytes;
+        uint32_t minSeq;
+        uint32_t maxSeq;
+        uint32_t conversationMask; // bit per conversation hash, lets a filtered sync skip whole segments
+    };
+
+    const char* dir;
+    uint32_t segmentBytes;
+    uint32_t nextSeq = 1;
+    bool ready = false;
+    bool damagedTail = false; // the active segment ends in a bad record, append elsewhere
+
+    // Oldest first, the last one is the one being appended to.  One spare while the oldest is being compacted.
+    Segment segments[MSGLOG_MAX_SEGMENTS + 1];
+    int segmentCount = 0;
+
+    MessageLogConversation conversations[MSGLOG_MAX_CONVERSATIONS];
+    int conversationCount = 0;
+
+    MessageLogStats stats = {};
+
+    void segmentPath(uint32_t id, char* out, size_t outMax) const;
+    void indexPath(char* out, size_t outMax) const;
+    bool loadIndex();
+    bool saveIndex();
+    void rebuild();
+    // Read a segment's valid records from offset on into the indexes, returns false if it ends in a bad record
+    bool replay(Segment &s, uint32_t from);
+
+    void startSegment();
+    void rollover();
+    void compactOldest();
+    bool writeRecord(Segment &s, const MessageLogEntry &e, const uint8_t* text);
+
+    int findSegment(uint32_t id) const;
+    int findConversation(const MessageLogConversation &c) const;
+    void countMessage(const MessageLogEntry &e, const MessageLogConversation &c, int delta);
+    static uint32_t conversationBit(const MessageLogConversation &c);
+    static void noteRecord(Segment &s, const MessageLogEntry &e, uint32_t size);
+};
+
+#endif
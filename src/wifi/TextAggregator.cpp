@@ -0,0 +1,118 @@
+#include "TextAggregator.h"
+
+#include <string.h>
+
+TextAggregator::TextAggregator() {
+    memset(batches, 0, sizeof(batches));
+    memset(used, 0, sizeof(used));
+}
+
+bool TextAggregator::add(uint32_t dest, uint8_t channel, bool wantAck, const AggregateRequest &req,
+                         const uint8_t* text, size_t len, uint32_t now, uint32_t windowMs, AggregateBatch &full,
+                         bool &fullReady) {
+    fullReady = false;
+    // A message alone in a batch still has to fit (which also keeps its length within the one byte record length)
+    if (windowMs == 0 || len == 0 || len + 2 > AGG_MAX_PAYLOAD)
+        return false;
+
+    int slot = -1;
+    for (int i = 0; i < AGG_MAX_BATCHES; i++) {
+        const AggregateBatch &b = batches[i];
+        if (used[i] && b.dest == dest && b.channel == channel && b.wantAck == wantAck) {
+            slot = i;
+            break;
+        }
+    }
+
+    if (slot >= 0 && (batches[slot].count == AGG_MAX_MESSAGES || batches[slot].len + len + 2 > AGG_MAX_PAYLOAD)) {
+        take(slot, full);
+        fullReady = true;
+        slot = -1;
+    }
+
+    if (slot < 0) {
+        for (int i = 0; i < AGG_MAX_BATCHES && slot < 0; i++) {
+            if (!used[i])
+                slot = i;
+        }
+        if (slot < 0)
+            return false;
+        AggregateBatch &b = batches[slot];
+        used[slot] = true;
+        b.dest = dest;
+        b.channel = channel;
+        b.wantAck = wantAck;
+        b.dueAt = now + windowMs;
+        b.count = 0;
+        b.len = 0;
+    }
+
+    AggregateBatch &b = batches[slot];
+    b.payload[b.len++] = AGG_TLV_TEXT;
+    b.payload[b.len++] = (uint8_t)len;
+    memcpy(b.payload + b.len, text, len);
+    b.len += len;
+    b.requests[b.count++] = req;
+    stats.messages++;
+    return true;
+}
+
+void TextAggregator::take(int i, AggregateBatch &out) {
+    out = batches[i];
+    used[i] = false;
+    stats.batches++;
+}
+
+bool TextAggregator::takeDue(uint32_t now, AggregateBatch &out, bool all) {
+    // Oldest window first
+    int best = -1;
+    for (int i = 0; i < AGG_MAX_BATCHES; i++) {
+        if (!used[i] || (!all && (int32_t)(now - batches[i].dueAt) < 0))
+            continue;
+        if (best < 0 || (int32_t)(batches[i].dueAt - batches[best].dueAt) < 0)
+            best = i;
+    }
+    if (best < 0)
+        return false;
+    take(best, out);
+    return true;
+}
+
+int32_t TextAggregator::msUntilDue(uint32_t now) const {
+    int32_t next = -1;
+    for (int i = 0; i < AGG_MAX_BATCHES; i++) {
+        if (!used[i])
+            continue;
+        int32_t left = (int32_t)(batches[i].dueAt - now);
+        if (left < 0)
+            left = 0;
+        if (next < 0 || left < next)
+            next = left;
+    }
+    return next;
+}
+
+int TextAggregator::getPendingCount() const {
+    int n = 0;
+    for (int i = 0; i < AGG_MAX_BATCHES; i++)
+        n += used[i];
+    return n;
+}
+
+bool TextAggregator::nextText(const uint8_t* payload, size_t len, size_t &offset, const uint8_t* &text,
+                              size_t &textLen) {
+    while (offset + 2 <= len) {
+        uint8_t type = payload[offset];
+        size_t n = payload[offset + 1];
+        if (offset + 2 + n > len)
+            return false;
+        const uint8_t* value = payload + offset + 2;
+        offset += 2 + n;
+        if (type == AGG_TLV_TEXT) {
+            text = value;
+            textLen = n;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest aggregate payload, what fits in a meshtastic_Data payload
+#define AGG_MAX_PAYLOAD 233
+
+// Messages in one aggregate, each keeps its own request id for delivery status
+#define AGG_MAX_MESSAGES 16
+
+// Batches (destination, channel, want_ack combinations) filling up at once
+#define AGG_MAX_BATCHES 4
+
+// TLV record types.  Unknown types are skipped, so later versions can add some.
+#define AGG_TLV_TEXT 0x01
+
+// A message waiting in a batch, who to tell what became of it
+struct AggregateRequest {
+    uint8_t client;
+    uint32_t requestId;
+};
+
+// Messages for the same destination and channel, packed as [type][length][value] records
+struct AggregateBatch {
+    uint32_t dest;
+    uint8_t channel;
+    bool wantAck;
+    uint32_t dueAt;  // millis() when the window closes
+    uint8_t count;
+    uint16_t len;
+    uint8_t payload[AGG_MAX_PAYLOAD];
+    AggregateRequest requests[AGG_MAX_MESSAGES];
+};
+
+struct AggregateStats {
+    uint32_t messages; // messages that went through a batch
+    uint32_t batches;  // batches handed out, single message ones included
+};
+
+/**
+ * Packs short text messages bound for the same destination and channel into one payload, so a burst of WiFi messages
+ * costs one LoRa preamble and header instead of one each.
+ *
+ * A message opens a batch (or joins the open one for its destination, channel and want_ack) which is handed out when
+ * its window closes or when the next message does not fit.  The window is chosen by the caller per batch, so it can
+ * follow the channel load.
+ *
+ * Pure bookkeeping with no mesh dependencies so it can be tested on the native build.
+ */
+class TextAggregator {
+public:
+    TextAggregator();
+
+    /**
+     * Queue a message for at most windowMs.  If its batch has no room left the batch is moved to full, which must be
+     * sent right away, and the message opens a new one.
+     * @return false if the message cannot be aggregated (too long, no window, no free batch): send it on its own
+     */
+    bool add(uint32_t dest, uint8_t channel, bool wantAck, const AggregateRequest &req, const uint8_t* text,
+             size_t len, uint32_t now, uint32_t windowMs, AggregateBatch &full, bool &fullReady);
+
+    // Move one batch whose window has closed (any batch if all) to out, false if none
+    bool takeDue(uint32_t now, AggregateBatch &out, bool all = false);
+
+    // Milliseconds until the next window closes, -1 if nothing is waiting
+    int32_t msUntilDue(uint32_t now) const;
+
+    int getPendingCount() const;
+    const AggregateStats &getStats() const { return stats; }
+
+    /**
+     * Iterate over the texts of a payload, offset starts at 0.  Records of unknown types are skipped.
+     * @return false at the end of the payload or on a truncated record
+     */
+    static bool nextText(const uint8_t* payload, size_t len, size_t &offset, const uint8_t* &text, size_t &textLen);
+
+private:
+    AggregateBatch batches[AGG_MAX_BATCHES];
+    bool used[AGG_MAX_BATCHES];
+    AggregateStats stats = {};
+
+    void take(int i, AggregateBatch &out);
+};
@@ -0,0 +1,93 @@
+#include "WebAssets.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Copy the next space separated field of line into out, false if there is none or it does not fit
+static bool nextField(const char* &p, const char* end, char* out, size_t outMax, bool toEnd = false) {
+    while (p < end && *p == ' ')
+        p++;
+    const char* start = p;
+    while (p < end && (toEnd || *p != ' '))
+        p++;
+    size_t len = p - start;
+    while (toEnd && len > 0 && (start[len - 1] == ' ' || start[len - 1] == '\r'))
+        len--;
+    if (len == 0 || len >= outMax)
+        return false;
+    memcpy(out, start, len);
+    out[len] = 0;
+    return true;
+}
+
+bool WebAssetManifest::parseLine(const char* line, size_t len, WebAsset &out) {
+    const char* p = line;
+    const char* end = line + len;
+    char hash[WEB_ASSET_ETAG_MAX - 2];
+    char maxAge[12];
+    char* ageEnd;
+
+    if (!nextField(p, end, out.url, sizeof(out.url)) || out.url[0] != '/')
+        return false;
+    if (!nextField(p, end, hash, sizeof(hash)) || !nextField(p, end, maxAge, sizeof(maxAge)))
+        return false;
+    if (!nextField(p, end, out.type, sizeof(out.type), true))
+        return false;
+    out.maxAge = strtoul(maxAge, &ageEnd, 10);
+    if (*ageEnd != 0)
+        return false;
+
+    out.etag[0] = '"';
+    strcpy(out.etag + 1, hash);
+    strcat(out.etag, "\"");
+    return true;
+}
+
+int WebAssetManifest::parse(const char* text, size_t len) {
+    count = 0;
+    const char* end = text + len;
+    for (const char* line = text; line < end && count < WEB_ASSET_MAX;) {
+        const char* eol = (const char*)memchr(line, '\n', end - line);
+        if (!eol)
+            eol = end;
+        if (line < eol && *line != '#' && parseLine(line, eol - line, assets[count]))
+            count++;
+        line = eol + 1;
+    }
+    return count;
+}
+
+const WebAsset* WebAssetManifest::find(const char* url) const {
+    if (strcmp(url, "/") == 0)
+        url = "/index.html";
+    for (int i = 0; i < count; i++) {
+        if (strcmp(assets[i].url, url) == 0)
+            return &assets[i];
+    }
+    return NULL;
+}
+
+bool WebAssetManifest::etagMatches(const char* ifNoneMatch, const char* etag) {
+    if (!ifNoneMatch)
+        return false;
+    size_t etagLen = strlen(etag);
+    const char* p = ifNoneMatch;
+    while (*p) {
+        while (*p == ' ' || *p == ',')
+            p++;
+        if (*p == '*')
+            return true;
+        // If-None-Match uses the weak comparison: W/"x" matches "x"
+        if (p[0] == 'W' && p[1] == '/')
+            p += 2;
+        const char* start = p;
+        while (*p && *p != ',')
+            p++;
+        const char* stop = p;
+        while (stop > start && stop[-1] == ' ')
+            stop--;
+        if ((size_t)(stop - start) == etagLen && memcmp(start, etag, etagLen) == 0)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Assets the web app may have, the manifest is generated by bin/webapp-pack.py
+#define WEB_ASSET_MAX 16
+#define WEB_ASSET_URL_MAX 48
+#define WEB_ASSET_TYPE_MAX 40
+#define WEB_ASSET_ETAG_MAX 20 // 16 hex digits and the quotes
+
+// Where the packed assets live on LittleFS: <dir><url>.gz, and the manifest describing them
+#define WEB_ASSET_DIR "/webapp"
+#define WEB_ASSET_MANIFEST WEB_ASSET_DIR "/assets.txt"
+
+struct WebAsset {
+    char url[WEB_ASSET_URL_MAX];
+    char etag[WEB_ASSET_ETAG_MAX];   // strong ETag, quoted, from the content hash
+    char type[WEB_ASSET_TYPE_MAX];
+    uint32_t maxAge;                 // seconds the browser may use it without asking, 0 to revalidate every time
+};
+
+/**
+ * The packed web app: which URLs exist, their content type, ETag and cache lifetime.
+ *
+ * The manifest is one asset per line, "<url> <hash> <max-age> <content-type>", written by bin/webapp-pack.py next to
+ * the gzipped files.  Entry points (index.html, the service worker and its precache list) get max-age 0 so a new
+ * firmware's UI shows up on the next load, at the cost of a 304 round trip; everything else is kept for a week.
+ */
+class WebAssetManifest {
+public:
+    WebAssetManifest() : count(0) {}
+
+    // Parse a whole manifest, replacing what was there. Returns the number of assets, bad lines are skipped.
+    int parse(const char* text, size_t len);
+
+    // The asset served for a URL ("/" is "/index.html"), NULL if there is none
+    const WebAsset* find(const char* url) const;
+
+    int getCount() const { return count; }
+
+    // Whether an If-None-Match header value (a list, maybe weak, or "*") covers etag: the client's copy is current
+    static bool etagMatches(const char* ifNoneMatch, const char* etag);
+
+private:
+    WebAsset assets[WEB_ASSET_MAX];
+    int count;
+
+    bool parseLine(const char* line, size_t len, WebAsset &out);
+};
@@ -7,12 +7,20 @@
 #include <lwip/ip.h>
 #include <lwip/udp.h>
 #include <lwip/tcp.h>
+#include <lwip/tcpip.h>
 #include <esp_wifi.h>
 #include <dhcpserver/dhcpserver.h>
+#include "NodeDB.h"
+#include "concurrency/LockGuard.h"
 #include "modules/EmergencyWiFiBridge.h"
+#include "modules/IpTunnelModule.h"
 
 WiFiMeshBridge wifiMeshBridge;
 
+// Ethernet header in front of the IP packet in what the AP interface receives
+#define BRIDGE_ETH_HEADER 14
+#define BRIDGE_ETHERTYPE_IPV4 0x0800
+
 // Static pointer for callbacks
 static WiFiMeshBridge* s_instance = nullptr;
 
@@ -127,14 +135,18 @@ void WiFiMeshBridge::setupNetworkBridge() {
     esp_err_t err = tcpip_adapter_get_netif(TCPIP_ADAPTER_IF_AP, (void**)&netif_ap);
 
     if (err == ESP_OK && netif_ap) {
+        apNetif = netif_ap;
+        // What the clients send comes through here first, traffic for the mesh is taken out before lwIP sees it
+        if (netif_ap->input != netifInput) {
+            apInput = netif_ap->input;
+            netif_ap->input = netifInput;
+        }
         Serial.println("✓ Network interface hooked for packet interception");
         Serial.printf("  Interface name: %c%c%d\n",
                      netif_ap->name[0], netif_ap->name[1], netif_ap->num);
-        // Note: Actual packet interception will be implemented via LWIP hooks
-        // For now, this confirms we can access the network interface
     } else {
         Serial.printf("⚠ Warning: Could not hook network interface (error: %d)\n", err);
-        Serial.println("  Packet routing will use alternative method");
+        Serial.println("  Nothing is bridged from WiFi to the mesh");
     }
 }
 
@@ -184,11 +196,13 @@ void WiFiMeshBridge::onWiFiEvent(WiFiEvent_t event, WiFiEventInfo_t info) {
 void WiFiMeshBridge::handleClientConnected(const uint8_t* mac) {
     clientCount = WiFi.softAPgetStationNum();
 
-    // Assign IP and add to local routing table
-    uint32_t ip = assignClientIP(mac);
-    addRoute(ip, getNodeId(), true); // Mark as local client
-
-    Serial.printf("  Assigned IP: 192.168.4.%d\n", ip & 0xFF);
+    // Lease an IP (the same one as last time for a returning client) and route it locally
+    uint32_t ip = routes.leaseFor(mac, getNodeId(), millis());
+    if (ip) {
+        Serial.printf("  Assigned IP: 192.168.4.%u\n", (unsigned)(ip & 0xFF));
+    } else {
+        Serial.println("⚠ WARNING: No free address lease for this client");
+    }
     Serial.printf("  Total clients: %d/%d\n", clientCount, MAX_WIFI_CLIENTS);
 
     if (clientCount >= MAX_WIFI_CLIENTS) {
@@ -201,21 +215,15 @@ void WiFiMeshBridge::handleClientDisconnected(const uint8_t* mac) {
 
     Serial.printf("  Remaining clients: %d/%d\n", clientCount, MAX_WIFI_CLIENTS);
 
-    // Cleanup will happen in loop() via removeStaleRoutes()
-}
-
-uint32_t WiFiMeshBridge::assignClientIP(const uint8_t* mac) {
-    // Generate IP from last byte of MAC
-    // IP range: 192.168.4.100 - 192.168.4.107
-    uint8_t ipLast = DHCP_POOL_START + (mac[5] % MAX_WIFI_CLIENTS);
-
-    uint32_t ip = (192U << 24) | (168U << 16) | (4U << 8) | ipLast;
-    return ip;
+    // Keep the lease for when it comes back, but stop routing to it
+    routes.releaseLease(mac, millis());
 }
 
 void WiFiMeshBridge::loop() {
     if (!apActive) return;
 
+    bridgeQueued();
+
     uint32_t now = millis();
 
     // Check connections every 5 seconds
@@ -253,16 +261,12 @@ void WiFiMeshBridge::checkConnections() {
                          station.mac[0], station.mac[1], station.mac[2],
                          station.mac[3], station.mac[4], station.mac[5],
                          ip4addr_ntoa((const ip4_addr_t*)&station.ip));
-        }
-    }
-}
 
-void WiFiMeshBridge::cleanupStaleConnections() {
-    // This is automatically handled by ESP32 WiFi stack
-    // Just log any issues
-    if (clientCount > MAX_WIFI_CLIENTS) {
-        Serial.println("⚠ WARNING: Client count exceeds maximum!");
-        clientCount = MAX_WIFI_CLIENTS;
+            // The DHCP server has the final say on which address a client got
+            if (station.ip.addr) {
+                routes.bindLease(station.mac, lwip_ntohl(station.ip.addr), getNodeId(), millis());
+            }
+        }
     }
 }
 
@@ -272,12 +276,19 @@ void WiFiMeshBridge::stop() {
     // Stop DHCP server
     tcpip_adapter_dhcps_stop(TCPIP_ADAPTER_IF_AP);
 
+    // Give the interface its own input back
+    if (apNetif && apInput) {
+        apNetif->input = apInput;
+        apInput = nullptr;
+    }
+
     // Disconnect all clients
     WiFi.softAPdisconnect(true);
 
     apActive = false;
     clientCount = 0;
-    routingTable.clear();
+    routes.clear();
+    headerCompressor.reset();
 
     Serial.println("✓ WiFi Mesh Bridge stopped");
 }
@@ -287,12 +298,9 @@ void WiFiMeshBridge::stop() {
 // ============================================================================
 
 void WiFiMeshBridge::addRoute(uint32_t ip, uint32_t nodeId, bool isLocal) {
-    RouteEntry entry;
-    entry.nodeId = nodeId;
-    entry.lastSeen = millis();
-    entry.isLocal = isLocal;
-
-    routingTable[ip] = entry;
+    if (!routes.learn(ip, nodeId, isLocal ? ROUTE_LOCAL : ROUTE_OBSERVED, millis())) {
+        return;
+    }
 
     Serial.printf("Route added: IP %s → Node 0x%04X (%s)\n",
                  IPAddress(ip).toString().c_str(),
@@ -301,95 +309,217 @@ void WiFiMeshBridge::addRoute(uint32_t ip, uint32_t nodeId, bool isLocal) {
 }
 
 bool WiFiMeshBridge::getRoute(uint32_t ip, uint32_t &nodeId) {
-    auto it = routingTable.find(ip);
-    if (it != routingTable.end()) {
-        nodeId = it->second.nodeId;
-        it->second.lastSeen = millis(); // Update last seen
-        return true;
+    if (!routes.contains(ip)) {
+        learnRouteFromNodeDB(ip);
+    }
+    const RouteEntry* route = routes.lookup(ip, millis());
+    if (!route) {
+        return false;
+    }
+    nodeId = route->nodeId;
+    return true;
+}
+
+bool WiFiMeshBridge::learnRouteFromNodeDB(uint32_t ip) {
+    // Mesh node addresses (10.115.x.y) name a node by the low 16 bits of its number, find the node they belong to
+    if ((ip & 0xFFFF0000) != ROUTE_MESH_SUBNET || !nodeDB) {
+        return false;
+    }
+
+    for (size_t i = 0; i < nodeDB->getNumMeshNodes(); i++) {
+        const meshtastic_NodeInfoLite* node = nodeDB->getMeshNodeByIndex(i);
+        if (node && node->num != nodeDB->getNodeNum() && (node->num & 0xFFFF) == (ip & 0xFFFF)) {
+            return routes.learn(ip, node->num, ROUTE_NODEDB, millis());
+        }
     }
     return false;
 }
 
 void WiFiMeshBridge::removeStaleRoutes() {
-    uint32_t now = millis();
-    const uint32_t ROUTE_TIMEOUT = 5 * 60 * 1000; // 5 minutes
-
-    auto it = routingTable.begin();
-    while (it != routingTable.end()) {
-        if (!it->second.isLocal && (now - it->second.lastSeen > ROUTE_TIMEOUT)) {
-            Serial.printf("Removing stale route: IP %s\n",
-                         IPAddress(it->first).toString().c_str());
-            it = routingTable.erase(it);
-        } else {
-            ++it;
+    int removed = routes.expire(millis());
+    if (removed > 0) {
+        Serial.printf("Removed %d stale routes\n", removed);
+    }
+}
+
+// ============================================================================
+// Packet Bridging (IP <-> LoRa)
+// ============================================================================
+
+err_t WiFiMeshBridge::netifInput(struct pbuf *p, struct netif *inp) {
+    WiFiMeshBridge* self = s_instance;
+    if (!self || !self->apInput) {
+        pbuf_free(p);
+        return ERR_OK;
+    }
+
+    // Runs on the WiFi task: only look at the Ethernet and IP headers here, the rest is up to loop()
+    uint8_t hdr[BRIDGE_ETH_HEADER + 20];
+    if (pbuf_copy_partial(p, hdr, sizeof(hdr), 0) == sizeof(hdr) &&
+        ((hdr[12] << 8) | hdr[13]) == BRIDGE_ETHERTYPE_IPV4 && (hdr[BRIDGE_ETH_HEADER] >> 4) == 4) {
+        ip4_addr_t dest;
+        memcpy(&dest.addr, hdr + BRIDGE_ETH_HEADER + 16, 4);
+
+        // A client sends what is not on the AP's own subnet to us as its gateway: mesh node addresses and whatever is
+        // behind other bridges.  Local traffic, broadcasts and multicasts stay with lwIP.
+        if (!ip4_addr_netcmp(&dest, netif_ip4_addr(inp), netif_ip4_netmask(inp)) && !ip4_addr_isbroadcast(&dest, inp) &&
+            !ip4_addr_ismulticast(&dest)) {
+            if (!self->queueFromWiFi(p)) {
+                Serial.println("Bridge: mesh side is behind, dropped a WiFi packet");
+            }
+            pbuf_free(p);
+            return ERR_OK;
         }
     }
+    return self->apInput(p, inp);
 }
 
-void WiFiMeshBridge::printRoutingTable() {
-    if (routingTable.empty()) {
-        Serial.println("Routing table: empty");
-        return;
+bool WiFiMeshBridge::queueFromWiFi(struct pbuf *p) {
+    uint8_t hdr[4];
+    pbuf_copy_partial(p, hdr, sizeof(hdr), BRIDGE_ETH_HEADER);
+    // The IP total length, the frame may carry padding after it
+    size_t len = (hdr[2] << 8) | hdr[3];
+    if (len < 20 || len > BRIDGE_MTU || len > p->tot_len - BRIDGE_ETH_HEADER) {
+        return true; // Malformed, nothing to bridge
     }
 
-    Serial.printf("Routing table (%d entries):\n", routingTable.size());
-    for (const auto& entry : routingTable) {
-        Serial.printf("  %s → Node 0x%04X (%s, age: %lus)\n",
-                     IPAddress(entry.first).toString().c_str(),
-                     entry.second.nodeId,
-                     entry.second.isLocal ? "local" : "remote",
-                     (millis() - entry.second.lastSeen) / 1000);
+    concurrency::LockGuard g(&fromWiFiLock);
+    if (fromWiFiCount == BRIDGE_RX_QUEUE_DEPTH) {
+        return false;
     }
+    // loop() only works on the first entry, this one is past it
+    IpPacket &slot = fromWiFi[(fromWiFiFirst + fromWiFiCount) % BRIDGE_RX_QUEUE_DEPTH];
+    slot.len = pbuf_copy_partial(p, slot.data, len, BRIDGE_ETH_HEADER);
+    fromWiFiCount++;
+    return true;
 }
 
-// ============================================================================
-// Packet Bridging (IP <-> LoRa)
-// ============================================================================
+void WiFiMeshBridge::bridgeQueued() {
+    while (true) {
+        {
+            concurrency::LockGuard g(&fromWiFiLock);
+            if (fromWiFiCount == 0) {
+                return;
+            }
+        }
+
+        // The WiFi task never writes the first entry while it is queued, so it is read without the lock
+        const IpPacket &packet = fromWiFi[fromWiFiFirst];
+        uint32_t destIP = ((uint32_t)packet.data[16] << 24) | ((uint32_t)packet.data[17] << 16) |
+                          ((uint32_t)packet.data[18] << 8) | packet.data[19];
+        bridgePacketToMesh(packet.data, packet.len, destIP);
+
+        concurrency::LockGuard g(&fromWiFiLock);
+        fromWiFiFirst = (fromWiFiFirst + 1) % BRIDGE_RX_QUEUE_DEPTH;
+        fromWiFiCount--;
+    }
+}
 
 void WiFiMeshBridge::bridgePacketToMesh(const uint8_t* data, size_t len, uint32_t destIP) {
-    Serial.printf("Bridge: WiFi packet (%d bytes) → LoRa mesh (dest IP: %s)\n",
-                 len, IPAddress(destIP).toString().c_str());
-
-    // Look up route for destination IP
-    uint32_t destNodeId;
-    if (!getRoute(destIP, destNodeId)) {
-        // No route found - broadcast to all nodes
-        destNodeId = 0xFFFFFFFF; // Broadcast
+    Serial.printf("Bridge: WiFi packet (%u bytes) → LoRa mesh (dest IP: %s)\n",
+                 (unsigned)len, IPAddress(destIP).toString().c_str());
+
+    // Look up route for destination IP, asking NodeDB about mesh node addresses we have not used yet
+    if (!BridgeRouteTable::isBroadcast(destIP) && !routes.contains(destIP)) {
+        learnRouteFromNodeDB(destIP);
+    }
+    uint32_t destNodeId = routes.resolve(destIP, millis());
+    if (destNodeId == getNodeId()) {
+        // One of our own clients, the AP delivers it
+        return;
+    } else if (destNodeId == ROUTE_BROADCAST) {
         Serial.printf("  No route for %s, broadcasting\n", IPAddress(destIP).toString().c_str());
     } else {
         Serial.printf("  Route found: %s → Node 0x%04X\n",
                      IPAddress(destIP).toString().c_str(), destNodeId);
     }
 
-    // TODO: Compress IP packet for LoRa transmission
-    // - Extract IP header (20 bytes) + transport header (8-20 bytes)
-    // - Compress headers (store only essential fields)
-    // - Fragment if payload > 200 bytes
-    // - Send via EmergencyWiFiBridge module
+    size_t frameLen = headerCompressor.compress(data, len, frameBuf, sizeof(frameBuf));
+    if (frameLen == 0) {
+        Serial.printf("  Packet too large to bridge (%u bytes), dropped\n", (unsigned)len);
+        return;
+    }
+    Serial.printf("  Compressed %u → %u bytes (%s)\n", (unsigned)len, (unsigned)frameLen,
+                 frameBuf[0] == IPHC_TYPE_RAW ? "raw" : frameBuf[0] == IPHC_TYPE_IR ? "full header" : "compressed");
 
-    // For now, just log
-    Serial.printf("  TODO: Compress and send %d bytes to node 0x%04X\n", len, destNodeId);
+    // Fragmented over IP_TUNNEL_APP if it does not fit one LoRa packet
+    if (!ipTunnelModule || !ipTunnelModule->sendToNode(destNodeId, frameBuf, frameLen)) {
+        Serial.printf("  Failed to send %u bytes to node 0x%04X\n", (unsigned)frameLen, destNodeId);
+    }
 }
 
-void WiFiMeshBridge::injectPacketFromMesh(const uint8_t* data, size_t len, uint32_t sourceIP) {
-    Serial.printf("Bridge: LoRa mesh packet (%d bytes) → WiFi (source IP: %s)\n",
-                 len, IPAddress(sourceIP).toString().c_str());
+void WiFiMeshBridge::injectPacketFromMesh(const uint8_t* data, size_t len, uint32_t fromNode) {
+    Serial.printf("Bridge: LoRa mesh frame (%u bytes) → WiFi (from node 0x%04X)\n", (unsigned)len, fromNode);
+
+    size_t outLen = 0;
+    switch (headerCompressor.decompress(fromNode, data, len, frameBuf, sizeof(frameBuf), outLen)) {
+        case IPHC_OK:
+            // Replies to the sender's address go straight back to its node instead of being flooded
+            if (outLen >= 20) {
+                uint32_t srcIP = ((uint32_t)frameBuf[12] << 24) | ((uint32_t)frameBuf[13] << 16) |
+                                 ((uint32_t)frameBuf[14] << 8) | frameBuf[15];
+                routes.learn(srcIP, fromNode, ROUTE_OBSERVED, millis());
+            }
+            Serial.printf("  Decompressed %u → %u bytes\n", (unsigned)len, (unsigned)outLen);
+            injectToWiFi(frameBuf, outLen);
+            break;
+
+        case IPHC_FEEDBACK:
+            Serial.println("  Peer lost our header context, next packet carries a full header");
+            break;
 
-    // TODO: Decompress LoRa packet and reconstruct IP packet
-    // - Decompress headers
-    // - Reassemble fragments if needed
-    // - Inject into WiFi network via LWIP
+        case IPHC_NO_CONTEXT:
+            Serial.printf("  No header context for this flow, asking node 0x%04X to resend\n", fromNode);
+            if (ipTunnelModule) {
+                ipTunnelModule->sendToNode(fromNode, frameBuf, outLen);
+            }
+            break;
 
-    // For now, just log
-    Serial.printf("  TODO: Decompress and inject %d bytes from %s\n",
-                 len, IPAddress(sourceIP).toString().c_str());
+        case IPHC_MALFORMED:
+            Serial.println("  Malformed frame, dropped");
+            break;
+    }
+}
+
+void WiFiMeshBridge::injectToWiFi(const uint8_t* packet, size_t len) {
+    if (!apNetif || len < 20) {
+        Serial.println("  No AP interface to deliver on, dropped");
+        return;
+    }
+
+    // Room for the Ethernet header in front, the AP interface resolves the client's MAC and adds it
+    struct pbuf* p = pbuf_alloc(PBUF_LINK, len, PBUF_RAM);
+    if (!p) {
+        Serial.printf("  Out of buffers for %u bytes, dropped\n", (unsigned)len);
+        return;
+    }
+    pbuf_take(p, packet, len);
+
+    // lwIP is not thread safe, the packet goes out from its own thread, which frees it
+    if (tcpip_callback(sendOnAp, p) != ERR_OK) {
+        Serial.println("  lwIP queue full, dropped");
+        pbuf_free(p);
+    }
+}
+
+void WiFiMeshBridge::sendOnAp(void* arg) {
+    struct pbuf* p = (struct pbuf*)arg;
+    struct netif* netif = s_instance ? s_instance->apNetif : nullptr;
+    if (netif && netif_is_up(netif)) {
+        // The destination is in the IP header, broadcasts go to every client
+        ip4_addr_t dest;
+        memcpy(&dest.addr, (const uint8_t*)p->payload + 16, 4);
+        err_t err = netif->output(netif, p, &dest);
+        if (err != ERR_OK) {
+            Serial.printf("  WiFi delivery failed (error: %d)\n", err);
+        }
+    }
+    pbuf_free(p);
 }
 
 uint32_t WiFiMeshBridge::getNodeId() {
-    // Use last 2 bytes of MAC address as node ID
-    uint8_t mac[6];
-    WiFi.macAddress(mac);
-    return (mac[4] << 8) | mac[5];
+    // Routes name mesh nodes, so local clients are routed to our own node number
+    return nodeDB ? nodeDB->getNodeNum() : 0;
 }
 
 #endif // ENABLE_WIFI_AP
@@ -6,20 +6,16 @@
 #include <lwip/ip_addr.h>
 #include <lwip/netif.h>
 #include <lwip/pbuf.h>
-#include <map>
+#include "BridgeRouteTable.h"
+#include "IpHeaderCompressor.h"
+#include "concurrency/Lock.h"
 
-// Maximum clients supported
-#define MAX_WIFI_CLIENTS 8
+// Largest IP packet we bridge (WiFi MTU)
+#define BRIDGE_MTU 1500
 
-// IP address pool for clients (192.168.4.100 - 192.168.4.107)
-#define DHCP_POOL_START 100
-
-// Routing table entry - maps WiFi client IP to remote LoRa node
-struct RouteEntry {
-    uint32_t nodeId;        // Remote Meshtastic node ID
-    uint32_t lastSeen;      // Last packet timestamp
-    bool isLocal;           // True if client is local (same WiFi)
-};
+// IP packets from the WiFi clients waiting for the mesh side, more are dropped.  LoRa carries far less than one of
+// these per second, so there is no point holding more.
+#define BRIDGE_RX_QUEUE_DEPTH 2
 
 /**
  * WiFi Mesh Bridge - Transparent IP packet routing over LoRa mesh
@@ -29,7 +25,7 @@ struct RouteEntry {
  * - Event-driven connection management
  * - Transparent IP packet interception and routing
  * - IP <-> LoRa packet compression/decompression
- * - Automatic routing table based on packet source
+ * - Routing table learned from leases, bridged traffic and NodeDB
  *
  * Architecture:
  * [Phone A] → WiFi → [Node 1] → LoRa → [Node 2] → WiFi → [Phone B]
@@ -49,21 +45,43 @@ public:
     // Bridge network packet to LoRa mesh
     void bridgePacketToMesh(const uint8_t* data, size_t len, uint32_t destIP);
 
-    // Receive packet from mesh and inject into WiFi network
-    void injectPacketFromMesh(const uint8_t* data, size_t len, uint32_t sourceIP);
+    // Receive compressed frame from a mesh node and inject the IP packet into WiFi network
+    void injectPacketFromMesh(const uint8_t* data, size_t len, uint32_t fromNode);
 
     // Routing table management
     void addRoute(uint32_t ip, uint32_t nodeId, bool isLocal);
     bool getRoute(uint32_t ip, uint32_t &nodeId);
     void removeStaleRoutes();
+    const RouteStats &getRouteStats() const { return routes.getStats(); }
 
 private:
     bool apActive;
     uint8_t clientCount;
     uint32_t lastClientCheck;
 
-    // Routing table: IP address -> RouteEntry
-    std::map<uint32_t, RouteEntry> routingTable;
+    // The AP's lwIP interface, packets from the mesh go out on it
+    struct netif* apNetif = nullptr;
+    // Its own input function, what we don't bridge is handed on to it
+    netif_input_fn apInput = nullptr;
+
+    // IP packets from the clients, filled by netifInput on the WiFi task and emptied by loop()
+    struct IpPacket {
+        uint16_t len;
+        uint8_t data[BRIDGE_MTU];
+    };
+    IpPacket fromWiFi[BRIDGE_RX_QUEUE_DEPTH];
+    uint8_t fromWiFiFirst = 0;
+    uint8_t fromWiFiCount = 0;
+    concurrency::Lock fromWiFiLock;
+
+    // Routing table (IP address -> node) and client leases (MAC -> IP)
+    BridgeRouteTable routes;
+
+    // Header compression contexts for both directions
+    IpHeaderCompressor headerCompressor;
+
+    // Scratch buffer for one compressed frame or rebuilt packet
+    uint8_t frameBuf[BRIDGE_MTU + 1];
 
     // WiFi setup
     void setupWiFiAP();
@@ -77,16 +95,17 @@ private:
 
     // Connection management
     void checkConnections();
-    void cleanupStaleConnections();
 
     // Packet processing
     static err_t netifInput(struct pbuf *p, struct netif *inp);
-    static err_t netifOutput(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr);
+    bool queueFromWiFi(struct pbuf *p);
+    void bridgeQueued();
+    void injectToWiFi(const uint8_t* packet, size_t len);
+    static void sendOnAp(void* arg);
 
     // Helpers
     uint32_t getNodeId();
-    uint32_t assignClientIP(const uint8_t* mac);
-    void printRoutingTable();
+    bool learnRouteFromNodeDB(uint32_t ip);
 };
 
 extern WiFiMeshBridge wifiMeshBridge;
@@ -0,0 +1,154 @@
+#include "WsPushQueue.h"
+
+#include <string.h>
+
+WsPushQueue::WsPushQueue() {
+    memset(readers, 0, sizeof(readers));
+    memset(&stats, 0, sizeof(stats));
+}
+
+// ============================================================================
+// Ring storage
+// ============================================================================
+
+uint16_t WsPushQueue::lengthAt(uint32_t offset) const {
+    return ring[offset % WS_PUSH_RING_BYTES] | (ring[(offset + 1) % WS_PUSH_RING_BYTES] << 8);
+}
+
+void WsPushQueue::copyOut(uint32_t offset, uint8_t* out, size_t len) const {
+    size_t start = offset % WS_PUSH_RING_BYTES;
+    size_t first = len < WS_PUSH_RING_BYTES - start ? len : WS_PUSH_RING_BYTES - start;
+    memcpy(out, ring + start, first);
+    memcpy(out + first, ring, len - first);
+}
+
+void WsPushQueue::copyIn(uint32_t offset, const uint8_t* in, size_t len) {
+    size_t start = offset % WS_PUSH_RING_BYTES;
+    size_t first = len < WS_PUSH_RING_BYTES - start ? len : WS_PUSH_RING_BYTES - start;
+    memcpy(ring + start, in, first);
+    memcpy(ring, in + first, len - first);
+}
+
+void WsPushQueue::dropOldest() {
+    tail += WS_PUSH_RECORD_HEADER + lengthAt(tail);
+    tailSeq++;
+}
+
+bool WsPushQueue::push(const char* json, size_t len, uint8_t client) {
+    if (len == 0 || len > WS_PUSH_MAX_EVENT) {
+        stats.eventsRefused++;
+        return false;
+    }
+
+    while (head - tail + WS_PUSH_RECORD_HEADER + len > WS_PUSH_RING_BYTES)
+        dropOldest();
+
+    uint8_t header[WS_PUSH_RECORD_HEADER] = {(uint8_t)(len & 0xFF), (uint8_t)(len >> 8), client};
+    copyIn(head, header, WS_PUSH_RECORD_HEADER);
+    copyIn(head + WS_PUSH_RECORD_HEADER, (const uint8_t*)json, len);
+    head += WS_PUSH_RECORD_HEADER + len;
+    headSeq++;
+    stats.eventsQueued++;
+    return true;
+}
+
+// ============================================================================
+// Readers
+// ============================================================================
+
+void WsPushQueue::attach(uint8_t client) {
+    if (client >= WS_PUSH_MAX_CLIENTS)
+        return;
+    Reader &r = readers[client];
+    r.attached = true;
+    r.seq = r.frameSeq = r.endSeq = headSeq;
+    r.offset = r.endOffset = head;
+    r.dropped = 0;
+}
+
+void WsPushQueue::detach(uint8_t client) {
+    if (client < WS_PUSH_MAX_CLIENTS)
+        readers[client].attached = false;
+}
+
+void WsPushQueue::catchUp(Reader &r) {
+    if ((int32_t)(r.seq - tailSeq) >= 0)
+        return;
+    uint32_t lost = tailSeq - r.seq;
+    r.dropped += lost;
+    stats.eventsDropped += lost;
+    r.seq = tailSeq;
+    r.offset = tail;
+}
+
+bool WsPushQueue::hasPending(uint8_t client) const {
+    return isAttached(client) && readers[client].seq != headSeq;
+}
+
+size_t WsPushQueue::buildFrame(uint8_t client, char* out, size_t outMax) {
+    if (!hasPending(client) || outMax < 2 + WS_PUSH_MAX_EVENT)
+        return 0;
+    Reader &r = readers[client];
+    catchUp(r);
+
+    // As many events as fit, at least one: the ring refuses events that could not fit a frame by themselves
+    size_t n = 0;
+    int events = 0;
+    bool targeted = false;
+    out[n++] = '[';
+    uint32_t seq = r.seq, offset = r.offset;
+    while (seq != headSeq) {
+        uint16_t len = lengthAt(offset);
+        uint8_t target = targetAt(offset);
+        if (target != WS_PUSH_ALL_CLIENTS) {
+            targeted = true;
+        }
+        if (target == WS_PUSH_ALL_CLIENTS || target == client) {
+            if (n + (events > 0) + len + 1 > outMax)
+                break;
+            if (events > 0)
+                out[n++] = ',';
+            copyOut(offset + WS_PUSH_RECORD_HEADER, (uint8_t*)out + n, len);
+            n += len;
+            events++;
+        }
+        offset += WS_PUSH_RECORD_HEADER + len;
+        seq++;
+    }
+    out[n++] = ']';
+
+    r.frameSeq = r.seq;
+    r.endSeq = seq;
+    r.endOffset = offset;
+    r.frameTargeted = targeted;
+    if (events == 0) {
+        // Only events for other clients, nothing to send
+        consumed(client);
+        return 0;
+    }
+    stats.framesBuilt++;
+    return n;
+}
+
+void WsPushQueue::consumed(uint8_t client) {
+    if (client >= WS_PUSH_MAX_CLIENTS)
+        return;
+    Reader &r = readers[client];
+    r.seq = r.endSeq;
+    r.offset = r.endOffset;
+    // The events may have been overwritten while we were sending, the next frame notices it
+}
+
+bool WsPushQueue::shareFrame(uint8_t client, uint8_t from) {
+    if (!hasPending(client) || !isAttached(from))
+        return false;
+    Reader &r = readers[client];
+    const Reader &built = readers[from];
+    catchUp(r);
+    if (r.seq != built.frameSeq || built.frameTargeted)
+        return false;
+    r.frameSeq = built.frameSeq;
+    r.endSeq = built.endSeq;
+    r.endOffset = built.endOffset;
+    return true;
+}
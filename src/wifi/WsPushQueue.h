@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bytes of rendered JSON events kept for the WebSocket clients
+#define WS_PUSH_RING_BYTES 4096
+
+// Per event overhead in the ring: length (2) and target client
+#define WS_PUSH_RECORD_HEADER 3
+
+// Largest single event, bigger ones are refused
+#define WS_PUSH_MAX_EVENT 768
+
+// Largest coalesced frame sent to a client in one go, about one TCP segment
+#define WS_PUSH_MAX_FRAME 1460
+
+// WebSocket client slots (WEBSOCKETS_SERVER_CLIENT_MAX of arduinoWebSockets)
+#define WS_PUSH_MAX_CLIENTS 5
+
+// Target of events meant for every client
+#define WS_PUSH_ALL_CLIENTS 0xFF
+
+static_assert((WS_PUSH_RING_BYTES & (WS_PUSH_RING_BYTES - 1)) == 0, "positions wrap around 2^32, keep the ring a power of two");
+static_assert(WS_PUSH_MAX_EVENT + 2 <= WS_PUSH_MAX_FRAME, "an event must fit a frame on its own");
+static_assert(WS_PUSH_MAX_EVENT + WS_PUSH_RECORD_HEADER <= WS_PUSH_RING_BYTES, "an event must fit the ring");
+
+struct WsPushStats {
+    uint32_t eventsQueued;
+    uint32_t eventsRefused; // larger than WS_PUSH_MAX_EVENT
+    uint32_t eventsDropped; // overwritten before a client read them, counted once per client
+    uint32_t framesBuilt;
+};
+
+/**
+ * Outbound queue of JSON events for the WebSocket clients.
+ *
+ * Producers append already rendered events to one byte ring, nothing is allocated.  Every client has its own read cursor
+ * into the ring, so one event is stored once however many clients there are.  The ring always accepts new events by
+ * overwriting the oldest ones: a client that reads too slowly (a phone with a full TCP window) just misses its oldest
+ * events while the others are not held back.
+ *
+ * Events go to every client or to a single one (replies to its requests), a client's frames skip events for the others.
+ *
+ * Clients read coalesced frames: a JSON array of every pending event that fits WS_PUSH_MAX_FRAME, so a burst costs one
+ * WebSocket frame per client instead of one per event.  Building a frame does not consume it, call consumed() once it was
+ * sent so a failed send is retried with whatever is still in the ring.
+ *
+ * Not thread safe, producers and the sending loop must run on the same thread.
+ */
+class WsPushQueue {
+public:
+    WsPushQueue();
+
+    /**
+     * Append one event, dropping the oldest ones if needed.
+     * @param client the only client to deliver it to, or WS_PUSH_ALL_CLIENTS
+     * @return false if it is larger than WS_PUSH_MAX_EVENT
+     */
+    bool push(const char* json, size_t len, uint8_t client = WS_PUSH_ALL_CLIENTS);
+
+    // Start delivering to a client, it only gets events pushed from now on
+    void attach(uint8_t client);
+    void detach(uint8_t client);
+    bool isAttached(uint8_t client) const { return client < WS_PUSH_MAX_CLIENTS && readers[client].attached; }
+
+    // Has the client anything to read
+    bool hasPending(uint8_t client) const;
+
+    /**
+     * Render the client's pending events as one JSON array.
+     * @return frame length, 0 if nothing is pending for this client
+     */
+    size_t buildFrame(uint8_t client, char* out, size_t outMax);
+
+    // The frame last built for client was sent, move past it
+    void consumed(uint8_t client);
+
+    /**
+     * Give client the frame just built for another client if both read from the same place, instead of building it again.
+     * Only valid when nothing was pushed since that buildFrame.
+     * @return false if client needs its own frame
+     */
+    bool shareFrame(uint8_t client, uint8_t from);
+
+    // Events lost by one client since it attached
+    uint32_t getDropped(uint8_t client) const { return client < WS_PUSH_MAX_CLIENTS ? readers[client].dropped : 0; }
+
+    uint32_t getQueuedCount() const { return headSeq - tailSeq; }
+    const WsPushStats &getStats() const { return stats; }
+
+private:
+    struct Reader {
+        bool attached;
+        uint32_t seq;      // next event to read
+        uint32_t offset;   // its position in the ring
+        uint32_t frameSeq; // start of the frame last built
+        uint32_t endSeq;   // and its end
+        uint32_t endOffset;
+        bool frameTargeted; // the frame covered events for single clients, so others cannot share it
+        uint32_t dropped;
+    };
+
+    uint8_t ring[WS_PUSH_RING_BYTES];
+    // Positions count bytes and events since the start, the ring index is the position modulo its size
+    uint32_t head = 0, tail = 0;
+    uint32_t headSeq = 0, tailSeq = 0;
+    Reader readers[WS_PUSH_MAX_CLIENTS];
+    WsPushStats stats;
+
+    uint16_t lengthAt(uint32_t offset) const;
+    uint8_t targetAt(uint32_t offset) const { return ring[(offset + 2) % WS_PUSH_RING_BYTES]; }
+    void copyOut(uint32_t offset, uint8_t* out, size_t len) const;
+    void copyIn(uint32_t offset, const uint8_t* in, size_t len);
+    void dropOldest();
+    // Skip a client that fell behind the ring to the oldest event still there
+    void catchUp(Reader &r);
+};
@@ -0,0 +1,223 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "wifi/BridgeRouteTable.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const uint32_t self = 0x1000, nodeA = 0x1111, nodeB = 0x2222;
+
+static uint32_t apAddr(uint8_t last)
+{
+    return ROUTE_AP_SUBNET | last;
+}
+
+static uint32_t remoteAddr(int i)
+{
+    return (10U << 24) | (1U << 16) | (uint32_t)i;
+}
+
+static void makeMac(uint8_t *mac, uint8_t id)
+{
+    const uint8_t base[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x00};
+    memcpy(mac, base, 6);
+    mac[5] = id;
+}
+
+static void test_lookupHitsAndMisses()
+{
+    BridgeRouteTable routes;
+    TEST_ASSERT_TRUE(routes.learn(remoteAddr(1), nodeA, ROUTE_OBSERVED, 0));
+
+    const RouteEntry *route = routes.lookup(remoteAddr(1), 10);
+    TEST_ASSERT_NOT_NULL(route);
+    TEST_ASSERT_EQUAL_HEX32(nodeA, route->nodeId);
+    TEST_ASSERT_NULL(routes.lookup(remoteAddr(2), 10));
+
+    TEST_ASSERT_EQUAL(1, routes.getStats().hits);
+    TEST_ASSERT_EQUAL(1, routes.getStats().misses);
+}
+
+static void test_resolveFallsBackToBroadcast()
+{
+    BridgeRouteTable routes;
+    routes.learn(remoteAddr(1), nodeA, ROUTE_OBSERVED, 0);
+
+    TEST_ASSERT_EQUAL_HEX32(nodeA, routes.resolve(remoteAddr(1), 0));
+    TEST_ASSERT_EQUAL_HEX32(ROUTE_BROADCAST, routes.resolve(remoteAddr(2), 0));
+    TEST_ASSERT_EQUAL(1, routes.getStats().broadcastFallbacks);
+
+    // Broadcast and multicast destinations are meant for everyone, not a fallback
+    TEST_ASSERT_EQUAL_HEX32(ROUTE_BROADCAST, routes.resolve(0xFFFFFFFF, 0));
+    TEST_ASSERT_EQUAL_HEX32(ROUTE_BROADCAST, routes.resolve(apAddr(255), 0));
+    TEST_ASSERT_EQUAL_HEX32(ROUTE_BROADCAST, routes.resolve((224U << 24) | 251, 0));
+    TEST_ASSERT_EQUAL(1, routes.getStats().broadcastFallbacks);
+    TEST_ASSERT_FALSE(routes.learn(0xFFFFFFFF, nodeA, ROUTE_OBSERVED, 0));
+}
+
+static void test_remoteRoutesAreBounded()
+{
+    BridgeRouteTable routes;
+    for (int i = 0; i < MAX_REMOTE_ROUTES; i++)
+        TEST_ASSERT_TRUE(routes.learn(remoteAddr(i), nodeA, ROUTE_OBSERVED, i));
+
+    // Keep the first one in use, the second is now the least recently used
+    TEST_ASSERT_NOT_NULL(routes.lookup(remoteAddr(0), 1000));
+    TEST_ASSERT_TRUE(routes.learn(remoteAddr(1000), nodeB, ROUTE_OBSERVED, 1001));
+
+    TEST_ASSERT_EQUAL(MAX_REMOTE_ROUTES, routes.getRemoteCount());
+    TEST_ASSERT_EQUAL(1, routes.getStats().evictions);
+    TEST_ASSERT_FALSE(routes.contains(remoteAddr(1)));
+    TEST_ASSERT_TRUE(routes.contains(remoteAddr(0)));
+    TEST_ASSERT_TRUE(routes.contains(remoteAddr(1000)));
+}
+
+/// Removing entries from the middle of probe runs must not hide the entries behind them
+static void test_eraseKeepsProbeRuns()
+{
+    BridgeRouteTable routes;
+    for (int round = 0; round < 50; round++) {
+        for (int i = 0; i < MAX_REMOTE_ROUTES; i++)
+            routes.learn(remoteAddr(round * 7 + i), nodeA, ROUTE_OBSERVED, 0);
+        for (int i = 0; i < MAX_REMOTE_ROUTES; i += 3)
+            routes.remove(remoteAddr(round * 7 + i));
+
+        int found = 0;
+        for (int slot = 0; slot < ROUTE_TABLE_SLOTS; slot++) {
+            const RouteEntry *e = routes.getSlot(slot);
+            if (e) {
+                TEST_ASSERT_TRUE(routes.contains(e->ip));
+                found++;
+            }
+        }
+        TEST_ASSERT_EQUAL(routes.getRouteCount(), found);
+    }
+}
+
+static void test_staleRoutesExpire()
+{
+    BridgeRouteTable routes;
+    routes.learn(remoteAddr(1), nodeA, ROUTE_OBSERVED, 0);
+    routes.learn(remoteAddr(2), nodeA, ROUTE_OBSERVED, 0);
+    routes.learn(remoteAddr(3), nodeB, ROUTE_OBSERVED, ROUTE_TIMEOUT_MS);
+
+    // Expired on lookup, or by the periodic sweep
+    TEST_ASSERT_NULL(routes.lookup(remoteAddr(1), ROUTE_TIMEOUT_MS + 1));
+    TEST_ASSERT_EQUAL(1, routes.expire(ROUTE_TIMEOUT_MS + 1));
+    TEST_ASSERT_EQUAL(1, routes.getRemoteCount());
+    TEST_ASSERT_EQUAL(2, routes.getStats().expired);
+}
+
+static void test_leasesAreStablePerMac()
+{
+    BridgeRouteTable routes;
+    uint8_t mac[MAX_WIFI_CLIENTS + 1][6];
+    uint32_t ips[MAX_WIFI_CLIENTS];
+
+    // Every client gets its own address, even when MACs share their last bits
+    for (int i = 0; i < MAX_WIFI_CLIENTS; i++) {
+        makeMac(mac[i], (uint8_t)(i * MAX_WIFI_CLIENTS));
+        ips[i] = routes.leaseFor(mac[i], self, i);
+        TEST_ASSERT_NOT_EQUAL(0, ips[i]);
+        for (int j = 0; j < i; j++)
+            TEST_ASSERT_NOT_EQUAL(ips[j], ips[i]);
+        TEST_ASSERT_EQUAL_HEX32(self, routes.resolve(ips[i], i));
+    }
+
+    // Pool exhausted while everybody is connected
+    makeMac(mac[MAX_WIFI_CLIENTS], 0xFF);
+    TEST_ASSERT_EQUAL(0, routes.leaseFor(mac[MAX_WIFI_CLIENTS], self, 100));
+    TEST_ASSERT_EQUAL(1, routes.getStats().leasesExhausted);
+
+    // A client that leaves and comes back gets the same address, its route only exists while it is here
+    routes.releaseLease(mac[3], 200);
+    TEST_ASSERT_FALSE(routes.contains(ips[3]));
+    TEST_ASSERT_EQUAL_HEX32(ips[3], routes.leaseFor(mac[3], self, 300));
+    TEST_ASSERT_TRUE(routes.contains(ips[3]));
+
+    // A newcomer takes over the lease of the client that left longest ago
+    routes.releaseLease(mac[5], 400);
+    routes.releaseLease(mac[2], 500);
+    TEST_ASSERT_EQUAL_HEX32(ips[5], routes.leaseFor(mac[MAX_WIFI_CLIENTS], self, 600));
+    TEST_ASSERT_NULL(routes.findLease(mac[5]));
+}
+
+static void test_bindLeaseFollowsDhcp()
+{
+    BridgeRouteTable routes;
+    uint8_t macA[6], macB[6];
+    makeMac(macA, 1);
+    makeMac(macB, 2);
+    uint32_t ipA = routes.leaseFor(macA, self, 0);
+    uint32_t ipB = routes.leaseFor(macB, self, 0);
+
+    // The DHCP server gave A the address we expected for B: they trade
+    routes.bindLease(macA, ipB, self, 10);
+    TEST_ASSERT_EQUAL_HEX32(ipB, routes.findLease(macA)->ip);
+    TEST_ASSERT_EQUAL_HEX32(ipA, routes.findLease(macB)->ip);
+    TEST_ASSERT_TRUE(routes.contains(ipA));
+    TEST_ASSERT_TRUE(routes.contains(ipB));
+    TEST_ASSERT_EQUAL(2, routes.getRouteCount());
+}
+
+static void test_localClientsWinConflicts()
+{
+    BridgeRouteTable routes;
+    uint8_t mac[6];
+    makeMac(mac, 1);
+
+    // Another node's client was seen with the address our new client is about to get
+    uint32_t ip = apAddr(DHCP_POOL_START);
+    TEST_ASSERT_TRUE(routes.learn(ip, nodeA, ROUTE_OBSERVED, 0));
+    TEST_ASSERT_EQUAL_HEX32(ip, routes.leaseFor(mac, self, 10));
+    TEST_ASSERT_EQUAL_HEX32(self, routes.resolve(ip, 10));
+
+    // And its traffic cannot take it back
+    TEST_ASSERT_FALSE(routes.learn(ip, nodeA, ROUTE_OBSERVED, 20));
+    TEST_ASSERT_EQUAL(1, routes.getStats().conflicts);
+    TEST_ASSERT_EQUAL_HEX32(self, routes.resolve(ip, 20));
+    TEST_ASSERT_EQUAL(0, routes.getRemoteCount());
+}
+
+static void test_learnMovesRoute()
+{
+    BridgeRouteTable routes;
+    routes.learn(remoteAddr(1), nodeA, ROUTE_OBSERVED, 0);
+    routes.learn(remoteAddr(1), nodeB, ROUTE_NODEDB, 10);
+
+    TEST_ASSERT_EQUAL_HEX32(nodeB, routes.resolve(remoteAddr(1), 10));
+    TEST_ASSERT_EQUAL(ROUTE_NODEDB, routes.lookup(remoteAddr(1), 10)->source);
+    TEST_ASSERT_EQUAL(2, routes.getStats().learned);
+    TEST_ASSERT_EQUAL(1, routes.getRouteCount());
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_lookupHitsAndMisses);
+    RUN_TEST(test_resolveFallsBackToBroadcast);
+    RUN_TEST(test_remoteRoutesAreBounded);
+    RUN_TEST(test_eraseKeepsProbeRuns);
+    RUN_TEST(test_staleRoutesExpire);
+    RUN_TEST(test_leasesAreStablePerMac);
+    RUN_TEST(test_bindLeaseFollowsDhcp);
+    RUN_TEST(test_localClientsWinConflicts);
+    RUN_TEST(test_learnMovesRoute);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
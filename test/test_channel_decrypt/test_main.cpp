@@ -0,0 +1,186 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "mesh/Channels.h"
+#include "mesh/CryptoEngine.h"
+#include "mesh/NodeDB.h"
+#include "mesh/Router.h"
+#include "mesh/mesh-pb-constants.h"
+
+#include <chrono>
+#include <memory>
+#include <random>
+
+namespace
+{
+// Minimal NodeDB so perhapsDecode has something to look senders up in.
+class MockNodeDB : public NodeDB
+{
+  public:
+    meshtastic_NodeInfoLite *getMeshNode(NodeNum n) override { return &emptyNode; }
+    meshtastic_NodeInfoLite emptyNode = {};
+};
+
+const char kChannelName[] = "bench";
+
+// Set up numChannels channels that all share one hash: their PSKs only differ in two bytes that xor to the same value, which
+// is exactly the collision perhapsDecode has to brute force through.
+void setupCollidingChannels(int numChannels)
+{
+    memset(&channelFile, 0, sizeof(channelFile));
+    channelFile.channels_count = MAX_NUM_CHANNELS;
+    for (int i = 0; i < numChannels; i++) {
+        meshtastic_Channel &ch = channelFile.channels[i];
+        ch.index = i;
+        ch.has_settings = true;
+        ch.role = i == 0 ? meshtastic_Channel_Role_PRIMARY : meshtastic_Channel_Role_SECONDARY;
+        strcpy(ch.settings.name, kChannelName);
+        ch.settings.psk.size = 16;
+        for (int b = 0; b < 16; b++)
+            ch.settings.psk.bytes[b] = 0x40 + b;
+        ch.settings.psk.bytes[0] ^= i;
+        ch.settings.psk.bytes[1] ^= i;
+    }
+    channels.onConfigChanged();
+}
+
+// A text packet encrypted with the key of channel chIndex, as it would arrive off the radio
+meshtastic_MeshPacket encryptedPacket(ChannelIndex chIndex, PacketId id)
+{
+    meshtastic_MeshPacket p = meshtastic_MeshPacket_init_zero;
+    p.from = 0x1234;
+    p.to = NODENUM_BROADCAST;
+    p.id = id;
+    p.which_payload_variant = meshtastic_MeshPacket_encrypted_tag;
+
+    meshtastic_Data d = meshtastic_Data_init_zero;
+    d.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+    d.payload.size = snprintf((char *)d.payload.bytes, sizeof(d.payload.bytes), "hello from a busy mesh %u", id);
+    p.encrypted.size = pb_encode_to_bytes(p.encrypted.bytes, sizeof(p.encrypted.bytes), &meshtastic_Data_msg, &d);
+
+    p.channel = channels.setActiveByIndex(chIndex);
+    crypto->encryptPacket(p.from, p.id, p.encrypted.size, p.encrypted.bytes);
+    return p;
+}
+} // namespace
+
+static void test_looksLikeData()
+{
+    uint8_t buf[64];
+    meshtastic_Data d = meshtastic_Data_init_zero;
+    d.portnum = meshtastic_PortNum_POSITION_APP;
+    d.payload.size = 5;
+    d.want_response = true;
+    size_t len = pb_encode_to_bytes(buf, sizeof(buf), &meshtastic_Data_msg, &d);
+    TEST_ASSERT_TRUE(pb_looks_like_data(buf, len));
+
+    // Truncated inside the payload
+    TEST_ASSERT_FALSE(pb_looks_like_data(buf, len - 1));
+
+    // No portnum at all
+    d.portnum = meshtastic_PortNum_UNKNOWN_APP;
+    len = pb_encode_to_bytes(buf, sizeof(buf), &meshtastic_Data_msg, &d);
+    TEST_ASSERT_FALSE(pb_looks_like_data(buf, len));
+
+    // Whatever the full decoder accepts with a real portnum, the pre-check must accept too
+    std::mt19937 rng(7);
+    int passed = 0;
+    for (int i = 0; i < 5000; i++) {
+        size_t n = 1 + rng() % sizeof(buf);
+        for (size_t b = 0; b < n; b++)
+            buf[b] = rng();
+        meshtastic_Data out = meshtastic_Data_init_zero;
+        bool decodes = pb_decode_from_bytes(buf, n, &meshtastic_Data_msg, &out) && out.portnum != meshtastic_PortNum_UNKNOWN_APP;
+        bool looks = pb_looks_like_data(buf, n);
+        if (decodes)
+            TEST_ASSERT_TRUE(looks);
+        passed += looks;
+    }
+    printf("pre-check accepted %d of 5000 random buffers\n", passed);
+    TEST_ASSERT_LESS_THAN(500, passed);
+}
+
+static void test_decodeFindsCollidingChannel()
+{
+    setupCollidingChannels(8);
+    for (ChannelIndex ch = 0; ch < 8; ch++) {
+        meshtastic_MeshPacket p = encryptedPacket(ch, 100 + ch);
+        TEST_ASSERT_EQUAL(DecodeState::DECODE_SUCCESS, perhapsDecode(&p));
+        TEST_ASSERT_EQUAL_UINT32(ch, p.channel);
+        TEST_ASSERT_EQUAL(meshtastic_PortNum_TEXT_MESSAGE_APP, p.decoded.portnum);
+    }
+
+    // Changing a channel key must not leave a stale schedule behind
+    channelFile.channels[3].settings.psk.bytes[5] ^= 0xff;
+    channelFile.channels[3].settings.psk.bytes[6] ^= 0xff;
+    channels.onConfigChanged();
+    meshtastic_MeshPacket p = encryptedPacket(3, 200);
+    TEST_ASSERT_EQUAL(DecodeState::DECODE_SUCCESS, perhapsDecode(&p));
+    TEST_ASSERT_EQUAL_UINT32(3, p.channel);
+}
+
+// Worst case: the packet belongs to the last of numChannels colliding channels, so every decode tries them all.
+static void benchmarkDecode(int numChannels)
+{
+    const int iterations = 2000;
+    setupCollidingChannels(numChannels);
+    const meshtastic_MeshPacket encrypted = encryptedPacket(numChannels - 1, 1);
+
+    double seconds[2];
+    for (int cached = 0; cached < 2; cached++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            meshtastic_MeshPacket p = encrypted;
+            if (!cached)
+                crypto->invalidateKeyCache(); // what every attempt used to cost: a fresh key expansion
+            TEST_ASSERT_EQUAL(DecodeState::DECODE_SUCCESS, perhapsDecode(&p));
+        }
+        seconds[cached] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double attempts = (double)iterations * numChannels;
+    printf("%d channels: %.0f attempts/s with cached key schedules, %.0f attempts/s re-expanding keys\n", numChannels,
+           attempts / seconds[1], attempts / seconds[0]);
+}
+
+static void test_benchmark1Channel()
+{
+    benchmarkDecode(1);
+}
+static void test_benchmark4Channels()
+{
+    benchmarkDecode(4);
+}
+static void test_benchmark8Channels()
+{
+    benchmarkDecode(8);
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+    const std::unique_ptr<MockNodeDB> mockNodeDB(new MockNodeDB());
+    nodeDB = mockNodeDB.get();
+    if (!cryptLock)
+        cryptLock = new concurrency::Lock();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_looksLikeData);
+    RUN_TEST(test_decodeFindsCollidingChannel);
+    RUN_TEST(test_benchmark1Channel);
+    RUN_TEST(test_benchmark4Channels);
+    RUN_TEST(test_benchmark8Channels);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+void loop() {}
@@ -178,6 +178,66 @@ void test_AES_CTR(void)
     TEST_ASSERT_EQUAL_MEMORY(expected, plain, 16);
 }
 
+void test_SharedKeyCache(void)
+{
+    uint8_t remotePub[3][32], ourPub[32], priv[32], plain[32] = {1, 2, 3}, encrypted[64] __attribute__((__aligned__));
+    meshtastic_UserLite_public_key_t remote;
+    remote.size = 32;
+
+    for (auto &pub : remotePub)
+        crypto->generateKeyPair(pub, priv);
+    crypto->generateKeyPair(ourPub, priv); // our key last, it also empties the cache
+
+    uint32_t hits = crypto->getSharedKeyHits(), misses = crypto->getSharedKeyMisses();
+    for (int round = 0; round < 2; round++) {
+        for (auto &pub : remotePub) {
+            memcpy(remote.bytes, pub, 32);
+            TEST_ASSERT(crypto->encryptCurve25519(0, 0x0929, remote, 1, sizeof(plain), plain, encrypted));
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(misses + 3, crypto->getSharedKeyMisses());
+    TEST_ASSERT_EQUAL_UINT32(hits + 3, crypto->getSharedKeyHits());
+
+    // A cached key must give the same result as a fresh DH
+    uint8_t cached[32];
+    memcpy(cached, crypto->shared_key, 32);
+    crypto->forgetSharedKey(remote.bytes);
+    TEST_ASSERT(crypto->encryptCurve25519(0, 0x0929, remote, 1, sizeof(plain), plain, encrypted));
+    TEST_ASSERT_EQUAL_UINT32(misses + 4, crypto->getSharedKeyMisses());
+    TEST_ASSERT_EQUAL_MEMORY(cached, crypto->shared_key, 32);
+
+    // After clearKeys nothing derived from the old private key may be reused
+    crypto->clearKeys();
+    crypto->setDHPrivateKey(priv);
+    TEST_ASSERT(crypto->encryptCurve25519(0, 0x0929, remote, 1, sizeof(plain), plain, encrypted));
+    TEST_ASSERT_EQUAL_UINT32(misses + 5, crypto->getSharedKeyMisses());
+}
+
+void test_SharedKeyCacheBenchmark(void)
+{
+    const int numRemotes = 8, packets = 400;
+    uint8_t remotePub[numRemotes][32], ourPub[32], priv[32], plain[64] = {0}, encrypted[96] __attribute__((__aligned__));
+    meshtastic_UserLite_public_key_t remote;
+    remote.size = 32;
+
+    for (auto &pub : remotePub)
+        crypto->generateKeyPair(pub, priv);
+    crypto->generateKeyPair(ourPub, priv);
+
+    for (int cached = 0; cached < 2; cached++) {
+        uint32_t start = millis();
+        for (int i = 0; i < packets; i++) {
+            if (!cached)
+                crypto->clearSharedKeyCache();
+            memcpy(remote.bytes, remotePub[i % numRemotes], 32);
+            TEST_ASSERT(crypto->encryptCurve25519(0, 0x0929, remote, i, sizeof(plain), plain, encrypted));
+        }
+        uint32_t elapsed = millis() - start;
+        printf("PKI encrypt to %d nodes %s cache: %d packets in %u ms (%.0f packets/s)\n", numRemotes,
+               cached ? "with" : "without", packets, elapsed, elapsed ? packets * 1000.0 / elapsed : 0.0);
+    }
+}
+
 void setup()
 {
     // NOTE!!! Wait for >2 secs
@@ -192,6 +252,8 @@ void setup()
     RUN_TEST(test_DH25519);
     RUN_TEST(test_AES_CTR);
     RUN_TEST(test_PKC);
+    RUN_TEST(test_SharedKeyCache);
+    RUN_TEST(test_SharedKeyCacheBenchmark);
     exit(UNITY_END()); // stop unit testing
 }
 
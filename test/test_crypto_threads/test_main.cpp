@@ -0,0 +1,152 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "mesh/CryptoEngine.h"
+#include "mesh/RadioInterface.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+const int kThreads = 8;
+const int kIterations = 3000;
+const int kRemotes = 4;
+const size_t kPacketLen = 64;
+
+struct ChannelCase {
+    CryptoContext ctx;
+    uint8_t plain[kPacketLen];
+    uint8_t cipher[kPacketLen]; // reference output, computed before any threads start
+};
+
+struct PkiCase {
+    meshtastic_UserLite_public_key_t remote;
+    uint8_t sharedKey[32]; // reference shared key
+};
+
+ChannelCase channelCases[CRYPTO_KEY_CACHE_SLOTS];
+PkiCase pkiCases[kRemotes];
+
+void makeCases()
+{
+    std::mt19937 rng(1234);
+    for (uint8_t slot = 0; slot < CRYPTO_KEY_CACHE_SLOTS; slot++) {
+        ChannelCase &c = channelCases[slot];
+        c.ctx = CryptoContext();
+        c.ctx.keySlot = slot;
+        c.ctx.key.length = (slot % 2) ? 16 : 32;
+        for (auto &b : c.ctx.key.bytes)
+            b = rng();
+        for (auto &b : c.plain)
+            b = rng();
+        memcpy(c.cipher, c.plain, kPacketLen);
+        CryptoContext ctx = c.ctx;
+        crypto->encryptPacket(ctx, 0x1000 + slot, 42, kPacketLen, c.cipher);
+    }
+
+    uint8_t priv[32], ourPub[32];
+    for (auto &c : pkiCases) {
+        crypto->generateKeyPair(c.remote.bytes, priv);
+        c.remote.size = 32;
+    }
+    crypto->generateKeyPair(ourPub, priv); // ours last, the remotes' private keys are never needed again
+
+    uint8_t plain[16] = {0}, out[16 + MESHTASTIC_PKC_OVERHEAD];
+    for (auto &c : pkiCases) {
+        CryptoContext ctx;
+        TEST_ASSERT_TRUE(crypto->encryptCurve25519(ctx, 0, 0x1000, c.remote, 1, sizeof(plain), plain, out));
+        memcpy(c.sharedKey, ctx.key.bytes, 32);
+    }
+}
+
+// Each worker mixes channel packets (every cache slot, so schedules are shared between threads) and PKI packets, and checks
+// every result against the single threaded reference.
+void worker(int id, std::atomic<int> &failures)
+{
+    std::mt19937 rng(id);
+    for (int i = 0; i < kIterations; i++) {
+        if (rng() % 4) {
+            const ChannelCase &c = channelCases[rng() % CRYPTO_KEY_CACHE_SLOTS];
+            CryptoContext ctx = c.ctx;
+            uint8_t buf[kPacketLen];
+            memcpy(buf, c.plain, kPacketLen);
+            crypto->encryptPacket(ctx, 0x1000 + c.ctx.keySlot, 42, kPacketLen, buf);
+            if (memcmp(buf, c.cipher, kPacketLen) != 0)
+                failures++;
+            crypto->decrypt(ctx, 0x1000 + c.ctx.keySlot, 42, kPacketLen, buf);
+            if (memcmp(buf, c.plain, kPacketLen) != 0)
+                failures++;
+        } else {
+            const PkiCase &c = pkiCases[rng() % kRemotes];
+            uint8_t plain[24], sealed[sizeof(plain) + MESHTASTIC_PKC_OVERHEAD], opened[sizeof(sealed)];
+            for (auto &b : plain)
+                b = rng();
+            CryptoContext ctx;
+            if (!crypto->encryptCurve25519(ctx, 0, 0x1000, c.remote, i, sizeof(plain), plain, sealed) ||
+                memcmp(ctx.key.bytes, c.sharedKey, 32) != 0)
+                failures++;
+            // With the same remote key the derived secret is the same, so we can open our own packet
+            CryptoContext ctx2;
+            if (!crypto->decryptCurve25519(ctx2, 0x1000, c.remote, i, sizeof(sealed), sealed, opened) ||
+                memcmp(opened, plain, sizeof(plain)) != 0)
+                failures++;
+        }
+    }
+}
+} // namespace
+
+static void test_concurrentEncryptDecrypt()
+{
+    makeCases();
+
+    std::atomic<int> failures(0);
+    std::atomic<bool> done(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++)
+        threads.emplace_back(worker, t, std::ref(failures));
+
+    // Meanwhile keep throwing away cached key material, as a config change or node removal would
+    std::thread churn([&]() {
+        int n = 0;
+        while (!done) {
+            if (n++ % 2)
+                crypto->invalidateKeyCache();
+            else
+                crypto->forgetSharedKey(pkiCases[n % kRemotes].remote.bytes);
+            std::this_thread::yield();
+        }
+    });
+
+    for (auto &t : threads)
+        t.join();
+    done = true;
+    churn.join();
+
+    printf("%d threads x %d packets, PKI cache hits=%u misses=%u\n", kThreads, kIterations, crypto->getSharedKeyHits(),
+           crypto->getSharedKeyMisses());
+    TEST_ASSERT_EQUAL_INT(0, failures.load());
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_concurrentEncryptDecrypt);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+void loop() {}
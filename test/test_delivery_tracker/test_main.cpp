@@ -0,0 +1,186 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "wifi/DeliveryTracker.h"
+
+#include <stdlib.h>
+
+#define DEST 0x1234
+#define RELAY 0x5678
+#define US 0x9abc
+#define NO_ROUTE 5 // meshtastic_Routing_Error_NO_ROUTE
+
+static DeliveryTracker *tracker;
+static DeliveryUpdate update;
+
+void setUp(void)
+{
+    tracker = new DeliveryTracker();
+}
+
+void tearDown(void)
+{
+    delete tracker;
+}
+
+static void expectUpdate(uint8_t client, uint32_t requestId, DeliveryState state, int32_t error)
+{
+    TEST_ASSERT_EQUAL(client, update.client);
+    TEST_ASSERT_EQUAL(requestId, update.requestId);
+    TEST_ASSERT_EQUAL(state, update.state);
+    TEST_ASSERT_EQUAL(error, update.error);
+}
+
+static void test_withoutAckDoneOnceQueued()
+{
+    tracker->track(100, 2, 7, DEST, false, 0);
+    TEST_ASSERT_TRUE(tracker->onQueued(100, true, 0, &update, 1));
+    expectUpdate(2, 7, DELIVERY_QUEUED, 0);
+    TEST_ASSERT_EQUAL(100, update.packetId);
+    TEST_ASSERT_FALSE(tracker->isTracked(100));
+}
+
+static void test_ackFromDestination()
+{
+    tracker->track(100, 1, 7, DEST, true, 0);
+    TEST_ASSERT_TRUE(tracker->onQueued(100, true, 0, &update, 1));
+    expectUpdate(1, 7, DELIVERY_QUEUED, 0);
+    TEST_ASSERT_TRUE(tracker->isTracked(100));
+
+    TEST_ASSERT_TRUE(tracker->onReport(100, DEST, 0, &update, 1));
+    expectUpdate(1, 7, DELIVERY_ACKED, 0);
+    TEST_ASSERT_FALSE(tracker->isTracked(100));
+    TEST_ASSERT_FALSE(tracker->onReport(100, DEST, 0, &update, 1));
+}
+
+static void test_relayedThenAcked()
+{
+    tracker->track(100, 1, 7, DEST, true, 0);
+    tracker->onQueued(100, true, 0, &update, 1);
+
+    // Implicit ACK (we heard it rebroadcast) then a relay's ACK: one update, then the real one
+    TEST_ASSERT_TRUE(tracker->onReport(100, US, 0, &update, 1));
+    expectUpdate(1, 7, DELIVERY_RELAYED, 0);
+    TEST_ASSERT_FALSE(tracker->onReport(100, RELAY, 0, &update, 1));
+    TEST_ASSERT_TRUE(tracker->onReport(100, DEST, 0, &update, 1));
+    expectUpdate(1, 7, DELIVERY_ACKED, 0);
+}
+
+static void test_broadcastDoneOnceRelayed()
+{
+    tracker->track(100, 1, 7, DELIVERY_BROADCAST, true, 0);
+    tracker->onQueued(100, true, 0, &update, 1);
+    TEST_ASSERT_TRUE(tracker->onReport(100, US, 0, &update, 1));
+    expectUpdate(1, 7, DELIVERY_RELAYED, 0);
+    TEST_ASSERT_FALSE(tracker->isTracked(100));
+}
+
+static void test_nak()
+{
+    tracker->track(100, 1, 7, DEST, true, 0);
+    tracker->onQueued(100, true, 0, &update, 1);
+    TEST_ASSERT_TRUE(tracker->onReport(100, RELAY, NO_ROUTE, &update, 1));
+    expectUpdate(1, 7, DELIVERY_NAKED, NO_ROUTE);
+    TEST_ASSERT_FALSE(tracker->isTracked(100));
+}
+
+static void test_refusedByRouter()
+{
+    tracker->track(100, 1, 7, DEST, true, 0);
+    TEST_ASSERT_TRUE(tracker->onQueued(100, false, 42, &update, 1));
+    expectUpdate(1, 7, DELIVERY_FAILED, 42);
+    TEST_ASSERT_FALSE(tracker->isTracked(100));
+}
+
+static void test_retransmissionStatusIgnored()
+{
+    tracker->track(100, 1, 7, DEST, true, 0);
+    TEST_ASSERT_TRUE(tracker->onQueued(100, true, 0, &update, 1));
+    TEST_ASSERT_FALSE(tracker->onQueued(100, true, 0, &update, 1));
+    TEST_ASSERT_FALSE(tracker->onQueued(100, false, 42, &update, 1));
+    TEST_ASSERT_TRUE(tracker->isTracked(100));
+
+    // Other nodes' packets and the phone's are none of our business
+    TEST_ASSERT_FALSE(tracker->onQueued(200, true, 0, &update, 1));
+    TEST_ASSERT_FALSE(tracker->onReport(200, DEST, 0, &update, 1));
+}
+
+static void test_oldestForgottenWhenFull()
+{
+    for (uint32_t i = 0; i < DELIVERY_MAX_TRACKED; i++)
+        TEST_ASSERT_TRUE(tracker->track(100 + i, 0, i, DEST, true, 1000 + i));
+    TEST_ASSERT_FALSE(tracker->track(100, 0, 0, DEST, true, 2000));
+
+    TEST_ASSERT_TRUE(tracker->track(500, 0, 99, DEST, true, 2000));
+    TEST_ASSERT_EQUAL(DELIVERY_MAX_TRACKED, tracker->getTrackedCount());
+    TEST_ASSERT_FALSE(tracker->isTracked(100));
+    TEST_ASSERT_TRUE(tracker->isTracked(101));
+    TEST_ASSERT_TRUE(tracker->isTracked(500));
+}
+
+static void test_aggregatedRequestsShareAPacket()
+{
+    DeliveryUpdate updates[4];
+    tracker->track(100, 1, 7, DEST, true, 0);
+    tracker->track(100, 2, 8, DEST, true, 0);
+    tracker->track(101, 1, 9, DEST, true, 0);
+
+    TEST_ASSERT_EQUAL(2, tracker->onQueued(100, true, 0, updates, 4));
+    TEST_ASSERT_EQUAL(1, updates[0].client);
+    TEST_ASSERT_EQUAL(7, updates[0].requestId);
+    TEST_ASSERT_EQUAL(2, updates[1].client);
+    TEST_ASSERT_EQUAL(8, updates[1].requestId);
+
+    // The destination's ACK completes both, the other packet is untouched
+    TEST_ASSERT_EQUAL(2, tracker->onReport(100, DEST, 0, updates, 4));
+    TEST_ASSERT_EQUAL(DELIVERY_ACKED, updates[0].state);
+    TEST_ASSERT_EQUAL(DELIVERY_ACKED, updates[1].state);
+    TEST_ASSERT_FALSE(tracker->isTracked(100));
+    TEST_ASSERT_TRUE(tracker->isTracked(101));
+
+    // No more updates than there is room for
+    tracker->track(102, 1, 10, DEST, true, 0);
+    tracker->track(102, 1, 11, DEST, true, 0);
+    TEST_ASSERT_EQUAL(1, tracker->onQueued(102, true, 0, updates, 1));
+}
+
+static void test_forgetClient()
+{
+    tracker->track(100, 1, 7, DEST, true, 0);
+    tracker->track(101, 2, 8, DEST, true, 0);
+    tracker->forgetClient(1);
+    TEST_ASSERT_FALSE(tracker->onReport(100, DEST, 0, &update, 1));
+    TEST_ASSERT_TRUE(tracker->onReport(101, DEST, 0, &update, 1));
+    expectUpdate(2, 8, DELIVERY_ACKED, 0);
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_withoutAckDoneOnceQueued);
+    RUN_TEST(test_ackFromDestination);
+    RUN_TEST(test_relayedThenAcked);
+    RUN_TEST(test_broadcastDoneOnceRelayed);
+    RUN_TEST(test_nak);
+    RUN_TEST(test_refusedByRouter);
+    RUN_TEST(test_retransmissionStatusIgnored);
+    RUN_TEST(test_oldestForgottenWhenFull);
+    RUN_TEST(test_aggregatedRequestsShareAPacket);
+    RUN_TEST(test_forgetClient);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
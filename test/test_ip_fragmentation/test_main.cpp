@@ -0,0 +1,340 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "airtime.h"
+#include "mesh/Router.h"
+#include "platform/portduino/SimRadio.h"
+#include "wifi/IpFragmenter.h"
+
+#include <deque>
+#include <vector>
+
+#define NACK_DELAY 1000
+#define REASSEMBLY_TIMEOUT 30000
+#define MAX_NACKS 3
+
+namespace
+{
+struct Frame {
+    uint32_t from, to;
+    std::vector<uint8_t> bytes;
+};
+
+/// Frames on their way, delivered by the test loop so nothing is handled reentrantly
+std::deque<Frame> air;
+
+class TestNode : public IpFragmenter
+{
+  public:
+    uint32_t nodeNum;
+    std::vector<std::vector<uint8_t>> delivered;
+
+    explicit TestNode(uint32_t n) : IpFragmenter(1, NACK_DELAY, REASSEMBLY_TIMEOUT, MAX_NACKS), nodeNum(n) {}
+
+  protected:
+    bool sendFrame(uint32_t dest, const uint8_t *frame, size_t len) override
+    {
+        air.push_back({nodeNum, dest, std::vector<uint8_t>(frame, frame + len)});
+        return true;
+    }
+
+    void deliver(uint32_t from, const uint8_t *data, size_t len) override { delivered.emplace_back(data, data + len); }
+};
+
+TestNode *nodeA, *nodeB;
+
+TestNode *nodeFor(uint32_t n)
+{
+    return n == nodeA->nodeNum ? nodeA : nodeB;
+}
+
+std::vector<uint8_t> makeDatagram(size_t len, uint8_t seed)
+{
+    std::vector<uint8_t> d(len);
+    for (size_t i = 0; i < len; i++)
+        d[i] = (uint8_t)(seed + i * 7);
+    return d;
+}
+
+/// Deliver queued frames, dropping the ones for which drop(n) is true (n counts frames since the start of the test)
+template <class DropFn> void runAir(uint32_t now, DropFn drop)
+{
+    static int n = 0;
+    while (!air.empty()) {
+        Frame f = air.front();
+        air.pop_front();
+        if (!drop(n++))
+            nodeFor(f.to)->handleFrame(f.from, f.bytes.data(), f.bytes.size(), now);
+    }
+}
+
+void runAir(uint32_t now)
+{
+    runAir(now, [](int) { return false; });
+}
+
+/// Collect the frames of one datagram without delivering them
+std::vector<Frame> takeFrames()
+{
+    std::vector<Frame> frames(air.begin(), air.end());
+    air.clear();
+    return frames;
+}
+
+void deliverFrame(const Frame &f, uint32_t now)
+{
+    nodeFor(f.to)->handleFrame(f.from, f.bytes.data(), f.bytes.size(), now);
+}
+
+// Stand-in for the rest of the mesh: packets SimRadio lets through land here
+class MockRouter : public Router
+{
+  public:
+    ~MockRouter()
+    {
+        delete cryptLock;
+        cryptLock = NULL;
+    }
+    void enqueueReceivedMessage(meshtastic_MeshPacket *p) override
+    {
+        received.push_back(*p);
+        packetPool.release(p);
+    }
+    std::deque<meshtastic_MeshPacket> received;
+};
+} // namespace
+
+void setUp(void)
+{
+    air.clear();
+    nodeA = new TestNode(0xA);
+    nodeB = new TestNode(0xB);
+}
+
+void tearDown(void)
+{
+    delete nodeA;
+    delete nodeB;
+}
+
+static void test_singleFragment()
+{
+    auto d = makeDatagram(100, 1);
+    TEST_ASSERT_TRUE(nodeA->sendDatagram(nodeB->nodeNum, d.data(), d.size(), 0));
+    TEST_ASSERT_EQUAL(1, air.size());
+    TEST_ASSERT_EQUAL(FRAG_HEADER_LEN + 100, air.front().bytes.size());
+    runAir(0);
+    TEST_ASSERT_EQUAL(1, nodeB->delivered.size());
+    TEST_ASSERT_TRUE(nodeB->delivered[0] == d);
+    TEST_ASSERT_EQUAL(UINT32_MAX, nodeA->runTimers(0)); // nothing kept for retransmission
+}
+
+static void test_reassemblyOutOfOrder()
+{
+    auto d = makeDatagram(FRAG_MAX_DATAGRAM, 2);
+    TEST_ASSERT_TRUE(nodeA->sendDatagram(nodeB->nodeNum, d.data(), d.size(), 0));
+    std::vector<Frame> frames = takeFrames();
+    TEST_ASSERT_EQUAL(7, frames.size());
+
+    for (int i = frames.size() - 1; i >= 0; i--) {
+        TEST_ASSERT_EQUAL(0, nodeB->delivered.size());
+        deliverFrame(frames[i], 10);
+    }
+    TEST_ASSERT_EQUAL(1, nodeB->delivered.size());
+    TEST_ASSERT_TRUE(nodeB->delivered[0] == d);
+    TEST_ASSERT_EQUAL(0, nodeB->getPendingCount());
+
+    // A late duplicate must not be reassembled again
+    deliverFrame(frames[2], 20);
+    TEST_ASSERT_EQUAL(1, nodeB->delivered.size());
+    TEST_ASSERT_EQUAL(0, nodeB->getPendingCount());
+    TEST_ASSERT_EQUAL(1, nodeB->getStats().duplicates);
+}
+
+static void test_selectiveNack()
+{
+    auto d = makeDatagram(1000, 3); // 5 fragments
+    nodeA->sendDatagram(nodeB->nodeNum, d.data(), d.size(), 0);
+    std::vector<Frame> frames = takeFrames();
+    TEST_ASSERT_EQUAL(5, frames.size());
+    for (size_t i = 0; i < frames.size(); i++)
+        if (i != 1 && i != 3)
+            deliverFrame(frames[i], 100);
+    TEST_ASSERT_EQUAL(0, nodeB->delivered.size());
+
+    // Not yet
+    TEST_ASSERT_EQUAL(NACK_DELAY - 100, nodeB->runTimers(200));
+    TEST_ASSERT_EQUAL(0, air.size());
+
+    nodeB->runTimers(100 + NACK_DELAY);
+    TEST_ASSERT_EQUAL(1, nodeB->getStats().nacksSent);
+    TEST_ASSERT_EQUAL(1, air.size());
+    TEST_ASSERT_EQUAL(FRAG_NACK_LEN, air.front().bytes.size());
+
+    // NACK reaches A, which resends exactly the two missing fragments
+    runAir(1200);
+    TEST_ASSERT_EQUAL(2, nodeA->getStats().fragmentsRetransmitted);
+    TEST_ASSERT_EQUAL(7, nodeA->getStats().fragmentsSent);
+    TEST_ASSERT_EQUAL(1, nodeB->delivered.size());
+    TEST_ASSERT_TRUE(nodeB->delivered[0] == d);
+}
+
+static void test_givesUpAfterMaxNacks()
+{
+    auto d = makeDatagram(500, 4);
+    nodeA->sendDatagram(nodeB->nodeNum, d.data(), d.size(), 0);
+    std::vector<Frame> frames = takeFrames();
+    deliverFrame(frames[0], 0);
+
+    uint32_t now = 0;
+    for (int i = 0; i < 10; i++) {
+        now += NACK_DELAY;
+        nodeB->runTimers(now);
+        runAir(now, [](int) { return true; }); // NACKs never make it
+    }
+    TEST_ASSERT_EQUAL(MAX_NACKS, nodeB->getStats().nacksSent);
+    TEST_ASSERT_EQUAL(1, nodeB->getStats().timeouts);
+    TEST_ASSERT_EQUAL(0, nodeB->getPendingCount());
+    TEST_ASSERT_EQUAL(UINT32_MAX, nodeB->runTimers(now));
+
+    // The sender lets go of its copy too
+    TEST_ASSERT_EQUAL(UINT32_MAX, nodeA->runTimers(REASSEMBLY_TIMEOUT));
+}
+
+static void test_reassemblyPoolIsBounded()
+{
+    // Partial datagrams from several senders fill every slot
+    for (int s = 0; s < FRAG_RX_SLOTS + 1; s++) {
+        TestNode sender(0x100 + s);
+        auto d = makeDatagram(300, s);
+        sender.sendDatagram(nodeB->nodeNum, d.data(), d.size(), 0);
+        std::vector<Frame> frames = takeFrames();
+        deliverFrame(frames[0], 0);
+    }
+    TEST_ASSERT_EQUAL(FRAG_RX_SLOTS, nodeB->getPendingCount());
+    TEST_ASSERT_EQUAL(1, nodeB->getStats().noSlot);
+
+    // Once the oldest stalls it can be recycled for a new datagram
+    auto d = makeDatagram(300, 9);
+    nodeA->sendDatagram(nodeB->nodeNum, d.data(), d.size(), NACK_DELAY);
+    runAir(NACK_DELAY);
+    TEST_ASSERT_EQUAL(1, nodeB->delivered.size());
+    TEST_ASSERT_EQUAL(1, nodeB->getStats().timeouts);
+}
+
+static void test_malformedFrames()
+{
+    const uint8_t tooShort[] = {FRAG_TYPE_DATA, 0, 1, 0, 2};
+    const uint8_t badIndex[] = {FRAG_TYPE_DATA, 0, 1, 3, 2, 0xAA};
+    const uint8_t shortMiddle[] = {FRAG_TYPE_DATA, 0, 1, 0, 2, 0xAA}; // only the last fragment may be short
+    const uint8_t tooMany[] = {FRAG_TYPE_DATA, 0, 1, 0, FRAG_MAX_FRAGMENTS + 1, 0xAA};
+    const uint8_t badType[] = {0x7F, 0, 1, 0, 1, 0xAA};
+    const uint8_t longNack[] = {FRAG_TYPE_NACK, 0, 1, 0, 0, 0};
+
+    nodeB->handleFrame(0xA, tooShort, sizeof(tooShort), 0);
+    nodeB->handleFrame(0xA, badIndex, sizeof(badIndex), 0);
+    nodeB->handleFrame(0xA, shortMiddle, sizeof(shortMiddle), 0);
+    nodeB->handleFrame(0xA, tooMany, sizeof(tooMany), 0);
+    nodeB->handleFrame(0xA, badType, sizeof(badType), 0);
+    nodeB->handleFrame(0xA, longNack, sizeof(longNack), 0);
+    TEST_ASSERT_EQUAL(6, nodeB->getStats().malformed);
+    TEST_ASSERT_EQUAL(0, nodeB->getPendingCount());
+    TEST_ASSERT_EQUAL(0, nodeB->delivered.size());
+}
+
+/**
+ * Two nodes exchanging datagrams through SimRadio's receive path with loss injection.  Every fragment and NACK is a real
+ * IP_TUNNEL_APP MeshPacket that SimRadio either drops or hands to the router.
+ */
+static void test_simRadioLoss()
+{
+    const int datagrams = 40;
+    MockRouter *mockRouter = new MockRouter();
+    router = mockRouter;
+    if (!airTime)
+        airTime = new AirTime();
+    SimRadio *sim = new SimRadio();
+    sim->rxLossPercent = 25;
+    randomSeed(1234);
+
+    uint32_t now = 0;
+    int sent = 0;
+    auto pump = [&]() {
+        while (!air.empty()) {
+            Frame f = air.front();
+            air.pop_front();
+            meshtastic_MeshPacket p = meshtastic_MeshPacket_init_zero;
+            p.from = f.from;
+            p.to = f.to;
+            p.id = sent + 1;
+            p.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+            p.decoded.portnum = meshtastic_PortNum_IP_TUNNEL_APP;
+            p.decoded.payload.size = f.bytes.size();
+            memcpy(p.decoded.payload.bytes, f.bytes.data(), f.bytes.size());
+            sim->startReceive(&p);
+        }
+        while (!mockRouter->received.empty()) {
+            meshtastic_MeshPacket p = mockRouter->received.front();
+            mockRouter->received.pop_front();
+            nodeFor(p.to)->handleFrame(p.from, p.decoded.payload.bytes, p.decoded.payload.size, now);
+        }
+    };
+
+    for (sent = 0; sent < datagrams; sent++) {
+        auto d = makeDatagram(300 + sent * 20, sent);
+        TestNode *from = sent % 2 ? nodeA : nodeB;
+        TestNode *to = from == nodeA ? nodeB : nodeA;
+        from->sendDatagram(to->nodeNum, d.data(), d.size(), now);
+        pump();
+        // Give NACK rounds a chance before the next datagram, like a slow LoRa link would
+        for (int round = 0; round < MAX_NACKS + 1; round++) {
+            now += NACK_DELAY;
+            nodeA->runTimers(now);
+            nodeB->runTimers(now);
+            pump();
+        }
+    }
+
+    int delivered = nodeA->delivered.size() + nodeB->delivered.size();
+    uint32_t retransmitted = nodeA->getStats().fragmentsRetransmitted + nodeB->getStats().fragmentsRetransmitted;
+    uint32_t fragments = nodeA->getStats().fragmentsSent + nodeB->getStats().fragmentsSent;
+    printf("%d%% loss: %d/%d datagrams delivered, %u packets lost, %u of %u fragments were retransmissions, %u NACKs\n",
+           sim->rxLossPercent, delivered, datagrams, (unsigned)sim->rxLost, (unsigned)retransmitted, (unsigned)fragments,
+           (unsigned)(nodeA->getStats().nacksSent + nodeB->getStats().nacksSent));
+
+    TEST_ASSERT_TRUE(sim->rxLost > 0);
+    TEST_ASSERT_TRUE(retransmitted > 0);
+    TEST_ASSERT_TRUE(delivered * 100 >= datagrams * 90);
+
+    delete sim;
+    router = NULL;
+    delete mockRouter;
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_singleFragment);
+    RUN_TEST(test_reassemblyOutOfOrder);
+    RUN_TEST(test_selectiveNack);
+    RUN_TEST(test_givesUpAfterMaxNacks);
+    RUN_TEST(test_reassemblyPoolIsBounded);
+    RUN_TEST(test_malformedFrames);
+    RUN_TEST(test_simRadioLoss);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
@@ -0,0 +1,288 @@
+// Captured-style IPv4 frames for the header compression round trip, in capture order.
+// Regenerate with checksums recomputed if you change them.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// chat 192.168.4.100:40000 -> 192.168.4.101:5000
+static const uint8_t frame0[] = {
+    0x45, 0x00, 0x00, 0x33, 0x1a, 0x2b, 0x40, 0x00, 0x40, 0x11, 0x96, 0x75, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x65, 0x9c, 0x40, 0x13, 0x88, 0x00, 0x1f, 0x94, 0xc9, 0x4e, 0x65, 0x65, 0x64,
+    0x20, 0x77, 0x61, 0x74, 0x65, 0x72, 0x20, 0x61, 0x74, 0x20, 0x73, 0x68, 0x65, 0x6c, 0x74, 0x65,
+    0x72, 0x20, 0x42,
+};
+// chat reply 192.168.4.101:5000 -> 192.168.4.100:40000 (ID always 0)
+static const uint8_t frame1[] = {
+    0x45, 0x00, 0x00, 0x1e, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0xb0, 0xb5, 0xc0, 0xa8, 0x04, 0x65,
+    0xc0, 0xa8, 0x04, 0x64, 0x13, 0x88, 0x9c, 0x40, 0x00, 0x0a, 0x56, 0x8c, 0x6f, 0x6b,
+};
+// chat 192.168.4.100:40000 -> 192.168.4.101:5000
+static const uint8_t frame2[] = {
+    0x45, 0x00, 0x00, 0x32, 0x1a, 0x2c, 0x40, 0x00, 0x40, 0x11, 0x96, 0x75, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x65, 0x9c, 0x40, 0x13, 0x88, 0x00, 0x1e, 0xef, 0xee, 0x4f, 0x6e, 0x20, 0x6f,
+    0x75, 0x72, 0x20, 0x77, 0x61, 0x79, 0x2c, 0x20, 0x45, 0x54, 0x41, 0x20, 0x32, 0x30, 0x20, 0x6d,
+    0x69, 0x6e,
+};
+// chat reply 192.168.4.101:5000 -> 192.168.4.100:40000 (ID always 0)
+static const uint8_t frame3[] = {
+    0x45, 0x00, 0x00, 0x55, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0xb0, 0x7e, 0xc0, 0xa8, 0x04, 0x65,
+    0xc0, 0xa8, 0x04, 0x64, 0x13, 0x88, 0x9c, 0x40, 0x00, 0x41, 0xfa, 0x76, 0x4d, 0x65, 0x64, 0x69,
+    0x63, 0x61, 0x6c, 0x20, 0x74, 0x65, 0x61, 0x6d, 0x20, 0x61, 0x72, 0x72, 0x69, 0x76, 0x69, 0x6e,
+    0x67, 0x20, 0x61, 0x74, 0x20, 0x31, 0x34, 0x3a, 0x30, 0x30, 0x2c, 0x20, 0x70, 0x6c, 0x65, 0x61,
+    0x73, 0x65, 0x20, 0x63, 0x6c, 0x65, 0x61, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x65, 0x6e, 0x74,
+    0x72, 0x61, 0x6e, 0x63, 0x65,
+};
+// chat 192.168.4.100:40000 -> 192.168.4.101:5000
+static const uint8_t frame4[] = {
+    0x45, 0x00, 0x00, 0x3b, 0x1a, 0x2d, 0x40, 0x00, 0x40, 0x11, 0x96, 0x6b, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x65, 0x9c, 0x40, 0x13, 0x88, 0x00, 0x27, 0x0b, 0x18, 0x52, 0x6f, 0x61, 0x64,
+    0x20, 0x6e, 0x6f, 0x72, 0x74, 0x68, 0x20, 0x69, 0x73, 0x20, 0x62, 0x6c, 0x6f, 0x63, 0x6b, 0x65,
+    0x64, 0x20, 0x62, 0x79, 0x20, 0x64, 0x65, 0x62, 0x72, 0x69, 0x73,
+};
+// chat reply 192.168.4.101:5000 -> 192.168.4.100:40000 (ID always 0)
+static const uint8_t frame5[] = {
+    0x45, 0x00, 0x00, 0x2a, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0xb0, 0xa9, 0xc0, 0xa8, 0x04, 0x65,
+    0xc0, 0xa8, 0x04, 0x64, 0x13, 0x88, 0x9c, 0x40, 0x00, 0x16, 0x7e, 0xaa, 0x42, 0x61, 0x74, 0x74,
+    0x65, 0x72, 0x79, 0x20, 0x61, 0x74, 0x20, 0x33, 0x30, 0x25,
+};
+// chat 192.168.4.100:40000 -> 192.168.4.101:5000
+static const uint8_t frame6[] = {
+    0x45, 0x00, 0x00, 0x1e, 0x1a, 0x2e, 0x40, 0x00, 0x40, 0x11, 0x96, 0x87, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x65, 0x9c, 0x40, 0x13, 0x88, 0x00, 0x0a, 0x56, 0x8c, 0x6f, 0x6b,
+};
+// chat reply 192.168.4.101:5000 -> 192.168.4.100:40000 (ID always 0)
+static const uint8_t frame7[] = {
+    0x45, 0x00, 0x00, 0x25, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0xb0, 0xae, 0xc0, 0xa8, 0x04, 0x65,
+    0xc0, 0xa8, 0x04, 0x64, 0x13, 0x88, 0x9c, 0x40, 0x00, 0x11, 0x15, 0x2b, 0x43, 0x6f, 0x70, 0x79,
+    0x20, 0x74, 0x68, 0x61, 0x74,
+};
+// chat 192.168.4.100:40000 -> 192.168.4.101:5000
+static const uint8_t frame8[] = {
+    0x45, 0x00, 0x00, 0x55, 0x1a, 0x2f, 0x40, 0x00, 0x40, 0x11, 0x96, 0x4f, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x65, 0x9c, 0x40, 0x13, 0x88, 0x00, 0x41, 0xfa, 0x76, 0x4d, 0x65, 0x64, 0x69,
+    0x63, 0x61, 0x6c, 0x20, 0x74, 0x65, 0x61, 0x6d, 0x20, 0x61, 0x72, 0x72, 0x69, 0x76, 0x69, 0x6e,
+    0x67, 0x20, 0x61, 0x74, 0x20, 0x31, 0x34, 0x3a, 0x30, 0x30, 0x2c, 0x20, 0x70, 0x6c, 0x65, 0x61,
+    0x73, 0x65, 0x20, 0x63, 0x6c, 0x65, 0x61, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x65, 0x6e, 0x74,
+    0x72, 0x61, 0x6e, 0x63, 0x65,
+};
+// chat reply 192.168.4.101:5000 -> 192.168.4.100:40000 (ID always 0)
+static const uint8_t frame9[] = {
+    0x45, 0x00, 0x00, 0x33, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0xb0, 0xa0, 0xc0, 0xa8, 0x04, 0x65,
+    0xc0, 0xa8, 0x04, 0x64, 0x13, 0x88, 0x9c, 0x40, 0x00, 0x1f, 0x7f, 0xef, 0x41, 0x6e, 0x79, 0x20,
+    0x6e, 0x65, 0x77, 0x73, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x73, 0x65, 0x63, 0x74, 0x6f, 0x72,
+    0x20, 0x34, 0x3f,
+};
+// chat 192.168.4.100:40000 -> 192.168.4.101:5000
+static const uint8_t frame10[] = {
+    0x45, 0x00, 0x00, 0x2a, 0x1a, 0x30, 0x40, 0x00, 0x40, 0x11, 0x96, 0x79, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x65, 0x9c, 0x40, 0x13, 0x88, 0x00, 0x16, 0x7e, 0xaa, 0x42, 0x61, 0x74, 0x74,
+    0x65, 0x72, 0x79, 0x20, 0x61, 0x74, 0x20, 0x33, 0x30, 0x25,
+};
+// chat reply 192.168.4.101:5000 -> 192.168.4.100:40000 (ID always 0)
+static const uint8_t frame11[] = {
+    0x45, 0x00, 0x00, 0x33, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0xb0, 0xa0, 0xc0, 0xa8, 0x04, 0x65,
+    0xc0, 0xa8, 0x04, 0x64, 0x13, 0x88, 0x9c, 0x40, 0x00, 0x1f, 0x94, 0xc9, 0x4e, 0x65, 0x65, 0x64,
+    0x20, 0x77, 0x61, 0x74, 0x65, 0x72, 0x20, 0x61, 0x74, 0x20, 0x73, 0x68, 0x65, 0x6c, 0x74, 0x65,
+    0x72, 0x20, 0x42,
+};
+// chat 192.168.4.100:40000 -> 192.168.4.101:5000
+static const uint8_t frame12[] = {
+    0x45, 0x00, 0x00, 0x25, 0x1a, 0x31, 0x40, 0x00, 0x40, 0x11, 0x96, 0x7d, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x65, 0x9c, 0x40, 0x13, 0x88, 0x00, 0x11, 0x15, 0x2b, 0x43, 0x6f, 0x70, 0x79,
+    0x20, 0x74, 0x68, 0x61, 0x74,
+};
+// chat reply 192.168.4.101:5000 -> 192.168.4.100:40000 (ID always 0)
+static const uint8_t frame13[] = {
+    0x45, 0x00, 0x00, 0x32, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0xb0, 0xa1, 0xc0, 0xa8, 0x04, 0x65,
+    0xc0, 0xa8, 0x04, 0x64, 0x13, 0x88, 0x9c, 0x40, 0x00, 0x1e, 0xef, 0xee, 0x4f, 0x6e, 0x20, 0x6f,
+    0x75, 0x72, 0x20, 0x77, 0x61, 0x79, 0x2c, 0x20, 0x45, 0x54, 0x41, 0x20, 0x32, 0x30, 0x20, 0x6d,
+    0x69, 0x6e,
+};
+// chat 192.168.4.100:40000 -> 192.168.4.101:5000
+static const uint8_t frame14[] = {
+    0x45, 0x00, 0x00, 0x33, 0x1a, 0x32, 0x40, 0x00, 0x40, 0x11, 0x96, 0x6e, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x65, 0x9c, 0x40, 0x13, 0x88, 0x00, 0x1f, 0x7f, 0xef, 0x41, 0x6e, 0x79, 0x20,
+    0x6e, 0x65, 0x77, 0x73, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x73, 0x65, 0x63, 0x74, 0x6f, 0x72,
+    0x20, 0x34, 0x3f,
+};
+// chat reply 192.168.4.101:5000 -> 192.168.4.100:40000 (ID always 0)
+static const uint8_t frame15[] = {
+    0x45, 0x00, 0x00, 0x3b, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0xb0, 0x98, 0xc0, 0xa8, 0x04, 0x65,
+    0xc0, 0xa8, 0x04, 0x64, 0x13, 0x88, 0x9c, 0x40, 0x00, 0x27, 0x0b, 0x18, 0x52, 0x6f, 0x61, 0x64,
+    0x20, 0x6e, 0x6f, 0x72, 0x74, 0x68, 0x20, 0x69, 0x73, 0x20, 0x62, 0x6c, 0x6f, 0x63, 0x6b, 0x65,
+    0x64, 0x20, 0x62, 0x79, 0x20, 0x64, 0x65, 0x62, 0x72, 0x69, 0x73,
+};
+// chat 192.168.4.100:40000 -> 192.168.4.101:5000
+static const uint8_t frame16[] = {
+    0x45, 0x00, 0x00, 0x33, 0x1a, 0x33, 0x40, 0x00, 0x40, 0x11, 0x96, 0x6d, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x65, 0x9c, 0x40, 0x13, 0x88, 0x00, 0x1f, 0x94, 0xc9, 0x4e, 0x65, 0x65, 0x64,
+    0x20, 0x77, 0x61, 0x74, 0x65, 0x72, 0x20, 0x61, 0x74, 0x20, 0x73, 0x68, 0x65, 0x6c, 0x74, 0x65,
+    0x72, 0x20, 0x42,
+};
+// chat reply 192.168.4.101:5000 -> 192.168.4.100:40000 (ID always 0)
+static const uint8_t frame17[] = {
+    0x45, 0x00, 0x00, 0x1e, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0xb0, 0xb5, 0xc0, 0xa8, 0x04, 0x65,
+    0xc0, 0xa8, 0x04, 0x64, 0x13, 0x88, 0x9c, 0x40, 0x00, 0x0a, 0x56, 0x8c, 0x6f, 0x6b,
+};
+// chat 192.168.4.100:40000 -> 192.168.4.101:5000
+static const uint8_t frame18[] = {
+    0x45, 0x00, 0x00, 0x32, 0x1a, 0x34, 0x40, 0x00, 0x40, 0x11, 0x96, 0x6d, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x65, 0x9c, 0x40, 0x13, 0x88, 0x00, 0x1e, 0xef, 0xee, 0x4f, 0x6e, 0x20, 0x6f,
+    0x75, 0x72, 0x20, 0x77, 0x61, 0x79, 0x2c, 0x20, 0x45, 0x54, 0x41, 0x20, 0x32, 0x30, 0x20, 0x6d,
+    0x69, 0x6e,
+};
+// chat reply 192.168.4.101:5000 -> 192.168.4.100:40000 (ID always 0)
+static const uint8_t frame19[] = {
+    0x45, 0x00, 0x00, 0x55, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0xb0, 0x7e, 0xc0, 0xa8, 0x04, 0x65,
+    0xc0, 0xa8, 0x04, 0x64, 0x13, 0x88, 0x9c, 0x40, 0x00, 0x41, 0xfa, 0x76, 0x4d, 0x65, 0x64, 0x69,
+    0x63, 0x61, 0x6c, 0x20, 0x74, 0x65, 0x61, 0x6d, 0x20, 0x61, 0x72, 0x72, 0x69, 0x76, 0x69, 0x6e,
+    0x67, 0x20, 0x61, 0x74, 0x20, 0x31, 0x34, 0x3a, 0x30, 0x30, 0x2c, 0x20, 0x70, 0x6c, 0x65, 0x61,
+    0x73, 0x65, 0x20, 0x63, 0x6c, 0x65, 0x61, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x65, 0x6e, 0x74,
+    0x72, 0x61, 0x6e, 0x63, 0x65,
+};
+// http 192.168.4.102:51000 -> 10.0.0.5:80, no DF, timestamps
+static const uint8_t frame20[] = {
+    0x45, 0x00, 0x00, 0x4a, 0x30, 0x00, 0x00, 0x00, 0x40, 0x06, 0x7b, 0x9b, 0xc0, 0xa8, 0x04, 0x66,
+    0x0a, 0x00, 0x00, 0x05, 0xc7, 0x38, 0x00, 0x50, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88,
+    0x80, 0x18, 0x01, 0xf6, 0x97, 0x0c, 0x00, 0x00, 0x01, 0x01, 0x08, 0x0a, 0x00, 0x00, 0x03, 0xe8,
+    0x00, 0x00, 0x03, 0xe3, 0x47, 0x45, 0x54, 0x20, 0x2f, 0x73, 0x74, 0x61, 0x74, 0x75, 0x73, 0x20,
+    0x48, 0x54, 0x54, 0x50, 0x2f, 0x31, 0x2e, 0x31, 0x0d, 0x0a,
+};
+// http 192.168.4.102:51000 -> 10.0.0.5:80, no DF, timestamps
+static const uint8_t frame21[] = {
+    0x45, 0x00, 0x00, 0x34, 0x30, 0x0a, 0x00, 0x00, 0x40, 0x06, 0x7b, 0xa7, 0xc0, 0xa8, 0x04, 0x66,
+    0x0a, 0x00, 0x00, 0x05, 0xc7, 0x38, 0x00, 0x50, 0x11, 0x22, 0x33, 0x5a, 0x55, 0x66, 0x77, 0x88,
+    0x80, 0x10, 0x01, 0xf6, 0xc4, 0xe1, 0x00, 0x00, 0x01, 0x01, 0x08, 0x0a, 0x00, 0x00, 0x03, 0xf2,
+    0x00, 0x00, 0x03, 0xed,
+};
+// http 192.168.4.102:51000 -> 10.0.0.5:80, no DF, timestamps
+static const uint8_t frame22[] = {
+    0x45, 0x00, 0x00, 0x34, 0x30, 0x0e, 0x00, 0x00, 0x40, 0x06, 0x7b, 0xa3, 0xc0, 0xa8, 0x04, 0x66,
+    0x0a, 0x00, 0x00, 0x05, 0xc7, 0x38, 0x00, 0x50, 0x11, 0x22, 0x33, 0x5a, 0x55, 0x66, 0x77, 0x88,
+    0x80, 0x10, 0x01, 0xf6, 0xc4, 0xcd, 0x00, 0x00, 0x01, 0x01, 0x08, 0x0a, 0x00, 0x00, 0x03, 0xfc,
+    0x00, 0x00, 0x03, 0xf7,
+};
+// http 192.168.4.102:51000 -> 10.0.0.5:80, no DF, timestamps
+static const uint8_t frame23[] = {
+    0x45, 0x00, 0x00, 0x34, 0x30, 0x31, 0x00, 0x00, 0x40, 0x06, 0x7b, 0x80, 0xc0, 0xa8, 0x04, 0x66,
+    0x0a, 0x00, 0x00, 0x05, 0xc7, 0x38, 0x00, 0x50, 0x11, 0x22, 0x33, 0x5a, 0x55, 0x66, 0x77, 0x88,
+    0x80, 0x10, 0x01, 0xf6, 0xc4, 0xb9, 0x00, 0x00, 0x01, 0x01, 0x08, 0x0a, 0x00, 0x00, 0x04, 0x06,
+    0x00, 0x00, 0x04, 0x01,
+};
+// http 192.168.4.102:51000 -> 10.0.0.5:80, no DF, timestamps
+static const uint8_t frame24[] = {
+    0x45, 0x00, 0x00, 0x34, 0x30, 0x49, 0x00, 0x00, 0x40, 0x06, 0x7b, 0x68, 0xc0, 0xa8, 0x04, 0x66,
+    0x0a, 0x00, 0x00, 0x05, 0xc7, 0x38, 0x00, 0x50, 0x11, 0x22, 0x33, 0x5a, 0x55, 0x66, 0x77, 0x88,
+    0x80, 0x10, 0x01, 0xf6, 0xc4, 0xa5, 0x00, 0x00, 0x01, 0x01, 0x08, 0x0a, 0x00, 0x00, 0x04, 0x10,
+    0x00, 0x00, 0x04, 0x0b,
+};
+// http 192.168.4.102:51000 -> 10.0.0.5:80, no DF, timestamps
+static const uint8_t frame25[] = {
+    0x45, 0x00, 0x00, 0x34, 0x30, 0x4d, 0x00, 0x00, 0x40, 0x06, 0x7b, 0x64, 0xc0, 0xa8, 0x04, 0x66,
+    0x0a, 0x00, 0x00, 0x05, 0xc7, 0x38, 0x00, 0x50, 0x11, 0x22, 0x33, 0x5a, 0x55, 0x66, 0x79, 0x88,
+    0x80, 0x10, 0x01, 0xf6, 0xc2, 0x91, 0x00, 0x00, 0x01, 0x01, 0x08, 0x0a, 0x00, 0x00, 0x04, 0x1a,
+    0x00, 0x00, 0x04, 0x15,
+};
+// http 192.168.4.102:51000 -> 10.0.0.5:80, no DF, timestamps
+static const uint8_t frame26[] = {
+    0x45, 0x00, 0x00, 0x34, 0x30, 0x5b, 0x00, 0x00, 0x40, 0x06, 0x7b, 0x56, 0xc0, 0xa8, 0x04, 0x66,
+    0x0a, 0x00, 0x00, 0x05, 0xc7, 0x38, 0x00, 0x50, 0x11, 0x22, 0x33, 0x5a, 0x55, 0x66, 0x7b, 0x88,
+    0x80, 0x10, 0x01, 0xf6, 0xc0, 0x7d, 0x00, 0x00, 0x01, 0x01, 0x08, 0x0a, 0x00, 0x00, 0x04, 0x24,
+    0x00, 0x00, 0x04, 0x1f,
+};
+// http 192.168.4.102:51000 -> 10.0.0.5:80, no DF, timestamps
+static const uint8_t frame27[] = {
+    0x45, 0x00, 0x00, 0x34, 0x30, 0x61, 0x00, 0x00, 0x40, 0x06, 0x7b, 0x50, 0xc0, 0xa8, 0x04, 0x66,
+    0x0a, 0x00, 0x00, 0x05, 0xc7, 0x38, 0x00, 0x50, 0x11, 0x22, 0x33, 0x5a, 0x55, 0x66, 0x7b, 0x88,
+    0x80, 0x10, 0x01, 0xf6, 0xc0, 0x69, 0x00, 0x00, 0x01, 0x01, 0x08, 0x0a, 0x00, 0x00, 0x04, 0x2e,
+    0x00, 0x00, 0x04, 0x29,
+};
+// ping 192.168.4.100 -> 192.168.4.1
+static const uint8_t frame28[] = {
+    0x45, 0x00, 0x00, 0x3c, 0x40, 0x00, 0x40, 0x00, 0x40, 0x01, 0x71, 0x0b, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x01, 0x08, 0x00, 0xf4, 0xc9, 0x12, 0x34, 0x00, 0x01, 0x00, 0x01, 0x02, 0x03,
+    0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13,
+    0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+};
+// ping 192.168.4.100 -> 192.168.4.1
+static const uint8_t frame29[] = {
+    0x45, 0x00, 0x00, 0x3c, 0x40, 0x01, 0x40, 0x00, 0x40, 0x01, 0x71, 0x0a, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x01, 0x08, 0x00, 0xf4, 0xc8, 0x12, 0x34, 0x00, 0x02, 0x00, 0x01, 0x02, 0x03,
+    0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13,
+    0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+};
+// ping 192.168.4.100 -> 192.168.4.1
+static const uint8_t frame30[] = {
+    0x45, 0x00, 0x00, 0x3c, 0x40, 0x02, 0x40, 0x00, 0x40, 0x01, 0x71, 0x09, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x01, 0x08, 0x00, 0xf4, 0xc7, 0x12, 0x34, 0x00, 0x03, 0x00, 0x01, 0x02, 0x03,
+    0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13,
+    0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+};
+// ping 192.168.4.100 -> 192.168.4.1
+static const uint8_t frame31[] = {
+    0x45, 0x00, 0x00, 0x3c, 0x40, 0x03, 0x40, 0x00, 0x40, 0x01, 0x71, 0x08, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x01, 0x08, 0x00, 0xf4, 0xc6, 0x12, 0x34, 0x00, 0x04, 0x00, 0x01, 0x02, 0x03,
+    0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13,
+    0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+};
+// ntp 192.168.4.103:123 -> 203.0.113.7:123, no UDP checksum
+static const uint8_t frame32[] = {
+    0x45, 0x00, 0x00, 0x4c, 0x01, 0x00, 0x40, 0x00, 0x40, 0x11, 0x38, 0x8a, 0xc0, 0xa8, 0x04, 0x67,
+    0xcb, 0x00, 0x71, 0x07, 0x00, 0x7b, 0x00, 0x7b, 0x00, 0x38, 0x00, 0x00, 0x23, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+// ntp 192.168.4.103:123 -> 203.0.113.7:123, no UDP checksum
+static const uint8_t frame33[] = {
+    0x45, 0x00, 0x00, 0x4c, 0x02, 0x2c, 0x40, 0x00, 0x40, 0x11, 0x37, 0x5e, 0xc0, 0xa8, 0x04, 0x67,
+    0xcb, 0x00, 0x71, 0x07, 0x00, 0x7b, 0x00, 0x7b, 0x00, 0x38, 0x00, 0x00, 0x23, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+// ntp 192.168.4.103:123 -> 203.0.113.7:123, no UDP checksum
+static const uint8_t frame34[] = {
+    0x45, 0x00, 0x00, 0x4c, 0x03, 0x58, 0x40, 0x00, 0x3f, 0x11, 0x37, 0x32, 0xc0, 0xa8, 0x04, 0x67,
+    0xcb, 0x00, 0x71, 0x07, 0x00, 0x7b, 0x00, 0x7b, 0x00, 0x38, 0x00, 0x00, 0x23, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+// ntp 192.168.4.103:123 -> 203.0.113.7:123, no UDP checksum
+static const uint8_t frame35[] = {
+    0x45, 0x00, 0x00, 0x4c, 0x04, 0x84, 0x40, 0x00, 0x3f, 0x11, 0x36, 0x06, 0xc0, 0xa8, 0x04, 0x67,
+    0xcb, 0x00, 0x71, 0x07, 0x00, 0x7b, 0x00, 0x7b, 0x00, 0x38, 0x00, 0x00, 0x23, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+// fragment (MF set)
+static const uint8_t frame36[] = {
+    0x45, 0x00, 0x00, 0x5c, 0x77, 0x77, 0x20, 0x00, 0x40, 0x11, 0x59, 0x00, 0xc0, 0xa8, 0x04, 0x64,
+    0xc0, 0xa8, 0x04, 0x65, 0x9c, 0x40, 0x13, 0x88, 0x00, 0x48, 0xc5, 0x7b, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+struct CaptureFrame {
+    const uint8_t *bytes;
+    size_t len;
+};
+
+static const CaptureFrame captureFrames[] = {
+    {frame0, sizeof(frame0)}, {frame1, sizeof(frame1)}, {frame2, sizeof(frame2)}, {frame3, sizeof(frame3)},
+    {frame4, sizeof(frame4)}, {frame5, sizeof(frame5)}, {frame6, sizeof(frame6)}, {frame7, sizeof(frame7)},
+    {frame8, sizeof(frame8)}, {frame9, sizeof(frame9)}, {frame10, sizeof(frame10)}, {frame11, sizeof(frame11)},
+    {frame12, sizeof(frame12)}, {frame13, sizeof(frame13)}, {frame14, sizeof(frame14)}, {frame15, sizeof(frame15)},
+    {frame16, sizeof(frame16)}, {frame17, sizeof(frame17)}, {frame18, sizeof(frame18)}, {frame19, sizeof(frame19)},
+    {frame20, sizeof(frame20)}, {frame21, sizeof(frame21)}, {frame22, sizeof(frame22)}, {frame23, sizeof(frame23)},
+    {frame24, sizeof(frame24)}, {frame25, sizeof(frame25)}, {frame26, sizeof(frame26)}, {frame27, sizeof(frame27)},
+    {frame28, sizeof(frame28)}, {frame29, sizeof(frame29)}, {frame30, sizeof(frame30)}, {frame31, sizeof(frame31)},
+    {frame32, sizeof(frame32)}, {frame33, sizeof(frame33)}, {frame34, sizeof(frame34)}, {frame35, sizeof(frame35)},
+    {frame36, sizeof(frame36)},
+};
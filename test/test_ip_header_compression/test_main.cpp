@@ -0,0 +1,191 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "capture_fixtures.h"
+#include "wifi/IpHeaderCompressor.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define NUM_FRAMES (sizeof(captureFrames) / sizeof(captureFrames[0]))
+
+// Indexes into captureFrames
+#define CHAT_FIRST 0  // 192.168.4.100 -> .101, every other frame up to 18
+#define TCP_FIRST 20  // 192.168.4.102 -> 10.0.0.5, 8 frames
+#define FRAGMENT 36
+
+static const uint32_t nodeA = 0x1111, nodeB = 0x2222;
+
+static uint8_t frame[1600];
+static uint8_t packet[1600];
+
+/// Decode frame at the receiver and check it matches the original packet bit for bit
+static void assertRoundTrip(IpHeaderCompressor &rx, uint32_t from, const CaptureFrame &orig, size_t frameLen)
+{
+    size_t outLen = 0;
+    TEST_ASSERT_EQUAL(IPHC_OK, rx.decompress(from, frame, frameLen, packet, sizeof(packet), outLen));
+    TEST_ASSERT_EQUAL(orig.len, outLen);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(orig.bytes, packet, orig.len);
+}
+
+static void test_roundTripCapture()
+{
+    IpHeaderCompressor tx, rx;
+    size_t totalIn = 0, totalOut = 0;
+
+    for (size_t i = 0; i < NUM_FRAMES; i++) {
+        size_t n = tx.compress(captureFrames[i].bytes, captureFrames[i].len, frame, sizeof(frame));
+        TEST_ASSERT_NOT_EQUAL(0, n);
+        assertRoundTrip(rx, nodeA, captureFrames[i], n);
+        totalIn += captureFrames[i].len;
+        totalOut += n;
+    }
+
+    printf("%-40s %7s %9s %9s %7s\n", "flow", "packets", "bytes in", "bytes out", "saved");
+    for (int f = 0; f < tx.getFlowCount(); f++) {
+        IphcFlowStats s;
+        TEST_ASSERT_TRUE(tx.getFlowStats(f, s));
+        char name[64];
+        snprintf(name, sizeof(name), "%u.%u.%u.%u:%u > %u.%u.%u.%u:%u/%u", s.srcIP >> 24, (s.srcIP >> 16) & 0xFF,
+                 (s.srcIP >> 8) & 0xFF, s.srcIP & 0xFF, s.srcPort, s.dstIP >> 24, (s.dstIP >> 16) & 0xFF, (s.dstIP >> 8) & 0xFF,
+                 s.dstIP & 0xFF, s.dstPort, s.protocol);
+        printf("%-40s %7u %9u %9u %6.1f%%\n", name, (unsigned)s.packets, (unsigned)s.bytesIn, (unsigned)s.bytesOut,
+               100.0 * (s.bytesIn - s.bytesOut) / s.bytesIn);
+        TEST_ASSERT_TRUE(s.bytesOut < s.bytesIn);
+    }
+    printf("total: %u -> %u bytes (%u raw frames)\n", (unsigned)totalIn, (unsigned)totalOut, (unsigned)tx.getRawCount());
+
+    TEST_ASSERT_EQUAL(1, tx.getRawCount()); // just the fragment
+    TEST_ASSERT_TRUE(totalOut * 100 < totalIn * 85);
+}
+
+static void test_udpHeaderShrinks()
+{
+    IpHeaderCompressor tx;
+    const CaptureFrame &first = captureFrames[CHAT_FIRST];
+    const CaptureFrame &next = captureFrames[CHAT_FIRST + 2];
+
+    size_t n = tx.compress(first.bytes, first.len, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL_HEX8(IPHC_TYPE_IR, frame[0]);
+    TEST_ASSERT_EQUAL(first.len - 28 + 14, n); // both addresses in the AP subnet
+
+    // 28 bytes of IPv4 + UDP header become a 2 byte context reference
+    n = tx.compress(next.bytes, next.len, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL_HEX8(IPHC_TYPE_CO, frame[0] & 0x80);
+    TEST_ASSERT_EQUAL(next.len - 28 + 2, n);
+}
+
+static void test_lostContextResync()
+{
+    IpHeaderCompressor a, b;
+    size_t outLen;
+
+    // The IR frame never makes it
+    a.compress(captureFrames[CHAT_FIRST].bytes, captureFrames[CHAT_FIRST].len, frame, sizeof(frame));
+
+    size_t n = a.compress(captureFrames[CHAT_FIRST + 2].bytes, captureFrames[CHAT_FIRST + 2].len, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL(IPHC_NO_CONTEXT, b.decompress(nodeA, frame, n, packet, sizeof(packet), outLen));
+    TEST_ASSERT_EQUAL(2, outLen);
+    TEST_ASSERT_EQUAL_HEX8(IPHC_TYPE_FEEDBACK, packet[0]);
+
+    // Feedback travels back, A resends a full header
+    memcpy(frame, packet, outLen);
+    TEST_ASSERT_EQUAL(IPHC_FEEDBACK, a.decompress(nodeB, frame, outLen, packet, sizeof(packet), outLen));
+    n = a.compress(captureFrames[CHAT_FIRST + 4].bytes, captureFrames[CHAT_FIRST + 4].len, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL_HEX8(IPHC_TYPE_IR, frame[0]);
+    assertRoundTrip(b, nodeA, captureFrames[CHAT_FIRST + 4], n);
+
+    n = a.compress(captureFrames[CHAT_FIRST + 6].bytes, captureFrames[CHAT_FIRST + 6].len, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL_HEX8(IPHC_TYPE_CO, frame[0] & 0x80);
+    assertRoundTrip(b, nodeA, captureFrames[CHAT_FIRST + 6], n);
+
+    // Same context id from another node is a different context
+    TEST_ASSERT_EQUAL(IPHC_NO_CONTEXT, b.decompress(nodeB, frame, n, packet, sizeof(packet), outLen));
+}
+
+static void test_periodicRefresh()
+{
+    IpHeaderCompressor tx;
+    const CaptureFrame &f = captureFrames[CHAT_FIRST + 1]; // constant IP ID, so it can be replayed
+
+    int irFrames = 0;
+    for (int i = 0; i < 2 * IPHC_REFRESH_INTERVAL + 1; i++) {
+        tx.compress(f.bytes, f.len, frame, sizeof(frame));
+        irFrames += frame[0] == IPHC_TYPE_IR;
+    }
+    TEST_ASSERT_EQUAL(3, irFrames);
+}
+
+// Non-DF TCP with jumping IP IDs: low 8 bits survive a couple of lost frames
+static void test_lostFramesKeepIpId()
+{
+    IpHeaderCompressor tx, rx;
+    for (int i = TCP_FIRST; i < TCP_FIRST + 8; i++) {
+        size_t n = tx.compress(captureFrames[i].bytes, captureFrames[i].len, frame, sizeof(frame));
+        if (i == TCP_FIRST + 1 || i == TCP_FIRST + 2)
+            continue; // lost on the air
+        assertRoundTrip(rx, nodeA, captureFrames[i], n);
+    }
+}
+
+static void test_rawFallback()
+{
+    IpHeaderCompressor tx, rx;
+
+    size_t n = tx.compress(captureFrames[FRAGMENT].bytes, captureFrames[FRAGMENT].len, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL_HEX8(IPHC_TYPE_RAW, frame[0]);
+    assertRoundTrip(rx, nodeA, captureFrames[FRAGMENT], n);
+
+    // Corrupt UDP payload: checksum no longer matches, so it must not be "repaired" by the receiver
+    uint8_t bad[256];
+    const CaptureFrame &chat = captureFrames[CHAT_FIRST];
+    memcpy(bad, chat.bytes, chat.len);
+    bad[chat.len - 1] ^= 0x01;
+    n = tx.compress(bad, chat.len, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL_HEX8(IPHC_TYPE_RAW, frame[0]);
+    TEST_ASSERT_EQUAL(2, tx.getRawCount());
+
+    TEST_ASSERT_EQUAL(0, tx.compress(chat.bytes, chat.len, frame, 10));
+}
+
+static void test_malformedFrames()
+{
+    IpHeaderCompressor tx, rx;
+    size_t outLen;
+
+    size_t n = tx.compress(captureFrames[TCP_FIRST].bytes, captureFrames[TCP_FIRST].len, frame, sizeof(frame));
+    for (size_t cut = 0; cut < 30; cut++)
+        TEST_ASSERT_EQUAL(IPHC_MALFORMED, rx.decompress(nodeA, frame, cut, packet, sizeof(packet), outLen));
+    TEST_ASSERT_EQUAL(IPHC_MALFORMED, rx.decompress(nodeA, frame, n, packet, 40, outLen));
+
+    frame[0] = 0x42;
+    TEST_ASSERT_EQUAL(IPHC_MALFORMED, rx.decompress(nodeA, frame, n, packet, sizeof(packet), outLen));
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_roundTripCapture);
+    RUN_TEST(test_udpHeaderShrinks);
+    RUN_TEST(test_lostContextResync);
+    RUN_TEST(test_periodicRefresh);
+    RUN_TEST(test_lostFramesKeepIpId);
+    RUN_TEST(test_rawFallback);
+    RUN_TEST(test_malformedFrames);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
@@ -0,0 +1,284 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "mesh/NodeDB.h"
+#include "serialization/JSON.h"
+#include "serialization/JsonWriter.h"
+#include "serialization/MeshPacketSerializer.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// Every heap allocation in this test binary, so the benchmark can say what a packet costs
+static size_t heapBytes, heapAllocs;
+
+void *operator new(size_t n)
+{
+    heapBytes += n;
+    heapAllocs++;
+    void *p = malloc(n ? n : 1);
+    if (!p)
+        abort();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+static void appendTo(void *context, const char *data, size_t len)
+{
+    static_cast<std::string *>(context)->append(data, len);
+}
+
+static void test_objectsAndArrays()
+{
+    char buf[128];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject();
+    w.key("id").integer(7);
+    w.key("empty").beginArray().endArray();
+    w.key("list").beginArray().integer(1).string("two").beginObject().key("x").null().endObject().endArray();
+    w.key("ok").boolean(true);
+    w.endObject();
+
+    TEST_ASSERT_FALSE(w.overflowed());
+    TEST_ASSERT_EQUAL_STRING("{\"id\":7,\"empty\":[],\"list\":[1,\"two\",{\"x\":null}],\"ok\":true}", w.c_str());
+    TEST_ASSERT_EQUAL(strlen(buf), w.length());
+    TEST_ASSERT_TRUE(JsonWriter::isValid(buf, w.length()));
+}
+
+static void test_numbers()
+{
+    char buf[128];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginArray();
+    w.integer(0).integer(-85).integer(0xFFFFFFFF).integer(INT64_MIN);
+    w.number(10.5f).number(3.7f).number(-0.25).number(NAN).number(INFINITY);
+    w.number(45.5016889, 10);
+    w.endArray();
+
+    TEST_ASSERT_EQUAL_STRING("[0,-85,4294967295,-9223372036854775808,10.5,3.7,-0.25,null,null,45.5016889]", w.c_str());
+    TEST_ASSERT_TRUE(JsonWriter::isValid(buf, w.length()));
+}
+
+static void test_stringEscaping()
+{
+    char out[64];
+    const uint8_t text[] = "say \"hi\"\\\n\xC3\xA9";
+    size_t n = JsonWriter::escape(out, sizeof(out), text, sizeof(text) - 1);
+    TEST_ASSERT_EQUAL(strlen("say \\\"hi\\\"\\\\\\u000a\xC3\xA9"), n);
+    TEST_ASSERT_EQUAL_MEMORY("say \\\"hi\\\"\\\\\\u000a\xC3\xA9", out, n);
+
+    // Broken UTF-8 (lone continuation byte, truncated sequence, overlong slash) becomes U+FFFD
+    const uint8_t broken[] = {'a', 0x80, 'b', 0xE2, 0x82, 0xC0, 0xAF};
+    n = JsonWriter::escape(out, sizeof(out), broken, sizeof(broken));
+    const char expected[] = "a\xEF\xBF\xBD"
+                            "b\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD";
+    TEST_ASSERT_EQUAL(sizeof(expected) - 1, n);
+    TEST_ASSERT_EQUAL_MEMORY(expected, out, n);
+
+    // Never cuts a character in half when out is full
+    const uint8_t accents[] = "\xC3\xA9\xC3\xA9\xC3\xA9";
+    TEST_ASSERT_EQUAL(4, JsonWriter::escape(out, 5, accents, sizeof(accents) - 1));
+    TEST_ASSERT_EQUAL(0, JsonWriter::escape(out, 5, (const uint8_t *)"\x01", 1));
+
+    // Keys and values go through the same escaping, whatever is in the text the output stays valid
+    char buf[128];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject().key("a\"b").string(broken, sizeof(broken)).endObject();
+    TEST_ASSERT_TRUE(JsonWriter::isValid(buf, w.length()));
+}
+
+static void test_overflowIsReported()
+{
+    char buf[16];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject().key("text").string("far too long for this").endObject();
+    TEST_ASSERT_TRUE(w.overflowed());
+    TEST_ASSERT_LESS_THAN(sizeof(buf), w.length());
+    TEST_ASSERT_EQUAL(strlen(buf), w.length());
+
+    // Exactly full still fits, the terminator has its own byte
+    JsonWriter exact(buf, 3);
+    exact.beginArray().endArray();
+    TEST_ASSERT_FALSE(exact.overflowed());
+    TEST_ASSERT_EQUAL_STRING("[]", buf);
+}
+
+static void test_keepCutsTextToFit()
+{
+    char buf[32];
+    const uint8_t accents[] = "\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9";
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject().key("t").string(accents, sizeof(accents) - 1, 8).key("n").integer(1).endObject();
+
+    // {"t":"...","n":1} with the text cut on a character boundary, leaving room for the rest
+    TEST_ASSERT_FALSE(w.overflowed());
+    TEST_ASSERT_TRUE(JsonWriter::isValid(buf, w.length()));
+    TEST_ASSERT_EQUAL_STRING("{\"t\":\"\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\",\"n\":1}", buf);
+}
+
+static void test_sinkStreamsAnyLength()
+{
+    std::string big(300, 'x');
+    big[10] = '"';
+    std::string raw = "[" + std::string(100, '1') + "]";
+
+    char whole[1024];
+    JsonWriter bounded(whole, sizeof(whole));
+    bounded.beginObject().key("big").string(big.c_str()).key("raw").raw(raw.c_str(), raw.size()).key("n").integer(42);
+    bounded.endObject();
+    TEST_ASSERT_FALSE(bounded.overflowed());
+
+    // The same document through a buffer far smaller than it, and smaller than the raw part
+    std::string streamed;
+    char small[16];
+    JsonWriter w(small, sizeof(small), appendTo, &streamed);
+    w.beginObject().key("big").string(big.c_str()).key("raw").raw(raw.c_str(), raw.size()).key("n").integer(42);
+    w.endObject().flush();
+
+    TEST_ASSERT_FALSE(w.overflowed());
+    TEST_ASSERT_EQUAL_STRING(whole, streamed.c_str());
+}
+
+static void test_validation()
+{
+    const char *valid[] = {"{}",  " [ ] ",         "{\"a\":[1,-2.5e+3,true,false,null,\"\\u00e9\\n\"]}",
+                           "0",   "\"\xC3\xA9\"", "{\"a\":{}}"};
+    for (const char *s : valid)
+        TEST_ASSERT_TRUE_MESSAGE(JsonWriter::isValid(s, strlen(s)), s);
+
+    const char *invalid[] = {"",     "hello",      "{",         "[1,]",        "{\"a\"}", "{\"a\":1,}", "01",
+                             "1.",   "-",          "tru",       "\"\x01\"",    "\"\\x\"", "\"\xFF\"",   "[1] 2",
+                             "{a:1}", "\"\\u12G4\"", "[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[1]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]"};
+    for (const char *s : invalid)
+        TEST_ASSERT_FALSE_MESSAGE(JsonWriter::isValid(s, strlen(s)), s);
+
+    // Stops at len, so a payload does not need a terminator
+    TEST_ASSERT_TRUE(JsonWriter::isValid("[1]garbage", 3));
+}
+
+// A text message as the MQTT JSON topic carries it
+static const char *benchText = "Road blocked by fallen trees north of the bridge, use the river road";
+
+static meshtastic_MeshPacket benchPacket()
+{
+    meshtastic_MeshPacket p = meshtastic_MeshPacket_init_zero;
+    p.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    p.decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+    p.decoded.payload.size = strlen(benchText);
+    memcpy(p.decoded.payload.bytes, benchText, p.decoded.payload.size);
+    p.id = 0x9999;
+    p.rx_time = 1609459200;
+    p.to = 0xFFFFFFFF;
+    p.from = 0x11223344;
+    p.rx_rssi = -85;
+    p.rx_snr = 10.5f;
+    p.hop_start = 3;
+    p.hop_limit = 2;
+    return p;
+}
+
+// The JSONValue tree MeshPacketSerializer used to build for that packet
+static std::string serializeTree()
+{
+    JSONObject payload;
+    payload["text"] = new JSONValue(benchText);
+    JSONObject obj;
+    obj["payload"] = new JSONValue(payload);
+    obj["id"] = new JSONValue((unsigned int)0x9999);
+    obj["timestamp"] = new JSONValue((unsigned int)1609459200);
+    obj["to"] = new JSONValue((unsigned int)0xFFFFFFFF);
+    obj["from"] = new JSONValue((unsigned int)0x11223344);
+    obj["channel"] = new JSONValue((unsigned int)0);
+    obj["type"] = new JSONValue("text");
+    obj["sender"] = new JSONValue(nodeDB->getNodeId());
+    obj["rssi"] = new JSONValue(-85);
+    obj["snr"] = new JSONValue(10.5f);
+    obj["hops_away"] = new JSONValue((unsigned int)1);
+    obj["hop_start"] = new JSONValue((unsigned int)3);
+    JSONValue *value = new JSONValue(obj);
+    std::string json = value->Stringify();
+    delete value;
+    return json;
+}
+
+// Packets per second and heap per packet, the JSONValue tree the serializer used to build against the writer
+static void test_benchmarkPacketSerialization()
+{
+    const int iterations = 20000;
+    const meshtastic_MeshPacket packet = benchPacket();
+    char out[512];
+
+    // Same document either way, up to key order
+    size_t len = MeshPacketSerializer::JsonSerialize(&packet, out, sizeof(out), false);
+    TEST_ASSERT_NOT_EQUAL(0, len);
+    JSONValue *fromWriter = JSON::Parse(out);
+    TEST_ASSERT_NOT_NULL(fromWriter);
+    TEST_ASSERT_EQUAL_STRING(serializeTree().c_str(), fromWriter->Stringify().c_str());
+    delete fromWriter;
+
+    size_t bytesBefore = heapBytes, allocsBefore = heapAllocs;
+    auto start = std::chrono::steady_clock::now();
+    size_t total = 0;
+    for (int i = 0; i < iterations; i++)
+        total += serializeTree().size();
+    double treeUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    double treeBytes = (double)(heapBytes - bytesBefore) / iterations;
+    double treeAllocs = (double)(heapAllocs - allocsBefore) / iterations;
+
+    bytesBefore = heapBytes;
+    allocsBefore = heapAllocs;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        total += MeshPacketSerializer::JsonSerialize(&packet, out, sizeof(out), false);
+    double writerUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    double writerBytes = (double)(heapBytes - bytesBefore) / iterations;
+
+    printf("%u byte packet, %u chars total\n", (unsigned)len, (unsigned)total);
+    printf("JSONValue tree: %.0f packets/s, %.0f heap bytes in %.0f allocations per packet\n", iterations * 1e6 / treeUs,
+           treeBytes, treeAllocs);
+    printf("JsonWriter:     %.0f packets/s, %.0f heap bytes per packet\n", iterations * 1e6 / writerUs, writerBytes);
+    TEST_ASSERT_EQUAL(0, heapBytes - bytesBefore);
+    TEST_ASSERT_LESS_THAN(treeUs, writerUs);
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+    nodeDB = new NodeDB(); // The serializer names the sender
+
+    UNITY_BEGIN();
+    RUN_TEST(test_objectsAndArrays);
+    RUN_TEST(test_numbers);
+    RUN_TEST(test_stringEscaping);
+    RUN_TEST(test_overflowIsReported);
+    RUN_TEST(test_keepCutsTextToFit);
+    RUN_TEST(test_sinkStreamsAnyLength);
+    RUN_TEST(test_validation);
+    RUN_TEST(test_benchmarkPacketSerialization);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
@@ -0,0 +1,85 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#include "mesh/MemoryPool.h"
+
+#include <vector>
+
+namespace
+{
+struct Item {
+    uint32_t a;
+    uint8_t b[20];
+};
+} // namespace
+
+static void test_allocUntilFullAndRelease()
+{
+    MemoryPool<Item, 8> pool;
+    std::vector<Item *> items;
+
+    for (int i = 0; i < 8; i++) {
+        Item *p = pool.allocZeroed();
+        TEST_ASSERT_NOT_NULL(p);
+        for (Item *q : items)
+            TEST_ASSERT_TRUE(p != q);
+        items.push_back(p);
+    }
+    TEST_ASSERT_NULL(pool.allocZeroed());
+
+    AllocatorStats s = pool.getStats();
+    TEST_ASSERT_EQUAL_UINT32(8, s.inUse);
+    TEST_ASSERT_EQUAL_UINT32(8, s.highWater);
+    TEST_ASSERT_EQUAL_UINT32(1, s.failures);
+
+    // A released slot is the next one handed out
+    pool.release(items[3]);
+    Item *again = pool.allocZeroed();
+    TEST_ASSERT_EQUAL_PTR(items[3], again);
+
+    for (Item *p : items)
+        pool.release(p);
+    s = pool.getStats();
+    TEST_ASSERT_EQUAL_UINT32(0, s.inUse);
+    TEST_ASSERT_EQUAL_UINT32(8, s.highWater);
+}
+
+static void test_uniqueAllocationReleases()
+{
+    MemoryPool<Item, 4> pool;
+    Item src = {42, {1, 2, 3}};
+    {
+        auto copy = pool.allocUniqueCopy(src);
+        TEST_ASSERT_NOT_NULL(copy.get());
+        TEST_ASSERT_EQUAL_UINT32(42, copy->a);
+        TEST_ASSERT_EQUAL_UINT32(1, pool.getStats().inUse);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, pool.getStats().inUse);
+    TEST_ASSERT_EQUAL_UINT32(1, pool.getStats().highWater);
+}
+
+static void test_dynamicCountsToo()
+{
+    MemoryDynamic<Item> pool;
+    Item *a = pool.allocZeroed();
+    Item *b = pool.allocZeroed();
+    TEST_ASSERT_EQUAL_UINT32(2, pool.getStats().inUse);
+    pool.release(a);
+    pool.release(b);
+    TEST_ASSERT_EQUAL_UINT32(0, pool.getStats().inUse);
+    TEST_ASSERT_EQUAL_UINT32(2, pool.getStats().highWater);
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_allocUntilFullAndRelease);
+    RUN_TEST(test_uniqueAllocationReleases);
+    RUN_TEST(test_dynamicCountsToo);
+    exit(UNITY_END());
+}
+
+void loop() {}
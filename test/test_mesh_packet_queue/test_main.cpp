@@ -0,0 +1,200 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "mesh/MeshPacketQueue.h"
+#include "mesh/NodeDB.h"
+#include "mesh/Router.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+// Minimal NodeDB so isFromUs() has a node number to compare against.
+class MockNodeDB : public NodeDB
+{
+  public:
+    meshtastic_NodeInfoLite *getMeshNode(NodeNum n) override { return &emptyNode; }
+    meshtastic_NodeInfoLite emptyNode = {};
+};
+
+const uint8_t kPriorities[] = {
+    meshtastic_MeshPacket_Priority_MIN,      meshtastic_MeshPacket_Priority_BACKGROUND, meshtastic_MeshPacket_Priority_DEFAULT,
+    meshtastic_MeshPacket_Priority_RELIABLE, meshtastic_MeshPacket_Priority_RESPONSE,   meshtastic_MeshPacket_Priority_HIGH,
+    meshtastic_MeshPacket_Priority_ALERT,    meshtastic_MeshPacket_Priority_ACK,        meshtastic_MeshPacket_Priority_MAX};
+
+// A packet with random ordering keys, drawn from a few senders and ids so (from, id) collisions happen.
+meshtastic_MeshPacket *randomPacket(std::mt19937 &rng)
+{
+    meshtastic_MeshPacket *p = packetPool.allocZeroed();
+    switch (rng() % 3) {
+    case 0:
+        p->from = 0; // from the local phone, counts as from us
+        break;
+    case 1:
+        p->from = nodeDB->getNodeNum();
+        break;
+    default:
+        p->from = 0x1000 + rng() % 3;
+    }
+    p->id = 1 + rng() % 8;
+    p->priority = (meshtastic_MeshPacket_Priority)kPriorities[rng() % sizeof(kPriorities)];
+    p->tx_after = (rng() % 3 == 0) ? 1234 : 0;
+    p->hop_limit = rng() % 4;
+    return p;
+}
+
+// The sorted vector MeshPacketQueue used to be, kept as the reference.
+struct ReferenceQueue {
+    std::vector<meshtastic_MeshPacket *> queue;
+
+    void insert(meshtastic_MeshPacket *p)
+    {
+        queue.insert(std::upper_bound(queue.begin(), queue.end(), p, CompareMeshPacketFunc), p);
+    }
+
+    meshtastic_MeshPacket *remove(NodeNum from, PacketId id, bool tx_normal, bool tx_late, uint8_t hop_limit_lt)
+    {
+        for (auto it = queue.begin(); it != queue.end(); it++) {
+            auto p = (*it);
+            if (getFrom(p) == from && p->id == id && ((tx_normal && !p->tx_after) || (tx_late && p->tx_after)) &&
+                (!hop_limit_lt || p->hop_limit < hop_limit_lt)) {
+                queue.erase(it);
+                return p;
+            }
+        }
+        return NULL;
+    }
+};
+} // namespace
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Dequeue order must be exactly a stable sort by CompareMeshPacketFunc, with removals mixed in.
+void test_orderMatchesCompareMeshPacketFunc(void)
+{
+    std::mt19937 rng(4711);
+
+    for (int round = 0; round < 200; round++) {
+        MeshPacketQueue queue(32);
+        ReferenceQueue ref;
+
+        for (int op = 0; op < 300; op++) {
+            uint32_t what = rng() % 10;
+            if (what < 5) {
+                if (queue.getFree() == 0)
+                    continue;
+                meshtastic_MeshPacket *p = randomPacket(rng);
+                TEST_ASSERT_TRUE(queue.enqueue(p));
+                ref.insert(p);
+            } else if (what < 7) {
+                meshtastic_MeshPacket *expected = ref.queue.empty() ? NULL : ref.queue.front();
+                if (expected)
+                    ref.queue.erase(ref.queue.begin());
+                meshtastic_MeshPacket *p = queue.dequeue();
+                TEST_ASSERT_EQUAL_PTR(expected, p);
+                if (p)
+                    packetPool.release(p);
+            } else {
+                NodeNum from = (rng() % 2) ? nodeDB->getNodeNum() : 0x1000 + rng() % 3;
+                PacketId id = 1 + rng() % 8;
+                bool txNormal = rng() % 2, txLate = rng() % 2;
+                uint8_t hopLimitLt = rng() % 4;
+                meshtastic_MeshPacket *expected = ref.remove(from, id, txNormal, txLate, hopLimitLt);
+                meshtastic_MeshPacket *p = queue.remove(from, id, txNormal, txLate, hopLimitLt);
+                TEST_ASSERT_EQUAL_PTR(expected, p);
+                if (p)
+                    packetPool.release(p);
+            }
+            TEST_ASSERT_EQUAL(32 - ref.queue.size(), queue.getFree());
+            TEST_ASSERT_EQUAL_PTR(ref.queue.empty() ? NULL : ref.queue.front(), queue.getFront());
+        }
+
+        while (meshtastic_MeshPacket *p = queue.dequeue()) {
+            TEST_ASSERT_EQUAL_PTR(ref.queue.front(), p);
+            ref.queue.erase(ref.queue.begin());
+            packetPool.release(p);
+        }
+    }
+}
+
+// find and getPacketFromQueue see every queued (from, id) and nothing else.
+void test_findByFromAndId(void)
+{
+    MeshPacketQueue queue(8);
+    meshtastic_MeshPacket *p = packetPool.allocZeroed();
+    p->from = 0x1234;
+    p->id = 99;
+    p->priority = meshtastic_MeshPacket_Priority_DEFAULT;
+    TEST_ASSERT_TRUE(queue.enqueue(p));
+
+    TEST_ASSERT_TRUE(queue.find(0x1234, 99));
+    TEST_ASSERT_FALSE(queue.find(0x1234, 98));
+    TEST_ASSERT_EQUAL_PTR(p, queue.getPacketFromQueue(0x1234, 99));
+
+    // Filters on the late window are honoured
+    TEST_ASSERT_NULL(queue.remove(0x1234, 99, false, true));
+    TEST_ASSERT_EQUAL_PTR(p, queue.remove(0x1234, 99, true, false));
+    TEST_ASSERT_FALSE(queue.find(0x1234, 99));
+    TEST_ASSERT_TRUE(queue.empty());
+    packetPool.release(p);
+}
+
+// A full queue evicts its lowest-priority non-late packet for a higher-priority one.
+void test_fullQueueReplacesLowerPriority(void)
+{
+    MeshPacketQueue queue(2);
+    meshtastic_MeshPacket *low = packetPool.allocZeroed();
+    low->from = 0x1000;
+    low->id = 1;
+    low->priority = meshtastic_MeshPacket_Priority_BACKGROUND;
+    meshtastic_MeshPacket *late = packetPool.allocZeroed();
+    late->from = 0x1000;
+    late->id = 2;
+    late->priority = meshtastic_MeshPacket_Priority_ACK;
+    late->tx_after = 1;
+    TEST_ASSERT_TRUE(queue.enqueue(low));
+    TEST_ASSERT_TRUE(queue.enqueue(late));
+
+    meshtastic_MeshPacket *high = packetPool.allocZeroed();
+    high->from = 0x1000;
+    high->id = 3;
+    high->priority = meshtastic_MeshPacket_Priority_HIGH;
+    bool dropped = false;
+    TEST_ASSERT_TRUE(queue.enqueue(high, &dropped));
+    TEST_ASSERT_TRUE(dropped);
+
+    TEST_ASSERT_FALSE(queue.find(0x1000, 1)); // released by the queue
+    TEST_ASSERT_EQUAL_PTR(high, queue.dequeue());
+    TEST_ASSERT_EQUAL_PTR(late, queue.dequeue());
+    packetPool.release(high);
+    packetPool.release(late);
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+    const std::unique_ptr<MockNodeDB> mockNodeDB(new MockNodeDB());
+    nodeDB = mockNodeDB.get();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_orderMatchesCompareMeshPacketFunc);
+    RUN_TEST(test_findByFromAndId);
+    RUN_TEST(test_fullQueueReplacesLowerPriority);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+void loop() {}
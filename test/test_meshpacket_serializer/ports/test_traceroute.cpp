@@ -0,0 +1,64 @@
+#include "../test_helpers.h"
+#include "mesh/NodeDB.h"
+
+static const uint8_t HOPS = sizeof(meshtastic_RouteDiscovery::route) / sizeof(uint32_t);
+
+// A known node whose name is all control characters, each of which JSON needs as \u00XX
+static void add_node_with_worst_name(NodeNum n)
+{
+    meshtastic_Telemetry t = meshtastic_Telemetry_init_zero;
+    t.which_variant = meshtastic_Telemetry_device_metrics_tag;
+    nodeDB->updateTelemetry(n, t);
+    meshtastic_NodeInfoLite *node = nodeDB->getMeshNode(n);
+    TEST_ASSERT_NOT_NULL(node);
+    node->has_user = true;
+    memset(node->user.long_name, 0x01, sizeof(node->user.long_name)); // Not even terminated
+}
+
+// A traceroute reply with both routes full and every hop's SNR
+static size_t encode_full_traceroute(uint8_t *buffer, size_t buffer_size)
+{
+    meshtastic_RouteDiscovery route = meshtastic_RouteDiscovery_init_zero;
+    route.route_count = route.route_back_count = route.snr_towards_count = route.snr_back_count = HOPS;
+    for (uint8_t i = 0; i < HOPS; i++) {
+        route.route[i] = 0x20000000 + i;
+        route.route_back[i] = 0x30000000 + i;
+        route.snr_towards[i] = -127;
+        route.snr_back[i] = -127;
+        add_node_with_worst_name(route.route[i]);
+        add_node_with_worst_name(route.route_back[i]);
+    }
+
+    pb_ostream_t stream = pb_ostream_from_buffer(buffer, buffer_size);
+    TEST_ASSERT_TRUE(pb_encode(&stream, &meshtastic_RouteDiscovery_msg, &route));
+    return stream.bytes_written;
+}
+
+// The longest JSON a packet can make still fits the buffer MQTT publishes from
+void test_traceroute_worst_case_fits()
+{
+    uint8_t buffer[meshtastic_RouteDiscovery_size];
+    size_t payload_size = encode_full_traceroute(buffer, sizeof(buffer));
+    meshtastic_MeshPacket packet = create_test_packet(meshtastic_PortNum_TRACEROUTE_APP, buffer, payload_size);
+    packet.decoded.request_id = 0x1234;
+    add_node_with_worst_name(packet.from);
+    add_node_with_worst_name(packet.to);
+
+    static char out[MESHPACKET_JSON_MAX];
+    size_t len = MeshPacketSerializer::JsonSerialize(&packet, out, sizeof(out), false);
+    printf("Worst case traceroute: %u of %u bytes\n", (unsigned)len, (unsigned)sizeof(out));
+    TEST_ASSERT_NOT_EQUAL(0, len);
+
+    JSONValue *root = JSON::Parse(out);
+    TEST_ASSERT_NOT_NULL(root);
+    JSONObject jsonObj = root->AsObject();
+    TEST_ASSERT_EQUAL_STRING("traceroute", jsonObj["type"]->AsString().c_str());
+    JSONObject payload = jsonObj["payload"]->AsObject();
+    TEST_ASSERT_EQUAL(HOPS + 2, payload["route"]->AsArray().size());
+    TEST_ASSERT_EQUAL(HOPS + 2, payload["route_back"]->AsArray().size());
+    TEST_ASSERT_EQUAL(HOPS, payload["snr_towards"]->AsArray().size());
+    delete root;
+
+    // One byte short of that is reported rather than cut
+    TEST_ASSERT_EQUAL(0, MeshPacketSerializer::JsonSerialize(&packet, out, len, false));
+}
@@ -1,3 +1,5 @@
+#include "TestUtil.h"
+#include "mesh/NodeDB.h"
 #include "test_helpers.h"
 #include <Arduino.h>
 #include <unity.h>
@@ -19,9 +21,14 @@ void test_telemetry_environment_metrics_complete_coverage();
 void test_telemetry_environment_metrics_unset_fields();
 void test_encrypted_packet_serialization();
 void test_empty_encrypted_packet();
+void test_traceroute_worst_case_fits();
 
 void setup()
 {
+    // Traceroutes look up the names of the hops
+    initializeTestEnvironment();
+    nodeDB = new NodeDB();
+
     UNITY_BEGIN();
 
     // Text message tests
@@ -52,6 +59,9 @@ void setup()
     RUN_TEST(test_encrypted_packet_serialization);
     RUN_TEST(test_empty_encrypted_packet);
 
+    // Traceroute test
+    RUN_TEST(test_traceroute_worst_case_fits);
+
     UNITY_END();
 }
 
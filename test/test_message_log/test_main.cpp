@@ -0,0 +1,250 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "FSCommon.h"
+#include "SPILock.h"
+#include "wifi/MessageLog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_DIR "/msglog_test"
+#define TEST_SEGMENT_BYTES 512 // about ten short messages
+#define BUSY_CHANNEL 0
+#define QUIET_PEER 0x1234
+#define US 0x9abc
+
+static MessageLog *msgLog;
+
+void setUp(void)
+{
+    rmDir(TEST_DIR);
+    msgLog = new MessageLog(TEST_DIR, TEST_SEGMENT_BYTES);
+    TEST_ASSERT_TRUE(msgLog->begin());
+}
+
+void tearDown(void)
+{
+    delete msgLog;
+    rmDir(TEST_DIR);
+}
+
+/// Reopen the log as after a reboot
+static void reopen()
+{
+    delete msgLog;
+    msgLog = new MessageLog(TEST_DIR, TEST_SEGMENT_BYTES);
+    TEST_ASSERT_TRUE(msgLog->begin());
+}
+
+static uint32_t appendChannel(uint8_t channel, uint32_t from, int n)
+{
+    char text[32];
+    MessageLogEntry e = {};
+    e.from = from;
+    e.to = 0xFFFFFFFF;
+    e.channel = channel;
+    e.flags = MSGLOG_FLAG_CHANNEL;
+    e.textLen = snprintf(text, sizeof(text), "channel msg %d", n);
+    return msgLog->append(e, (const uint8_t *)text);
+}
+
+static uint32_t appendDirect(uint32_t peer, int n)
+{
+    char text[32];
+    MessageLogEntry e = {};
+    e.from = peer;
+    e.to = US;
+    e.textLen = snprintf(text, sizeof(text), "direct msg %d", n);
+    return msgLog->append(e, (const uint8_t *)text);
+}
+
+/// Sequence numbers a sync returns, in order; -1 past max
+static int syncSeqs(uint32_t since, const MessageLogConversation *only, uint32_t *seqs, int max)
+{
+    MessageLogCursor c;
+    MessageLogEntry e;
+    uint8_t text[MSGLOG_MAX_TEXT];
+    int n = 0;
+    msgLog->startSync(c, since, only);
+    while (msgLog->next(c, e, text)) {
+        if (n == max)
+            return -1;
+        seqs[n++] = e.seq;
+    }
+    return n;
+}
+
+static void test_syncReturnsOnlyTheDelta()
+{
+    for (int i = 1; i <= 5; i++)
+        TEST_ASSERT_EQUAL(i, appendChannel(BUSY_CHANNEL, 0x100, i));
+
+    MessageLogCursor c;
+    MessageLogEntry e;
+    uint8_t text[MSGLOG_MAX_TEXT];
+    msgLog->startSync(c, 2);
+    for (uint32_t seq = 3; seq <= 5; seq++) {
+        TEST_ASSERT_TRUE(msgLog->next(c, e, text));
+        TEST_ASSERT_EQUAL(seq, e.seq);
+        TEST_ASSERT_EQUAL(0x100, e.from);
+        TEST_ASSERT_EQUAL_MEMORY("channel msg", text, 11);
+    }
+    TEST_ASSERT_FALSE(msgLog->next(c, e, text));
+    TEST_ASSERT_TRUE(c.done);
+
+    // Nothing new since the last one
+    uint32_t seqs[8];
+    TEST_ASSERT_EQUAL(0, syncSeqs(5, NULL, seqs, 8));
+}
+
+static void test_rolloverCompactsButKeepsQuietConversations()
+{
+    for (int i = 0; i < 3; i++)
+        appendDirect(QUIET_PEER, i);
+    for (int i = 0; i < 300; i++)
+        TEST_ASSERT_NOT_EQUAL(0, appendChannel(BUSY_CHANNEL, 0x100 + i % 5, i));
+
+    const MessageLogStats &stats = msgLog->getStats();
+    TEST_ASSERT_GREATER_THAN(MSGLOG_MAX_SEGMENTS, stats.rollovers);
+    TEST_ASSERT_GREATER_THAN(0, stats.compactions);
+    TEST_ASSERT_GREATER_THAN(0, stats.dropped);
+    TEST_ASSERT_EQUAL(MSGLOG_MAX_SEGMENTS, msgLog->getSegmentCount());
+    TEST_ASSERT_EQUAL(303, msgLog->getLastSeq());
+
+    // The three direct messages predate everything else still there, but survived
+    MessageLogConversation quiet = {QUIET_PEER, 0, 0, 0};
+    uint32_t seqs[512];
+    TEST_ASSERT_EQUAL(3, syncSeqs(0, &quiet, seqs, 512));
+    for (int i = 0; i < 3; i++)
+        TEST_ASSERT_EQUAL(i + 1, seqs[i]);
+
+    // Every message is seen exactly once, the busy channel's newest ones included
+    int n = syncSeqs(0, NULL, seqs, 512);
+    TEST_ASSERT_GREATER_THAN(3, n);
+    static bool seen[304];
+    memset(seen, 0, sizeof(seen));
+    for (int i = 0; i < n; i++) {
+        TEST_ASSERT_FALSE(seen[seqs[i]]);
+        seen[seqs[i]] = true;
+    }
+    TEST_ASSERT_TRUE(seen[303]);
+
+    // And the counts in the index agree with what can be read
+    int counted = 0;
+    for (int i = 0; i < msgLog->getConversationCount(); i++)
+        counted += msgLog->getConversation(i).count;
+    TEST_ASSERT_EQUAL(n, counted);
+}
+
+static void test_reopenContinuesSequence()
+{
+    for (int i = 0; i < 25; i++)
+        appendChannel(BUSY_CHANNEL, 0x100, i);
+    appendDirect(QUIET_PEER, 0);
+    int segments = msgLog->getSegmentCount();
+
+    reopen();
+    TEST_ASSERT_EQUAL(26, msgLog->getLastSeq());
+    TEST_ASSERT_EQUAL(segments, msgLog->getSegmentCount());
+    TEST_ASSERT_EQUAL(0, msgLog->getStats().rebuilds);
+    TEST_ASSERT_EQUAL(2, msgLog->getConversationCount());
+    TEST_ASSERT_EQUAL(27, appendChannel(BUSY_CHANNEL, 0x100, 26));
+
+    uint32_t seqs[64];
+    TEST_ASSERT_EQUAL(27, syncSeqs(0, NULL, seqs, 64));
+}
+
+static void test_tornRecordEndsSegment()
+{
+    for (int i = 0; i < 4; i++)
+        appendChannel(BUSY_CHANNEL, 0x100, i);
+
+    // Power lost halfway through writing the fifth one
+    char path[64];
+    snprintf(path, sizeof(path), "%s/seg%05u", TEST_DIR, 0);
+    {
+        concurrency::LockGuard g(spiLock);
+        File f = FSCom.open(path, "a");
+        const uint8_t partial[] = {0xA7, 0x55, 5, 0, 0};
+        f.write(partial, sizeof(partial));
+        f.close();
+    }
+
+    reopen();
+    TEST_ASSERT_EQUAL(1, msgLog->getStats().damaged);
+    TEST_ASSERT_EQUAL(4, msgLog->getLastSeq());
+    TEST_ASSERT_EQUAL(5, appendChannel(BUSY_CHANNEL, 0x100, 4));
+    TEST_ASSERT_EQUAL(2, msgLog->getSegmentCount());
+
+    uint32_t seqs[8];
+    TEST_ASSERT_EQUAL(5, syncSeqs(0, NULL, seqs, 8));
+    TEST_ASSERT_EQUAL(5, seqs[4]);
+}
+
+static void test_lostIndexIsRebuilt()
+{
+    for (int i = 0; i < 40; i++)
+        appendChannel(i % 2, 0x100, i);
+    char path[64];
+    snprintf(path, sizeof(path), "%s/index", TEST_DIR);
+    {
+        concurrency::LockGuard g(spiLock);
+        FSCom.remove(path);
+    }
+
+    reopen();
+    TEST_ASSERT_EQUAL(1, msgLog->getStats().rebuilds);
+    TEST_ASSERT_EQUAL(40, msgLog->getLastSeq());
+    TEST_ASSERT_EQUAL(2, msgLog->getConversationCount());
+
+    uint32_t seqs[64];
+    TEST_ASSERT_EQUAL(10, syncSeqs(30, NULL, seqs, 64));
+}
+
+static void test_filteredSync()
+{
+    for (int i = 0; i < 30; i++) {
+        appendChannel(BUSY_CHANNEL, 0x100, i);
+        if (i % 10 == 0)
+            appendDirect(QUIET_PEER, i);
+    }
+
+    MessageLogConversation quiet = {QUIET_PEER, 0, 0, 0};
+    uint32_t seqs[64];
+    TEST_ASSERT_EQUAL(3, syncSeqs(0, &quiet, seqs, 64));
+    TEST_ASSERT_EQUAL(2, syncSeqs(seqs[0], &quiet, seqs, 64));
+
+    MessageLogConversation channel = {BUSY_CHANNEL, MSGLOG_FLAG_CHANNEL, 0, 0};
+    TEST_ASSERT_EQUAL(30, syncSeqs(0, &channel, seqs, 64));
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+    if (!spiLock)
+        initSPI();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_syncReturnsOnlyTheDelta);
+    RUN_TEST(test_rolloverCompactsButKeepsQuietConversations);
+    RUN_TEST(test_reopenContinuesSequence);
+    RUN_TEST(test_tornRecordEndsSegment);
+    RUN_TEST(test_lostIndexIsRebuilt);
+    RUN_TEST(test_filteredSync);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
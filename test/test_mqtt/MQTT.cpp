@@ -26,6 +26,7 @@
 #include <string_view>
 #include <utility>
 #include <variant>
+#include <vector>
 
 #if defined(UNIT_TEST)
 #define IS_RUNNING_TESTS 1
@@ -143,6 +144,8 @@ class MockPubSubServer : public WiFiClient
     size_t write(uint8_t data) override { return write(&data, 1); }
     size_t write(const uint8_t *buf, size_t size) override
     {
+        if (rejectPacketId_ && command_.empty() && isPublishOf(buf, size, rejectPacketId_))
+            return 0; // Still connected, but this one does not go through
         command_ += std::string(reinterpret_cast<const char *>(buf), size);
         if (command_.size() < 2)
             return size;
@@ -154,6 +157,18 @@ class MockPubSubServer : public WiFiClient
         return size;
     }
 
+    // Whether buf is a whole publish of a ServiceEnvelope carrying packet id.
+    static bool isPublishOf(const uint8_t *buf, size_t size, uint32_t id)
+    {
+        if (size < 4 || (buf[0] & 0xf0) != MQTTPUBLISH)
+            return false;
+        const size_t topicSize = buf[2] << 8 | buf[3];
+        if (size < 4 + topicSize)
+            return false;
+        DecodedServiceEnvelope env(buf + 4 + topicSize, size - 4 - topicSize);
+        return env.validDecode && env.packet->id == id;
+    }
+
     // The pub/sub "server".
     // https://public.dhe.ibm.com/software/dw/webservices/ws-mqtt/MQTT_V3.1_Protocol_Specific.pdf
     void handleCommand(uint8_t header, std::string_view message)
@@ -211,6 +226,7 @@ class MockPubSubServer : public WiFiClient
 
     bool connected_ = false;
     bool refuseConnection_ = false;       // Simulate a failed connection.
+    uint32_t rejectPacketId_ = 0;         // Simulate a publish that fails while connected.
     uint32_t ipAddress_ = 0x01010101;     // IP address of the MQTT server.
     std::string host_;                    // Requested host.
     uint16_t port_;                       // Requested port.
@@ -503,6 +519,141 @@ void test_sendQueued(void)
     TEST_ASSERT_EQUAL(decoded.id, env.packet->id);
 }
 
+// Verify a packet queued while disconnected keeps a reference to the router's copy rather than copying it.
+void test_sendQueuedSharesPacket(void)
+{
+    moduleConfig.mqtt.encryption_enabled = true;
+    pubsub->connected_ = false;
+    pubsub->refuseConnection_ = true;
+    TEST_ASSERT_TRUE(loopUntil([] { return !unitTest->getPubSub().connected(); }));
+
+    SharedPacket shared = SharedPacket::copyOf(encrypted);
+    const uint32_t packetsBefore = packetPool.getStats().inUse;
+    mqtt->onSend(shared, decoded, 0);
+    TEST_ASSERT_EQUAL(1, unitTest->queueSize());
+    TEST_ASSERT_EQUAL(2, shared.useCount());
+    TEST_ASSERT_EQUAL_UINT32(packetsBefore, packetPool.getStats().inUse);
+
+    pubsub->refuseConnection_ = false;
+    TEST_ASSERT_TRUE(loopUntil([] { return !pubsub->published_.empty(); }));
+    TEST_ASSERT_EQUAL(1, shared.useCount());
+    const auto &[topic, payload] = pubsub->published_.front();
+    const DecodedServiceEnvelope &env = std::get<DecodedServiceEnvelope>(payload);
+    TEST_ASSERT_EQUAL_STRING("msh/2/e/test/!12345678", topic.c_str());
+    TEST_ASSERT_TRUE(env.validDecode);
+    TEST_ASSERT_EQUAL(encrypted.id, env.packet->id);
+}
+
+// Cut the broker off, what is sent from now on is queued.
+static void disconnectBroker()
+{
+    pubsub->connected_ = false;
+    pubsub->refuseConnection_ = true;
+    TEST_ASSERT_TRUE(loopUntil([] { return !unitTest->getPubSub().connected(); }));
+}
+
+static void sendDecoded(meshtastic_PortNum portnum, uint32_t id)
+{
+    meshtastic_MeshPacket p = decoded;
+    p.id = id;
+    p.decoded.portnum = portnum;
+    mqtt->onSend(encrypted, p, 0);
+}
+
+// Ids of the packets the broker got, in order.
+static std::vector<uint32_t> publishedIds()
+{
+    std::vector<uint32_t> ids;
+    for (const auto &[topic, payload] : pubsub->published_)
+        ids.push_back(std::get<DecodedServiceEnvelope>(payload).packet->id);
+    return ids;
+}
+
+// Verify the whole backlog goes out once the broker is back, not one packet per reconnect.
+void test_sendQueuedDrainsBacklog(void)
+{
+    disconnectBroker();
+    for (uint32_t id = 100; id < 100 + MAX_MQTT_QUEUE; id++)
+        sendDecoded(meshtastic_PortNum_TEXT_MESSAGE_APP, id);
+    TEST_ASSERT_EQUAL(MAX_MQTT_QUEUE, mqtt->getQueueDepth());
+
+    pubsub->refuseConnection_ = false;
+    TEST_ASSERT_TRUE(loopUntil([] { return pubsub->published_.size() == MAX_MQTT_QUEUE; }));
+
+    std::vector<uint32_t> ids = publishedIds();
+    for (uint32_t i = 0; i < MAX_MQTT_QUEUE; i++)
+        TEST_ASSERT_EQUAL(100 + i, ids[i]);
+    const MQTTQueueStats &stats = mqtt->getQueueStats();
+    TEST_ASSERT_EQUAL(0, mqtt->getQueueDepth());
+    TEST_ASSERT_EQUAL(MAX_MQTT_QUEUE, stats.published);
+    TEST_ASSERT_EQUAL(MAX_MQTT_QUEUE, stats.maxDepth);
+    TEST_ASSERT_LESS_OR_EQUAL(2, stats.drains);
+    TEST_ASSERT_EQUAL(0, stats.publishFailures);
+}
+
+// Verify a queued packet the broker keeps refusing is dropped after a few tries instead of holding up the rest.
+void test_sendQueuedDropsRefusedPacket(void)
+{
+    disconnectBroker();
+    for (uint32_t id = 1; id <= 3; id++)
+        sendDecoded(meshtastic_PortNum_TEXT_MESSAGE_APP, id);
+
+    pubsub->rejectPacketId_ = 1;
+    pubsub->refuseConnection_ = false;
+    TEST_ASSERT_TRUE(loopUntil([] { return pubsub->published_.size() == 2; }));
+
+    std::vector<uint32_t> ids = publishedIds();
+    TEST_ASSERT_EQUAL(2, ids[0]);
+    TEST_ASSERT_EQUAL(3, ids[1]);
+    const MQTTQueueStats &stats = mqtt->getQueueStats();
+    TEST_ASSERT_EQUAL(0, mqtt->getQueueDepth());
+    TEST_ASSERT_EQUAL(2, stats.published);
+    TEST_ASSERT_EQUAL(1, stats.publishFailures);
+    TEST_ASSERT_TRUE(pubsub->connected_);
+}
+
+// Verify telemetry piling up during an outage makes room for messages and alerts, and alerts go out first.
+void test_sendQueuedAlertsWin(void)
+{
+    disconnectBroker();
+    for (uint32_t id = 1; id <= 20; id++)
+        sendDecoded(meshtastic_PortNum_POSITION_APP, id);
+    TEST_ASSERT_EQUAL(MAX_MQTT_QUEUE / 2, mqtt->getQueueDepth()); // Telemetry keeps half the queue at most
+    for (uint32_t id = 101; id <= 112; id++)
+        sendDecoded(meshtastic_PortNum_TEXT_MESSAGE_APP, id);
+    for (uint32_t id = 201; id <= 204; id++)
+        sendDecoded(meshtastic_PortNum_ALERT_APP, id);
+    sendDecoded(meshtastic_PortNum_TELEMETRY_APP, 21); // No room left for it
+    TEST_ASSERT_EQUAL(MAX_MQTT_QUEUE, mqtt->getQueueDepth());
+
+    const MQTTQueueStats &stats = mqtt->getQueueStats();
+    TEST_ASSERT_EQUAL(21, stats.dropped[MQTT_QUEUE_BACKGROUND]);
+    TEST_ASSERT_EQUAL(0, stats.dropped[MQTT_QUEUE_MESSAGE]);
+    TEST_ASSERT_EQUAL(0, stats.dropped[MQTT_QUEUE_ALERT]);
+
+    pubsub->refuseConnection_ = false;
+    TEST_ASSERT_TRUE(loopUntil([] { return pubsub->published_.size() == MAX_MQTT_QUEUE; }));
+    std::vector<uint32_t> ids = publishedIds();
+    for (uint32_t i = 0; i < 4; i++)
+        TEST_ASSERT_EQUAL(201 + i, ids[i]);
+    for (uint32_t i = 0; i < 12; i++)
+        TEST_ASSERT_EQUAL(101 + i, ids[4 + i]);
+}
+
+// Verify the time a packet waited for the broker is counted.
+void test_sendQueuedLatency(void)
+{
+    disconnectBroker();
+    sendDecoded(meshtastic_PortNum_TEXT_MESSAGE_APP, 7);
+    delay(50);
+
+    pubsub->refuseConnection_ = false;
+    TEST_ASSERT_TRUE(loopUntil([] { return !pubsub->published_.empty(); }));
+    const MQTTQueueStats &stats = mqtt->getQueueStats();
+    TEST_ASSERT_GREATER_OR_EQUAL(50, stats.lastLatencyMs);
+    TEST_ASSERT_EQUAL(stats.lastLatencyMs, stats.maxLatencyMs);
+}
+
 // Verify reconnecting with the proxy enabled does not reconnect to a MQTT server.
 void test_reconnectProxyDoesNotReconnectMqtt(void)
 {
@@ -886,6 +1037,11 @@ void setup()
     RUN_TEST(test_noRangeTestAppOnDefaultServer);
     RUN_TEST(test_noDetectionSensorAppOnDefaultServer);
     RUN_TEST(test_sendQueued);
+    RUN_TEST(test_sendQueuedSharesPacket);
+    RUN_TEST(test_sendQueuedDrainsBacklog);
+    RUN_TEST(test_sendQueuedDropsRefusedPacket);
+    RUN_TEST(test_sendQueuedAlertsWin);
+    RUN_TEST(test_sendQueuedLatency);
     RUN_TEST(test_reconnectProxyDoesNotReconnectMqtt);
     RUN_TEST(test_receiveEmptyMeshPacket);
     RUN_TEST(test_receiveDecodedProto);
@@ -0,0 +1,147 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "mqtt/MQTTQueueDrain.h"
+
+#include <vector>
+
+struct Entry {
+    uint32_t id;
+    uint32_t queuedAt;
+    uint8_t attempts;
+};
+
+static const int retention[MQTT_QUEUE_LEVELS] = {8, 8, 4};
+static PriorityDropQueue<Entry, MQTT_QUEUE_LEVELS> *queue;
+static MQTTQueueStats stats;
+
+// The broker: takes everything but refused, while up
+static std::vector<uint32_t> published;
+static uint32_t refused;
+static bool up;
+
+static uint32_t drain(uint32_t publishMs = 0)
+{
+    return drainMQTTQueue(
+        *queue, stats,
+        [publishMs](Entry &e) {
+            if (!up || e.id == refused)
+                return false;
+            delay(publishMs);
+            published.push_back(e.id);
+            return true;
+        },
+        [] { return up; });
+}
+
+static void add(uint32_t id, MQTTQueueLevel level = MQTT_QUEUE_MESSAGE)
+{
+    queue->push(level, {id, millis(), 0});
+}
+
+void setUp(void)
+{
+    queue = new PriorityDropQueue<Entry, MQTT_QUEUE_LEVELS>(8, retention);
+    stats = {};
+    published.clear();
+    refused = 0;
+    up = true;
+}
+
+void tearDown(void)
+{
+    delete queue;
+}
+
+static void test_publishesInOrder()
+{
+    add(1);
+    add(2, MQTT_QUEUE_BACKGROUND);
+    add(3, MQTT_QUEUE_ALERT);
+    delay(20);
+
+    TEST_ASSERT_EQUAL(3, drain());
+    TEST_ASSERT_EQUAL(3, published[0]);
+    TEST_ASSERT_EQUAL(1, published[1]);
+    TEST_ASSERT_EQUAL(2, published[2]);
+    TEST_ASSERT_TRUE(queue->isEmpty());
+    TEST_ASSERT_EQUAL(3, stats.published);
+    TEST_ASSERT_EQUAL(1, stats.drains);
+    TEST_ASSERT_GREATER_OR_EQUAL(20, stats.maxLatencyMs);
+}
+
+static void test_keptWhileBrokerGone()
+{
+    add(1);
+    add(2);
+    up = false;
+    for (int i = 0; i < 2 * MQTT_PUBLISH_MAX_ATTEMPTS; i++)
+        TEST_ASSERT_EQUAL(0, drain());
+    TEST_ASSERT_EQUAL(2, queue->numUsed());
+    TEST_ASSERT_EQUAL(0, queue->front().attempts);
+    TEST_ASSERT_EQUAL(0, stats.publishFailures);
+    TEST_ASSERT_EQUAL(0, stats.drains);
+
+    up = true;
+    TEST_ASSERT_EQUAL(2, drain());
+}
+
+static void test_refusedPacketDropped()
+{
+    add(1);
+    add(2);
+    add(3);
+    refused = 1;
+
+    // It is tried again on the next runs, then makes way for the rest
+    for (int i = 1; i < MQTT_PUBLISH_MAX_ATTEMPTS; i++) {
+        TEST_ASSERT_EQUAL(0, drain());
+        TEST_ASSERT_EQUAL(i, queue->front().attempts);
+    }
+    TEST_ASSERT_EQUAL(2, drain());
+    TEST_ASSERT_EQUAL(2, published[0]);
+    TEST_ASSERT_EQUAL(3, published[1]);
+    TEST_ASSERT_TRUE(queue->isEmpty());
+    TEST_ASSERT_EQUAL(1, stats.publishFailures);
+    TEST_ASSERT_EQUAL(2, stats.published);
+}
+
+static void test_stopsAtBudget()
+{
+    for (uint32_t id = 1; id <= 8; id++)
+        add(id);
+
+    uint32_t first = drain(MQTT_DRAIN_BUDGET_MS / 4);
+    TEST_ASSERT_LESS_THAN(8, first);
+    TEST_ASSERT_GREATER_THAN(0, first);
+    while (!queue->isEmpty())
+        drain(MQTT_DRAIN_BUDGET_MS / 4);
+    TEST_ASSERT_EQUAL(8, published.size());
+    for (uint32_t i = 0; i < 8; i++)
+        TEST_ASSERT_EQUAL(i + 1, published[i]);
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_publishesInOrder);
+    RUN_TEST(test_keptWhileBrokerGone);
+    RUN_TEST(test_refusedPacketDropped);
+    RUN_TEST(test_stopsAtBudget);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
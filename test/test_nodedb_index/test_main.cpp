@@ -0,0 +1,311 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "gps/RTC.h"
+#include "mesh/NodeDB.h"
+#include "platform/portduino/PortduinoGlue.h"
+
+#include <chrono>
+#include <vector>
+
+namespace
+{
+const uint32_t kMaxNodes = 3000;
+
+NodeNum nodeNumFor(uint32_t i)
+{
+    return 0x10000000 + i * 7919;
+}
+
+// Create a node the same way received telemetry does.
+void addNode(NodeNum n)
+{
+    meshtastic_Telemetry t = meshtastic_Telemetry_init_zero;
+    t.which_variant = meshtastic_Telemetry_device_metrics_tag;
+    nodeDB->updateTelemetry(n, t);
+}
+
+// Hear a node the way the router reports received packets.
+void hearNode(NodeNum n, uint32_t rxTime)
+{
+    meshtastic_MeshPacket mp = meshtastic_MeshPacket_init_zero;
+    mp.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    mp.from = n;
+    mp.rx_time = rxTime;
+    nodeDB->updateFrom(mp);
+}
+
+// Hear a node on a channel, with what its NodeInfo advertised, secsAgo seconds ago.
+void hearNodeWith(NodeNum n, uint8_t channel, uint32_t bitfield, uint32_t secsAgo = 0)
+{
+    hearNode(n, getTime() - secsAgo);
+    meshtastic_NodeInfoLite *node = nodeDB->getMeshNode(n);
+    node->channel = channel;
+    node->bitfield = bitfield;
+}
+
+// The bubble sort sortMeshDB used to run over the records themselves, kept as the benchmark baseline.
+void bubbleSortNodes(std::vector<meshtastic_NodeInfoLite> &nodes, NodeNum ourNum)
+{
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = nodes.size() - 1; i > 0; i--) {
+            if (nodes[i - 1].num == ourNum) {
+                // noop
+            } else if (nodes[i].num == ourNum) {
+                std::swap(nodes[i], nodes[i - 1]);
+                changed = true;
+            } else if (nodes[i].is_favorite && !nodes[i - 1].is_favorite) {
+                std::swap(nodes[i], nodes[i - 1]);
+                changed = true;
+            } else if (!nodes[i].is_favorite && nodes[i - 1].is_favorite) {
+                // noop
+            } else if (nodes[i].last_heard > nodes[i - 1].last_heard) {
+                std::swap(nodes[i], nodes[i - 1]);
+                changed = true;
+            }
+        }
+    }
+}
+
+// The lookup getMeshNode used to do, kept as the benchmark baseline.
+meshtastic_NodeInfoLite *scanForNode(NodeNum n)
+{
+    for (size_t i = 0; i < nodeDB->getNumMeshNodes(); i++) {
+        if (nodeDB->meshNodes->at(i).num == n)
+            return &nodeDB->meshNodes->at(i);
+    }
+    return NULL;
+}
+
+double perSecond(uint32_t count, std::chrono::steady_clock::duration elapsed)
+{
+    double secs = std::chrono::duration<double>(elapsed).count();
+    return secs > 0 ? count / secs : 0;
+}
+} // namespace
+
+void setUp(void)
+{
+    nodeDB->resetNodes();
+}
+
+void tearDown(void) {}
+
+void test_lookupMatchesScan(void)
+{
+    for (uint32_t i = 0; i < 500; i++)
+        addNode(nodeNumFor(i));
+
+    TEST_ASSERT_TRUE(nodeDB->checkNodeIndex());
+    for (uint32_t i = 0; i < 600; i++) {
+        NodeNum n = nodeNumFor(i);
+        TEST_ASSERT_EQUAL_PTR(scanForNode(n), nodeDB->getMeshNode(n));
+    }
+    TEST_ASSERT_NOT_NULL(nodeDB->getMeshNode(nodeDB->getNodeNum()));
+}
+
+void test_indexAfterRemove(void)
+{
+    for (uint32_t i = 0; i < 50; i++)
+        addNode(nodeNumFor(i));
+
+    nodeDB->removeNodeByNum(nodeNumFor(10));
+    TEST_ASSERT_NULL(nodeDB->getMeshNode(nodeNumFor(10)));
+    TEST_ASSERT_NOT_NULL(nodeDB->getMeshNode(nodeNumFor(11)));
+    TEST_ASSERT_EQUAL_UINT32(nodeNumFor(49), nodeDB->getMeshNode(nodeNumFor(49))->num);
+    TEST_ASSERT_TRUE(nodeDB->checkNodeIndex());
+}
+
+void test_indexAfterResetKeepingFavorites(void)
+{
+    for (uint32_t i = 0; i < 50; i++)
+        addNode(nodeNumFor(i));
+    nodeDB->set_favorite(true, nodeNumFor(7));
+
+    nodeDB->resetNodes(true);
+    TEST_ASSERT_TRUE(nodeDB->checkNodeIndex());
+    TEST_ASSERT_TRUE(nodeDB->isFavorite(nodeNumFor(7)));
+    TEST_ASSERT_NULL(nodeDB->getMeshNode(nodeNumFor(8)));
+}
+
+// Filling the DB evicts the oldest entries, the index must follow the shifted nodes.
+void test_indexAfterEviction(void)
+{
+    for (uint32_t i = 0; i < kMaxNodes + 20; i++)
+        addNode(nodeNumFor(i));
+
+    TEST_ASSERT_EQUAL_UINT32(kMaxNodes, nodeDB->getNumMeshNodes());
+    TEST_ASSERT_TRUE(nodeDB->checkNodeIndex());
+    TEST_ASSERT_NOT_NULL(nodeDB->getMeshNode(nodeNumFor(kMaxNodes + 19)));
+}
+
+// The WiFi bridge only sends aggregated texts to receivers that said they can unpack them.
+void test_receiversHave(void)
+{
+    const uint32_t agg = NODEINFO_BITFIELD_TEXT_AGGREGATE_MASK;
+    NodeNum capable = nodeNumFor(1), plain = nodeNumFor(2), quiet = nodeNumFor(3);
+    hearNodeWith(capable, 0, agg | NODEINFO_BITFIELD_TEXT_COMPRESSION_MASK);
+    hearNodeWith(plain, 0, NODEINFO_BITFIELD_TEXT_COMPRESSION_MASK);
+
+    TEST_ASSERT_TRUE(nodeDB->receiversHave(capable, 0, agg));
+    TEST_ASSERT_FALSE(nodeDB->receiversHave(plain, 0, agg));
+    TEST_ASSERT_FALSE(nodeDB->receiversHave(nodeNumFor(4), 0, agg)); // Never heard of
+    TEST_ASSERT_TRUE(nodeDB->receiversHave(plain, 0, NODEINFO_BITFIELD_TEXT_COMPRESSION_MASK));
+
+    // A broadcast needs everyone recently heard on the channel, and someone
+    TEST_ASSERT_FALSE(nodeDB->receiversHave(NODENUM_BROADCAST, 0, agg));
+    TEST_ASSERT_TRUE(nodeDB->receiversHave(NODENUM_BROADCAST, 0, NODEINFO_BITFIELD_TEXT_COMPRESSION_MASK));
+    TEST_ASSERT_FALSE(nodeDB->receiversHave(NODENUM_BROADCAST, 1, agg));
+    hearNodeWith(nodeNumFor(5), 1, agg);
+    TEST_ASSERT_TRUE(nodeDB->receiversHave(NODENUM_BROADCAST, 1, agg));
+
+    // Nodes not heard for a while no longer count
+    hearNodeWith(quiet, 1, 0, NODEINFO_AUDIENCE_SECS + 60);
+    TEST_ASSERT_TRUE(nodeDB->receiversHave(NODENUM_BROADCAST, 1, agg));
+    hearNodeWith(quiet, 1, 0);
+    TEST_ASSERT_FALSE(nodeDB->receiversHave(NODENUM_BROADCAST, 1, agg));
+}
+
+// Display order is ourselves, then favorites, then most recently heard, without moving the records.
+void test_orderIsMaintained(void)
+{
+    for (uint32_t i = 0; i < 200; i++)
+        hearNode(nodeNumFor(i), 1000 + (i * 37) % 200);
+
+    meshtastic_NodeInfoLite *fav = nodeDB->getMeshNode(nodeNumFor(3));
+    nodeDB->set_favorite(true, nodeNumFor(3));
+    hearNode(nodeNumFor(150), 5000);
+    TEST_ASSERT_EQUAL_PTR(fav, nodeDB->getMeshNode(nodeNumFor(3)));
+
+    TEST_ASSERT_EQUAL_UINT32(nodeDB->getNodeNum(), nodeDB->getMeshNodeByIndex(0)->num);
+    TEST_ASSERT_EQUAL_UINT32(nodeNumFor(3), nodeDB->getMeshNodeByIndex(1)->num);
+    TEST_ASSERT_EQUAL_UINT32(nodeNumFor(150), nodeDB->getMeshNodeByIndex(2)->num);
+    for (size_t i = 3; i < nodeDB->getNumMeshNodes(); i++) {
+        TEST_ASSERT_FALSE(nodeDB->getMeshNodeByIndex(i)->is_favorite);
+        TEST_ASSERT_TRUE(nodeDB->getMeshNodeByIndex(i - 1)->last_heard >= nodeDB->getMeshNodeByIndex(i)->last_heard);
+    }
+
+    // readNextMeshNode walks the same order
+    uint32_t readIndex = 0;
+    for (size_t i = 0; i < nodeDB->getNumMeshNodes(); i++)
+        TEST_ASSERT_EQUAL_PTR(nodeDB->getMeshNodeByIndex(i), nodeDB->readNextMeshNode(readIndex));
+    TEST_ASSERT_NULL(nodeDB->readNextMeshNode(readIndex));
+}
+
+// Time to keep the node list ordered while every node is heard once, incremental vs. the old bubble sort.
+static void benchmarkOrdering(uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+        hearNode(nodeNumFor(i), 1000 + i);
+
+    // Each node is heard again in reverse order, so every one of them moves to the front
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < count; i++)
+        hearNode(nodeNumFor(count - 1 - i), 100000 + i);
+    double incrementalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    TEST_ASSERT_EQUAL_UINT32(nodeNumFor(0), nodeDB->getMeshNodeByIndex(1)->num);
+
+    // The old code sorted the whole DB at most every 5s, so compare against a single full sort of the records
+    std::vector<meshtastic_NodeInfoLite> nodes(nodeDB->meshNodes->begin(),
+                                               nodeDB->meshNodes->begin() + nodeDB->getNumMeshNodes());
+    for (uint32_t i = 0; i < count; i++)
+        nodes[(i * 7) % nodes.size()].last_heard ^= i; // scramble, like several minutes of traffic
+    start = std::chrono::steady_clock::now();
+    bubbleSortNodes(nodes, nodeDB->getNodeNum());
+    double bubbleMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    printf("NodeDB nodes=%u: Sort took %.3f milliseconds for %u incremental reorders, %.3f milliseconds for one bubble sort\n",
+           count, incrementalMs, count, bubbleMs);
+}
+
+void test_orderBenchmark100(void)
+{
+    benchmarkOrdering(100);
+}
+
+void test_orderBenchmark500(void)
+{
+    benchmarkOrdering(500);
+}
+
+void test_orderBenchmark3000(void)
+{
+    benchmarkOrdering(kMaxNodes - 1);
+}
+
+static void benchmarkNodes(uint32_t count)
+{
+    const uint32_t lookups = 100000;
+
+    for (uint32_t i = 0; i < count; i++)
+        addNode(nodeNumFor(i));
+
+    // Every other lookup misses, like packets from nodes we have not heard yet
+    uint32_t hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < lookups; n++)
+        hits += nodeDB->getMeshNode(nodeNumFor(n % (2 * count))) != NULL;
+    double indexedRate = perSecond(lookups, std::chrono::steady_clock::now() - start);
+    TEST_ASSERT_TRUE(hits > 0);
+
+    uint32_t scanHits = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < lookups; n++)
+        scanHits += scanForNode(nodeNumFor(n % (2 * count))) != NULL;
+    double scanRate = perSecond(lookups, std::chrono::steady_clock::now() - start);
+    TEST_ASSERT_EQUAL_UINT32(hits, scanHits);
+
+    printf("NodeDB nodes=%u: indexed %.0f lookups/s, linear scan %.0f lookups/s (x%.1f)\n", count, indexedRate, scanRate,
+           scanRate > 0 ? indexedRate / scanRate : 0);
+}
+
+void test_benchmark100(void)
+{
+    benchmarkNodes(100);
+}
+
+void test_benchmark1000(void)
+{
+    benchmarkNodes(1000);
+}
+
+void test_benchmark3000(void)
+{
+    benchmarkNodes(kMaxNodes - 1);
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+    portduino_config.MaxNodes = kMaxNodes;
+    nodeDB = new NodeDB();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_lookupMatchesScan);
+    RUN_TEST(test_indexAfterRemove);
+    RUN_TEST(test_indexAfterResetKeepingFavorites);
+    RUN_TEST(test_indexAfterEviction);
+    RUN_TEST(test_benchmark100);
+    RUN_TEST(test_benchmark1000);
+    RUN_TEST(test_benchmark3000);
+    RUN_TEST(test_orderIsMaintained);
+    RUN_TEST(test_receiversHave);
+    RUN_TEST(test_orderBenchmark100);
+    RUN_TEST(test_orderBenchmark500);
+    RUN_TEST(test_orderBenchmark3000);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+void loop() {}
@@ -0,0 +1,252 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "mesh/NodeDB.h"
+#include "mesh/PacketHistory.h"
+#include "platform/portduino/PortduinoGlue.h"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace
+{
+// Minimal NodeDB so PacketHistory can ask for our own node number.
+class MockNodeDB : public NodeDB
+{
+  public:
+    meshtastic_NodeInfoLite *getMeshNode(NodeNum n) override { return &emptyNode; }
+    meshtastic_NodeInfoLite emptyNode = {};
+};
+
+// The linear scan PacketHistory used before it was indexed, kept as the benchmark baseline.
+class LinearScanHistory
+{
+  public:
+    struct Record {
+        NodeNum sender;
+        PacketId id;
+        uint32_t rxTimeMsec;
+        uint8_t next_hop;
+        uint8_t hop_limit;
+        uint8_t relayed_by[NUM_RELAYERS];
+    };
+
+    explicit LinearScanHistory(uint32_t capacity) : records(capacity) {}
+
+    const Record *find(NodeNum sender, PacketId id) const
+    {
+        for (const Record &r : records) {
+            if (r.id == id && r.sender == sender)
+                return &r;
+        }
+        return NULL;
+    }
+
+    void insert(NodeNum sender, PacketId id, uint32_t now)
+    {
+        Record *tu = NULL;
+        uint32_t oldest = 0;
+        for (Record &r : records) {
+            if (r.id == 0 && r.sender == 0) {
+                tu = &r;
+                break;
+            }
+            if (now - r.rxTimeMsec >= oldest) {
+                oldest = now - r.rxTimeMsec;
+                tu = &r;
+            }
+        }
+        *tu = {sender, id, now ? now : 1, 0, 0, {0}};
+    }
+
+  private:
+    std::vector<Record> records;
+};
+
+meshtastic_MeshPacket makePacket(NodeNum from, PacketId id)
+{
+    meshtastic_MeshPacket p = meshtastic_MeshPacket_init_zero;
+    p.from = from;
+    p.id = id;
+    p.hop_limit = 3;
+    p.next_hop = NO_NEXT_HOP_PREFERENCE;
+    return p;
+}
+
+// Senders spread over many nodes, ids sequential per packet like a busy mesh.
+NodeNum senderFor(uint32_t i)
+{
+    return 0x10000 + (i * 7919) % 3000;
+}
+
+double perSecond(uint32_t count, std::chrono::steady_clock::duration elapsed)
+{
+    double secs = std::chrono::duration<double>(elapsed).count();
+    return secs > 0 ? count / secs : 0;
+}
+} // namespace
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// A packet is reported as seen only after it was recorded.
+void test_seenAfterInsert(void)
+{
+    PacketHistory history(100);
+    TEST_ASSERT_TRUE(history.initOk());
+
+    meshtastic_MeshPacket p = makePacket(0x1001, 0x42);
+    TEST_ASSERT_FALSE(history.wasSeenRecently(&p, false));
+    TEST_ASSERT_FALSE(history.wasSeenRecently(&p));
+    TEST_ASSERT_TRUE(history.wasSeenRecently(&p));
+
+    meshtastic_MeshPacket other = makePacket(0x1002, 0x42);
+    TEST_ASSERT_FALSE(history.wasSeenRecently(&other, false));
+}
+
+// When full, the least recently refreshed record is the one evicted.
+void test_evictsOldest(void)
+{
+    const uint32_t capacity = 8;
+    PacketHistory history(capacity);
+
+    for (uint32_t i = 1; i <= capacity; i++) {
+        meshtastic_MeshPacket p = makePacket(0x2000, i);
+        history.wasSeenRecently(&p);
+        delay(2);
+    }
+
+    // Refresh the first packet, so the second becomes the oldest
+    meshtastic_MeshPacket first = makePacket(0x2000, 1);
+    TEST_ASSERT_TRUE(history.wasSeenRecently(&first));
+
+    meshtastic_MeshPacket overflow = makePacket(0x2000, capacity + 1);
+    TEST_ASSERT_FALSE(history.wasSeenRecently(&overflow));
+
+    meshtastic_MeshPacket second = makePacket(0x2000, 2);
+    TEST_ASSERT_TRUE(history.wasSeenRecently(&first, false));
+    TEST_ASSERT_FALSE(history.wasSeenRecently(&second, false));
+    for (uint32_t i = 3; i <= capacity + 1; i++) {
+        meshtastic_MeshPacket p = makePacket(0x2000, i);
+        TEST_ASSERT_TRUE(history.wasSeenRecently(&p, false));
+    }
+}
+
+// Evicting records must not break probe chains of keys that are still stored.
+void test_indexSurvivesChurn(void)
+{
+    const uint32_t capacity = 64;
+    PacketHistory history(capacity);
+
+    for (uint32_t i = 1; i <= 20 * capacity; i++) {
+        meshtastic_MeshPacket p = makePacket(senderFor(i), i);
+        TEST_ASSERT_FALSE(history.wasSeenRecently(&p));
+        if (i > capacity) {
+            meshtastic_MeshPacket evicted = makePacket(senderFor(i - capacity), i - capacity);
+            TEST_ASSERT_FALSE(history.wasSeenRecently(&evicted, false));
+        }
+        for (uint32_t j = (i > capacity ? i - capacity + 1 : 1); j <= i; j += 7) {
+            meshtastic_MeshPacket kept = makePacket(senderFor(j), j);
+            TEST_ASSERT_TRUE(history.wasSeenRecently(&kept, false));
+        }
+    }
+}
+
+// Relayers are tracked on the indexed record and can be removed again.
+void test_relayers(void)
+{
+    PacketHistory history(16);
+
+    meshtastic_MeshPacket p = makePacket(0x3000, 7);
+    p.relay_node = nodeDB->getLastByteOfNodeNum(nodeDB->getNodeNum());
+    history.wasSeenRecently(&p);
+
+    bool wasSole = false;
+    TEST_ASSERT_TRUE(history.wasRelayer(p.relay_node, p.id, p.from, &wasSole));
+    TEST_ASSERT_TRUE(wasSole);
+
+    history.removeRelayer(p.relay_node, p.id, p.from);
+    TEST_ASSERT_FALSE(history.wasRelayer(p.relay_node, p.id, p.from));
+}
+
+// Lookups per second of the indexed history against the old linear scan.
+static double benchmarkCapacity(uint32_t capacity)
+{
+    const uint32_t lookups = 200000;
+
+    PacketHistory history(capacity);
+    LinearScanHistory scan(capacity);
+    TEST_ASSERT_TRUE(history.initOk());
+
+    for (uint32_t i = 1; i <= capacity; i++) {
+        meshtastic_MeshPacket p = makePacket(senderFor(i), i);
+        history.wasSeenRecently(&p);
+        scan.insert(p.from, p.id, millis());
+    }
+
+    // About half of the lookups hit, half miss, like duplicate and fresh traffic; ids up to capacity are the ones stored
+    uint32_t expected = 0;
+    for (uint32_t n = 0; n < lookups; n++)
+        expected += 1 + (n * 2654435761u) % (2 * capacity) <= capacity;
+    uint32_t hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < lookups; n++) {
+        uint32_t i = 1 + (n * 2654435761u) % (2 * capacity);
+        meshtastic_MeshPacket p = makePacket(senderFor(i), i);
+        hits += history.wasSeenRecently(&p, false);
+    }
+    double indexedRate = perSecond(lookups, std::chrono::steady_clock::now() - start);
+    TEST_ASSERT_EQUAL_UINT32(expected, hits);
+
+    // The scan is much slower at large capacities, so fewer iterations suffice
+    const uint32_t scanLookups = lookups / (capacity / 100);
+    uint32_t scanHits = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < scanLookups; n++) {
+        uint32_t i = 1 + (n * 2654435761u) % (2 * capacity);
+        scanHits += scan.find(senderFor(i), i) != NULL;
+    }
+    double scanRate = perSecond(scanLookups, std::chrono::steady_clock::now() - start);
+    TEST_ASSERT_TRUE(scanHits > 0);
+
+    printf("PacketHistory capacity=%u: indexed %.0f lookups/s, linear scan %.0f lookups/s (x%.1f)\n", capacity, indexedRate,
+           scanRate, scanRate > 0 ? indexedRate / scanRate : 0);
+    return scanRate > 0 ? indexedRate / scanRate : 0;
+}
+
+void test_benchmarkLookups(void)
+{
+    benchmarkCapacity(100);
+    benchmarkCapacity(1000);
+    double speedup = benchmarkCapacity(10000);
+    TEST_ASSERT_TRUE(speedup > 1.0);
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+    portduino_config.MaxNodes = 5000; // PACKETHISTORY_MAX is twice the node count, allow 10k records
+    const std::unique_ptr<MockNodeDB> mockNodeDB(new MockNodeDB());
+    nodeDB = mockNodeDB.get();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_seenAfterInsert);
+    RUN_TEST(test_evictsOldest);
+    RUN_TEST(test_indexSurvivesChurn);
+    RUN_TEST(test_relayers);
+    RUN_TEST(test_benchmarkLookups);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+void loop() {}
@@ -0,0 +1,222 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "mesh/FanoutQueue.h"
+#include "mesh/MeshService.h"
+#include "mesh/SharedPacket.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+typedef FanoutQueue<SharedPacket, 4> PacketFanout;
+
+SharedPacket makeShared(uint32_t id)
+{
+    meshtastic_MeshPacket *p = packetPool.allocZeroed();
+    p->id = id;
+    p->which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    p->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+    return SharedPacket::adopt(p);
+}
+
+meshtastic_MeshPacket *makePacket(uint32_t id)
+{
+    meshtastic_MeshPacket *p = packetPool.allocZeroed();
+    p->id = id;
+    p->which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    p->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+    return p;
+}
+
+uint32_t packetsInUse()
+{
+    return packetPool.getStats().inUse;
+}
+
+/// Stand-in for one connected API client: drains its reader like PhoneAPI::available()/getFromRadio() do
+struct FakeClient {
+    int reader = -1;
+    std::vector<uint32_t> seen;
+
+    void drain()
+    {
+        SharedPacket p;
+        while ((p = service->getForPhone(reader))) {
+            seen.push_back(p->id);
+            p.reset();
+        }
+    }
+};
+} // namespace
+
+// Every reader sees every packet, and it is the same buffer for all of them
+static void test_readersShareOneCopy()
+{
+    uint32_t base = packetsInUse();
+    {
+        PacketFanout q(8);
+        int a = q.openReader(), b = q.openReader(), c = q.openReader();
+        for (uint32_t i = 0; i < 3; i++)
+            TEST_ASSERT_TRUE(q.enqueue(makeShared(i)));
+        TEST_ASSERT_EQUAL_UINT32(base + 3, packetsInUse());
+
+        SharedPacket fromA = q.take(a);
+        SharedPacket fromB = q.take(b);
+        SharedPacket fromC = q.take(c);
+        TEST_ASSERT_EQUAL_PTR(fromA.get(), fromB.get());
+        TEST_ASSERT_EQUAL_PTR(fromA.get(), fromC.get());
+        TEST_ASSERT_EQUAL_UINT32(0, fromA->id);
+
+        // The queue let go of it once everybody read it, the clients' handles keep it alive until they are done
+        TEST_ASSERT_EQUAL(3, fromA.useCount());
+        fromA.reset();
+        fromB.reset();
+        TEST_ASSERT_EQUAL_UINT32(base + 3, packetsInUse());
+        fromC.reset();
+        TEST_ASSERT_EQUAL_UINT32(base + 2, packetsInUse());
+    }
+    TEST_ASSERT_EQUAL_UINT32(base, packetsInUse());
+}
+
+// A slow reader holds packets back, closing it lets them go
+static void test_closeReleasesBacklog()
+{
+    uint32_t base = packetsInUse();
+    PacketFanout q(8);
+    int fast = q.openReader(), slow = q.openReader();
+    for (uint32_t i = 0; i < 5; i++)
+        q.enqueue(makeShared(i));
+
+    while (q.take(fast))
+        ;
+    TEST_ASSERT_EQUAL_UINT32(base + 5, packetsInUse());
+    TEST_ASSERT_EQUAL(5, q.numUsed());
+
+    SharedPacket held = q.take(slow); // dropped while copying a packet out
+    q.closeReader(slow);
+    TEST_ASSERT_TRUE(q.isEmpty());
+    TEST_ASSERT_EQUAL_UINT32(base + 1, packetsInUse());
+    held.reset();
+    TEST_ASSERT_EQUAL_UINT32(base, packetsInUse());
+}
+
+// Evicting the oldest packet while a reader holds it must not free it under that reader
+static void test_dropOldestWhileHeld()
+{
+    uint32_t base = packetsInUse();
+    PacketFanout q(3);
+    int a = q.openReader(), b = q.openReader();
+    for (uint32_t i = 0; i < 3; i++)
+        q.enqueue(makeShared(i));
+
+    SharedPacket held = q.take(a);
+    TEST_ASSERT_FALSE(q.enqueue(makeShared(99))); // full, the new packet is dropped
+    TEST_ASSERT_EQUAL_UINT32(base + 3, packetsInUse());
+
+    TEST_ASSERT_TRUE(q.dropOldest());
+    TEST_ASSERT_EQUAL_UINT32(0, held->id); // still valid
+    TEST_ASSERT_EQUAL_UINT32(1, q.take(b)->id); // b skips the evicted packet
+    held.reset();
+    TEST_ASSERT_EQUAL_UINT32(base + 2, packetsInUse());
+}
+
+// With nobody connected the backlog is kept for the first client, later clients start at what is still queued
+static void test_lateReaderSeesBacklog()
+{
+    uint32_t base = packetsInUse();
+    PacketFanout q(8);
+    for (uint32_t i = 0; i < 3; i++)
+        q.enqueue(makeShared(i));
+    TEST_ASSERT_EQUAL_UINT32(base + 3, packetsInUse());
+
+    int first = q.openReader();
+    TEST_ASSERT_EQUAL_UINT32(0, q.take(first)->id);
+
+    int second = q.openReader();
+    TEST_ASSERT_EQUAL_UINT32(1, q.take(second)->id);
+    TEST_ASSERT_EQUAL_UINT32(base + 2, packetsInUse());
+}
+
+static void test_readerSlotsAreBounded()
+{
+    PacketFanout q(8);
+    for (int i = 0; i < 4; i++)
+        TEST_ASSERT_NOT_EQUAL(-1, q.openReader());
+    TEST_ASSERT_EQUAL(-1, q.openReader());
+    q.closeReader(2);
+    TEST_ASSERT_EQUAL(2, q.openReader());
+    TEST_ASSERT_FALSE(q.take(-1));
+}
+
+// Several clients connected through MeshService at once each get the full packet stream, and each packet is only held once
+static void test_multipleClientsThroughMeshService()
+{
+    const int numClients = 4;
+    const uint32_t numPackets = 20;
+
+    service = new MeshService();
+    uint32_t base = packetsInUse();
+
+    FakeClient clients[numClients];
+    for (int i = 0; i < numClients; i++) {
+        clients[i].reader = service->openPhoneReader();
+        TEST_ASSERT_NOT_EQUAL(-1, clients[i].reader);
+    }
+
+    for (uint32_t id = 1; id <= numPackets; id++) {
+        service->sendToPhone(makePacket(id));
+        // Queued packets cost one buffer each, regardless of how many clients still have to read them
+        size_t slowest = clients[0].seen.size();
+        for (int i = 1; i < numClients; i++)
+            slowest = std::min(slowest, clients[i].seen.size());
+        TEST_ASSERT_EQUAL_UINT32(base + id - slowest, packetsInUse());
+        // Clients drain at different rates: the first every packet, the others less often
+        for (int i = 0; i < numClients; i++)
+            if (id % (i + 1) == 0)
+                clients[i].drain();
+    }
+    for (int i = 0; i < numClients; i++)
+        clients[i].drain();
+
+    for (int i = 0; i < numClients; i++) {
+        TEST_ASSERT_EQUAL(numPackets, clients[i].seen.size());
+        for (uint32_t id = 1; id <= numPackets; id++)
+            TEST_ASSERT_EQUAL_UINT32(id, clients[i].seen[id - 1]);
+    }
+    TEST_ASSERT_TRUE(service->isToPhoneQueueEmpty());
+    TEST_ASSERT_EQUAL_UINT32(base, packetsInUse());
+
+    for (int i = 0; i < numClients; i++)
+        service->closePhoneReader(clients[i].reader);
+    delete service;
+    service = NULL;
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_readersShareOneCopy);
+    RUN_TEST(test_closeReleasesBacklog);
+    RUN_TEST(test_dropOldestWhileHeld);
+    RUN_TEST(test_lateReaderSeesBacklog);
+    RUN_TEST(test_readerSlotsAreBounded);
+    RUN_TEST(test_multipleClientsThroughMeshService);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
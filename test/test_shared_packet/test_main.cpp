@@ -0,0 +1,186 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "mesh/DropOldestQueue.h"
+#include "mesh/SharedPacket.h"
+
+#include <algorithm>
+
+namespace
+{
+uint32_t packetsInUse()
+{
+    return packetPool.getStats().inUse;
+}
+
+uint32_t controlsInUse()
+{
+    return sharedPacketControlPool.getStats().inUse;
+}
+
+meshtastic_MeshPacket makeTextPacket(uint32_t id, size_t payloadLen)
+{
+    meshtastic_MeshPacket p = meshtastic_MeshPacket_init_zero;
+    p.id = id;
+    p.from = 0x1000 + id;
+    p.which_payload_variant = meshtastic_MeshPacket_decoded_tag;
+    p.decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
+    p.decoded.payload.size = std::min(payloadLen, sizeof(p.decoded.payload.bytes));
+    memset(p.decoded.payload.bytes, 'a' + (id % 26), p.decoded.payload.size);
+    return p;
+}
+} // namespace
+
+static void test_handleRefcount()
+{
+    uint32_t base = packetsInUse();
+    meshtastic_MeshPacket src = makeTextPacket(1, 20);
+    {
+        SharedPacket a = SharedPacket::copyOf(src);
+        TEST_ASSERT_TRUE((bool)a);
+        TEST_ASSERT_EQUAL(1, a.useCount());
+        TEST_ASSERT_EQUAL_UINT32(base + 1, packetsInUse());
+
+        SharedPacket b = a;
+        SharedPacket c;
+        c = b;
+        TEST_ASSERT_EQUAL(3, a.useCount());
+        TEST_ASSERT_EQUAL_PTR(a.get(), c.get());
+        TEST_ASSERT_EQUAL_UINT32(1, c->id);
+
+        SharedPacket d = std::move(b);
+        TEST_ASSERT_FALSE((bool)b);
+        TEST_ASSERT_EQUAL(3, d.useCount());
+
+        a.reset();
+        c.reset();
+        TEST_ASSERT_EQUAL_UINT32(base + 1, packetsInUse());
+        TEST_ASSERT_EQUAL(1, d.useCount());
+    }
+    TEST_ASSERT_EQUAL_UINT32(base, packetsInUse());
+}
+
+static void test_adoptTakesOwnership()
+{
+    uint32_t base = packetsInUse();
+    uint32_t baseControls = controlsInUse();
+    {
+        SharedPacket p = SharedPacket::adopt(packetPool.allocCopy(makeTextPacket(2, 10)));
+        TEST_ASSERT_EQUAL_UINT32(base + 1, packetsInUse());
+        TEST_ASSERT_EQUAL_UINT32(baseControls + 1, controlsInUse());
+        TEST_ASSERT_FALSE((bool)SharedPacket::adopt(NULL));
+    }
+    TEST_ASSERT_EQUAL_UINT32(base, packetsInUse());
+    TEST_ASSERT_EQUAL_UINT32(baseControls, controlsInUse());
+}
+
+// Each consumer has its own depth, a full one only loses its own oldest entries
+static void test_dropOldestPerConsumer()
+{
+    uint32_t base = packetsInUse();
+    {
+        DropOldestQueue<SharedPacket> slow(2), fast(8);
+        for (uint32_t id = 1; id <= 5; id++) {
+            SharedPacket p = SharedPacket::copyOf(makeTextPacket(id, 8));
+            slow.push(p);
+            fast.push(p);
+        }
+        TEST_ASSERT_EQUAL(2, slow.numUsed());
+        TEST_ASSERT_EQUAL_UINT32(3, slow.getDropped());
+        TEST_ASSERT_EQUAL(5, fast.numUsed());
+        TEST_ASSERT_EQUAL_UINT32(0, fast.getDropped());
+        TEST_ASSERT_EQUAL_UINT32(4, slow.front()->id);
+        TEST_ASSERT_EQUAL_UINT32(base + 5, packetsInUse()); // dropped by slow, still held by fast
+
+        TEST_ASSERT_EQUAL_UINT32(1, fast.pop()->id);
+        TEST_ASSERT_EQUAL_UINT32(base + 4, packetsInUse());
+        fast.clear();
+        TEST_ASSERT_EQUAL_UINT32(base + 2, packetsInUse());
+    }
+    TEST_ASSERT_EQUAL_UINT32(base, packetsInUse());
+}
+
+/**
+ * Heap needed to keep a burst of received packets around for the phone, MQTT, the WiFi bridge and store & forward: one full
+ * copy per consumer (the old way) against one shared buffer plus a control block per packet.
+ */
+static void test_heapComparison()
+{
+    const int consumers = 4;
+    const int burst = 16;
+    const size_t payloadLen = 200;
+
+    uint32_t base = packetsInUse();
+    uint32_t baseControls = controlsInUse();
+
+    // One copy per consumer
+    uint32_t copiedPeak = 0;
+    {
+        DropOldestQueue<meshtastic_MeshPacket *> queues[consumers] = {DropOldestQueue<meshtastic_MeshPacket *>(burst),
+                                                                      DropOldestQueue<meshtastic_MeshPacket *>(burst),
+                                                                      DropOldestQueue<meshtastic_MeshPacket *>(burst),
+                                                                      DropOldestQueue<meshtastic_MeshPacket *>(burst)};
+        for (int id = 0; id < burst; id++) {
+            meshtastic_MeshPacket rx = makeTextPacket(id, payloadLen);
+            for (int c = 0; c < consumers; c++)
+                queues[c].push(packetPool.allocCopy(rx));
+        }
+        copiedPeak = packetsInUse() - base;
+        for (int c = 0; c < consumers; c++)
+            while (!queues[c].isEmpty())
+                packetPool.release(queues[c].pop());
+    }
+    size_t copiedBytes = copiedPeak * sizeof(meshtastic_MeshPacket);
+
+    // One shared copy
+    uint32_t sharedPeak = 0, controlPeak = 0;
+    {
+        DropOldestQueue<SharedPacket> queues[consumers] = {DropOldestQueue<SharedPacket>(burst),
+                                                           DropOldestQueue<SharedPacket>(burst),
+                                                           DropOldestQueue<SharedPacket>(burst),
+                                                           DropOldestQueue<SharedPacket>(burst)};
+        for (int id = 0; id < burst; id++) {
+            SharedPacket rx = SharedPacket::copyOf(makeTextPacket(id, payloadLen));
+            for (int c = 0; c < consumers; c++)
+                queues[c].push(rx);
+        }
+        sharedPeak = packetsInUse() - base;
+        controlPeak = controlsInUse() - baseControls;
+    }
+    size_t sharedBytes = sharedPeak * sizeof(meshtastic_MeshPacket) + controlPeak * sizeof(SharedPacketControl);
+
+    printf("%d packets x %d consumers: per-consumer copies %u packets / %u bytes, shared %u packets + %u handles / %u bytes\n",
+           burst, consumers, (unsigned)copiedPeak, (unsigned)copiedBytes, (unsigned)sharedPeak, (unsigned)controlPeak,
+           (unsigned)sharedBytes);
+
+    TEST_ASSERT_EQUAL_UINT32(burst * consumers, copiedPeak);
+    TEST_ASSERT_EQUAL_UINT32(burst, sharedPeak);
+    TEST_ASSERT_TRUE(sharedBytes * 3 < copiedBytes);
+    TEST_ASSERT_EQUAL_UINT32(base, packetsInUse());
+    TEST_ASSERT_EQUAL_UINT32(baseControls, controlsInUse());
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_handleRefcount);
+    RUN_TEST(test_adoptTakesOwnership);
+    RUN_TEST(test_dropOldestPerConsumer);
+    RUN_TEST(test_heapComparison);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
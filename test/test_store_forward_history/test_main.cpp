@@ -0,0 +1,361 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "modules/StoreForwardHistory.h"
+
+#include <chrono>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+// How StoreForwardModule picked records before the history was indexed, kept as the reference and benchmark baseline
+struct LinearScan {
+    const std::vector<PacketHistoryStruct> &records;
+    uint32_t first; // Records before it were dropped
+
+    bool eligible(const PacketHistoryStruct &r, NodeNum dest, uint32_t since) const
+    {
+        return r.time && r.time > since && r.from != dest && (r.to == NODENUM_BROADCAST || r.to == dest);
+    }
+
+    uint32_t countAvailable(NodeNum dest, uint32_t since, uint32_t start) const
+    {
+        uint32_t n = 0;
+        for (uint32_t i = std::max(start, first); i < records.size(); i++)
+            n += eligible(records[i], dest, since);
+        return n;
+    }
+
+    uint32_t next(NodeNum dest, uint32_t since, uint32_t start) const
+    {
+        for (uint32_t i = std::max(start, first); i < records.size(); i++)
+            if (eligible(records[i], dest, since))
+                return i;
+        return StoreForwardHistory::NONE;
+    }
+};
+
+// A history with its own storage, and every record added to it
+struct TestHistory {
+    std::vector<uint8_t> storage;
+    std::vector<PacketHistoryStruct> added;
+    StoreForwardHistory history;
+
+    TestHistory(size_t bytes, uint32_t maxRecords = 0) : storage(bytes) { history.init(storage.data(), bytes, maxRecords); }
+
+    void add(uint32_t time, NodeNum from, NodeNum to, const char *text = "")
+    {
+        PacketHistoryStruct r = {};
+        r.time = time;
+        r.from = from;
+        r.to = to;
+        r.id = added.size() + 1;
+        r.payload_size = strlen(text);
+        memcpy(r.payload, text, r.payload_size);
+        history.add(r);
+        added.push_back(r);
+    }
+
+    LinearScan scan() const { return {added, history.getFirst()}; }
+};
+} // namespace
+
+// Clients 1..clients, plus as many other nodes that only ever talk
+static NodeNum randomNode(uint32_t clients)
+{
+    return 1 + rand() % (clients * 2);
+}
+
+// What responders and residents actually send
+static const char *const texts[] = {
+    "ok",
+    "Need water at the school",
+    "Copy that, on our way. ETA 15 min",
+    "Road blocked by fallen trees north of the bridge, use the river road",
+    "All clear at shelter 2, 45 people, need blankets and baby formula",
+    "Yes",
+    "Missing person: Maria Lopez, 72, grey coat, last seen 14:30 near the market",
+    "SOS 45.5017 -73.5673 trapped in basement",
+};
+
+// Mostly broadcasts, the rest direct messages, one second apart on average
+static void fillRandom(TestHistory &t, uint32_t records, uint32_t clients, uint32_t start)
+{
+    uint32_t time = start;
+    for (uint32_t i = 0; i < records; i++) {
+        time += rand() % 3;
+        NodeNum from = randomNode(clients);
+        NodeNum to = rand() % 10 < 7 ? NODENUM_BROADCAST : randomNode(clients);
+        t.add(time, from, to, texts[rand() % (sizeof(texts) / sizeof(texts[0]))]);
+    }
+}
+
+static void test_eligibilityRules()
+{
+    TestHistory t(StoreForwardHistory::bytesFor(16), 16);
+    t.add(100, 2, NODENUM_BROADCAST); // 0: broadcast from someone else
+    t.add(101, 1, NODENUM_BROADCAST); // 1: client's own broadcast
+    t.add(102, 2, 1);                 // 2: direct to the client
+    t.add(103, 2, 3);                 // 3: direct to someone else
+    t.add(104, 1, 1);                 // 4: the client to itself
+    t.add(0, 2, NODENUM_BROADCAST);   // 5: no time, never sent
+    t.add(105, 3, NODENUM_BROADCAST); // 6
+
+    StoreForwardHistory &h = t.history;
+    TEST_ASSERT_EQUAL(3, h.countAvailable(1, 0, 0));
+    TEST_ASSERT_EQUAL(0, h.next(1, 0, 0));
+    TEST_ASSERT_EQUAL(2, h.next(1, 0, 1));
+    TEST_ASSERT_EQUAL(6, h.next(1, 0, 3));
+    TEST_ASSERT_EQUAL(StoreForwardHistory::NONE, h.next(1, 0, 7));
+
+    // A node that has never been heard of still gets the broadcasts
+    TEST_ASSERT_EQUAL(3, h.countAvailable(9, 0, 0));
+    TEST_ASSERT_EQUAL(1, h.next(9, 0, 1));
+}
+
+static void test_timeWindow()
+{
+    TestHistory t(StoreForwardHistory::bytesFor(16), 16);
+    for (uint32_t i = 0; i < 10; i++)
+        t.add(1000 + i * 60, 2, NODENUM_BROADCAST);
+
+    StoreForwardHistory &h = t.history;
+    TEST_ASSERT_EQUAL(10, h.countAvailable(1, 999, 0));
+    TEST_ASSERT_EQUAL(4, h.countAvailable(1, 1000 + 5 * 60, 0)); // strictly newer
+    TEST_ASSERT_EQUAL(6, h.next(1, 1000 + 5 * 60, 0));
+    TEST_ASSERT_EQUAL(2, h.countAvailable(1, 1000 + 5 * 60, 8)); // the cursor is further on than the window
+    TEST_ASSERT_EQUAL(0, h.countAvailable(1, 5000, 0));
+    TEST_ASSERT_EQUAL(StoreForwardHistory::NONE, h.next(1, 5000, 0));
+}
+
+static void test_matchesLinearScan()
+{
+    const uint32_t clients = 20;
+    TestHistory t(100000); // holds about 1500 of them, so the ring has wrapped
+    srand(1);
+    fillRandom(t, 3000, clients, 1000);
+    LinearScan scan = t.scan();
+    TEST_ASSERT_GREATER_THAN(0, t.history.getFirst());
+
+    for (int round = 0; round < 500; round++) {
+        NodeNum dest = randomNode(clients);
+        uint32_t since = 1000 + rand() % 3500;
+        uint32_t start = rand() % 3200;
+        TEST_ASSERT_EQUAL(scan.countAvailable(dest, since, start), t.history.countAvailable(dest, since, start));
+        TEST_ASSERT_EQUAL(scan.next(dest, since, start), t.history.next(dest, since, start));
+    }
+
+    // A whole delivery, record by record as the module moves its cursor
+    for (NodeNum dest = 1; dest <= clients; dest++) {
+        uint32_t since = 3000, cursor = 0, sent = 0;
+        uint32_t expected = scan.countAvailable(dest, since, cursor);
+        uint32_t i;
+        while ((i = t.history.next(dest, since, cursor)) != StoreForwardHistory::NONE) {
+            TEST_ASSERT_EQUAL(scan.next(dest, since, cursor), i);
+            cursor = i + 1;
+            sent++;
+        }
+        TEST_ASSERT_EQUAL(expected, sent);
+    }
+}
+
+static void test_clockSteppingBack()
+{
+    TestHistory t(StoreForwardHistory::bytesFor(16), 16);
+    t.add(500, 2, NODENUM_BROADCAST);
+    t.add(600, 2, NODENUM_BROADCAST);
+    t.add(300, 2, NODENUM_BROADCAST); // clock set back
+    t.add(700, 2, NODENUM_BROADCAST);
+
+    // The stale record may be counted but is never handed out
+    StoreForwardHistory &h = t.history;
+    TEST_ASSERT_EQUAL(1, h.next(1, 550, 0));
+    TEST_ASSERT_EQUAL(3, h.next(1, 550, 2));
+    TEST_ASSERT_EQUAL(0, h.next(1, 0, 0));
+    TEST_ASSERT_EQUAL(4, h.countAvailable(1, 0, 0));
+}
+
+static void test_recordsReadBack()
+{
+    TestHistory t(StoreForwardHistory::bytesFor(4), 4);
+    PacketHistoryStruct r = {};
+    r.time = 1234567;
+    r.to = 0x11223344;
+    r.from = 0x55667788;
+    r.id = 42;
+    r.channel = 3;
+    r.reply_id = 41;
+    r.emoji = true;
+    r.rx_rssi = -117;
+    r.rx_snr = -7.25f;
+    r.hop_start = 7;
+    r.hop_limit = 5;
+    r.via_mqtt = true;
+    r.transport_mechanism = 2;
+    r.payload_size = meshtastic_Constants_DATA_PAYLOAD_LEN;
+    for (int i = 0; i < meshtastic_Constants_DATA_PAYLOAD_LEN; i++)
+        r.payload[i] = i;
+    t.history.add(r);
+
+    PacketHistoryStruct out;
+    memset(&out, 0xAA, sizeof(out));
+    t.history.get(0, out);
+    TEST_ASSERT_EQUAL(r.time, out.time);
+    TEST_ASSERT_EQUAL(r.to, out.to);
+    TEST_ASSERT_EQUAL(r.from, out.from);
+    TEST_ASSERT_EQUAL(r.id, out.id);
+    TEST_ASSERT_EQUAL(r.channel, out.channel);
+    TEST_ASSERT_EQUAL(r.reply_id, out.reply_id);
+    TEST_ASSERT_TRUE(out.emoji);
+    TEST_ASSERT_EQUAL(r.rx_rssi, out.rx_rssi);
+    TEST_ASSERT_EQUAL_FLOAT(r.rx_snr, out.rx_snr);
+    TEST_ASSERT_EQUAL(r.hop_start, out.hop_start);
+    TEST_ASSERT_EQUAL(r.hop_limit, out.hop_limit);
+    TEST_ASSERT_TRUE(out.via_mqtt);
+    TEST_ASSERT_EQUAL(r.transport_mechanism, out.transport_mechanism);
+    TEST_ASSERT_EQUAL(r.payload_size, out.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY(r.payload, out.payload, r.payload_size);
+    TEST_ASSERT_EQUAL(StoreForwardHistory::HEADER_SIZE + meshtastic_Constants_DATA_PAYLOAD_LEN, t.history.getUsed());
+}
+
+static void test_wrapKeepsCursors()
+{
+    // Room for only a few records, so they soon run over the end of the ring and the oldest are dropped
+    TestHistory t(StoreForwardHistory::bytesFor(2), 10);
+    char text[16];
+    for (uint32_t i = 0; i < 50; i++) {
+        snprintf(text, sizeof(text), "msg %u", (unsigned)i);
+        t.add(100 + i, 2, i % 2 ? 1 : NODENUM_BROADCAST, text);
+
+        // Everything kept reads back whole, wherever it lies in the ring
+        for (uint32_t n = t.history.getFirst(); n < t.history.getEnd(); n++) {
+            PacketHistoryStruct r;
+            t.history.get(n, r);
+            TEST_ASSERT_EQUAL(n + 1, r.id);
+            TEST_ASSERT_EQUAL(t.added[n].payload_size, r.payload_size);
+            TEST_ASSERT_EQUAL_MEMORY(t.added[n].payload, r.payload, r.payload_size);
+        }
+        TEST_ASSERT_LESS_OR_EQUAL(t.history.getRingSize(), t.history.getUsed());
+    }
+
+    StoreForwardHistory &h = t.history;
+    TEST_ASSERT_EQUAL(50, h.getEnd());
+    TEST_ASSERT_EQUAL(10, h.size());
+    TEST_ASSERT_EQUAL(40, h.getFirst());
+
+    // A client that was part way through carries on where it was, one that fell behind gets the oldest left
+    TEST_ASSERT_EQUAL(45, h.next(1, 0, 45));
+    TEST_ASSERT_EQUAL(5, h.countAvailable(1, 0, 45));
+    TEST_ASSERT_EQUAL(40, h.next(1, 0, 3));
+    TEST_ASSERT_EQUAL(10, h.countAvailable(1, 0, 0));
+    TEST_ASSERT_EQUAL(5, h.countAvailable(3, 0, 0)); // only the broadcasts
+}
+
+// The same PSRAM as fixed PacketHistoryStruct records were given keeps several times as many packed ones
+static void test_retainsMoreThanFixedRecords()
+{
+    const uint32_t fixedRecords = 2000;
+    const size_t bytes = fixedRecords * sizeof(PacketHistoryStruct);
+    TestHistory t(bytes);
+    srand(3);
+    fillRandom(t, fixedRecords * 10, 50, 1000);
+
+    printf("%u bytes: %u fixed records, %u packed (%.1fx), %u bytes of records in use\n", (unsigned)bytes, fixedRecords,
+           t.history.size(), (double)t.history.size() / fixedRecords, (unsigned)t.history.getUsed());
+    TEST_ASSERT_GREATER_THAN(fixedRecords * 3, t.history.size());
+}
+
+static void test_noStorage()
+{
+    StoreForwardHistory h;
+    h.init(NULL, 100000);
+    TEST_ASSERT_EQUAL(0, h.getCapacity());
+    TEST_ASSERT_EQUAL(0, h.countAvailable(1, 0, 0));
+    TEST_ASSERT_EQUAL(StoreForwardHistory::NONE, h.next(1, 0, 0));
+
+    h.add(PacketHistoryStruct{});
+    TEST_ASSERT_EQUAL(0, h.size());
+}
+
+// A busy server: 50k records and 100 clients, each asking for the default 4 hour window and taking the default
+// 25 records, counted again between each like the module does when it answers a request and a busy retry
+static void test_benchmark50kRecords100Clients()
+{
+    const uint32_t records = 50000, clients = 100, returnMax = 25, window = 4 * 3600;
+    TestHistory t(StoreForwardHistory::bytesFor(records), records);
+    srand(2);
+    fillRandom(t, records, clients, 1000000);
+    LinearScan scan = t.scan();
+    uint32_t now = t.added.back().time;
+
+    std::vector<uint32_t> cursors(clients + 1);
+    uint32_t checkIndexed = 0, checkScan = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (NodeNum dest = 1; dest <= clients; dest++) {
+        uint32_t &cursor = cursors[dest];
+        cursor = 0;
+        checkIndexed += t.history.countAvailable(dest, now - window, cursor);
+        for (uint32_t n = 0; n < returnMax; n++) {
+            uint32_t i = t.history.next(dest, now - window, cursor);
+            if (i == StoreForwardHistory::NONE)
+                break;
+            cursor = i + 1;
+            checkIndexed += t.history.countAvailable(dest, now - window, cursor) + i;
+        }
+    }
+    double indexedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (NodeNum dest = 1; dest <= clients; dest++) {
+        uint32_t &cursor = cursors[dest];
+        cursor = 0;
+        checkScan += scan.countAvailable(dest, now - window, cursor);
+        for (uint32_t n = 0; n < returnMax; n++) {
+            uint32_t i = scan.next(dest, now - window, cursor);
+            if (i == StoreForwardHistory::NONE)
+                break;
+            cursor = i + 1;
+            checkScan += scan.countAvailable(dest, now - window, cursor) + i;
+        }
+    }
+    double scanUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%u records, %u clients taking %u each: indexed %.0f us, linear scan %.0f us (%.0fx)\n", records, clients,
+           returnMax, indexedUs, scanUs, scanUs / indexedUs);
+    TEST_ASSERT_EQUAL_UINT32(checkScan, checkIndexed);
+    TEST_ASSERT_LESS_THAN(scanUs, indexedUs);
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_eligibilityRules);
+    RUN_TEST(test_timeWindow);
+    RUN_TEST(test_matchesLinearScan);
+    RUN_TEST(test_clockSteppingBack);
+    RUN_TEST(test_recordsReadBack);
+    RUN_TEST(test_wrapKeepsCursors);
+    RUN_TEST(test_retainsMoreThanFixedRecords);
+    RUN_TEST(test_noStorage);
+    RUN_TEST(test_benchmark50kRecords100Clients);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
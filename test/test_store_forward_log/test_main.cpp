@@ -0,0 +1,306 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "FSCommon.h"
+#include "SPILock.h"
+#include "modules/StoreForwardLog.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define TEST_DIR "/sflog_test"
+#define TEST_SEGMENT_BYTES 1024 // about twenty short messages
+#define TEST_MAX_SEGMENTS 4
+#define TEST_RECORDS 2000
+
+// A history and the log behind it, as the module holds them
+struct Server {
+    std::vector<uint8_t> storage;
+    StoreForwardHistory history;
+    StoreForwardLog log;
+
+    Server(uint32_t records = TEST_RECORDS, uint32_t segmentBytes = TEST_SEGMENT_BYTES,
+           uint32_t maxSegments = TEST_MAX_SEGMENTS, uint64_t freeBytes = SFLOG_FREE_UNKNOWN)
+        : storage(StoreForwardHistory::bytesFor(records)), log(TEST_DIR, segmentBytes, maxSegments)
+    {
+        history.init(storage.data(), storage.size(), records);
+        TEST_ASSERT_TRUE(log.begin(history, freeBytes));
+    }
+
+    void add(uint32_t id, uint32_t now = 0)
+    {
+        PacketHistoryStruct r = {};
+        r.time = 1700000000 + id;
+        r.from = 0x100 + id % 7;
+        r.to = id % 3 ? NODENUM_BROADCAST : 0x200;
+        r.id = id;
+        r.rx_snr = 6.5f;
+        r.rx_rssi = -90;
+        r.payload_size = snprintf((char *)r.payload, sizeof(r.payload), "message number %u", (unsigned)id);
+        history.add(r);
+        log.append(r, now);
+    }
+};
+
+static Server *server;
+
+void setUp(void)
+{
+    rmDir(TEST_DIR);
+    server = new Server();
+}
+
+void tearDown(void)
+{
+    delete server;
+    rmDir(TEST_DIR);
+}
+
+/// Start again as after a reboot, with what made it to flash
+static void reboot(uint32_t records = TEST_RECORDS, uint32_t segmentBytes = TEST_SEGMENT_BYTES,
+                   uint32_t maxSegments = TEST_MAX_SEGMENTS, uint64_t freeBytes = SFLOG_FREE_UNKNOWN)
+{
+    delete server;
+    server = new Server(records, segmentBytes, maxSegments, freeBytes);
+}
+
+/// The history holds exactly records first..last, in order and intact
+static void assertHolds(uint32_t first, uint32_t last)
+{
+    StoreForwardHistory &h = server->history;
+    TEST_ASSERT_EQUAL(last - first + 1, h.size());
+    char text[32];
+    for (uint32_t n = h.getFirst(); n < h.getEnd(); n++) {
+        PacketHistoryStruct r;
+        h.get(n, r);
+        uint32_t id = first + n - h.getFirst();
+        TEST_ASSERT_EQUAL(id, r.id);
+        TEST_ASSERT_EQUAL(1700000000 + id, r.time);
+        TEST_ASSERT_EQUAL(-90, r.rx_rssi);
+        size_t len = snprintf(text, sizeof(text), "message number %u", (unsigned)id);
+        TEST_ASSERT_EQUAL(len, r.payload_size);
+        TEST_ASSERT_EQUAL_MEMORY(text, r.payload, len);
+    }
+}
+
+static void test_survivesReboot()
+{
+    for (uint32_t id = 1; id <= 50; id++)
+        server->add(id);
+    server->log.flush();
+
+    reboot();
+    TEST_ASSERT_EQUAL(50, server->log.getStats().replayed);
+    TEST_ASSERT_EQUAL(0, server->log.getStats().damaged);
+    assertHolds(1, 50);
+
+    // And carries on appending after what was there
+    for (uint32_t id = 51; id <= 60; id++)
+        server->add(id);
+    server->log.flush();
+    reboot();
+    assertHolds(1, 60);
+}
+
+static void test_writesInBatches()
+{
+    for (uint32_t id = 1; id <= 5; id++)
+        server->add(id, 1000 + id);
+
+    // Nothing written until the first one has waited long enough, then all five at once
+    server->log.flushIfDue(1000 + SFLOG_FLUSH_MS);
+    TEST_ASSERT_EQUAL(0, server->log.getStats().batches);
+    server->log.flushIfDue(1001 + SFLOG_FLUSH_MS);
+    TEST_ASSERT_EQUAL(1, server->log.getStats().batches);
+
+    // Whatever was still waiting is lost with the power
+    server->add(6, 20000);
+    reboot();
+    assertHolds(1, 5);
+}
+
+static void test_tornRecordEndsSegment()
+{
+    for (uint32_t id = 1; id <= 10; id++)
+        server->add(id);
+    server->log.flush();
+
+    // Power lost halfway through writing the next batch
+    char path[64];
+    snprintf(path, sizeof(path), "%s/seg%05u", TEST_DIR, 0);
+    {
+        concurrency::LockGuard g(spiLock);
+        File f = FSCom.open(path, "a");
+        const uint8_t partial[] = {0x5F, 0x12, 0x34, 0x56, 0x78, 0, 0};
+        f.write(partial, sizeof(partial));
+        f.close();
+    }
+
+    reboot();
+    TEST_ASSERT_EQUAL(1, server->log.getStats().damaged);
+    assertHolds(1, 10);
+
+    // New records go after the damage, into a segment of their own
+    for (uint32_t id = 11; id <= 12; id++)
+        server->add(id);
+    server->log.flush();
+    TEST_ASSERT_EQUAL(2, server->log.getSegmentCount());
+    reboot();
+    assertHolds(1, 12);
+}
+
+static void test_corruptRecordEndsSegment()
+{
+    for (uint32_t id = 1; id <= 10; id++)
+        server->add(id);
+    server->log.flush();
+
+    // Flip a byte in the payload of the sixth record
+    char path[64];
+    snprintf(path, sizeof(path), "%s/seg%05u", TEST_DIR, 0);
+    std::vector<uint8_t> bytes;
+    {
+        concurrency::LockGuard g(spiLock);
+        File f = FSCom.open(path, FILE_O_READ);
+        bytes.resize(f.size());
+        f.read(bytes.data(), bytes.size());
+        f.close();
+    }
+    size_t offset = 0;
+    for (int i = 0; i < 5; i++)
+        offset += 2 + StoreForwardHistory::HEADER_SIZE + bytes[offset + 2 + StoreForwardHistory::HEADER_SIZE - 1];
+    bytes[offset + 2 + StoreForwardHistory::HEADER_SIZE] ^= 0x20;
+    {
+        concurrency::LockGuard g(spiLock);
+        File f = FSCom.open(path, FILE_O_WRITE);
+        f.write(bytes.data(), bytes.size());
+        f.close();
+    }
+
+    reboot();
+    TEST_ASSERT_EQUAL(1, server->log.getStats().damaged);
+    assertHolds(1, 5);
+}
+
+static void test_oldSegmentsDropped()
+{
+    for (uint32_t id = 1; id <= 500; id++) {
+        server->add(id);
+        if (id % 10 == 0)
+            server->log.flush();
+    }
+    TEST_ASSERT_EQUAL(TEST_MAX_SEGMENTS, server->log.getSegmentCount());
+    TEST_ASSERT_GREATER_THAN(0, server->log.getStats().dropped);
+
+    // What is left is the newest, whole segments of it
+    reboot();
+    StoreForwardHistory &h = server->history;
+    PacketHistoryStruct r;
+    h.get(h.getFirst(), r);
+    TEST_ASSERT_LESS_THAN(TEST_SEGMENT_BYTES * TEST_MAX_SEGMENTS / 40, h.size());
+    assertHolds(r.id, 500);
+}
+
+static void test_sizedToFreeSpace()
+{
+    // Room for three segments besides the reserve, and the log keeps to it
+    reboot(TEST_RECORDS, TEST_SEGMENT_BYTES, TEST_MAX_SEGMENTS, SFLOG_FS_RESERVE_BYTES + 3 * TEST_SEGMENT_BYTES + 100);
+    TEST_ASSERT_EQUAL(3, server->log.getMaxSegments());
+    for (uint32_t id = 1; id <= 500; id++) {
+        server->add(id);
+        if (id % 10 == 0)
+            server->log.flush();
+    }
+    TEST_ASSERT_EQUAL(3, server->log.getSegmentCount());
+
+    // What the log has on flash already counts as room, nearly three segments of it
+    reboot(TEST_RECORDS, TEST_SEGMENT_BYTES, TEST_MAX_SEGMENTS, SFLOG_FS_RESERVE_BYTES + TEST_SEGMENT_BYTES);
+    TEST_ASSERT_EQUAL(3, server->log.getMaxSegments());
+
+    // Too little for even two, the history stays in RAM
+    StoreForwardLog full(TEST_DIR "_full", TEST_SEGMENT_BYTES, TEST_MAX_SEGMENTS);
+    TEST_ASSERT_FALSE(full.begin(server->history, SFLOG_FS_RESERVE_BYTES + TEST_SEGMENT_BYTES));
+    rmDir(TEST_DIR "_full");
+}
+
+static void test_stopsAfterWriteFailures()
+{
+    // A directory where each segment would go, so every write fails
+    char path[64];
+    for (uint32_t id = 0; id < 10; id++) {
+        snprintf(path, sizeof(path), "%s/seg%05u", TEST_DIR, (unsigned)id);
+        concurrency::LockGuard g(spiLock);
+        FSCom.mkdir(path);
+        strcat(path, "/in_the_way");
+        File f = FSCom.open(path, FILE_O_WRITE);
+        f.close();
+    }
+
+    for (uint32_t id = 1; id <= 20; id++) {
+        server->add(id);
+        server->log.flush();
+    }
+    const StoreForwardLogStats &stats = server->log.getStats();
+    TEST_ASSERT_TRUE(server->log.isStopped());
+    TEST_ASSERT_EQUAL(SFLOG_MAX_WRITE_FAILURES, stats.writeFailures);
+    TEST_ASSERT_EQUAL(SFLOG_MAX_WRITE_FAILURES, stats.batches);
+    TEST_ASSERT_EQUAL(SFLOG_MAX_WRITE_FAILURES, server->log.getSegmentCount());
+    TEST_ASSERT_EQUAL(20, stats.discarded);
+
+    // The history itself is still all there
+    assertHolds(1, 20);
+}
+
+// Startup replay of a big log: 100k records, as a busy server might have after a long incident
+static void test_benchmarkReplay100k()
+{
+    const uint32_t records = 100000;
+    reboot(records, 256 * 1024, 64);
+    for (uint32_t id = 1; id <= records; id++)
+        server->add(id, id * 10);
+    server->log.flush();
+    uint32_t batches = server->log.getStats().batches;
+
+    delete server;
+    server = NULL;
+    auto start = std::chrono::steady_clock::now();
+    server = new Server(records, 256 * 1024, 64);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%u records in %u batches over %u segments, replayed in %.0f ms (%.0f records/s)\n", records, batches,
+           server->log.getSegmentCount(), ms, records / ms * 1000);
+    TEST_ASSERT_EQUAL(records, server->log.getStats().replayed);
+    TEST_ASSERT_EQUAL(records, server->history.size());
+    TEST_ASSERT_LESS_THAN(5000, ms);
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_survivesReboot);
+    RUN_TEST(test_writesInBatches);
+    RUN_TEST(test_tornRecordEndsSegment);
+    RUN_TEST(test_corruptRecordEndsSegment);
+    RUN_TEST(test_oldSegmentsDropped);
+    RUN_TEST(test_sizedToFreeSpace);
+    RUN_TEST(test_stopsAfterWriteFailures);
+    RUN_TEST(test_benchmarkReplay100k);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
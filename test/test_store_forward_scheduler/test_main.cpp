@@ -0,0 +1,307 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "modules/StoreForwardScheduler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define CLIENT_A 0x10
+#define CLIENT_B 0x20
+#define CLIENT_C 0x30
+#define TALKER 0x40
+#define OTHER_TALKER 0x50
+
+// A history with its own storage
+struct TestHistory {
+    std::vector<uint8_t> storage;
+    StoreForwardHistory history;
+    uint32_t nextId = 1;
+
+    TestHistory() : storage(StoreForwardHistory::bytesFor(1000)) { history.init(storage.data(), storage.size(), 1000); }
+
+    void add(uint32_t time, NodeNum from, NodeNum to, const char *text, uint32_t replyId = 0)
+    {
+        PacketHistoryStruct r = {};
+        r.time = time;
+        r.from = from;
+        r.to = to;
+        r.id = nextId++;
+        r.reply_id = replyId;
+        r.payload_size = strlen(text);
+        memcpy(r.payload, text, r.payload_size);
+        history.add(r);
+    }
+};
+
+static TestHistory *h;
+static StoreForwardScheduler *scheduler;
+
+void setUp(void)
+{
+    h = new TestHistory();
+    scheduler = new StoreForwardScheduler();
+}
+
+void tearDown(void)
+{
+    delete scheduler;
+    delete h;
+}
+
+/// Take the next frame, checking it is for dest and carries text
+static void assertFrame(NodeNum dest, const char *text)
+{
+    StoreForwardFrame frame;
+    uint32_t cursor;
+    TEST_ASSERT_TRUE(scheduler->next(h->history, frame, cursor));
+    TEST_ASSERT_EQUAL_HEX32(dest, frame.dest);
+    TEST_ASSERT_EQUAL(strlen(text), frame.record.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY(text, frame.record.payload, frame.record.payload_size);
+}
+
+static void assertDone()
+{
+    StoreForwardFrame frame;
+    uint32_t cursor;
+    TEST_ASSERT_FALSE(scheduler->next(h->history, frame, cursor));
+    TEST_ASSERT_TRUE(scheduler->empty());
+}
+
+static void test_clientsTakeTurns()
+{
+    h->add(100, TALKER, CLIENT_A, "to A 1");
+    h->add(101, TALKER, CLIENT_B, "to B 1");
+    h->add(102, OTHER_TALKER, CLIENT_A, "to A 2");
+    h->add(103, OTHER_TALKER, CLIENT_B, "to B 2");
+    h->add(104, TALKER, CLIENT_A, "to A 3");
+
+    TEST_ASSERT_TRUE(scheduler->add(CLIENT_A, 0, 0, 10));
+    TEST_ASSERT_TRUE(scheduler->add(CLIENT_B, 0, 0, 10));
+    assertFrame(CLIENT_A, "to A 1");
+    assertFrame(CLIENT_B, "to B 1");
+    assertFrame(CLIENT_A, "to A 2");
+    assertFrame(CLIENT_B, "to B 2");
+    assertFrame(CLIENT_A, "to A 3");
+    assertDone();
+}
+
+static void test_lateClientWaitsItsTurn()
+{
+    for (uint32_t i = 0; i < 4; i++)
+        h->add(100 + i, i % 2 ? TALKER : OTHER_TALKER, NODENUM_BROADCAST, i % 2 ? "odd" : "even");
+
+    TEST_ASSERT_TRUE(scheduler->add(CLIENT_A, 0, 0, 10));
+    TEST_ASSERT_TRUE(scheduler->add(CLIENT_B, 0, 0, 10));
+    assertFrame(CLIENT_A, "even");
+
+    // C joins while B is next, it goes after A's second frame
+    TEST_ASSERT_TRUE(scheduler->add(CLIENT_C, 0, 0, 10));
+    assertFrame(CLIENT_B, "even");
+    assertFrame(CLIENT_A, "odd");
+    assertFrame(CLIENT_C, "even");
+    TEST_ASSERT_EQUAL(3, scheduler->clients());
+}
+
+static void test_limitsAndRemoval()
+{
+    for (uint32_t i = 0; i < 6; i++)
+        h->add(100 + i, i % 2 ? TALKER : OTHER_TALKER, NODENUM_BROADCAST, "news");
+
+    // At most the records asked for, and only the newer ones
+    TEST_ASSERT_TRUE(scheduler->add(CLIENT_A, 101, 0, 2));
+    TEST_ASSERT_TRUE(scheduler->add(CLIENT_B, 0, 0, 10));
+    TEST_ASSERT_EQUAL(12, scheduler->queued());
+    assertFrame(CLIENT_A, "news");
+    assertFrame(CLIENT_B, "news");
+    assertFrame(CLIENT_A, "news");
+    assertFrame(CLIENT_B, "news");
+    assertFrame(CLIENT_B, "news");
+    TEST_ASSERT_FALSE(scheduler->has(CLIENT_A));
+
+    // An abort ends it at once
+    TEST_ASSERT_TRUE(scheduler->remove(CLIENT_B));
+    TEST_ASSERT_FALSE(scheduler->remove(CLIENT_B));
+    assertDone();
+
+    // A new request from a client being served replaces its old one
+    TEST_ASSERT_TRUE(scheduler->add(CLIENT_A, 0, 0, 5));
+    TEST_ASSERT_TRUE(scheduler->add(CLIENT_A, 0, 4, 5));
+    TEST_ASSERT_EQUAL(1, scheduler->clients());
+    assertFrame(CLIENT_A, "news");
+    assertFrame(CLIENT_A, "news");
+    assertDone();
+
+    for (NodeNum n = 1; n <= SF_MAX_CLIENTS; n++)
+        TEST_ASSERT_TRUE(scheduler->add(n, 0, 0, 1));
+    TEST_ASSERT_TRUE(scheduler->full());
+    TEST_ASSERT_FALSE(scheduler->add(CLIENT_C, 0, 0, 1));
+    TEST_ASSERT_TRUE(scheduler->add(1, 0, 0, 1));
+}
+
+static void test_shortTextsBundled()
+{
+    h->add(100, TALKER, NODENUM_BROADCAST, "Road blocked");
+    h->add(130, TALKER, NODENUM_BROADCAST, "use the river road");
+    h->add(160, TALKER, NODENUM_BROADCAST, "stay away from the bridge");
+    h->add(170, OTHER_TALKER, NODENUM_BROADCAST, "copy");
+    h->add(180, OTHER_TALKER, NODENUM_BROADCAST, "which bridge?", 4); // A reply keeps its reference
+    h->add(200, TALKER, NODENUM_BROADCAST, "the north one");
+    h->add(200 + SF_BUNDLE_GAP_SECS + 1, TALKER, NODENUM_BROADCAST, "much later");
+    h->add(900, TALKER, CLIENT_A, "and one for you"); // To another destination
+
+    TEST_ASSERT_TRUE(scheduler->add(CLIENT_A, 0, 0, 25));
+    StoreForwardFrame frame;
+    uint32_t cursor;
+    TEST_ASSERT_TRUE(scheduler->next(h->history, frame, cursor));
+    TEST_ASSERT_EQUAL(3, frame.records);
+    TEST_ASSERT_EQUAL(0, frame.record.id);
+    TEST_ASSERT_EQUAL(100, frame.record.time);
+    const char *text = "Road blocked\nuse the river road\nstay away from the bridge";
+    TEST_ASSERT_EQUAL(strlen(text), frame.record.payload_size);
+    TEST_ASSERT_EQUAL_MEMORY(text, frame.record.payload, frame.record.payload_size);
+    TEST_ASSERT_EQUAL(h->history.getFirst() + 3, cursor);
+    TEST_ASSERT_EQUAL(22, scheduler->queued());
+
+    assertFrame(CLIENT_A, "copy");
+    assertFrame(CLIENT_A, "which bridge?");
+    assertFrame(CLIENT_A, "the north one");
+    assertFrame(CLIENT_A, "much later");
+    assertFrame(CLIENT_A, "and one for you");
+    assertDone();
+}
+
+static void test_bundleGetsItsOwnId()
+{
+    // The client heard "on my way" live, but not what followed
+    h->add(100, TALKER, CLIENT_A, "on my way");
+    h->add(110, TALKER, CLIENT_A, "ETA 10 min");
+    h->add(500, TALKER, CLIENT_A, "here");
+
+    TEST_ASSERT_TRUE(scheduler->add(CLIENT_A, 0, 0, 25));
+    StoreForwardFrame frame;
+    uint32_t cursor;
+    TEST_ASSERT_TRUE(scheduler->next(h->history, frame, cursor));
+    TEST_ASSERT_EQUAL(2, frame.records);
+    TEST_ASSERT_EQUAL(0, frame.record.id); // Not 1, which its dedup would drop
+
+    // A text on its own is the original packet again, and dropped if already had
+    TEST_ASSERT_TRUE(scheduler->next(h->history, frame, cursor));
+    TEST_ASSERT_EQUAL(1, frame.records);
+    TEST_ASSERT_EQUAL(3, frame.record.id);
+    assertDone();
+}
+
+static void test_bundleFitsOneFrame()
+{
+    // 40 texts of 30 bytes, seven fit in a frame with the newlines between them
+    char text[31];
+    memset(text, 'x', 30);
+    text[30] = 0;
+    for (uint32_t i = 0; i < 40; i++)
+        h->add(100 + i, TALKER, NODENUM_BROADCAST, text);
+
+    TEST_ASSERT_TRUE(scheduler->add(CLIENT_A, 0, 0, 25));
+    StoreForwardFrame frame;
+    uint32_t cursor;
+    uint32_t records = 0, frames = 0;
+    while (scheduler->next(h->history, frame, cursor)) {
+        TEST_ASSERT_LESS_OR_EQUAL(SF_BUNDLE_MAX_TEXT, frame.record.payload_size);
+        records += frame.records;
+        frames++;
+    }
+    TEST_ASSERT_EQUAL(25, records); // Bundling never goes over the limit asked for
+    TEST_ASSERT_EQUAL(4, frames);
+}
+
+static void test_pacedByAirtime()
+{
+    // A quiet channel leaves SF_CHANNEL_UTIL_TARGET percent to the history
+    TEST_ASSERT_EQUAL(1000 * 100 / SF_CHANNEL_UTIL_TARGET, StoreForwardScheduler::interval(1000, 0));
+    // The rest of the mesh using 20% leaves 5%
+    TEST_ASSERT_EQUAL(20000, StoreForwardScheduler::interval(1000, 20));
+    TEST_ASSERT_EQUAL(SF_MIN_INTERVAL_MS, StoreForwardScheduler::interval(50, 0));
+    TEST_ASSERT_EQUAL(SF_MAX_INTERVAL_MS, StoreForwardScheduler::interval(3000, 22));
+    TEST_ASSERT_EQUAL(SF_BUSY_INTERVAL_MS, StoreForwardScheduler::interval(1000, SF_CHANNEL_UTIL_TARGET));
+
+    // Across millis() wrapping
+    scheduler->sent(UINT32_MAX - 1000, 1000, 0);
+    TEST_ASSERT_EQUAL(3000, scheduler->waitFor(UINT32_MAX));
+    TEST_ASSERT_EQUAL(0, scheduler->waitFor(3000));
+
+    for (uint32_t i = 0; i < 10; i++)
+        h->add(100 + i, TALKER, CLIENT_A, "hello", 1);
+    TEST_ASSERT_TRUE(scheduler->add(CLIENT_A, 0, 0, 10));
+    TEST_ASSERT_EQUAL(10 * 4, scheduler->eta());
+}
+
+// LoRa airtime of a frame carrying len bytes of text, roughly as on LongFast
+static uint32_t longFastAirtime(uint32_t len)
+{
+    return 300 + len * 5;
+}
+
+// Four clients each fetching the history at once, now against the fixed 5 s gap and one client at a time it replaces
+static void test_benchmarkDelivery()
+{
+    static const char *const texts[] = {"ok", "Need water at the school", "Copy that, on our way. ETA 15 min",
+                                        "All clear at shelter 2, 45 people, need blankets"};
+    for (uint32_t i = 0; i < 100; i++)
+        h->add(1000 + i * 20, 0x100 + (i / 3) % 7, NODENUM_BROADCAST, texts[i % 4]);
+
+    const NodeNum clients[] = {CLIENT_A, CLIENT_B, CLIENT_C, 0x60};
+    for (NodeNum c : clients)
+        TEST_ASSERT_TRUE(scheduler->add(c, 0, 0, 25));
+
+    uint32_t now = 0, frames = 0, records = 0, firstFrameDone[4] = {0};
+    StoreForwardFrame frame;
+    uint32_t cursor;
+    while (scheduler->next(h->history, frame, cursor)) {
+        now += scheduler->waitFor(now);
+        for (int c = 0; c < 4; c++)
+            if (frame.dest == clients[c] && !firstFrameDone[c])
+                firstFrameDone[c] = now;
+        scheduler->sent(now, longFastAirtime(frame.record.payload_size), 5);
+        frames++;
+        records += frame.records;
+    }
+    now += scheduler->waitFor(now);
+
+    uint32_t fixedMs = 4 * 25 * 5000;
+    printf("%u records to 4 clients in %u frames, %.0f s paced vs %.0f s one client at a time; last client starts after "
+           "%.1f s instead of %.0f s\n",
+           records, frames, now / 1000.0, fixedMs / 1000.0, firstFrameDone[3] / 1000.0, 3 * 25 * 5000 / 1000.0);
+    TEST_ASSERT_EQUAL(100, records);
+    TEST_ASSERT_LESS_THAN(records, frames);
+    TEST_ASSERT_LESS_THAN(fixedMs, now);
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_clientsTakeTurns);
+    RUN_TEST(test_lateClientWaitsItsTurn);
+    RUN_TEST(test_limitsAndRemoval);
+    RUN_TEST(test_shortTextsBundled);
+    RUN_TEST(test_bundleGetsItsOwnId);
+    RUN_TEST(test_bundleFitsOneFrame);
+    RUN_TEST(test_pacedByAirtime);
+    RUN_TEST(test_benchmarkDelivery);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
@@ -0,0 +1,184 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "wifi/TextAggregator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DEST 0x1234
+#define OTHER 0x5678
+#define BROADCAST 0xFFFFFFFF
+
+static TextAggregator *aggregator;
+static AggregateBatch full;
+static bool fullReady;
+
+void setUp(void)
+{
+    aggregator = new TextAggregator();
+}
+
+void tearDown(void)
+{
+    delete aggregator;
+}
+
+static bool add(uint32_t dest, uint8_t channel, bool wantAck, uint32_t requestId, const char *text, uint32_t now,
+                uint32_t windowMs = 1000)
+{
+    AggregateRequest req = {1, requestId};
+    return aggregator->add(dest, channel, wantAck, req, (const uint8_t *)text, strlen(text), now, windowMs, full, fullReady);
+}
+
+static void expectTexts(const AggregateBatch &b, const char *const *texts, int count)
+{
+    size_t offset = 0;
+    const uint8_t *text;
+    size_t len;
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(TextAggregator::nextText(b.payload, b.len, offset, text, len));
+        TEST_ASSERT_EQUAL(strlen(texts[i]), len);
+        TEST_ASSERT_EQUAL_MEMORY(texts[i], text, len);
+    }
+    TEST_ASSERT_FALSE(TextAggregator::nextText(b.payload, b.len, offset, text, len));
+}
+
+static void test_burstSharesOnePacket()
+{
+    TEST_ASSERT_TRUE(add(DEST, 0, true, 1, "need water", 100));
+    TEST_ASSERT_TRUE(add(DEST, 0, true, 2, "two injured", 400));
+    TEST_ASSERT_TRUE(add(DEST, 0, true, 3, "at the school", 900));
+    TEST_ASSERT_FALSE(fullReady);
+    TEST_ASSERT_EQUAL(1, aggregator->getPendingCount());
+
+    // The window runs from the first message
+    AggregateBatch b;
+    TEST_ASSERT_EQUAL(100, aggregator->msUntilDue(1000));
+    TEST_ASSERT_FALSE(aggregator->takeDue(1099, b));
+    TEST_ASSERT_TRUE(aggregator->takeDue(1100, b));
+    TEST_ASSERT_EQUAL(0, aggregator->getPendingCount());
+    TEST_ASSERT_EQUAL(-1, aggregator->msUntilDue(1100));
+
+    TEST_ASSERT_EQUAL(DEST, b.dest);
+    TEST_ASSERT_TRUE(b.wantAck);
+    TEST_ASSERT_EQUAL(3, b.count);
+    TEST_ASSERT_EQUAL(2, b.requests[1].requestId);
+    const char *texts[] = {"need water", "two injured", "at the school"};
+    expectTexts(b, texts, 3);
+
+    TEST_ASSERT_EQUAL(3, aggregator->getStats().messages);
+    TEST_ASSERT_EQUAL(1, aggregator->getStats().batches);
+}
+
+static void test_separateBatchesPerDestination()
+{
+    TEST_ASSERT_TRUE(add(DEST, 0, true, 1, "a", 0));
+    TEST_ASSERT_TRUE(add(OTHER, 0, true, 2, "b", 10));
+    TEST_ASSERT_TRUE(add(BROADCAST, 1, false, 3, "c", 20));
+    TEST_ASSERT_TRUE(add(BROADCAST, 1, true, 4, "d", 30));
+    TEST_ASSERT_EQUAL(AGG_MAX_BATCHES, aggregator->getPendingCount());
+
+    // No batch left for a fifth combination: it goes on its own
+    TEST_ASSERT_FALSE(add(BROADCAST, 2, false, 5, "e", 40));
+
+    // Everything comes out, oldest window first
+    AggregateBatch b;
+    TEST_ASSERT_TRUE(aggregator->takeDue(50, b, true));
+    TEST_ASSERT_EQUAL(DEST, b.dest);
+    TEST_ASSERT_TRUE(aggregator->takeDue(50, b, true));
+    TEST_ASSERT_EQUAL(OTHER, b.dest);
+    TEST_ASSERT_TRUE(aggregator->takeDue(50, b, true));
+    TEST_ASSERT_FALSE(b.wantAck);
+    TEST_ASSERT_TRUE(aggregator->takeDue(50, b, true));
+    TEST_ASSERT_FALSE(aggregator->takeDue(50, b, true));
+}
+
+static void test_fullBatchHandedOut()
+{
+    char text[100];
+    memset(text, 'x', sizeof(text) - 1);
+    text[sizeof(text) - 1] = 0;
+
+    TEST_ASSERT_TRUE(add(DEST, 0, false, 1, text, 0));
+    TEST_ASSERT_TRUE(add(DEST, 0, false, 2, text, 0));
+    TEST_ASSERT_FALSE(fullReady);
+
+    // A third does not fit in AGG_MAX_PAYLOAD: the first two go now, it opens the next batch
+    TEST_ASSERT_TRUE(add(DEST, 0, false, 3, text, 500));
+    TEST_ASSERT_TRUE(fullReady);
+    TEST_ASSERT_EQUAL(2, full.count);
+    TEST_ASSERT_EQUAL(2 * (2 + 99), full.len);
+    TEST_ASSERT_EQUAL(1, aggregator->getPendingCount());
+    TEST_ASSERT_EQUAL(1000, aggregator->msUntilDue(500));
+}
+
+static void test_tooMany()
+{
+    for (uint32_t i = 0; i < AGG_MAX_MESSAGES; i++) {
+        TEST_ASSERT_TRUE(add(DEST, 0, false, i, "ok", 0));
+        TEST_ASSERT_FALSE(fullReady);
+    }
+    TEST_ASSERT_TRUE(add(DEST, 0, false, 99, "ok", 0));
+    TEST_ASSERT_TRUE(fullReady);
+    TEST_ASSERT_EQUAL(AGG_MAX_MESSAGES, full.count);
+}
+
+static void test_notAggregated()
+{
+    char text[AGG_MAX_PAYLOAD];
+    memset(text, 'x', sizeof(text) - 1);
+    text[sizeof(text) - 1] = 0;
+
+    TEST_ASSERT_FALSE(add(DEST, 0, false, 1, "hello", 0, 0)); // no window
+    TEST_ASSERT_FALSE(add(DEST, 0, false, 2, "", 0));
+    TEST_ASSERT_FALSE(add(DEST, 0, false, 3, text, 0)); // no room for its record header
+    TEST_ASSERT_EQUAL(0, aggregator->getPendingCount());
+}
+
+static void test_windowAcrossMillisWrap()
+{
+    TEST_ASSERT_TRUE(add(DEST, 0, false, 1, "late", 0xFFFFFF00));
+    AggregateBatch b;
+    TEST_ASSERT_FALSE(aggregator->takeDue(0x00000001, b));
+    TEST_ASSERT_EQUAL(0x2E8 - 1, aggregator->msUntilDue(0x00000001));
+    TEST_ASSERT_TRUE(aggregator->takeDue(0x000002E8, b));
+}
+
+static void test_unpackSkipsUnknownAndStopsOnTruncation()
+{
+    const uint8_t payload[] = {0x01, 2, 'h', 'i', 0x7F, 3, 1, 2, 3, 0x01, 1, '!', 0x01, 9, 'x'};
+    const char *texts[] = {"hi", "!"};
+    AggregateBatch b;
+    memcpy(b.payload, payload, sizeof(payload));
+    b.len = sizeof(payload);
+    expectTexts(b, texts, 2);
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_burstSharesOnePacket);
+    RUN_TEST(test_separateBatchesPerDestination);
+    RUN_TEST(test_fullBatchHandedOut);
+    RUN_TEST(test_tooMany);
+    RUN_TEST(test_notAggregated);
+    RUN_TEST(test_windowAcrossMillisWrap);
+    RUN_TEST(test_unpackSkipsUnknownAndStopsOnTruncation);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
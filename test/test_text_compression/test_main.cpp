@@ -0,0 +1,159 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "mesh/compression/TextCompression.h"
+
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+
+// What responders and residents actually send: short, mostly lower case, numbers, the odd location or callsign
+static const char *const corpus[] = {
+    "ok",
+    "Need water at the school",
+    "Two injured, one can't walk. Send medic to Main St & 3rd",
+    "Road blocked by fallen trees north of the bridge, use the river road",
+    "All clear at shelter 2, 45 people, need blankets and baby formula",
+    "Copy that, on our way. ETA 15 min",
+    "Fire spreading east towards the gas station!! Evacuate Oak Ave now",
+    "Is anyone at the community center? Power is out here",
+    "Generator at the clinic needs diesel, about 20 liters",
+    "Missing person: Maria Lopez, 72, grey coat, last seen 14:30 near the market",
+    "Water level rising fast at the bridge, about 50cm in the last hour",
+    "Checkpoint B is open again for vehicles",
+    "Relay: team 3 reached the farm, all 6 residents safe",
+    "SOS 45.5017 -73.5673 trapped in basement",
+    "Need insulin for a diabetic patient at shelter 1, urgent",
+    "Yes",
+    "Thanks, received",
+    "Power restored on the west side, still out east of the river",
+};
+
+static void test_roundTrip()
+{
+    uint8_t packed[256], text[256];
+    for (const char *s : corpus) {
+        size_t len = strlen(s);
+        size_t n = compressText((const uint8_t *)s, len, packed, sizeof(packed));
+        if (n == 0)
+            continue; // sent as is
+        TEST_ASSERT_LESS_THAN(len, n);
+        TEST_ASSERT_EQUAL((int)len, decompressText(packed, n, text, sizeof(text)));
+        TEST_ASSERT_EQUAL_MEMORY(s, text, len);
+    }
+}
+
+static void test_typicalMessagesShrink()
+{
+    uint8_t packed[256];
+    const char *s = "Road blocked by fallen trees north of the bridge, use the river road";
+    size_t n = compressText((const uint8_t *)s, strlen(s), packed, sizeof(packed));
+    TEST_ASSERT_NOT_EQUAL(0, n);
+    TEST_ASSERT_LESS_THAN(strlen(s) * 3 / 4, n);
+}
+
+static void test_noGainSentAsIs()
+{
+    uint8_t packed[256];
+    // Random bytes do not compress, and tiny texts have nothing to gain
+    uint8_t noise[64];
+    srand(1);
+    for (size_t i = 0; i < sizeof(noise); i++)
+        noise[i] = rand();
+    TEST_ASSERT_EQUAL(0, compressText(noise, sizeof(noise), packed, sizeof(packed)));
+    TEST_ASSERT_EQUAL(0, compressText((const uint8_t *)"k", 1, packed, sizeof(packed)));
+    TEST_ASSERT_EQUAL(0, compressText((const uint8_t *)"", 0, packed, sizeof(packed)));
+}
+
+static void test_outputBounded()
+{
+    uint8_t packed[8];
+    const char *s = "Fire spreading east towards the gas station!! Evacuate Oak Ave now";
+    TEST_ASSERT_EQUAL(0, compressText((const uint8_t *)s, strlen(s), packed, sizeof(packed)));
+
+    uint8_t big[256], text[16];
+    size_t n = compressText((const uint8_t *)s, strlen(s), big, sizeof(big));
+    TEST_ASSERT_NOT_EQUAL(0, n);
+    TEST_ASSERT_EQUAL(-1, decompressText(big, n, text, sizeof(text)));
+}
+
+static void test_corruptInputRejectedOrBounded()
+{
+    uint8_t garbage[64], text[256];
+    srand(2);
+    for (int round = 0; round < 200; round++) {
+        size_t len = 1 + rand() % sizeof(garbage);
+        for (size_t i = 0; i < len; i++)
+            garbage[i] = rand();
+        int n = decompressText(garbage, len, text, sizeof(text));
+        TEST_ASSERT_TRUE(n >= -1 && n <= (int)sizeof(text));
+    }
+}
+
+// Compression ratio and CPU cost over the corpus: bytes saved is airtime saved, the CPU is spent once per message sent
+static void test_benchmarkCorpus()
+{
+    const int iterations = 2000;
+    uint8_t packed[256], text[256];
+    size_t plainBytes = 0, sentBytes = 0;
+    int compressed = 0;
+    const int count = sizeof(corpus) / sizeof(corpus[0]);
+
+    for (const char *s : corpus) {
+        size_t len = strlen(s);
+        size_t n = compressText((const uint8_t *)s, len, packed, sizeof(packed));
+        plainBytes += len;
+        sentBytes += n ? n : len;
+        compressed += n != 0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        for (const char *s : corpus)
+            compressText((const uint8_t *)s, strlen(s), packed, sizeof(packed));
+    double compressUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    size_t lens[sizeof(corpus) / sizeof(corpus[0])];
+    uint8_t stored[sizeof(corpus) / sizeof(corpus[0])][256];
+    for (int i = 0; i < count; i++)
+        lens[i] = compressText((const uint8_t *)corpus[i], strlen(corpus[i]), stored[i], sizeof(stored[i]));
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        for (int j = 0; j < count; j++)
+            if (lens[j])
+                decompressText(stored[j], lens[j], text, sizeof(text));
+    double decompressUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%d messages, %d compressed: %u -> %u payload bytes (%.0f%%)\n", count, compressed, (unsigned)plainBytes,
+           (unsigned)sentBytes, 100.0 * sentBytes / plainBytes);
+    printf("%.2f us to compress (with round-trip check), %.2f us to decompress, per message\n",
+           compressUs / (iterations * count), decompressUs / (iterations * compressed));
+    TEST_ASSERT_LESS_THAN(plainBytes * 85 / 100, sentBytes);
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_roundTrip);
+    RUN_TEST(test_typicalMessagesShrink);
+    RUN_TEST(test_noGainSentAsIs);
+    RUN_TEST(test_outputBounded);
+    RUN_TEST(test_corruptInputRejectedOrBounded);
+    RUN_TEST(test_benchmarkCorpus);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
@@ -0,0 +1,104 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "wifi/WebAssets.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char manifestText[] = "# generated by bin/webapp-pack.py, url hash max-age content-type\n"
+                                   "/index.html d142c89cd87e1591 0 text/html; charset=utf-8\n"
+                                   "/app.js 2cee20eb156797be 604800 application/javascript\r\n"
+                                   "\n"
+                                   "/broken 1234\n"
+                                   "no-slash 1234 0 text/plain\n"
+                                   "/bad-age 1234 soon text/plain\n";
+
+static void test_parseManifest()
+{
+    WebAssetManifest manifest;
+    TEST_ASSERT_EQUAL(2, manifest.parse(manifestText, strlen(manifestText)));
+
+    const WebAsset *index = manifest.find("/index.html");
+    TEST_ASSERT_NOT_NULL(index);
+    TEST_ASSERT_EQUAL_STRING("\"d142c89cd87e1591\"", index->etag);
+    TEST_ASSERT_EQUAL_STRING("text/html; charset=utf-8", index->type);
+    TEST_ASSERT_EQUAL(0, index->maxAge);
+
+    // Windows line endings do not leak into the content type
+    const WebAsset *app = manifest.find("/app.js");
+    TEST_ASSERT_NOT_NULL(app);
+    TEST_ASSERT_EQUAL_STRING("application/javascript", app->type);
+    TEST_ASSERT_EQUAL(604800, app->maxAge);
+}
+
+static void test_findRootAndMissing()
+{
+    WebAssetManifest manifest;
+    manifest.parse(manifestText, strlen(manifestText));
+    TEST_ASSERT_EQUAL_PTR(manifest.find("/index.html"), manifest.find("/"));
+    TEST_ASSERT_NULL(manifest.find("/broken"));
+    TEST_ASSERT_NULL(manifest.find("/index.htm"));
+
+    // A new manifest replaces the old one
+    manifest.parse("/only.css abcd 60 text/css", strlen("/only.css abcd 60 text/css"));
+    TEST_ASSERT_EQUAL(1, manifest.getCount());
+    TEST_ASSERT_NULL(manifest.find("/"));
+}
+
+static void test_capacityAndLongFields()
+{
+    static char text[4096];
+    size_t n = 0;
+    for (int i = 0; i < WEB_ASSET_MAX + 4; i++)
+        n += snprintf(text + n, sizeof(text) - n, "/file%d.js %016x 60 application/javascript\n", i, i);
+    WebAssetManifest manifest;
+    TEST_ASSERT_EQUAL(WEB_ASSET_MAX, manifest.parse(text, n));
+
+    char longUrl[WEB_ASSET_URL_MAX + 32];
+    memset(longUrl, 'a', sizeof(longUrl));
+    longUrl[0] = '/';
+    n = snprintf(text, sizeof(text), "%.*s abcd 0 text/plain\n", (int)sizeof(longUrl), longUrl);
+    TEST_ASSERT_EQUAL(0, manifest.parse(text, n));
+}
+
+static void test_etagMatching()
+{
+    const char *etag = "\"d142c89cd87e1591\"";
+    TEST_ASSERT_TRUE(WebAssetManifest::etagMatches("\"d142c89cd87e1591\"", etag));
+    TEST_ASSERT_TRUE(WebAssetManifest::etagMatches("W/\"d142c89cd87e1591\"", etag));
+    TEST_ASSERT_TRUE(WebAssetManifest::etagMatches("\"0000\", \"d142c89cd87e1591\" ", etag));
+    TEST_ASSERT_TRUE(WebAssetManifest::etagMatches("*", etag));
+
+    TEST_ASSERT_FALSE(WebAssetManifest::etagMatches(NULL, etag));
+    TEST_ASSERT_FALSE(WebAssetManifest::etagMatches("", etag));
+    TEST_ASSERT_FALSE(WebAssetManifest::etagMatches("\"d142c89cd87e159\"", etag));
+    TEST_ASSERT_FALSE(WebAssetManifest::etagMatches("d142c89cd87e1591", etag));
+    TEST_ASSERT_FALSE(WebAssetManifest::etagMatches("\"0000\",\"1111\"", etag));
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_parseManifest);
+    RUN_TEST(test_findRootAndMissing);
+    RUN_TEST(test_capacityAndLongFields);
+    RUN_TEST(test_etagMatching);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
@@ -0,0 +1,232 @@
+#include "DebugConfiguration.h"
+#include "TestUtil.h"
+#include <unity.h>
+
+#ifdef ARCH_PORTDUINO
+#include "wifi/WsPushQueue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static WsPushQueue *queue;
+static char frame[WS_PUSH_MAX_FRAME];
+
+void setUp(void)
+{
+    queue = new WsPushQueue();
+}
+
+void tearDown(void)
+{
+    delete queue;
+}
+
+static void pushEvent(int id, size_t padding = 0)
+{
+    char json[WS_PUSH_MAX_EVENT];
+    int n = snprintf(json, sizeof(json), "{\"id\":%d,\"pad\":\"", id);
+    memset(json + n, 'x', padding);
+    n += padding;
+    n += snprintf(json + n, sizeof(json) - n, "\"}");
+    TEST_ASSERT_TRUE(queue->push(json, n));
+}
+
+/// Ids of the events in a frame, in order, -1 if it is not a JSON array
+static int frameIds(const char *f, size_t len, int *ids, int max)
+{
+    int count = 0;
+    if (len < 2 || f[0] != '[' || f[len - 1] != ']')
+        return -1;
+    for (const char *p = f; (p = strstr(p, "\"id\":")) != NULL && p < f + len && count < max; p += 5)
+        ids[count++] = atoi(p + 5);
+    return count;
+}
+
+static void test_burstIsCoalesced()
+{
+    queue->attach(0);
+    for (int i = 0; i < 10; i++)
+        pushEvent(i);
+
+    size_t len = queue->buildFrame(0, frame, sizeof(frame));
+    int ids[16];
+    TEST_ASSERT_EQUAL(10, frameIds(frame, len, ids, 16));
+    for (int i = 0; i < 10; i++)
+        TEST_ASSERT_EQUAL(i, ids[i]);
+    TEST_ASSERT_EQUAL(']', frame[len - 1]);
+    TEST_ASSERT_NOT_EQUAL(',', frame[len - 2]);
+
+    queue->consumed(0);
+    TEST_ASSERT_FALSE(queue->hasPending(0));
+    TEST_ASSERT_EQUAL(0, queue->buildFrame(0, frame, sizeof(frame)));
+}
+
+static void test_frameSizeIsBounded()
+{
+    queue->attach(0);
+    for (int i = 0; i < 6; i++)
+        pushEvent(i, 400);
+
+    // Three ~410 byte events per frame, the rest waits for the next tick
+    int ids[16], seen = 0;
+    while (queue->hasPending(0)) {
+        size_t len = queue->buildFrame(0, frame, sizeof(frame));
+        TEST_ASSERT_LESS_OR_EQUAL(WS_PUSH_MAX_FRAME, len);
+        int n = frameIds(frame, len, ids, 16);
+        TEST_ASSERT_GREATER_THAN(0, n);
+        for (int i = 0; i < n; i++)
+            TEST_ASSERT_EQUAL(seen + i, ids[i]);
+        seen += n;
+        queue->consumed(0);
+    }
+    TEST_ASSERT_EQUAL(6, seen);
+}
+
+static void test_unsentFrameIsRetried()
+{
+    queue->attach(0);
+    pushEvent(1);
+    queue->buildFrame(0, frame, sizeof(frame));
+
+    // The send failed, nothing consumed: the next frame starts from the same event and picks up the new one
+    pushEvent(2);
+    int ids[4];
+    size_t len = queue->buildFrame(0, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL(2, frameIds(frame, len, ids, 4));
+    TEST_ASSERT_EQUAL(1, ids[0]);
+}
+
+static void test_slowClientDropsOldest()
+{
+    queue->attach(0);
+    queue->attach(1);
+
+    // Client 1 keeps up, client 0 never manages to send
+    int ids[64], nextFast = 0;
+    for (int i = 0; i < 200; i++) {
+        pushEvent(i, 100);
+        size_t len = queue->buildFrame(1, frame, sizeof(frame));
+        int n = frameIds(frame, len, ids, 64);
+        TEST_ASSERT_EQUAL(1, n);
+        TEST_ASSERT_EQUAL(nextFast++, ids[0]);
+        queue->consumed(1);
+    }
+    TEST_ASSERT_EQUAL(0, queue->getDropped(1));
+
+    // The slow one gets the newest events the ring still holds, and knows how many it missed
+    size_t len = queue->buildFrame(0, frame, sizeof(frame));
+    int n = frameIds(frame, len, ids, 64);
+    TEST_ASSERT_GREATER_THAN(0, n);
+    uint32_t dropped = queue->getDropped(0);
+    TEST_ASSERT_EQUAL(200 - queue->getQueuedCount(), dropped);
+    TEST_ASSERT_EQUAL((int)dropped, ids[0]);
+    TEST_ASSERT_EQUAL(dropped, queue->getStats().eventsDropped);
+}
+
+static void test_caughtUpClientsShareFrame()
+{
+    for (uint8_t c = 0; c < 3; c++)
+        queue->attach(c);
+    pushEvent(1);
+    pushEvent(2);
+
+    size_t len = queue->buildFrame(0, frame, sizeof(frame));
+    TEST_ASSERT_TRUE(queue->shareFrame(1, 0));
+    TEST_ASSERT_TRUE(queue->shareFrame(2, 0));
+    for (uint8_t c = 0; c < 3; c++)
+        queue->consumed(c);
+    TEST_ASSERT_EQUAL(1, queue->getStats().framesBuilt);
+    TEST_ASSERT_GREATER_THAN(0, len);
+
+    // Once they diverge they need their own frame
+    pushEvent(3);
+    queue->buildFrame(0, frame, sizeof(frame));
+    queue->consumed(0);
+    pushEvent(4);
+    queue->buildFrame(0, frame, sizeof(frame));
+    TEST_ASSERT_FALSE(queue->shareFrame(1, 0));
+}
+
+static void test_lateClientOnlySeesNewEvents()
+{
+    pushEvent(1);
+    queue->attach(3);
+    TEST_ASSERT_FALSE(queue->hasPending(3));
+    pushEvent(2);
+
+    int ids[4];
+    size_t len = queue->buildFrame(3, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL(1, frameIds(frame, len, ids, 4));
+    TEST_ASSERT_EQUAL(2, ids[0]);
+
+    queue->detach(3);
+    TEST_ASSERT_FALSE(queue->hasPending(3));
+    TEST_ASSERT_EQUAL(0, queue->buildFrame(3, frame, sizeof(frame)));
+}
+
+static void test_targetedEventsReachOneClient()
+{
+    queue->attach(0);
+    queue->attach(1);
+    pushEvent(1);
+    TEST_ASSERT_TRUE(queue->push("{\"id\":2}", 8, 1));
+    pushEvent(3);
+
+    int ids[4];
+    size_t len = queue->buildFrame(0, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL(2, frameIds(frame, len, ids, 4));
+    TEST_ASSERT_EQUAL(1, ids[0]);
+    TEST_ASSERT_EQUAL(3, ids[1]);
+    // The frame is not the same for everyone any more
+    TEST_ASSERT_FALSE(queue->shareFrame(1, 0));
+    queue->consumed(0);
+
+    len = queue->buildFrame(1, frame, sizeof(frame));
+    TEST_ASSERT_EQUAL(3, frameIds(frame, len, ids, 4));
+    TEST_ASSERT_EQUAL(2, ids[1]);
+    queue->consumed(1);
+
+    // Nothing but someone else's events: nothing to send, and nothing left pending
+    TEST_ASSERT_TRUE(queue->push("{\"id\":4}", 8, 1));
+    TEST_ASSERT_TRUE(queue->hasPending(0));
+    TEST_ASSERT_EQUAL(0, queue->buildFrame(0, frame, sizeof(frame)));
+    TEST_ASSERT_FALSE(queue->hasPending(0));
+}
+
+static void test_oversizeEventRefused()
+{
+    static char big[WS_PUSH_MAX_EVENT + 1];
+    memset(big, 'x', sizeof(big));
+    TEST_ASSERT_FALSE(queue->push(big, sizeof(big)));
+    TEST_ASSERT_FALSE(queue->push(big, 0));
+    TEST_ASSERT_EQUAL(2, queue->getStats().eventsRefused);
+    TEST_ASSERT_EQUAL(0, queue->getQueuedCount());
+}
+
+void setup()
+{
+    initializeTestEnvironment();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_burstIsCoalesced);
+    RUN_TEST(test_frameSizeIsBounded);
+    RUN_TEST(test_unsentFrameIsRetried);
+    RUN_TEST(test_slowClientDropsOldest);
+    RUN_TEST(test_caughtUpClientsShareFrame);
+    RUN_TEST(test_lateClientOnlySeesNewEvents);
+    RUN_TEST(test_targetedEventsReachOneClient);
+    RUN_TEST(test_oversizeEventRefused);
+    exit(UNITY_END());
+}
+#else
+void setup()
+{
+    initializeTestEnvironment();
+    LOG_WARN("This test requires the ARCH_PORTDUINO variant");
+    UNITY_BEGIN();
+    UNITY_END();
+}
+#endif
+
+void loop() {}
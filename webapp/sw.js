@@ -0,0 +1,33 @@
+// Keeps the whole UI cached so reopening it costs the node nothing, or a couple of 304s when it checks for an update.
+// precache.json (generated by bin/webapp-pack.py) lists every asset and a version that changes with any of them.
+const PREFIX = 'emergency-ui-';
+
+async function refresh() {
+    const manifest = await (await fetch('/precache.json', { cache: 'no-cache' })).json();
+    const name = PREFIX + manifest.version;
+    if (!(await caches.has(name))) {
+        const cache = await caches.open(name);
+        // Revalidate rather than trust the HTTP cache, the assets may be from the previous firmware
+        await cache.addAll(manifest.assets.map((url) => new Request(url, { cache: 'no-cache' })));
+    }
+    for (const key of await caches.keys()) {
+        if (key.startsWith(PREFIX) && key !== name) await caches.delete(key);
+    }
+}
+
+self.addEventListener('install', (event) => {
+    event.waitUntil(refresh().then(() => self.skipWaiting()));
+});
+
+self.addEventListener('activate', (event) => {
+    event.waitUntil(self.clients.claim());
+});
+
+self.addEventListener('fetch', (event) => {
+    const request = event.request;
+    if (request.method !== 'GET' || new URL(request.url).origin !== self.location.origin) return;
+
+    // sw.js itself does not change with the UI, so look for a new version whenever the page is opened
+    if (request.mode === 'navigate') event.waitUntil(refresh().catch(() => {}));
+    event.respondWith(caches.match(request).then((cached) => cached || fetch(request)));
+});